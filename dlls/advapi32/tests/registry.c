@@ -3278,6 +3278,89 @@ static void test_delete_key_value(void)
     RegCloseKey(subkey);
 }
 
+static void test_many_subkeys(void)
+{
+    /* the full benchmark is only run in interactive mode */
+    DWORD count = winetest_interactive ? 1000000 : 5000;
+    DWORD i, n, start, type, data, size, subkeys, values;
+    char name[32];
+    HKEY hkey, subkey;
+    LONG ret;
+
+    ret = RegCreateKeyExA(hkey_main, "Many", 0, NULL, 0, KEY_ALL_ACCESS, NULL, &hkey, NULL);
+    ok(!ret, "RegCreateKeyExA failed: %d\n", ret);
+
+    /* insert them out of order */
+    start = GetTickCount();
+    for (i = 0; i < count; i++)
+    {
+        n = (DWORD)(((ULONGLONG)i * 7919) % count);
+        sprintf(name, "Key%07u", n);
+        ret = RegCreateKeyExA(hkey, name, 0, NULL, 0, KEY_ALL_ACCESS, NULL, &subkey, NULL);
+        ok(!ret, "RegCreateKeyExA %s failed: %d\n", name, ret);
+        RegCloseKey(subkey);
+        ret = RegSetValueExA(hkey, name, 0, REG_DWORD, (const BYTE *)&n, sizeof(n));
+        ok(!ret, "RegSetValueExA %s failed: %d\n", name, ret);
+    }
+    trace("created %u keys and values in %u ms\n", count, GetTickCount() - start);
+
+    start = GetTickCount();
+    for (i = 0; i < count; i++)
+    {
+        sprintf(name, "KEY%07u", i);
+        ret = RegOpenKeyExA(hkey, name, 0, KEY_READ, &subkey);
+        ok(!ret, "RegOpenKeyExA %s failed: %d\n", name, ret);
+        RegCloseKey(subkey);
+        size = sizeof(data);
+        ret = RegQueryValueExA(hkey, name, NULL, &type, (BYTE *)&data, &size);
+        ok(!ret, "RegQueryValueExA %s failed: %d\n", name, ret);
+        ok(type == REG_DWORD && data == i, "%s: got type %u data %u\n", name, type, data);
+    }
+    trace("queried %u keys and values in %u ms\n", count, GetTickCount() - start);
+
+    ret = RegQueryInfoKeyA(hkey, NULL, NULL, NULL, &subkeys, NULL, NULL, &values, NULL, NULL, NULL, NULL);
+    ok(!ret, "RegQueryInfoKeyA failed: %d\n", ret);
+    ok(subkeys == count, "got %u subkeys\n", subkeys);
+    ok(values == count, "got %u values\n", values);
+
+    /* subkeys are enumerated in sorted order */
+    start = GetTickCount();
+    for (i = 0; i < count; i++)
+    {
+        char expect[32];
+
+        size = sizeof(name);
+        ret = RegEnumKeyExA(hkey, i, name, &size, NULL, NULL, NULL, NULL);
+        ok(!ret, "RegEnumKeyExA %u failed: %d\n", i, ret);
+        sprintf(expect, "Key%07u", i);
+        ok(!strcmp(name, expect), "%u: got %s\n", i, name);
+        if (strcmp(name, expect)) break;
+    }
+    size = sizeof(name);
+    ret = RegEnumKeyExA(hkey, count, name, &size, NULL, NULL, NULL, NULL);
+    ok(ret == ERROR_NO_MORE_ITEMS, "RegEnumKeyExA returned %d\n", ret);
+    trace("enumerated %u keys in %u ms\n", count, GetTickCount() - start);
+
+    start = GetTickCount();
+    for (i = count; i > 0; i--)
+    {
+        sprintf(name, "Key%07u", i - 1);
+        ret = RegDeleteKeyA(hkey, name);
+        ok(!ret, "RegDeleteKeyA %s failed: %d\n", name, ret);
+        ret = RegDeleteValueA(hkey, name);
+        ok(!ret, "RegDeleteValueA %s failed: %d\n", name, ret);
+    }
+    trace("deleted %u keys and values in %u ms\n", count, GetTickCount() - start);
+
+    ret = RegQueryInfoKeyA(hkey, NULL, NULL, NULL, &subkeys, NULL, NULL, &values, NULL, NULL, NULL, NULL);
+    ok(!ret, "RegQueryInfoKeyA failed: %d\n", ret);
+    ok(!subkeys && !values, "got %u subkeys %u values\n", subkeys, values);
+
+    RegCloseKey(hkey);
+    ret = RegDeleteKeyA(hkey_main, "Many");
+    ok(!ret, "RegDeleteKeyA failed: %d\n", ret);
+}
+
 START_TEST(registry)
 {
     /* Load pointers for functions that are not available in all Windows versions */
@@ -3310,6 +3393,7 @@ START_TEST(registry)
     test_deleted_key();
     test_delete_value();
     test_delete_key_value();
+    test_many_subkeys();
 
     /* cleanup */
     delete_key( hkey_main );
@@ -0,0 +1,235 @@
+/*
+ * DIB driver banding of large operations
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * Operations covering a large number of pixels are split into horizontal
+ * bands that are drawn in parallel by the calling thread and the threads of
+ * a small private pool. The bands of an operation don't depend on each
+ * other, so the result is the same as drawing them in sequence. The calling
+ * thread takes bands until none are left and cancels the callbacks that
+ * haven't started yet, so the operation completes even if the pool threads
+ * can't run, e.g. while the loader lock is held.
+ *
+ * Setting WINEDIBBANDS=0 in the environment draws everything in sequence.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "gdi_private.h"
+#include "dibdrv.h"
+
+#include "wine/debug.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(dib);
+
+#define MAX_BAND_THREADS  8             /* maximum number of threads drawing an operation */
+#define MIN_BAND_PIXELS   (256 * 1024)  /* smaller operations are drawn by the calling thread */
+#define MIN_BAND_ROWS     16            /* minimum height of a band */
+#define BANDS_PER_THREAD  4             /* more bands than threads to balance the load */
+
+struct band_job
+{
+    band_func func;
+    void     *arg;
+    int       rows;       /* total number of rows */
+    int       band_rows;  /* number of rows in a band */
+    LONG      next;       /* index of the next band to draw */
+};
+
+static INIT_ONCE band_once = INIT_ONCE_STATIC_INIT;
+static TP_CALLBACK_ENVIRON band_environ;
+static int band_threads;
+
+static BOOL CALLBACK init_band_pool( INIT_ONCE *once, void *param, void **context )
+{
+    const char *env = getenv( "WINEDIBBANDS" );
+    SYSTEM_INFO info;
+    PTP_POOL pool;
+
+    GetSystemInfo( &info );
+    band_threads = min( info.dwNumberOfProcessors, MAX_BAND_THREADS );
+    if (env && !atoi( env )) band_threads = 1;
+    if (band_threads < 2) return TRUE;
+
+    if (!(pool = CreateThreadpool( NULL )))
+    {
+        band_threads = 1;
+        return TRUE;
+    }
+    SetThreadpoolThreadMaximum( pool, band_threads - 1 );
+    band_environ.Version = 1;
+    band_environ.Pool = pool;
+    TRACE( "drawing large operations with %d threads\n", band_threads );
+    return TRUE;
+}
+
+static void draw_bands( struct band_job *job )
+{
+    int start;
+
+    while ((start = (InterlockedIncrement( &job->next ) - 1) * job->band_rows) < job->rows)
+        job->func( job->arg, start, min( start + job->band_rows, job->rows ));
+}
+
+static void CALLBACK band_callback( TP_CALLBACK_INSTANCE *instance, void *context, TP_WORK *work )
+{
+    draw_bands( context );
+}
+
+/***********************************************************************
+ *           run_bands
+ *
+ * Call func for bands of rows covering 0 to rows, in parallel when the
+ * operation is large enough. width is the average number of pixels per row.
+ */
+void run_bands( band_func func, void *arg, int rows, int width )
+{
+    struct band_job job;
+    PTP_WORK work;
+    int i, bands;
+
+    if (rows < 2 * MIN_BAND_ROWS || (LONGLONG)rows * width < MIN_BAND_PIXELS ||
+        !InitOnceExecuteOnce( &band_once, init_band_pool, NULL, NULL ) || band_threads < 2 ||
+        !(work = CreateThreadpoolWork( band_callback, &job, &band_environ )))
+    {
+        func( arg, 0, rows );
+        return;
+    }
+
+    bands = min( rows / MIN_BAND_ROWS, band_threads * BANDS_PER_THREAD );
+    job.func = func;
+    job.arg = arg;
+    job.rows = rows;
+    job.band_rows = (rows + bands - 1) / bands;
+    job.next = 0;
+
+    for (i = 1; i < band_threads; i++) SubmitThreadpoolWork( work );
+    draw_bands( &job );
+    WaitForThreadpoolWorkCallbacks( work, TRUE );
+    CloseThreadpoolWork( work );
+}
+
+struct rect_bands
+{
+    int             num;
+    const RECT     *rects;
+    int             top;
+    rect_band_func  func;
+    void           *arg;
+};
+
+static void draw_rect_band( void *arg, int start, int end )
+{
+    const struct rect_bands *bands = arg;
+    RECT rc;
+    int i;
+
+    for (i = 0; i < bands->num; i++)
+    {
+        rc = bands->rects[i];
+        rc.top = max( rc.top, bands->top + start );
+        rc.bottom = min( rc.bottom, bands->top + end );
+        if (rc.top < rc.bottom) bands->func( bands->arg, &rc );
+    }
+}
+
+/***********************************************************************
+ *           run_rect_bands
+ *
+ * Call func for the parts of a list of non-overlapping rectangles in each band.
+ */
+void run_rect_bands( int num, const RECT *rects, rect_band_func func, void *arg )
+{
+    struct rect_bands bands;
+    LONGLONG area = 0;
+    int i, bottom;
+
+    if (!num) return;
+
+    bands.num = num;
+    bands.rects = rects;
+    bands.top = rects[0].top;
+    bands.func = func;
+    bands.arg = arg;
+    bottom = rects[0].bottom;
+    for (i = 0; i < num; i++)
+    {
+        bands.top = min( bands.top, rects[i].top );
+        bottom = max( bottom, rects[i].bottom );
+        area += (LONGLONG)(rects[i].right - rects[i].left) * (rects[i].bottom - rects[i].top);
+    }
+    run_bands( draw_rect_band, &bands, bottom - bands.top, area / (bottom - bands.top) );
+}
+
+struct solid_rects_params
+{
+    const dib_info *dib;
+    DWORD           and;
+    DWORD           xor;
+};
+
+static void solid_rect_band( void *arg, const RECT *rc )
+{
+    const struct solid_rects_params *params = arg;
+
+    params->dib->funcs->solid_rects( params->dib, 1, rc, params->and, params->xor );
+}
+
+/***********************************************************************
+ *           solid_rects_bands
+ */
+void solid_rects_bands( const dib_info *dib, int num, const RECT *rects, DWORD and, DWORD xor )
+{
+    struct solid_rects_params params;
+
+    params.dib = dib;
+    params.and = and;
+    params.xor = xor;
+    run_rect_bands( num, rects, solid_rect_band, &params );
+}
+
+struct pattern_rects_params
+{
+    const dib_info      *dib;
+    const POINT         *origin;
+    const dib_info      *brush;
+    const rop_mask_bits *bits;
+};
+
+static void pattern_rect_band( void *arg, const RECT *rc )
+{
+    const struct pattern_rects_params *params = arg;
+
+    params->dib->funcs->pattern_rects( params->dib, 1, rc, params->origin, params->brush, params->bits );
+}
+
+/***********************************************************************
+ *           pattern_rects_bands
+ */
+void pattern_rects_bands( const dib_info *dib, int num, const RECT *rects, const POINT *origin,
+                          const dib_info *brush, const rop_mask_bits *bits )
+{
+    struct pattern_rects_params params;
+
+    params.dib = dib;
+    params.origin = origin;
+    params.brush = brush;
+    params.bits = bits;
+    run_rect_bands( num, rects, pattern_rect_band, &params );
+}
@@ -552,20 +552,38 @@ static void copy_rect( dib_info *dst, const RECT *dst_rect, const dib_info *src,
     }
 }
 
+struct blend_rect_params
+{
+    dib_info       *dst;
+    const RECT     *dst_rect;
+    const dib_info *src;
+    const RECT     *src_rect;
+    BLENDFUNCTION   blend;
+};
+
+static void blend_rect_band( void *arg, const RECT *rc )
+{
+    const struct blend_rect_params *params = arg;
+    POINT origin;
+
+    origin.x = params->src_rect->left + rc->left - params->dst_rect->left;
+    origin.y = params->src_rect->top  + rc->top  - params->dst_rect->top;
+    params->dst->funcs->blend_rect( params->dst, rc, params->src, &origin, params->blend );
+}
+
 static DWORD blend_rect( dib_info *dst, const RECT *dst_rect, const dib_info *src, const RECT *src_rect,
                          HRGN clip, BLENDFUNCTION blend )
 {
-    POINT origin;
+    struct blend_rect_params params;
     struct clipped_rects clipped_rects;
-    int i;
 
     if (!get_clipped_rects( dst, dst_rect, clip, &clipped_rects )) return ERROR_SUCCESS;
-    for (i = 0; i < clipped_rects.count; i++)
-    {
-        origin.x = src_rect->left + clipped_rects.rects[i].left - dst_rect->left;
-        origin.y = src_rect->top  + clipped_rects.rects[i].top  - dst_rect->top;
-        dst->funcs->blend_rect( dst, &clipped_rects.rects[i], src, &origin, blend );
-    }
+    params.dst = dst;
+    params.dst_rect = dst_rect;
+    params.src = src;
+    params.src_rect = src_rect;
+    params.blend = blend;
+    run_rect_bands( clipped_rects.count, clipped_rects.rects, blend_rect_band, &params );
     free_clipped_rects( &clipped_rects );
     return ERROR_SUCCESS;
 }
@@ -649,19 +667,35 @@ static void get_gradient_triangle_vertices( const GRADIENT_TRIANGLE *tri, const
     bounds->bottom = v[2].y;
 }
 
+struct gradient_rect_params
+{
+    dib_info        *dib;
+    const TRIVERTEX *v;
+    int              mode;
+    LONG             failed;
+};
+
+static void gradient_rect_band( void *arg, const RECT *rc )
+{
+    struct gradient_rect_params *params = arg;
+
+    if (!params->failed && !params->dib->funcs->gradient_rect( params->dib, rc, params->v, params->mode ))
+        InterlockedExchange( &params->failed, TRUE );
+}
+
 static BOOL gradient_rect( dib_info *dib, TRIVERTEX *v, int mode, HRGN clip, const RECT *bounds )
 {
-    int i;
+    struct gradient_rect_params params;
     struct clipped_rects clipped_rects;
-    BOOL ret = TRUE;
 
     if (!get_clipped_rects( dib, bounds, clip, &clipped_rects )) return TRUE;
-    for (i = 0; i < clipped_rects.count; i++)
-    {
-        if (!(ret = dib->funcs->gradient_rect( dib, &clipped_rects.rects[i], v, mode ))) break;
-    }
+    params.dib = dib;
+    params.v = v;
+    params.mode = mode;
+    params.failed = FALSE;
+    run_rect_bands( clipped_rects.count, clipped_rects.rects, gradient_rect_band, &params );
     free_clipped_rects( &clipped_rects );
-    return ret;
+    return !params.failed;
 }
 
 static DWORD copy_src_bits( dib_info *src, RECT *src_rect )
@@ -1147,111 +1181,147 @@ static DWORD calc_1d_stretch_params( INT dst_start, INT dst_length, INT dst_vis_
 }
 
 
-DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bitblt_coords *src,
-                          const BITMAPINFO *dst_info, void *dst_bits, struct bitblt_coords *dst,
-                          INT mode )
+struct stretch_rows_params
 {
-    dib_info src_dib, dst_dib;
-    POINT dst_start, src_start, dst_end, src_end;
-    RECT rect;
-    BOOL hstretch, vstretch;
-    struct stretch_params v_params, h_params;
-    int err;
-    DWORD ret;
+    dib_info             *dst_dib;
+    const dib_info       *src_dib;
+    POINT                 dst_start;
+    POINT                 src_start;
+    struct stretch_params v_params;
+    struct stretch_params h_params;
+    int                   mode;
+    BOOL                  vstretch;
+    int                   width;
     void (* row_fn)(const dib_info *dst_dib, const POINT *dst_start,
                     const dib_info *src_dib, const POINT *src_start,
                     const struct stretch_params *params, int mode, BOOL keep_dst);
+};
 
-    TRACE("dst %d, %d - %d x %d visrect %s src %d, %d - %d x %d visrect %s\n",
-          dst->x, dst->y, dst->width, dst->height, wine_dbgstr_rect(&dst->visrect),
-          src->x, src->y, src->width, src->height, wine_dbgstr_rect(&src->visrect));
-
-    init_dib_info_from_bitmapinfo( &src_dib, src_info, src_bits );
-    init_dib_info_from_bitmapinfo( &dst_dib, dst_info, dst_bits );
-
-    /* v */
-    ret = calc_1d_stretch_params( dst->y, dst->height, dst->visrect.top, dst->visrect.bottom,
-                                  src->y, src->height, src->visrect.top, src->visrect.bottom,
-                                  &dst_start.y, &src_start.y, &dst_end.y, &src_end.y,
-                                  &v_params, &vstretch );
-    if (ret) return ret;
-
-    /* h */
-    ret = calc_1d_stretch_params( dst->x, dst->width, dst->visrect.left, dst->visrect.right,
-                                  src->x, src->width, src->visrect.left, src->visrect.right,
-                                  &dst_start.x, &src_start.x, &dst_end.x, &src_end.x,
-                                  &h_params, &hstretch );
-    if (ret) return ret;
-
-    TRACE("got dst start %d, %d inc %d, %d. src start %d, %d inc %d, %d len %d x %d\n",
-          dst_start.x, dst_start.y, h_params.dst_inc, v_params.dst_inc,
-          src_start.x, src_start.y, h_params.src_inc, v_params.src_inc,
-          h_params.length, v_params.length);
-
-    get_bounding_rect( &rect, dst_start.x, dst_start.y, dst_end.x - dst_start.x, dst_end.y - dst_start.y );
-    intersect_rect( &dst->visrect, &dst->visrect, &rect );
-
-    dst_start.x -= dst->visrect.left;
-    dst_start.y -= dst->visrect.top;
-
-    err = v_params.err_start;
-
-    row_fn = hstretch ? dst_dib.funcs->stretch_row : dst_dib.funcs->shrink_row;
+/* draw the rows of the vertical stretch/shrink steps from start to end; a band starting in
+ * the middle of a duplicated row draws it again from the source, and one starting in the
+ * middle of a merged row leaves it to the previous band */
+static void stretch_rows( void *arg, int start, int end )
+{
+    const struct stretch_rows_params *params = arg;
+    const struct stretch_params *v_params = &params->v_params;
+    POINT dst_start = params->dst_start, src_start = params->src_start;
+    int i, err = v_params->err_start;
 
-    if (vstretch)
+    if (params->vstretch)
     {
         BOOL need_row = TRUE;
         RECT last_row, this_row;
-        if (hstretch) mode = STRETCH_DELETESCANS;
         last_row.left = 0;
-        last_row.right = dst->visrect.right - dst->visrect.left;
+        last_row.right = params->width;
 
-        while (v_params.length--)
+        for (i = 0; i < end; i++)
         {
-            if (need_row)
-            {
-                row_fn( &dst_dib, &dst_start, &src_dib, &src_start, &h_params, mode, FALSE );
-                need_row = FALSE;
-            }
-            else
+            if (i >= start)
             {
-                last_row.top = dst_start.y - v_params.dst_inc;
-                last_row.bottom = last_row.top + 1;
-                this_row = last_row;
-                offset_rect( &this_row, 0, v_params.dst_inc );
-                copy_rect( &dst_dib, &this_row, &dst_dib, &last_row, NULL, R2_COPYPEN );
+                if (need_row || i == start)
+                    params->row_fn( params->dst_dib, &dst_start, params->src_dib, &src_start,
+                                    &params->h_params, params->mode, FALSE );
+                else
+                {
+                    last_row.top = dst_start.y - v_params->dst_inc;
+                    last_row.bottom = last_row.top + 1;
+                    this_row = last_row;
+                    offset_rect( &this_row, 0, v_params->dst_inc );
+                    copy_rect( params->dst_dib, &this_row, params->dst_dib, &last_row, NULL, R2_COPYPEN );
+                }
             }
+            need_row = FALSE;
 
             if (err > 0)
             {
-                src_start.y += v_params.src_inc;
+                src_start.y += v_params->src_inc;
                 need_row = TRUE;
-                err += v_params.err_add_1;
+                err += v_params->err_add_1;
             }
-            else err += v_params.err_add_2;
-            dst_start.y += v_params.dst_inc;
+            else err += v_params->err_add_2;
+            dst_start.y += v_params->dst_inc;
         }
     }
     else
     {
         int merged_rows = 0;
+        BOOL draw = FALSE;
 
-        while (v_params.length--)
+        for (i = 0; i < v_params->length; i++)
         {
-            if (mode != STRETCH_DELETESCANS || !merged_rows)
-                row_fn( &dst_dib, &dst_start, &src_dib, &src_start, &h_params, mode, merged_rows != 0 );
+            if (!merged_rows)
+            {
+                if (i >= end) break;
+                draw = (i >= start);
+            }
+            if (draw && (params->mode != STRETCH_DELETESCANS || !merged_rows))
+                params->row_fn( params->dst_dib, &dst_start, params->src_dib, &src_start,
+                                &params->h_params, params->mode, merged_rows != 0 );
             merged_rows++;
 
             if (err > 0)
             {
-                dst_start.y += v_params.dst_inc;
+                dst_start.y += v_params->dst_inc;
                 merged_rows = 0;
-                err += v_params.err_add_1;
+                err += v_params->err_add_1;
             }
-            else err += v_params.err_add_2;
-            src_start.y += v_params.src_inc;
+            else err += v_params->err_add_2;
+            src_start.y += v_params->src_inc;
         }
     }
+}
+
+DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bitblt_coords *src,
+                          const BITMAPINFO *dst_info, void *dst_bits, struct bitblt_coords *dst,
+                          INT mode )
+{
+    dib_info src_dib, dst_dib;
+    POINT dst_end, src_end;
+    RECT rect;
+    BOOL hstretch;
+    struct stretch_rows_params params;
+    DWORD ret;
+
+    TRACE("dst %d, %d - %d x %d visrect %s src %d, %d - %d x %d visrect %s\n",
+          dst->x, dst->y, dst->width, dst->height, wine_dbgstr_rect(&dst->visrect),
+          src->x, src->y, src->width, src->height, wine_dbgstr_rect(&src->visrect));
+
+    init_dib_info_from_bitmapinfo( &src_dib, src_info, src_bits );
+    init_dib_info_from_bitmapinfo( &dst_dib, dst_info, dst_bits );
+
+    /* v */
+    ret = calc_1d_stretch_params( dst->y, dst->height, dst->visrect.top, dst->visrect.bottom,
+                                  src->y, src->height, src->visrect.top, src->visrect.bottom,
+                                  &params.dst_start.y, &params.src_start.y, &dst_end.y, &src_end.y,
+                                  &params.v_params, &params.vstretch );
+    if (ret) return ret;
+
+    /* h */
+    ret = calc_1d_stretch_params( dst->x, dst->width, dst->visrect.left, dst->visrect.right,
+                                  src->x, src->width, src->visrect.left, src->visrect.right,
+                                  &params.dst_start.x, &params.src_start.x, &dst_end.x, &src_end.x,
+                                  &params.h_params, &hstretch );
+    if (ret) return ret;
+
+    TRACE("got dst start %d, %d inc %d, %d. src start %d, %d inc %d, %d len %d x %d\n",
+          params.dst_start.x, params.dst_start.y, params.h_params.dst_inc, params.v_params.dst_inc,
+          params.src_start.x, params.src_start.y, params.h_params.src_inc, params.v_params.src_inc,
+          params.h_params.length, params.v_params.length);
+
+    get_bounding_rect( &rect, params.dst_start.x, params.dst_start.y,
+                       dst_end.x - params.dst_start.x, dst_end.y - params.dst_start.y );
+    intersect_rect( &dst->visrect, &dst->visrect, &rect );
+
+    params.dst_start.x -= dst->visrect.left;
+    params.dst_start.y -= dst->visrect.top;
+
+    params.dst_dib = &dst_dib;
+    params.src_dib = &src_dib;
+    params.row_fn = hstretch ? dst_dib.funcs->stretch_row : dst_dib.funcs->shrink_row;
+    params.mode = (params.vstretch && hstretch) ? STRETCH_DELETESCANS : mode;
+    params.width = dst->visrect.right - dst->visrect.left;
+
+    run_bands( stretch_rows, &params, params.v_params.length, params.h_params.length );
 
     /* update coordinates, the destination rectangle is always stored at 0,0 */
     *src = *dst;
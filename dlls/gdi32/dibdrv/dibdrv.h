@@ -78,6 +78,33 @@ typedef struct dib_brush
                   int num, const RECT *rects, INT rop);
 } dib_brush;
 
+struct cached_glyph
+{
+    GLYPHMETRICS metrics;
+    BYTE         bits[1];
+};
+
+/* identifies the rendering of a font in the shared glyph cache; the
+ * layout is the same for 32-bit and 64-bit processes */
+struct glyph_cache_key
+{
+    ULONGLONG     file_hash;    /* hash of the font file path */
+    LARGE_INTEGER file_size;
+    FILETIME      write_time;
+    WORD          face_index;
+    WORD          simulations;
+    UINT          aa_flags;
+    LONG          height;
+    LONG          width;
+    LONG          escapement;
+    LONG          orientation;
+    LONG          weight;
+    BYTE          italic;
+    BYTE          charset;
+    BYTE          pad[2];
+    XFORM         xform;
+};
+
 struct intensity_range
 {
     BYTE r_min, r_max;
@@ -203,11 +230,12 @@ typedef struct primitive_funcs
                                     const struct stretch_params *params, int mode, BOOL keep_dst);
 } primitive_funcs;
 
-extern const primitive_funcs funcs_8888 DECLSPEC_HIDDEN;
-extern const primitive_funcs funcs_32   DECLSPEC_HIDDEN;
-extern const primitive_funcs funcs_24   DECLSPEC_HIDDEN;
-extern const primitive_funcs funcs_555  DECLSPEC_HIDDEN;
-extern const primitive_funcs funcs_16   DECLSPEC_HIDDEN;
+/* the 32, 24 and 16 bpp tables are patched by init_simd_primitives() */
+extern primitive_funcs funcs_8888       DECLSPEC_HIDDEN;
+extern primitive_funcs funcs_32         DECLSPEC_HIDDEN;
+extern primitive_funcs funcs_24         DECLSPEC_HIDDEN;
+extern primitive_funcs funcs_555        DECLSPEC_HIDDEN;
+extern primitive_funcs funcs_16         DECLSPEC_HIDDEN;
 extern const primitive_funcs funcs_8    DECLSPEC_HIDDEN;
 extern const primitive_funcs funcs_4    DECLSPEC_HIDDEN;
 extern const primitive_funcs funcs_1    DECLSPEC_HIDDEN;
@@ -238,6 +266,19 @@ struct clipped_rects
 };
 
 extern void get_rop_codes(INT rop, struct rop_codes *codes) DECLSPEC_HIDDEN;
+
+typedef void (*band_func)( void *arg, int start, int end );
+typedef void (*rect_band_func)( void *arg, const RECT *rc );
+extern void run_bands( band_func func, void *arg, int rows, int width ) DECLSPEC_HIDDEN;
+extern void run_rect_bands( int num, const RECT *rects, rect_band_func func, void *arg ) DECLSPEC_HIDDEN;
+extern void solid_rects_bands( const dib_info *dib, int num, const RECT *rects, DWORD and, DWORD xor ) DECLSPEC_HIDDEN;
+extern void pattern_rects_bands( const dib_info *dib, int num, const RECT *rects, const POINT *origin,
+                                 const dib_info *brush, const rop_mask_bits *bits ) DECLSPEC_HIDDEN;
+extern BOOL get_glyph_cache_key( HDC hdc, const LOGFONTW *lf, const XFORM *xform, UINT aa_flags,
+                                 struct glyph_cache_key *key ) DECLSPEC_HIDDEN;
+extern struct cached_glyph *get_shared_glyph( const struct glyph_cache_key *key, UINT index, UINT flags ) DECLSPEC_HIDDEN;
+extern void put_shared_glyph( const struct glyph_cache_key *key, UINT index, UINT flags,
+                              const struct cached_glyph *glyph, DWORD size ) DECLSPEC_HIDDEN;
 extern void reset_dash_origin(dibdrv_physdev *pdev) DECLSPEC_HIDDEN;
 extern void init_dib_info_from_bitmapinfo(dib_info *dib, const BITMAPINFO *info, void *bits) DECLSPEC_HIDDEN;
 extern BOOL init_dib_info_from_bitmapobj(dib_info *dib, BITMAPOBJ *bmp) DECLSPEC_HIDDEN;
@@ -0,0 +1,405 @@
+/*
+ * DIB driver glyph cache shared between processes
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * When enabled, the rendered glyph bitmaps are also stored in a named section
+ * mapped by all the processes of the prefix, so that each glyph only needs to
+ * be rasterized once. Glyphs are identified by the font file, face index,
+ * simulations, size, transform and anti-aliasing mode of the font, and by
+ * their index. The section holds a hash table followed by slabs of fixed size
+ * slots, each slab with its own LRU list: when a slab is full, its least
+ * recently used glyph is replaced. A glyph can be evicted by another process
+ * at any time, so the glyphs that are found are copied to the per-process
+ * cache of the font. All accesses are serialized by a named mutex.
+ */
+
+#include <stdlib.h>
+
+#include "gdi_private.h"
+#include "dibdrv.h"
+#include "winreg.h"
+
+#include "wine/unicode.h"
+#include "wine/debug.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(dib);
+
+#define GLYPH_CACHE_MAGIC     0x474c5943  /* 'GLYC' */
+#define GLYPH_CACHE_MAX_SIZE  256         /* in megabytes */
+#define GLYPH_SLABS           8
+#define GLYPH_MIN_SLOT_SIZE   256         /* slot sizes are powers of two from this one */
+
+struct glyph_entry
+{
+    DWORD                  hash_next;  /* offset of the next entry in the hash chain */
+    DWORD                  lru_prev;   /* offset of the previous (more recently used) entry */
+    DWORD                  lru_next;   /* offset of the next (less recently used) entry */
+    DWORD                  hash;
+    DWORD                  slab;
+    UINT                   index;
+    UINT                   type;       /* ETO_GLYPH_INDEX or 0 */
+    DWORD                  size;       /* size of the glyph bits */
+    struct glyph_cache_key key;
+    struct cached_glyph    glyph;
+};
+
+struct glyph_slab
+{
+    DWORD slot_size;
+    DWORD first;     /* offset of the first slot */
+    DWORD count;     /* number of slots */
+    DWORD used;      /* number of slots in use */
+    DWORD lru_head;  /* offset of the most recently used entry */
+    DWORD lru_tail;  /* offset of the least recently used entry */
+};
+
+struct glyph_cache
+{
+    DWORD             magic;
+    DWORD             size;        /* size of the section */
+    DWORD             entry_size;  /* size of struct glyph_entry, to catch layout changes */
+    DWORD             hash_size;   /* number of hash buckets, a power of two */
+    ULONGLONG         hits;
+    ULONGLONG         misses;
+    ULONGLONG         inserts;
+    ULONGLONG         evictions;
+    struct glyph_slab slabs[GLYPH_SLABS];
+    DWORD             buckets[1];  /* offsets of the first entry of the hash chains */
+};
+
+static const WCHAR glyph_cache_nameW[] = {'_','_','w','i','n','e','_','g','d','i','3','2','_',
+                                          'g','l','y','p','h','_','c','a','c','h','e',0};
+static const WCHAR glyph_cache_mutexW[] = {'_','_','w','i','n','e','_','g','d','i','3','2','_',
+                                           'g','l','y','p','h','_','c','a','c','h','e','_',
+                                           'm','u','t','e','x',0};
+
+static INIT_ONCE glyph_cache_once = INIT_ONCE_STATIC_INIT;
+static struct glyph_cache *glyph_cache;
+static DWORD glyph_cache_size;
+static HANDLE glyph_cache_mutex;
+
+static inline struct glyph_entry *get_entry( DWORD offset )
+{
+    return (struct glyph_entry *)((char *)glyph_cache + offset);
+}
+
+static inline DWORD get_offset( const struct glyph_entry *entry )
+{
+    return (const char *)entry - (const char *)glyph_cache;
+}
+
+static ULONGLONG hash_data( ULONGLONG hash, const void *data, SIZE_T size )
+{
+    const BYTE *ptr = data;
+
+    while (size--) hash = (hash ^ *ptr++) * 0x100000001b3;  /* FNV-1a */
+    return hash;
+}
+
+static DWORD hash_glyph( const struct glyph_cache_key *key, UINT index, UINT type )
+{
+    ULONGLONG hash = hash_data( 0xcbf29ce484222325, key, sizeof(*key) );
+
+    hash = hash_data( hash, &index, sizeof(index) );
+    hash = hash_data( hash, &type, sizeof(type) );
+    return hash ^ (hash >> 32);
+}
+
+/* initialize an empty cache; must be called with the mutex held */
+static void reset_glyph_cache(void)
+{
+    DWORD i, hash_size, header_size, slab_size;
+
+    for (hash_size = 1; hash_size * 2 <= glyph_cache_size / 1024; hash_size *= 2) ;
+    header_size = (FIELD_OFFSET( struct glyph_cache, buckets[hash_size] ) + 7) & ~7;
+    slab_size = ((glyph_cache_size - header_size) / GLYPH_SLABS) & ~7;
+
+    memset( glyph_cache, 0, header_size );
+    glyph_cache->size = glyph_cache_size;
+    glyph_cache->entry_size = sizeof(struct glyph_entry);
+    glyph_cache->hash_size = hash_size;
+    for (i = 0; i < GLYPH_SLABS; i++)
+    {
+        glyph_cache->slabs[i].slot_size = GLYPH_MIN_SLOT_SIZE << i;
+        glyph_cache->slabs[i].first = header_size + i * slab_size;
+        glyph_cache->slabs[i].count = slab_size / glyph_cache->slabs[i].slot_size;
+    }
+    glyph_cache->magic = GLYPH_CACHE_MAGIC;
+    TRACE( "%u bytes, %u buckets\n", glyph_cache_size, hash_size );
+}
+
+static BOOL lock_glyph_cache(void)
+{
+    switch (WaitForSingleObject( glyph_cache_mutex, INFINITE ))
+    {
+    case WAIT_OBJECT_0:
+        return TRUE;
+    case WAIT_ABANDONED:
+        WARN( "owner of the glyph cache died, resetting it\n" );
+        reset_glyph_cache();
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+static void unlock_glyph_cache(void)
+{
+    ReleaseMutex( glyph_cache_mutex );
+}
+
+static DWORD get_glyph_cache_config(void)
+{
+    char buffer[16];
+    DWORD type, count = sizeof(buffer), size = 0;
+    HKEY hkey;
+
+    /* @@ Wine registry key: HKCU\Software\Wine\Fonts */
+    if (RegOpenKeyA( HKEY_CURRENT_USER, "Software\\Wine\\Fonts", &hkey )) return 0;
+    if (!RegQueryValueExA( hkey, "GlyphCacheSize", NULL, &type, (BYTE *)buffer, &count ))
+    {
+        if (type == REG_DWORD && count == sizeof(DWORD)) memcpy( &size, buffer, sizeof(size) );
+        else if (type == REG_SZ) size = strtoul( buffer, NULL, 10 );
+    }
+    RegCloseKey( hkey );
+    return min( size, GLYPH_CACHE_MAX_SIZE );
+}
+
+static BOOL CALLBACK init_glyph_cache( INIT_ONCE *once, void *param, void **context )
+{
+    MEMORY_BASIC_INFORMATION mbi;
+    DWORD size = get_glyph_cache_config() << 20;
+    HANDLE mapping;
+    void *view;
+
+    if (!size) return TRUE;
+
+    if (!(glyph_cache_mutex = CreateMutexW( NULL, FALSE, glyph_cache_mutexW ))) return TRUE;
+    if (!(mapping = CreateFileMappingW( INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, size, glyph_cache_nameW )))
+        goto failed;
+    view = MapViewOfFile( mapping, FILE_MAP_WRITE, 0, 0, 0 );
+    CloseHandle( mapping );
+    if (!view) goto failed;
+
+    /* the section may have been created by another process with a different size */
+    VirtualQuery( view, &mbi, sizeof(mbi) );
+    glyph_cache = view;
+    glyph_cache_size = min( mbi.RegionSize, GLYPH_CACHE_MAX_SIZE << 20 );
+
+    if (!lock_glyph_cache()) goto failed;
+    if (glyph_cache->magic != GLYPH_CACHE_MAGIC) reset_glyph_cache();
+    else if (glyph_cache->entry_size != sizeof(struct glyph_entry) || glyph_cache->size != glyph_cache_size)
+    {
+        ERR( "incompatible glyph cache layout, not using it\n" );
+        unlock_glyph_cache();
+        goto failed;
+    }
+    unlock_glyph_cache();
+    TRACE( "using a %u byte shared glyph cache\n", glyph_cache_size );
+    return TRUE;
+
+failed:
+    if (glyph_cache) UnmapViewOfFile( glyph_cache );
+    glyph_cache = NULL;
+    CloseHandle( glyph_cache_mutex );
+    glyph_cache_mutex = 0;
+    return TRUE;
+}
+
+static struct glyph_entry *find_entry( const struct glyph_cache_key *key, UINT index, UINT type, DWORD hash )
+{
+    DWORD offset = glyph_cache->buckets[hash & (glyph_cache->hash_size - 1)];
+    struct glyph_entry *entry;
+
+    while (offset)
+    {
+        entry = get_entry( offset );
+        if (entry->hash == hash && entry->index == index && entry->type == type &&
+            !memcmp( &entry->key, key, sizeof(*key) ))
+            return entry;
+        offset = entry->hash_next;
+    }
+    return NULL;
+}
+
+static void remove_entry( struct glyph_entry *entry )
+{
+    struct glyph_slab *slab = &glyph_cache->slabs[entry->slab];
+    DWORD *ptr = &glyph_cache->buckets[entry->hash & (glyph_cache->hash_size - 1)];
+    DWORD offset = get_offset( entry );
+
+    while (*ptr != offset) ptr = &get_entry( *ptr )->hash_next;
+    *ptr = entry->hash_next;
+
+    if (entry->lru_prev) get_entry( entry->lru_prev )->lru_next = entry->lru_next;
+    else slab->lru_head = entry->lru_next;
+    if (entry->lru_next) get_entry( entry->lru_next )->lru_prev = entry->lru_prev;
+    else slab->lru_tail = entry->lru_prev;
+}
+
+static void add_entry( struct glyph_entry *entry )
+{
+    struct glyph_slab *slab = &glyph_cache->slabs[entry->slab];
+    DWORD *bucket = &glyph_cache->buckets[entry->hash & (glyph_cache->hash_size - 1)];
+    DWORD offset = get_offset( entry );
+
+    entry->hash_next = *bucket;
+    *bucket = offset;
+
+    entry->lru_prev = 0;
+    entry->lru_next = slab->lru_head;
+    if (slab->lru_head) get_entry( slab->lru_head )->lru_prev = offset;
+    else slab->lru_tail = offset;
+    slab->lru_head = offset;
+}
+
+static void trace_stats(void)
+{
+    ULONGLONG lookups = glyph_cache->hits + glyph_cache->misses;
+
+    if (lookups % 4096) return;
+    TRACE( "%s lookups, %s hits, %s inserts, %s evictions\n", wine_dbgstr_longlong(lookups),
+           wine_dbgstr_longlong(glyph_cache->hits), wine_dbgstr_longlong(glyph_cache->inserts),
+           wine_dbgstr_longlong(glyph_cache->evictions) );
+}
+
+/***********************************************************************
+ *           get_glyph_cache_key
+ *
+ * Build the key of the font selected in hdc. Fails if the shared cache
+ * is disabled or if the font doesn't come from a file.
+ */
+BOOL get_glyph_cache_key( HDC hdc, const LOGFONTW *lf, const XFORM *xform, UINT aa_flags,
+                          struct glyph_cache_key *key )
+{
+    struct font_realization_info info;
+    struct font_fileinfo *fileinfo;
+    DWORD size;
+
+    InitOnceExecuteOnce( &glyph_cache_once, init_glyph_cache, NULL, NULL );
+    if (!glyph_cache) return FALSE;
+
+    info.size = sizeof(info);
+    if (!GetFontRealizationInfo( hdc, &info )) return FALSE;
+    if (GetFontFileInfo( info.instance_id, 0, NULL, 0, &size ) || GetLastError() != ERROR_INSUFFICIENT_BUFFER)
+        return FALSE;
+    if (!(fileinfo = HeapAlloc( GetProcessHeap(), 0, size ))) return FALSE;
+    if (!GetFontFileInfo( info.instance_id, 0, fileinfo, size, &size ) || !fileinfo->path[0])
+    {
+        /* memory fonts have no path */
+        HeapFree( GetProcessHeap(), 0, fileinfo );
+        return FALSE;
+    }
+
+    memset( key, 0, sizeof(*key) );
+    key->file_hash   = hash_data( 0xcbf29ce484222325, fileinfo->path, strlenW( fileinfo->path ) * sizeof(WCHAR) );
+    key->file_size   = fileinfo->size;
+    key->write_time  = fileinfo->writetime;
+    key->face_index  = info.face_index;
+    key->simulations = info.simulations;
+    key->aa_flags    = aa_flags;
+    key->height      = lf->lfHeight;
+    key->width       = lf->lfWidth;
+    key->escapement  = lf->lfEscapement;
+    key->orientation = lf->lfOrientation;
+    key->weight      = lf->lfWeight;
+    key->italic      = lf->lfItalic;
+    key->charset     = lf->lfCharSet;
+    key->xform       = *xform;
+    TRACE( "%s face %u -> %s\n", debugstr_w(fileinfo->path), info.face_index,
+           wine_dbgstr_longlong(key->file_hash) );
+    HeapFree( GetProcessHeap(), 0, fileinfo );
+    return TRUE;
+}
+
+/***********************************************************************
+ *           get_shared_glyph
+ *
+ * Return a copy of a glyph from the shared cache.
+ */
+struct cached_glyph *get_shared_glyph( const struct glyph_cache_key *key, UINT index, UINT flags )
+{
+    UINT type = flags & ETO_GLYPH_INDEX;
+    DWORD hash = hash_glyph( key, index, type );
+    struct glyph_entry *entry;
+    struct cached_glyph *glyph = NULL;
+
+    if (!glyph_cache || !lock_glyph_cache()) return NULL;
+
+    if ((entry = find_entry( key, index, type, hash )))
+    {
+        remove_entry( entry );
+        add_entry( entry );
+        glyph_cache->hits++;
+        if ((glyph = HeapAlloc( GetProcessHeap(), 0, FIELD_OFFSET( struct cached_glyph, bits[entry->size] ))))
+            memcpy( glyph, &entry->glyph, FIELD_OFFSET( struct cached_glyph, bits[entry->size] ));
+    }
+    else glyph_cache->misses++;
+
+    trace_stats();
+    unlock_glyph_cache();
+    return glyph;
+}
+
+/***********************************************************************
+ *           put_shared_glyph
+ *
+ * Store a glyph with size bytes of bits in the shared cache.
+ */
+void put_shared_glyph( const struct glyph_cache_key *key, UINT index, UINT flags,
+                       const struct cached_glyph *glyph, DWORD size )
+{
+    UINT type = flags & ETO_GLYPH_INDEX;
+    DWORD hash = hash_glyph( key, index, type );
+    DWORD i, total = FIELD_OFFSET( struct glyph_entry, glyph.bits[size] );
+    struct glyph_entry *entry;
+    struct glyph_slab *slab;
+
+    if (!glyph_cache) return;
+
+    for (i = 0; i < GLYPH_SLABS; i++) if (total <= GLYPH_MIN_SLOT_SIZE << i) break;
+    if (i == GLYPH_SLABS) return;  /* too large to be worth sharing */
+
+    if (!lock_glyph_cache()) return;
+
+    if (find_entry( key, index, type, hash )) goto done;  /* added by another process */
+
+    slab = &glyph_cache->slabs[i];
+    if (slab->used < slab->count)
+        entry = get_entry( slab->first + slab->used++ * slab->slot_size );
+    else if (slab->lru_tail)
+    {
+        entry = get_entry( slab->lru_tail );
+        remove_entry( entry );
+        glyph_cache->evictions++;
+    }
+    else goto done;
+
+    entry->hash  = hash;
+    entry->slab  = i;
+    entry->index = index;
+    entry->type  = type;
+    entry->size  = size;
+    entry->key   = *key;
+    memcpy( &entry->glyph, glyph, FIELD_OFFSET( struct cached_glyph, bits[size] ));
+    add_entry( entry );
+    glyph_cache->inserts++;
+
+done:
+    unlock_glyph_cache();
+}
@@ -27,12 +27,6 @@
 
 WINE_DEFAULT_DEBUG_CHANNEL(dib);
 
-struct cached_glyph
-{
-    GLYPHMETRICS metrics;
-    BYTE         bits[1];
-};
-
 enum glyph_type
 {
     GLYPH_INDEX,
@@ -51,6 +45,8 @@ struct cached_font
     LOGFONTW              lf;
     XFORM                 xform;
     UINT                  aa_flags;
+    LONG                  shared;  /* 1 if the glyphs can be shared between processes, -1 if not */
+    struct glyph_cache_key key;
     struct cached_glyph **glyphs[GLYPH_NBTYPES][GLYPH_CACHE_PAGES];
 };
 
@@ -539,6 +535,7 @@ static struct cached_font *add_cached_font( HDC hdc, HFONT hfont, UINT aa_flags
 
     *ptr = font;
     ptr->ref = 1;
+    ptr->shared = 0;
     memset( ptr->glyphs, 0, sizeof(ptr->glyphs) );
 done:
     list_add_head( &font_cache, &ptr->entry );
@@ -588,6 +585,19 @@ static struct cached_glyph *get_cached_glyph( struct cached_font *font, UINT ind
     return font->glyphs[type][page][index % GLYPH_CACHE_PAGE_SIZE];
 }
 
+static BOOL is_shared_font( HDC hdc, struct cached_font *font )
+{
+    if (!font->shared)
+    {
+        EnterCriticalSection( &font_cache_cs );
+        if (!font->shared)
+            InterlockedExchange( &font->shared, get_glyph_cache_key( hdc, &font->lf, &font->xform,
+                                                                     font->aa_flags, &font->key ) ? 1 : -1 );
+        LeaveCriticalSection( &font_cache_cs );
+    }
+    return font->shared > 0;
+}
+
 /**********************************************************************
  *                 get_text_bkgnd_masks
  *
@@ -672,6 +682,8 @@ static const int padding[4] = {0, 3, 2, 1};
  *
  * For non-antialiased bitmaps convert them to the 17-level format
  * using only values 0 or 16.
+ *
+ * Glyphs rendered by another process are taken from the shared cache.
  */
 static struct cached_glyph *cache_glyph_bitmap( HDC hdc, struct cached_font *font, UINT index, UINT flags )
 {
@@ -684,6 +696,10 @@ static struct cached_glyph *cache_glyph_bitmap( HDC hdc, struct cached_font *fon
     int pad = 0, stride, bit_count;
     GLYPHMETRICS metrics;
     struct cached_glyph *glyph;
+    BOOL shared = is_shared_font( hdc, font );
+
+    if (shared && (glyph = get_shared_glyph( &font->key, index, flags )))
+        return add_cached_glyph( font, index, flags, glyph );
 
     if (flags & ETO_GLYPH_INDEX) ggo_flags |= GGO_GLYPH_INDEX;
     indices[0] = index;
@@ -733,6 +749,7 @@ static struct cached_glyph *cache_glyph_bitmap( HDC hdc, struct cached_font *fon
 
 done:
     glyph->metrics = metrics;
+    if (shared) put_shared_glyph( &font->key, indices[0], flags, glyph, size );
     return add_cached_glyph( font, index, flags, glyph );
 }
 
@@ -1102,7 +1119,7 @@ BOOL dibdrv_PatBlt( PHYSDEV dev, struct bitblt_coords *dst, DWORD rop )
     case R2_WHITE: xor = ~0u;
         /* fall through */
     case R2_BLACK:
-        pdev->dib.funcs->solid_rects( &pdev->dib, clipped_rects.count, clipped_rects.rects, and, xor );
+        solid_rects_bands( &pdev->dib, clipped_rects.count, clipped_rects.rects, and, xor );
         /* fall through */
     case R2_NOP:
         break;
@@ -1763,7 +1763,7 @@ static BOOL solid_brush(dibdrv_physdev *pdev, dib_brush *brush, dib_info *dib,
     DWORD color = get_pixel_color( pdev->dev.hdc, &pdev->dib, brush->colorref, TRUE );
 
     calc_rop_masks( rop, color, &brush_color );
-    dib->funcs->solid_rects( dib, num, rects, brush_color.and, brush_color.xor );
+    solid_rects_bands( dib, num, rects, brush_color.and, brush_color.xor );
     return TRUE;
 }
 
@@ -2030,7 +2030,7 @@ static BOOL pattern_brush(dibdrv_physdev *pdev, dib_brush *brush, dib_info *dib,
 
     GetBrushOrgEx(pdev->dev.hdc, &origin);
 
-    dib->funcs->pattern_rects( dib, num, rects, &origin, &brush->dib, &brush->masks );
+    pattern_rects_bands( dib, num, rects, &origin, &brush->dib, &brush->masks );
 
     if (needs_reselect) free_pattern_brush( brush );
     return TRUE;
@@ -6225,7 +6225,7 @@ static void shrink_row_null(const dib_info *dst_dib, const POINT *dst_start,
     return;
 }
 
-const primitive_funcs funcs_8888 =
+primitive_funcs funcs_8888 =
 {
     solid_rects_32,
     solid_line_32,
@@ -6245,7 +6245,7 @@ const primitive_funcs funcs_8888 =
     shrink_row_32
 };
 
-const primitive_funcs funcs_32 =
+primitive_funcs funcs_32 =
 {
     solid_rects_32,
     solid_line_32,
@@ -6265,7 +6265,7 @@ const primitive_funcs funcs_32 =
     shrink_row_32
 };
 
-const primitive_funcs funcs_24 =
+primitive_funcs funcs_24 =
 {
     solid_rects_24,
     solid_line_24,
@@ -6285,7 +6285,7 @@ const primitive_funcs funcs_24 =
     shrink_row_24
 };
 
-const primitive_funcs funcs_555 =
+primitive_funcs funcs_555 =
 {
     solid_rects_16,
     solid_line_16,
@@ -6305,7 +6305,7 @@ const primitive_funcs funcs_555 =
     shrink_row_16
 };
 
-const primitive_funcs funcs_16 =
+primitive_funcs funcs_16 =
 {
     solid_rects_16,
     solid_line_16,
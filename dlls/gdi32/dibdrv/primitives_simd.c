@@ -0,0 +1,698 @@
+/*
+ * DIB driver SIMD primitives.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * The functions here replace some of the scalar primitives for the 32, 24
+ * and 16 bpp formats when the cpu supports SSE2 or AVX2. They work on rows
+ * of bytes, replicating the and/xor masks and the rop codes to the width of
+ * a vector, and must produce exactly the same pixels as the scalar versions.
+ *
+ * The stretch_row and shrink_row primitives are left scalar: each pixel
+ * depends on the error term of the previous one, and a plain copy of the
+ * gathered pixels is all the work there is to do once it's computed.
+ *
+ * Setting WINEDIBSIMD=0 in the environment keeps the scalar versions.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "gdi_private.h"
+#include "dibdrv.h"
+
+#include "wine/debug.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(dib);
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9) || defined(__clang__))
+
+#include <immintrin.h>
+
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+/* apply (dst & and) ^ xor to a row, the masks repeating every 4 bytes */
+typedef void (*rop_row_func)( BYTE *ptr, int len, DWORD and, DWORD xor );
+/* apply the rop codes to a row, the codes repeating every 4 bytes */
+typedef void (*rop_codes_row_func)( BYTE *dst, const BYTE *src, int len, const struct rop_codes *codes );
+/* apply (dst & and) ^ xor to a row, with a row of masks */
+typedef void (*rop_mask_row_func)( BYTE *dst, const BYTE *and, const BYTE *xor, int len );
+
+static rop_row_func rop_row;
+static rop_codes_row_func rop_codes_row;
+static rop_codes_row_func rop_codes_row_rev;
+static rop_mask_row_func rop_mask_row;
+
+static void (*draw_glyph_8888_scalar)( const dib_info *dib, const RECT *rect, const dib_info *glyph,
+                                       const POINT *origin, DWORD text_pixel,
+                                       const struct intensity_range *ranges );
+
+static inline BYTE *get_pixel_ptr( const dib_info *dib, int x, int y )
+{
+    return (BYTE *)dib->bits.ptr + (dib->rect.top + y) * dib->stride + (dib->rect.left + x) * dib->bit_count / 8;
+}
+
+static inline BYTE mask_byte( DWORD mask, int i )
+{
+    return mask >> ((i & 3) * 8);
+}
+
+static inline void rop_row_tail( BYTE *ptr, int i, int len, DWORD and, DWORD xor )
+{
+    for (; i < len; i++) ptr[i] = (ptr[i] & mask_byte( and, i )) ^ mask_byte( xor, i );
+}
+
+static inline void rop_codes_tail( BYTE *dst, const BYTE *src, int i, int len, const struct rop_codes *codes )
+{
+    BYTE and, xor;
+
+    for (; i < len; i++)
+    {
+        and = (src[i] & mask_byte( codes->a1, i )) ^ mask_byte( codes->a2, i );
+        xor = (src[i] & mask_byte( codes->x1, i )) ^ mask_byte( codes->x2, i );
+        dst[i] = (dst[i] & and) ^ xor;
+    }
+}
+
+static inline void rop_codes_tail_rev( BYTE *dst, const BYTE *src, int i, int len, const struct rop_codes *codes )
+{
+    BYTE and, xor;
+
+    while (len-- > i)
+    {
+        and = (src[len] & mask_byte( codes->a1, len )) ^ mask_byte( codes->a2, len );
+        xor = (src[len] & mask_byte( codes->x1, len )) ^ mask_byte( codes->x2, len );
+        dst[len] = (dst[len] & and) ^ xor;
+    }
+}
+
+static inline void rop_mask_tail( BYTE *dst, const BYTE *and, const BYTE *xor, int i, int len )
+{
+    for (; i < len; i++) dst[i] = (dst[i] & and[i]) ^ xor[i];
+}
+
+static TARGET_SSE2 void rop_row_sse2( BYTE *ptr, int len, DWORD and, DWORD xor )
+{
+    __m128i and_vec = _mm_set1_epi32( and ), xor_vec = _mm_set1_epi32( xor );
+    int i = 0;
+
+    if (!and)
+        for (; i + 16 <= len; i += 16) _mm_storeu_si128( (__m128i *)(ptr + i), xor_vec );
+    else
+        for (; i + 16 <= len; i += 16)
+        {
+            __m128i val = _mm_loadu_si128( (__m128i *)(ptr + i) );
+            _mm_storeu_si128( (__m128i *)(ptr + i), _mm_xor_si128( _mm_and_si128( val, and_vec ), xor_vec ));
+        }
+    rop_row_tail( ptr, i, len, and, xor );
+}
+
+static TARGET_AVX2 void rop_row_avx2( BYTE *ptr, int len, DWORD and, DWORD xor )
+{
+    __m256i and_vec = _mm256_set1_epi32( and ), xor_vec = _mm256_set1_epi32( xor );
+    int i = 0;
+
+    if (!and)
+        for (; i + 32 <= len; i += 32) _mm256_storeu_si256( (__m256i *)(ptr + i), xor_vec );
+    else
+        for (; i + 32 <= len; i += 32)
+        {
+            __m256i val = _mm256_loadu_si256( (__m256i *)(ptr + i) );
+            _mm256_storeu_si256( (__m256i *)(ptr + i),
+                                 _mm256_xor_si256( _mm256_and_si256( val, and_vec ), xor_vec ));
+        }
+    _mm256_zeroupper();
+    rop_row_tail( ptr, i, len, and, xor );
+}
+
+/* the masks repeat every 3 bytes, i.e. every 48 bytes for a vector width */
+static TARGET_SSE2 void rop_row_24_sse2( BYTE *ptr, int len, DWORD and, DWORD xor )
+{
+    BYTE and_bytes[48], xor_bytes[48];
+    __m128i and_vec[3], xor_vec[3];
+    int i, j;
+
+    for (i = 0; i < 48; i++)
+    {
+        and_bytes[i] = and >> ((i % 3) * 8);
+        xor_bytes[i] = xor >> ((i % 3) * 8);
+    }
+    for (j = 0; j < 3; j++)
+    {
+        and_vec[j] = _mm_loadu_si128( (__m128i *)and_bytes + j );
+        xor_vec[j] = _mm_loadu_si128( (__m128i *)xor_bytes + j );
+    }
+
+    for (i = 0; i + 48 <= len; i += 48)
+        for (j = 0; j < 3; j++)
+        {
+            __m128i val = _mm_loadu_si128( (__m128i *)(ptr + i) + j );
+            _mm_storeu_si128( (__m128i *)(ptr + i) + j,
+                              _mm_xor_si128( _mm_and_si128( val, and_vec[j] ), xor_vec[j] ));
+        }
+    for (j = 0; i < len; i++, j++) ptr[i] = (ptr[i] & and_bytes[j]) ^ xor_bytes[j];
+}
+
+static TARGET_SSE2 void rop_codes_row_sse2( BYTE *dst, const BYTE *src, int len, const struct rop_codes *codes )
+{
+    __m128i a1 = _mm_set1_epi32( codes->a1 ), a2 = _mm_set1_epi32( codes->a2 );
+    __m128i x1 = _mm_set1_epi32( codes->x1 ), x2 = _mm_set1_epi32( codes->x2 );
+    int i;
+
+    for (i = 0; i + 16 <= len; i += 16)
+    {
+        __m128i s = _mm_loadu_si128( (const __m128i *)(src + i) );
+        __m128i d = _mm_loadu_si128( (const __m128i *)(dst + i) );
+        __m128i and = _mm_xor_si128( _mm_and_si128( s, a1 ), a2 );
+        __m128i xor = _mm_xor_si128( _mm_and_si128( s, x1 ), x2 );
+        _mm_storeu_si128( (__m128i *)(dst + i), _mm_xor_si128( _mm_and_si128( d, and ), xor ));
+    }
+    rop_codes_tail( dst, src, i, len, codes );
+}
+
+/* for overlapping rows with dst right of src; each vector is loaded before being stored */
+static TARGET_SSE2 void rop_codes_row_rev_sse2( BYTE *dst, const BYTE *src, int len, const struct rop_codes *codes )
+{
+    __m128i a1 = _mm_set1_epi32( codes->a1 ), a2 = _mm_set1_epi32( codes->a2 );
+    __m128i x1 = _mm_set1_epi32( codes->x1 ), x2 = _mm_set1_epi32( codes->x2 );
+    int i;
+
+    /* keep the vectors aligned on the 4-byte period of the codes */
+    rop_codes_tail_rev( dst, src, len & ~3, len, codes );
+    for (i = len & ~3; i >= 16; i -= 16)
+    {
+        __m128i s = _mm_loadu_si128( (const __m128i *)(src + i - 16) );
+        __m128i d = _mm_loadu_si128( (const __m128i *)(dst + i - 16) );
+        __m128i and = _mm_xor_si128( _mm_and_si128( s, a1 ), a2 );
+        __m128i xor = _mm_xor_si128( _mm_and_si128( s, x1 ), x2 );
+        _mm_storeu_si128( (__m128i *)(dst + i - 16), _mm_xor_si128( _mm_and_si128( d, and ), xor ));
+    }
+    rop_codes_tail_rev( dst, src, 0, i, codes );
+}
+
+static TARGET_AVX2 void rop_codes_row_avx2( BYTE *dst, const BYTE *src, int len, const struct rop_codes *codes )
+{
+    __m256i a1 = _mm256_set1_epi32( codes->a1 ), a2 = _mm256_set1_epi32( codes->a2 );
+    __m256i x1 = _mm256_set1_epi32( codes->x1 ), x2 = _mm256_set1_epi32( codes->x2 );
+    int i;
+
+    for (i = 0; i + 32 <= len; i += 32)
+    {
+        __m256i s = _mm256_loadu_si256( (const __m256i *)(src + i) );
+        __m256i d = _mm256_loadu_si256( (const __m256i *)(dst + i) );
+        __m256i and = _mm256_xor_si256( _mm256_and_si256( s, a1 ), a2 );
+        __m256i xor = _mm256_xor_si256( _mm256_and_si256( s, x1 ), x2 );
+        _mm256_storeu_si256( (__m256i *)(dst + i), _mm256_xor_si256( _mm256_and_si256( d, and ), xor ));
+    }
+    _mm256_zeroupper();
+    rop_codes_tail( dst, src, i, len, codes );
+}
+
+static TARGET_AVX2 void rop_codes_row_rev_avx2( BYTE *dst, const BYTE *src, int len, const struct rop_codes *codes )
+{
+    __m256i a1 = _mm256_set1_epi32( codes->a1 ), a2 = _mm256_set1_epi32( codes->a2 );
+    __m256i x1 = _mm256_set1_epi32( codes->x1 ), x2 = _mm256_set1_epi32( codes->x2 );
+    int i;
+
+    rop_codes_tail_rev( dst, src, len & ~3, len, codes );
+    for (i = len & ~3; i >= 32; i -= 32)
+    {
+        __m256i s = _mm256_loadu_si256( (const __m256i *)(src + i - 32) );
+        __m256i d = _mm256_loadu_si256( (const __m256i *)(dst + i - 32) );
+        __m256i and = _mm256_xor_si256( _mm256_and_si256( s, a1 ), a2 );
+        __m256i xor = _mm256_xor_si256( _mm256_and_si256( s, x1 ), x2 );
+        _mm256_storeu_si256( (__m256i *)(dst + i - 32), _mm256_xor_si256( _mm256_and_si256( d, and ), xor ));
+    }
+    _mm256_zeroupper();
+    rop_codes_tail_rev( dst, src, 0, i, codes );
+}
+
+static TARGET_SSE2 void rop_mask_row_sse2( BYTE *dst, const BYTE *and, const BYTE *xor, int len )
+{
+    int i;
+
+    for (i = 0; i + 16 <= len; i += 16)
+    {
+        __m128i d = _mm_loadu_si128( (const __m128i *)(dst + i) );
+        __m128i a = _mm_loadu_si128( (const __m128i *)(and + i) );
+        __m128i x = _mm_loadu_si128( (const __m128i *)(xor + i) );
+        _mm_storeu_si128( (__m128i *)(dst + i), _mm_xor_si128( _mm_and_si128( d, a ), x ));
+    }
+    rop_mask_tail( dst, and, xor, i, len );
+}
+
+static TARGET_AVX2 void rop_mask_row_avx2( BYTE *dst, const BYTE *and, const BYTE *xor, int len )
+{
+    int i;
+
+    for (i = 0; i + 32 <= len; i += 32)
+    {
+        __m256i d = _mm256_loadu_si256( (const __m256i *)(dst + i) );
+        __m256i a = _mm256_loadu_si256( (const __m256i *)(and + i) );
+        __m256i x = _mm256_loadu_si256( (const __m256i *)(xor + i) );
+        _mm256_storeu_si256( (__m256i *)(dst + i), _mm256_xor_si256( _mm256_and_si256( d, a ), x ));
+    }
+    _mm256_zeroupper();
+    /* a pattern row is often only a vector or two wide */
+    if (i + 16 <= len)
+    {
+        __m128i d = _mm_loadu_si128( (const __m128i *)(dst + i) );
+        __m128i a = _mm_loadu_si128( (const __m128i *)(and + i) );
+        __m128i x = _mm_loadu_si128( (const __m128i *)(xor + i) );
+        _mm_storeu_si128( (__m128i *)(dst + i), _mm_xor_si128( _mm_and_si128( d, a ), x ));
+        i += 16;
+    }
+    rop_mask_tail( dst, and, xor, i, len );
+}
+
+static void solid_rects_32_simd( const dib_info *dib, int num, const RECT *rc, DWORD and, DWORD xor )
+{
+    BYTE *start;
+    int y, i;
+
+    for (i = 0; i < num; i++, rc++)
+    {
+        assert( !is_rect_empty( rc ));
+
+        start = get_pixel_ptr( dib, rc->left, rc->top );
+        for (y = rc->top; y < rc->bottom; y++, start += dib->stride)
+            rop_row( start, (rc->right - rc->left) * 4, and, xor );
+    }
+}
+
+static void solid_rects_24_simd( const dib_info *dib, int num, const RECT *rc, DWORD and, DWORD xor )
+{
+    BYTE *start;
+    int y, i;
+
+    for (i = 0; i < num; i++, rc++)
+    {
+        assert( !is_rect_empty( rc ));
+
+        start = get_pixel_ptr( dib, rc->left, rc->top );
+        for (y = rc->top; y < rc->bottom; y++, start += dib->stride)
+            rop_row_24_sse2( start, (rc->right - rc->left) * 3, and, xor );
+    }
+}
+
+static void solid_rects_16_simd( const dib_info *dib, int num, const RECT *rc, DWORD and, DWORD xor )
+{
+    BYTE *start;
+    int y, i;
+
+    and = (and & 0xffff) * 0x10001;
+    xor = (xor & 0xffff) * 0x10001;
+    for (i = 0; i < num; i++, rc++)
+    {
+        assert( !is_rect_empty( rc ));
+
+        start = get_pixel_ptr( dib, rc->left, rc->top );
+        for (y = rc->top; y < rc->bottom; y++, start += dib->stride)
+            rop_row( start, (rc->right - rc->left) * 2, and, xor );
+    }
+}
+
+/* the brush rows are processed in runs that end at the right edge of the brush */
+static void pattern_rects_simd( const dib_info *dib, int num, const RECT *rc, const POINT *origin,
+                                const dib_info *brush, const rop_mask_bits *bits, int bpp )
+{
+    BYTE *start, *start_and, *start_xor;
+    int x, y, i, len, brush_x, brush_y, offset_x;
+
+    for (i = 0; i < num; i++, rc++)
+    {
+        assert( !is_rect_empty( rc ));
+
+        offset_x = (rc->left - origin->x) % brush->width;
+        if (offset_x < 0) offset_x += brush->width;
+        brush_y = (rc->top - origin->y) % brush->height;
+        if (brush_y < 0) brush_y += brush->height;
+
+        start = get_pixel_ptr( dib, rc->left, rc->top );
+        for (y = rc->top; y < rc->bottom; y++, start += dib->stride)
+        {
+            start_xor = (BYTE *)bits->xor + brush_y * brush->stride;
+            start_and = bits->and ? (BYTE *)bits->and + brush_y * brush->stride : NULL;
+            for (x = rc->left, brush_x = offset_x; x < rc->right; x += len)
+            {
+                len = min( rc->right - x, brush->width - brush_x );
+                if (start_and)
+                    rop_mask_row( start + (x - rc->left) * bpp, start_and + brush_x * bpp,
+                                  start_xor + brush_x * bpp, len * bpp );
+                else
+                    memcpy( start + (x - rc->left) * bpp, start_xor + brush_x * bpp, len * bpp );
+                brush_x = 0;
+            }
+            if (++brush_y == brush->height) brush_y = 0;
+        }
+    }
+}
+
+static void pattern_rects_32_simd( const dib_info *dib, int num, const RECT *rc, const POINT *origin,
+                                   const dib_info *brush, const rop_mask_bits *bits )
+{
+    pattern_rects_simd( dib, num, rc, origin, brush, bits, 4 );
+}
+
+static void pattern_rects_24_simd( const dib_info *dib, int num, const RECT *rc, const POINT *origin,
+                                   const dib_info *brush, const rop_mask_bits *bits )
+{
+    pattern_rects_simd( dib, num, rc, origin, brush, bits, 3 );
+}
+
+static void pattern_rects_16_simd( const dib_info *dib, int num, const RECT *rc, const POINT *origin,
+                                   const dib_info *brush, const rop_mask_bits *bits )
+{
+    pattern_rects_simd( dib, num, rc, origin, brush, bits, 2 );
+}
+
+static void copy_rect_simd( const dib_info *dst, const RECT *rc, const dib_info *src,
+                            const POINT *origin, int rop2, int overlap, DWORD pixel_mask )
+{
+    BYTE *dst_start, *src_start;
+    int y, dst_stride, src_stride, len = (rc->right - rc->left) * dst->bit_count / 8;
+    struct rop_codes codes;
+
+    if (overlap & OVERLAP_BELOW)
+    {
+        dst_start = get_pixel_ptr( dst, rc->left, rc->bottom - 1 );
+        src_start = get_pixel_ptr( src, origin->x, origin->y + rc->bottom - rc->top - 1 );
+        dst_stride = -dst->stride;
+        src_stride = -src->stride;
+    }
+    else
+    {
+        dst_start = get_pixel_ptr( dst, rc->left, rc->top );
+        src_start = get_pixel_ptr( src, origin->x, origin->y );
+        dst_stride = dst->stride;
+        src_stride = src->stride;
+    }
+
+    if (rop2 == R2_COPYPEN)
+    {
+        for (y = rc->top; y < rc->bottom; y++, dst_start += dst_stride, src_start += src_stride)
+            memmove( dst_start, src_start, len );
+        return;
+    }
+
+    /* the scalar versions truncate the codes to the pixel size */
+    get_rop_codes( rop2, &codes );
+    codes.a1 = (codes.a1 & pixel_mask) * (~0u / pixel_mask);
+    codes.a2 = (codes.a2 & pixel_mask) * (~0u / pixel_mask);
+    codes.x1 = (codes.x1 & pixel_mask) * (~0u / pixel_mask);
+    codes.x2 = (codes.x2 & pixel_mask) * (~0u / pixel_mask);
+
+    for (y = rc->top; y < rc->bottom; y++, dst_start += dst_stride, src_start += src_stride)
+    {
+        if (overlap & OVERLAP_RIGHT)
+            rop_codes_row_rev( dst_start, src_start, len, &codes );
+        else
+            rop_codes_row( dst_start, src_start, len, &codes );
+    }
+}
+
+static void copy_rect_32_simd( const dib_info *dst, const RECT *rc, const dib_info *src,
+                               const POINT *origin, int rop2, int overlap )
+{
+    copy_rect_simd( dst, rc, src, origin, rop2, overlap, ~0u );
+}
+
+static void copy_rect_24_simd( const dib_info *dst, const RECT *rc, const dib_info *src,
+                               const POINT *origin, int rop2, int overlap )
+{
+    copy_rect_simd( dst, rc, src, origin, rop2, overlap, 0xff );
+}
+
+static void copy_rect_16_simd( const dib_info *dst, const RECT *rc, const dib_info *src,
+                               const POINT *origin, int rop2, int overlap )
+{
+    copy_rect_simd( dst, rc, src, origin, rop2, overlap, 0xffff );
+}
+
+/* (val + 127) / 255 for val <= 255 * 255, in 16-bit lanes */
+static inline TARGET_SSE2 __m128i div255_sse2( __m128i val )
+{
+    val = _mm_add_epi16( val, _mm_set1_epi16( 127 ));
+    val = _mm_add_epi16( val, _mm_add_epi16( _mm_srli_epi16( val, 8 ), _mm_set1_epi16( 1 )));
+    return _mm_srli_epi16( val, 8 );
+}
+
+/* pack two pixels of 16-bit channels, or'ing any carry into the next channel like the scalar code */
+static inline TARGET_SSE2 __m128i pack_carry_sse2( __m128i val )
+{
+    __m128i lo = _mm_or_si128( _mm_and_si128( val, _mm_set1_epi32( 0xffff ) ),
+                               _mm_and_si128( _mm_srli_epi32( val, 8 ), _mm_set1_epi32( ~0xff ) ));
+    val = _mm_or_si128( lo, _mm_srli_epi64( _mm_slli_epi32( lo, 16 ), 32 ));
+    return _mm_shuffle_epi32( val, _MM_SHUFFLE( 3, 1, 2, 0 ));
+}
+
+/* blend_argb_constant_alpha(), optionally with a 255 source alpha */
+static inline TARGET_SSE2 __m128i blend_constant_sse2( __m128i dst, __m128i src, __m128i alpha )
+{
+    __m128i zero = _mm_setzero_si128(), inv = _mm_sub_epi16( _mm_set1_epi16( 255 ), alpha );
+    __m128i lo, hi;
+
+    lo = _mm_add_epi16( _mm_mullo_epi16( _mm_unpacklo_epi8( src, zero ), alpha ),
+                        _mm_mullo_epi16( _mm_unpacklo_epi8( dst, zero ), inv ));
+    hi = _mm_add_epi16( _mm_mullo_epi16( _mm_unpackhi_epi8( src, zero ), alpha ),
+                        _mm_mullo_epi16( _mm_unpackhi_epi8( dst, zero ), inv ));
+    return _mm_packus_epi16( div255_sse2( lo ), div255_sse2( hi ));
+}
+
+/* blend_argb() and blend_argb_alpha() on two pixels of 16-bit channels */
+static inline TARGET_SSE2 __m128i blend_premult_sse2( __m128i dst, __m128i src )
+{
+    __m128i alpha = _mm_shufflehi_epi16( _mm_shufflelo_epi16( src, _MM_SHUFFLE( 3, 3, 3, 3 )),
+                                         _MM_SHUFFLE( 3, 3, 3, 3 ));
+    __m128i inv = _mm_sub_epi16( _mm_set1_epi16( 255 ), alpha );
+
+    return _mm_add_epi16( src, div255_sse2( _mm_mullo_epi16( dst, inv )));
+}
+
+static TARGET_SSE2 void blend_row_8888_sse2( DWORD *dst, const DWORD *src, int len, BLENDFUNCTION blend,
+                                             DWORD src_alpha )
+{
+    __m128i zero = _mm_setzero_si128(), alpha = _mm_set1_epi16( blend.SourceConstantAlpha );
+    __m128i d, s, lo, hi;
+    int x;
+
+    for (x = 0; x + 4 <= len; x += 4)
+    {
+        d = _mm_loadu_si128( (const __m128i *)(dst + x) );
+        s = _mm_loadu_si128( (const __m128i *)(src + x) );
+        if (blend.AlphaFormat & AC_SRC_ALPHA)
+        {
+            lo = _mm_unpacklo_epi8( s, zero );
+            hi = _mm_unpackhi_epi8( s, zero );
+            if (blend.SourceConstantAlpha != 255)
+            {
+                lo = div255_sse2( _mm_mullo_epi16( lo, alpha ));
+                hi = div255_sse2( _mm_mullo_epi16( hi, alpha ));
+            }
+            lo = pack_carry_sse2( blend_premult_sse2( _mm_unpacklo_epi8( d, zero ), lo ));
+            hi = pack_carry_sse2( blend_premult_sse2( _mm_unpackhi_epi8( d, zero ), hi ));
+            d = _mm_unpacklo_epi64( lo, hi );
+        }
+        else d = blend_constant_sse2( d, _mm_or_si128( s, _mm_set1_epi32( src_alpha )), alpha );
+        _mm_storeu_si128( (__m128i *)(dst + x), d );
+    }
+
+    /* do the remaining pixels as a whole vector */
+    if (x < len)
+    {
+        DWORD dst_buf[4] = { 0 }, src_buf[4] = { 0 };
+
+        memcpy( dst_buf, dst + x, (len - x) * 4 );
+        memcpy( src_buf, src + x, (len - x) * 4 );
+        blend_row_8888_sse2( dst_buf, src_buf, 4, blend, src_alpha );
+        memcpy( dst + x, dst_buf, (len - x) * 4 );
+    }
+}
+
+static void blend_rect_8888_simd( const dib_info *dst, const RECT *rc, const dib_info *src,
+                                  const POINT *origin, BLENDFUNCTION blend )
+{
+    BYTE *src_ptr = get_pixel_ptr( src, origin->x, origin->y );
+    BYTE *dst_ptr = get_pixel_ptr( dst, rc->left, rc->top );
+    DWORD src_alpha = (src->compression == BI_RGB) ? 0 : 0xff000000;
+    int y;
+
+    for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride, src_ptr += src->stride)
+        blend_row_8888_sse2( (DWORD *)dst_ptr, (const DWORD *)src_ptr, rc->right - rc->left, blend, src_alpha );
+}
+
+/* draw the pixels of a glyph row between x and end with the scalar code */
+static void draw_glyph_span( const dib_info *dib, const RECT *rect, const dib_info *glyph, const POINT *origin,
+                             int x, int end, int y, DWORD text_pixel, const struct intensity_range *ranges )
+{
+    RECT rc;
+    POINT pt;
+
+    rc.left   = rect->left + x;
+    rc.right  = rect->left + end;
+    rc.top    = y;
+    rc.bottom = y + 1;
+    pt.x = origin->x + x;
+    pt.y = origin->y + y - rect->top;
+    draw_glyph_8888_scalar( dib, &rc, glyph, &pt, text_pixel, ranges );
+}
+
+/* Glyph pixels are mostly either transparent (intensity <= 1) or opaque (>= 16). Blocks
+ * of such pixels are skipped or filled with vectors, and blocks of four pixels that
+ * contain anti-aliased ones are left to the scalar code. */
+static TARGET_SSE2 void draw_glyph_8888_sse2( const dib_info *dib, const RECT *rect, const dib_info *glyph,
+                                              const POINT *origin, DWORD text_pixel,
+                                              const struct intensity_range *ranges )
+{
+    BYTE *dst_ptr = get_pixel_ptr( dib, rect->left, rect->top );
+    const BYTE *glyph_ptr = (const BYTE *)glyph->bits.ptr + (glyph->rect.top + origin->y) * glyph->stride +
+                            glyph->rect.left + origin->x;
+    __m128i text = _mm_set1_epi32( text_pixel ), one = _mm_set1_epi8( 1 ), opaque = _mm_set1_epi8( 15 );
+    int x, i, y, width = rect->right - rect->left;
+
+    for (y = rect->top; y < rect->bottom; y++, dst_ptr += dib->stride, glyph_ptr += glyph->stride)
+    {
+        for (x = 0; x + 16 <= width; x += 16)
+        {
+            __m128i g = _mm_loadu_si128( (const __m128i *)(glyph_ptr + x) );
+            __m128i opaque_bytes = _mm_cmpgt_epi8( g, opaque ), lo, hi, sel[4], d;
+            int visible = _mm_movemask_epi8( _mm_cmpgt_epi8( g, one ));
+            int solid = _mm_movemask_epi8( opaque_bytes );
+
+            if (!visible) continue;
+            /* expand the opaque byte masks to dword masks, four pixels at a time */
+            lo = _mm_unpacklo_epi8( opaque_bytes, opaque_bytes );
+            hi = _mm_unpackhi_epi8( opaque_bytes, opaque_bytes );
+            sel[0] = _mm_unpacklo_epi16( lo, lo );
+            sel[1] = _mm_unpackhi_epi16( lo, lo );
+            sel[2] = _mm_unpacklo_epi16( hi, hi );
+            sel[3] = _mm_unpackhi_epi16( hi, hi );
+            for (i = 0; i < 4; i++)
+            {
+                int mask = (visible >> (i * 4)) & 0xf;
+
+                if (!mask) continue;
+                if (mask != ((solid >> (i * 4)) & 0xf))
+                {
+                    draw_glyph_span( dib, rect, glyph, origin, x + i * 4, x + i * 4 + 4, y, text_pixel, ranges );
+                    continue;
+                }
+                d = _mm_loadu_si128( (const __m128i *)(dst_ptr + (x + i * 4) * 4) );
+                d = _mm_or_si128( _mm_and_si128( sel[i], text ), _mm_andnot_si128( sel[i], d ));
+                _mm_storeu_si128( (__m128i *)(dst_ptr + (x + i * 4) * 4), d );
+            }
+        }
+        if (x < width) draw_glyph_span( dib, rect, glyph, origin, x, width, y, text_pixel, ranges );
+    }
+}
+
+static inline void do_cpuid( unsigned int ax, unsigned int cx, unsigned int *p )
+{
+#ifdef __i386__
+    __asm__( "pushl %%ebx\n\t"
+             "cpuid\n\t"
+             "movl %%ebx, %%esi\n\t"
+             "popl %%ebx"
+             : "=a" (p[0]), "=S" (p[1]), "=c" (p[2]), "=d" (p[3])
+             : "0" (ax), "2" (cx) );
+#else
+    __asm__( "cpuid"
+             : "=a" (p[0]), "=b" (p[1]), "=c" (p[2]), "=d" (p[3])
+             : "0" (ax), "2" (cx) );
+#endif
+}
+
+static BOOL have_sse2(void)
+{
+    unsigned int regs[4];
+
+    do_cpuid( 1, 0, regs );
+    return (regs[3] >> 26) & 1;
+}
+
+static BOOL have_avx2(void)
+{
+    unsigned int regs[4], xcr0;
+
+    do_cpuid( 0, 0, regs );
+    if (regs[0] < 7) return FALSE;
+    do_cpuid( 1, 0, regs );
+    if ((regs[2] & 0x18000000) != 0x18000000) return FALSE;  /* OSXSAVE and AVX */
+    __asm__( "xgetbv" : "=a" (xcr0) : "c" (0) : "edx" );
+    if ((xcr0 & 6) != 6) return FALSE;  /* the OS saves the xmm and ymm state */
+    do_cpuid( 7, 0, regs );
+    return (regs[1] >> 5) & 1;
+}
+
+/***********************************************************************
+ *           init_simd_primitives
+ *
+ * Replace the scalar primitives by the SIMD versions the cpu supports.
+ */
+void init_simd_primitives(void)
+{
+    const char *env = getenv( "WINEDIBSIMD" );
+
+    if (env && !atoi( env )) return;
+    if (!have_sse2()) return;
+
+    if (have_avx2())
+    {
+        TRACE( "using AVX2 primitives\n" );
+        rop_row = rop_row_avx2;
+        rop_codes_row = rop_codes_row_avx2;
+        rop_codes_row_rev = rop_codes_row_rev_avx2;
+        rop_mask_row = rop_mask_row_avx2;
+    }
+    else
+    {
+        TRACE( "using SSE2 primitives\n" );
+        rop_row = rop_row_sse2;
+        rop_codes_row = rop_codes_row_sse2;
+        rop_codes_row_rev = rop_codes_row_rev_sse2;
+        rop_mask_row = rop_mask_row_sse2;
+    }
+    draw_glyph_8888_scalar = funcs_8888.draw_glyph;
+
+    funcs_8888.solid_rects   = solid_rects_32_simd;
+    funcs_8888.pattern_rects = pattern_rects_32_simd;
+    funcs_8888.copy_rect     = copy_rect_32_simd;
+    funcs_8888.blend_rect    = blend_rect_8888_simd;
+    funcs_8888.draw_glyph    = draw_glyph_8888_sse2;
+    funcs_32.solid_rects     = solid_rects_32_simd;
+    funcs_32.pattern_rects   = pattern_rects_32_simd;
+    funcs_32.copy_rect       = copy_rect_32_simd;
+    funcs_24.solid_rects     = solid_rects_24_simd;
+    funcs_24.pattern_rects   = pattern_rects_24_simd;
+    funcs_24.copy_rect       = copy_rect_24_simd;
+    funcs_555.solid_rects    = solid_rects_16_simd;
+    funcs_555.pattern_rects  = pattern_rects_16_simd;
+    funcs_555.copy_rect      = copy_rect_16_simd;
+    funcs_16.solid_rects     = solid_rects_16_simd;
+    funcs_16.pattern_rects   = pattern_rects_16_simd;
+    funcs_16.copy_rect       = copy_rect_16_simd;
+}
+
+#else  /* __GNUC__ && (__i386__ || __x86_64__) */
+
+void init_simd_primitives(void)
+{
+}
+
+#endif
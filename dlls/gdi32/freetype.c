@@ -172,6 +172,8 @@ static FT_Error (*pFT_Library_SetLcdFilter)(FT_Library, FT_LcdFilter);
 
 #ifdef SONAME_LIBFONTCONFIG
 #include <fontconfig/fontconfig.h>
+MAKE_FUNCPTR(FcConfigGetConfigFiles);
+MAKE_FUNCPTR(FcConfigGetFontDirs);
 MAKE_FUNCPTR(FcConfigSubstitute);
 MAKE_FUNCPTR(FcFontList);
 MAKE_FUNCPTR(FcFontSetDestroy);
@@ -184,6 +186,8 @@ MAKE_FUNCPTR(FcPatternDestroy);
 MAKE_FUNCPTR(FcPatternGetBool);
 MAKE_FUNCPTR(FcPatternGetInteger);
 MAKE_FUNCPTR(FcPatternGetString);
+MAKE_FUNCPTR(FcStrListDone);
+MAKE_FUNCPTR(FcStrListNext);
 #endif
 
 #undef MAKE_FUNCPTR
@@ -255,6 +259,7 @@ typedef struct tagFace {
     BOOL scalable;
     Bitmap_Size size;     /* set if face is a bitmap */
     DWORD flags;          /* ADDFONT flags */
+    BOOL indexed;         /* loaded from or stored in the font index */
     struct tagFamily *family;
     /* Cached data for Enum */
     struct enum_data *cached_enum_data;
@@ -269,11 +274,14 @@ typedef struct tagFace {
 
 typedef struct tagFamily {
     struct list entry;
+    struct list name_entry;     /* entry in the family name hash table */
+    struct list english_entry;  /* entry in the English name hash table */
     unsigned int refcount;
     WCHAR *FamilyName;
     WCHAR *EnglishName;
     struct list faces;
     struct list *replacement;
+    unsigned int seq;           /* position in font_list, later families have higher numbers */
 } Family;
 
 typedef struct {
@@ -364,14 +372,8 @@ typedef struct {
     GdiFont *font;
 } CHILD_FONT;
 
-struct font_fileinfo {
-    FILETIME writetime;
-    LARGE_INTEGER size;
-    WCHAR path[1];
-};
-
 struct tagGdiFont {
-    struct list entry;
+    struct list entry;          /* entry in the font hash table */
     struct list unused_entry;
     unsigned int refcount;
     GM **gm;
@@ -430,15 +432,22 @@ struct enum_charset_list {
 #define GM_BLOCK_SIZE 128
 #define FONT_GM(font,idx) (&(font)->gm[(idx) / GM_BLOCK_SIZE][(idx) % GM_BLOCK_SIZE])
 
-static struct list gdi_font_list = LIST_INIT(gdi_font_list);
+#define GDI_FONT_HASH_SIZE 256
+static struct list gdi_font_table[GDI_FONT_HASH_SIZE];
 static struct list unused_gdi_font_list = LIST_INIT(unused_gdi_font_list);
 static unsigned int unused_font_count;
 #define UNUSED_CACHE_SIZE 10
+static unsigned int font_cache_hits, font_cache_unused_hits, font_cache_misses;
 static struct list system_links = LIST_INIT(system_links);
 
 static struct list font_subst_list = LIST_INIT(font_subst_list);
 
 static struct list font_list = LIST_INIT(font_list);
+static unsigned int next_family_seq;
+
+#define FAMILY_HASH_SIZE 1024
+static struct list family_name_table[FAMILY_HASH_SIZE];
+static struct list family_english_table[FAMILY_HASH_SIZE];
 
 struct freetype_physdev
 {
@@ -544,6 +553,7 @@ static const WCHAR wine_fonts_key[] = {'S','o','f','t','w','a','r','e','\\','W',
                                        'F','o','n','t','s',0};
 static const WCHAR wine_fonts_cache_key[] = {'C','a','c','h','e',0};
 static const WCHAR english_name_value[] = {'E','n','g','l','i','s','h',' ','N','a','m','e',0};
+static const WCHAR font_list_value[] = {'F','o','n','t',' ','L','i','s','t',0};
 static const WCHAR face_index_value[] = {'I','n','d','e','x',0};
 static const WCHAR face_ntmflags_value[] = {'N','t','m','f','l','a','g','s',0};
 static const WCHAR face_version_value[] = {'V','e','r','s','i','o','n',0};
@@ -590,6 +600,7 @@ static const WCHAR szDefaultFallbackLink[] = {'M','i','c','r','o','s','o','f','t
 static BOOL use_default_fallback = FALSE;
 
 static BOOL get_glyph_index_linked(GdiFont *font, UINT c, GdiFont **linked_font, FT_UInt *glyph, BOOL *vert);
+static Family *get_family_from_names( WCHAR *name, WCHAR *english_name );
 static BOOL get_outline_text_metrics(GdiFont *font);
 static BOOL get_bitmap_text_metrics(GdiFont *font);
 static BOOL get_text_metrics(GdiFont *font, LPTEXTMETRICW ptm);
@@ -1025,11 +1036,47 @@ static Face *find_face_from_filename(const WCHAR *file_name, const WCHAR *face_n
     return NULL;
 }
 
+static void init_font_tables(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < FAMILY_HASH_SIZE; i++)
+    {
+        list_init( &family_name_table[i] );
+        list_init( &family_english_table[i] );
+    }
+    for (i = 0; i < GDI_FONT_HASH_SIZE; i++) list_init( &gdi_font_table[i] );
+}
+
+/* case-insensitive in the same way as strcmpiW */
+static unsigned int hash_family_name( const WCHAR *name )
+{
+    unsigned int hash = 0;
+
+    while (*name) hash = hash * 31 + tolowerW( *name++ );
+    return hash % FAMILY_HASH_SIZE;
+}
+
+static void add_family_to_table( Family *family )
+{
+    list_add_tail( &family_name_table[hash_family_name( family->FamilyName )], &family->name_entry );
+    if (family->EnglishName)
+        list_add_tail( &family_english_table[hash_family_name( family->EnglishName )], &family->english_entry );
+    else
+        list_init( &family->english_entry );
+}
+
+static void remove_family_from_table( Family *family )
+{
+    list_remove( &family->name_entry );
+    list_remove( &family->english_entry );
+}
+
 static Family *find_family_from_name(const WCHAR *name)
 {
     Family *family;
 
-    LIST_FOR_EACH_ENTRY(family, &font_list, Family, entry)
+    LIST_FOR_EACH_ENTRY(family, &family_name_table[hash_family_name( name )], Family, name_entry)
     {
         if(!strcmpiW(family->FamilyName, name))
             return family;
@@ -1040,19 +1087,35 @@ static Family *find_family_from_name(const WCHAR *name)
 
 static Family *find_family_from_any_name(const WCHAR *name)
 {
-    Family *family;
+    Family *family = find_family_from_name(name);
 
-    LIST_FOR_EACH_ENTRY(family, &font_list, Family, entry)
+    if (family) return family;
+
+    LIST_FOR_EACH_ENTRY(family, &family_english_table[hash_family_name( name )], Family, english_entry)
     {
-        if(!strcmpiW(family->FamilyName, name))
-            return family;
-        if(family->EnglishName && !strcmpiW(family->EnglishName, name))
+        if(!strcmpiW(family->EnglishName, name))
             return family;
     }
 
     return NULL;
 }
 
+/* check whether first comes before second in font_list */
+static BOOL family_precedes( const Family *first, const Family *second )
+{
+    return first->seq < second->seq;
+}
+
+/* number the families again after font_list has been reordered */
+static void renumber_families(void)
+{
+    Family *family;
+
+    next_family_seq = 0;
+    LIST_FOR_EACH_ENTRY( family, &font_list, Family, entry )
+        family->seq = next_family_seq++;
+}
+
 static void DumpSubstList(void)
 {
     FontSubst *psub;
@@ -1455,13 +1518,24 @@ static inline BOOL faces_equal( const Face *f1, const Face *f2 )
     return !memcmp( &f1->fs, &f2->fs, sizeof(f1->fs) );
 }
 
+static const char *font_index;  /* mapped font index, see below */
+static size_t font_index_size;
+
+/* strings loaded from the font index point into the mapping */
+static void free_font_string( WCHAR *str )
+{
+    if (font_index && (char *)str >= font_index && (char *)str < font_index + font_index_size) return;
+    HeapFree( GetProcessHeap(), 0, str );
+}
+
 static void release_family( Family *family )
 {
     if (--family->refcount) return;
     assert( list_empty( &family->faces ));
     list_remove( &family->entry );
-    HeapFree( GetProcessHeap(), 0, family->FamilyName );
-    HeapFree( GetProcessHeap(), 0, family->EnglishName );
+    remove_family_from_table( family );
+    free_font_string( family->FamilyName );
+    free_font_string( family->EnglishName );
     HeapFree( GetProcessHeap(), 0, family );
 }
 
@@ -1470,13 +1544,13 @@ static void release_face( Face *face )
     if (--face->refcount) return;
     if (face->family)
     {
-        if (face->flags & ADDFONT_ADD_TO_CACHE) remove_face_from_cache( face );
+        if ((face->flags & ADDFONT_ADD_TO_CACHE) && !face->indexed) remove_face_from_cache( face );
         list_remove( &face->entry );
         release_family( face->family );
     }
-    HeapFree( GetProcessHeap(), 0, face->file );
-    HeapFree( GetProcessHeap(), 0, face->StyleName );
-    HeapFree( GetProcessHeap(), 0, face->FullName );
+    free_font_string( face->file );
+    free_font_string( face->StyleName );
+    free_font_string( face->FullName );
     HeapFree( GetProcessHeap(), 0, face->cached_enum_data );
     HeapFree( GetProcessHeap(), 0, face );
 }
@@ -1564,7 +1638,9 @@ static Family *create_family( WCHAR *name, WCHAR *english_name )
     family->EnglishName = english_name;
     list_init( &family->faces );
     family->replacement = &family->faces;
+    family->seq = next_family_seq++;
     list_add_tail( &font_list, &family->entry );
+    add_family_to_table( family );
 
     return family;
 }
@@ -1617,6 +1693,7 @@ static void load_face(HKEY hkey_face, WCHAR *face_name, Family *family, void *bu
         face = HeapAlloc(GetProcessHeap(), 0, sizeof(*face));
         face->cached_enum_data = NULL;
         face->family = NULL;
+        face->indexed = FALSE;
 
         face->refcount = 1;
         face->file = strdupW( buffer );
@@ -1710,6 +1787,7 @@ static void reorder_vertical_fonts(void)
         else ptr = list_next( &font_list, ptr );
     }
     list_move_tail( &font_list, &vertical_families );
+    renumber_families();
 }
 
 static void load_font_list_from_cache(HKEY hkey_font_cache)
@@ -1732,17 +1810,8 @@ static void load_font_list_from_cache(HKEY hkey_font_cache)
         if (!RegQueryValueExW(hkey_family, english_name_value, NULL, NULL, (BYTE *)buffer, &size))
             english_family = strdupW( buffer );
 
-        family = create_family(family_name, english_family);
-
-        if(english_family)
-        {
-            FontSubst *subst = HeapAlloc(GetProcessHeap(), 0, sizeof(*subst));
-            subst->from.name = strdupW(english_family);
-            subst->from.charset = -1;
-            subst->to.name = strdupW(family_name);
-            subst->to.charset = -1;
-            add_font_subst(&font_subst_list, subst, 0);
-        }
+        /* the family may also have faces in the font index */
+        family = get_family_from_names(family_name, english_family);
 
         size = sizeof(buffer);
         while (!RegEnumKeyExW(hkey_family, face_index++, buffer, &size, NULL, NULL, NULL, NULL))
@@ -1763,7 +1832,7 @@ static void load_font_list_from_cache(HKEY hkey_font_cache)
         size = sizeof(buffer);
     }
 
-    reorder_vertical_fonts();
+    if (family_index > 1) reorder_vertical_fonts();
 }
 
 static LONG create_font_cache_key(HKEY *hkey, DWORD *disposition)
@@ -1895,14 +1964,10 @@ static void get_family_names( FT_Face ft_face, WCHAR **name, WCHAR **english, BO
     }
 }
 
-static Family *get_family( FT_Face ft_face, BOOL vertical )
+/* takes ownership of the names */
+static Family *get_family_from_names( WCHAR *name, WCHAR *english_name )
 {
-    Family *family;
-    WCHAR *name, *english_name;
-
-    get_family_names( ft_face, &name, &english_name, vertical );
-
-    family = find_family_from_name( name );
+    Family *family = find_family_from_name( name );
 
     if (!family)
     {
@@ -1919,14 +1984,22 @@ static Family *get_family( FT_Face ft_face, BOOL vertical )
     }
     else
     {
-        HeapFree( GetProcessHeap(), 0, name );
-        HeapFree( GetProcessHeap(), 0, english_name );
+        free_font_string( name );
+        free_font_string( english_name );
         family->refcount++;
     }
 
     return family;
 }
 
+static Family *get_family( FT_Face ft_face, BOOL vertical )
+{
+    WCHAR *name, *english_name;
+
+    get_family_names( ft_face, &name, &english_name, vertical );
+    return get_family_from_names( name, english_name );
+}
+
 static inline FT_Fixed get_font_version( FT_Face ft_face )
 {
     FT_Fixed version = 0;
@@ -2092,6 +2165,7 @@ static Face *create_face( FT_Face ft_face, FT_Long face_index, const char *file,
 
     if (!HIWORD( flags )) flags |= ADDFONT_AA_FLAGS( default_aa_flags );
     face->flags  = flags;
+    face->indexed = FALSE;
     face->family = NULL;
     face->cached_enum_data = NULL;
 
@@ -2103,14 +2177,8 @@ static Face *create_face( FT_Face ft_face, FT_Long face_index, const char *file,
     return face;
 }
 
-static void AddFaceToList(FT_Face ft_face, const char *file, void *font_data_ptr, DWORD font_data_size,
-                          FT_Long face_index, DWORD flags )
+static void add_face_to_family( Face *face, Family *family )
 {
-    Face *face;
-    Family *family;
-
-    face = create_face( ft_face, face_index, file, font_data_ptr, font_data_size, flags );
-    family = get_family( ft_face, flags & ADDFONT_VERTICAL_FONT );
     if (strlenW(family->FamilyName) >= LF_FACESIZE)
     {
         WARN("Ignoring %s because name is too long\n", debugstr_w(family->FamilyName));
@@ -2121,7 +2189,7 @@ static void AddFaceToList(FT_Face ft_face, const char *file, void *font_data_ptr
 
     if (insert_face_in_family_list( face, family ))
     {
-        if (flags & ADDFONT_ADD_TO_CACHE)
+        if ((face->flags & ADDFONT_ADD_TO_CACHE) && !face->indexed)
             add_face_to_cache( face );
 
         TRACE("Added font %s %s\n", debugstr_w(family->FamilyName),
@@ -2131,6 +2199,736 @@ static void AddFaceToList(FT_Face ft_face, const char *file, void *font_data_ptr
     release_family( family );
 }
 
+/*************************************************************
+ * The font index
+ *
+ * The faces found while building the font list are stored in a binary file
+ * in the prefix, which every process maps instead of opening all the font
+ * files again. The index stays valid as long as the scanned directories, the
+ * directories of the indexed files and, with fontconfig, all its font
+ * directories and configuration files keep their modification time, and
+ * the strings of the faces loaded from it point into the mapping. When it's
+ * out of date the font list is built again, reusing the faces of the files
+ * that haven't changed, and the index is replaced. Fonts added at run time
+ * are still shared through the volatile registry cache.
+ */
+
+#define FONT_INDEX_MAGIC    0x78646966  /* 'fidx' */
+#define FONT_INDEX_VERSION  1
+
+/* the layout is the same for 32-bit and 64-bit processes */
+struct font_index_header
+{
+    DWORD magic;
+    DWORD version;
+    DWORD size;        /* size of the file */
+    LCID  lcid;        /* face names depend on the system locale */
+    DWORD aa_flags;    /* default anti-aliasing flags */
+    DWORD config;      /* hash of the configured font path */
+    DWORD dir_count;
+    DWORD dirs;        /* offset of the struct font_index_dir array */
+    DWORD file_count;
+    DWORD files;       /* offset of the struct font_index_file array */
+    DWORD face_count;
+    DWORD faces;       /* offset of the struct font_index_face array */
+};
+
+struct font_index_dir
+{
+    ULONGLONG mtime;   /* 0 if the directory doesn't exist */
+    DWORD     name;    /* offset of the unix name */
+    DWORD     pad;
+};
+
+struct font_index_file
+{
+    ULONGLONG mtime;
+    ULONGLONG size;
+    ULONGLONG dev;
+    ULONGLONG ino;
+    DWORD     name;        /* offset of the unix name */
+    DWORD     nameW;       /* offset of the name used for Face.file */
+    DWORD     flags;       /* flags passed to AddFontToList */
+    INT       result;      /* value returned by AddFontToList */
+    DWORD     first_face;
+    DWORD     face_count;
+};
+
+struct font_index_face
+{
+    DWORD         family;  /* offsets of the names */
+    DWORD         english;
+    DWORD         style;
+    DWORD         full;
+    DWORD         face_index;
+    DWORD         ntm_flags;
+    DWORD         flags;
+    LONG          version;
+    LONG          size;
+    LONG          x_ppem;
+    LONG          y_ppem;
+    SHORT         height;
+    SHORT         width;
+    SHORT         internal_leading;
+    SHORT         scalable;
+    FONTSIGNATURE fs;
+};
+
+struct index_builder_dir
+{
+    char     *name;
+    ULONGLONG mtime;
+};
+
+struct index_builder_file
+{
+    char     *name;
+    WCHAR    *nameW;
+    ULONGLONG mtime;
+    ULONGLONG size;
+    ULONGLONG dev;
+    ULONGLONG ino;
+    DWORD     flags;
+    INT       result;
+    UINT      first_face;
+    UINT      face_count;
+};
+
+struct index_builder_face
+{
+    Face   face;     /* copy of the face, with its own copies of the names */
+    WCHAR *family;
+    WCHAR *english;
+};
+
+struct font_index_builder
+{
+    struct index_builder_dir      *dirs;
+    UINT                           dir_count, dir_size;
+    struct index_builder_file     *files;
+    UINT                           file_count, file_size;
+    struct index_builder_face     *faces;
+    UINT                           face_count, face_size;
+    struct index_builder_file     *current;    /* file whose faces are being added */
+    BOOL                           failed;
+    const struct font_index_file **old_files;  /* hash table of the files of the previous index */
+    UINT                           old_size;
+};
+
+static struct font_index_builder *font_index_builder;
+
+static INT AddFontToList(const char *file, void *font_data_ptr, DWORD font_data_size, DWORD flags);
+
+static inline const struct font_index_header *get_font_index_header(void)
+{
+    return (const struct font_index_header *)font_index;
+}
+
+static inline WCHAR *get_index_string( DWORD offset )
+{
+    return offset ? (WCHAR *)(font_index + offset) : NULL;
+}
+
+static ULONGLONG get_mtime( const struct stat *st )
+{
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    return (ULONGLONG)st->st_mtime * 1000000000 + st->st_mtim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    return (ULONGLONG)st->st_mtime * 1000000000 + st->st_mtimespec.tv_nsec;
+#else
+    return (ULONGLONG)st->st_mtime * 1000000000;
+#endif
+}
+
+static DWORD hash_index_name( const char *name )
+{
+    DWORD hash = 0;
+
+    while (*name) hash = hash * 33 + (unsigned char)*name++;
+    return hash;
+}
+
+static char *get_font_index_path(void)
+{
+    static const char name[] = "/fontindex";
+    const char *dir = wine_get_config_dir();
+    char *path;
+
+    if ((path = HeapAlloc( GetProcessHeap(), 0, strlen(dir) + sizeof(name) )))
+    {
+        strcpy( path, dir );
+        strcat( path, name );
+    }
+    return path;
+}
+
+/* hash of the font directories configured in HKCU\Software\Wine\Fonts */
+static DWORD get_font_index_config(void)
+{
+    static const WCHAR pathW[] = {'P','a','t','h',0};
+    DWORD hash = 0, size, i;
+    BYTE *data;
+    HKEY hkey;
+
+    if (RegOpenKeyW( HKEY_CURRENT_USER, wine_fonts_key, &hkey )) return 0;
+    if (!RegQueryValueExW( hkey, pathW, NULL, NULL, NULL, &size ) &&
+        (data = HeapAlloc( GetProcessHeap(), 0, size )))
+    {
+        if (!RegQueryValueExW( hkey, pathW, NULL, NULL, data, &size ))
+            for (i = 0; i < size; i++) hash = hash * 33 + data[i];
+        HeapFree( GetProcessHeap(), 0, data );
+    }
+    RegCloseKey( hkey );
+    return hash;
+}
+
+static BOOL check_index_array( DWORD offset, DWORD count, DWORD size )
+{
+    return !(offset % 8) && offset <= font_index_size && count <= (font_index_size - offset) / size;
+}
+
+static BOOL check_index_string( DWORD offset, DWORD align, BOOL optional )
+{
+    if (!offset) return optional;
+    return offset < font_index_size && !(offset % align);
+}
+
+/* check that the index can be used; it may still be out of date */
+static BOOL check_font_index(void)
+{
+    const struct font_index_header *header = get_font_index_header();
+    const struct font_index_dir *dirs;
+    const struct font_index_file *files;
+    const struct font_index_face *faces;
+    UINT i;
+
+    if (font_index_size < sizeof(*header) + sizeof(WCHAR)) return FALSE;
+    if (header->magic != FONT_INDEX_MAGIC || header->version != FONT_INDEX_VERSION) return FALSE;
+    if (header->size != font_index_size) return FALSE;
+    if (header->lcid != GetSystemDefaultLCID() || header->aa_flags != default_aa_flags) return FALSE;
+    if (!check_index_array( header->dirs, header->dir_count, sizeof(*dirs) ) ||
+        !check_index_array( header->files, header->file_count, sizeof(*files) ) ||
+        !check_index_array( header->faces, header->face_count, sizeof(*faces) ))
+        return FALSE;
+    /* the string area ends with a null WCHAR */
+    if (font_index[font_index_size - 1] || font_index[font_index_size - 2]) return FALSE;
+
+    dirs = (const struct font_index_dir *)(font_index + header->dirs);
+    for (i = 0; i < header->dir_count; i++)
+        if (!check_index_string( dirs[i].name, 1, FALSE )) return FALSE;
+
+    files = (const struct font_index_file *)(font_index + header->files);
+    for (i = 0; i < header->file_count; i++)
+    {
+        if (!check_index_string( files[i].name, 1, FALSE ) ||
+            !check_index_string( files[i].nameW, sizeof(WCHAR), FALSE ))
+            return FALSE;
+        if (files[i].first_face > header->face_count ||
+            files[i].face_count > header->face_count - files[i].first_face)
+            return FALSE;
+    }
+
+    faces = (const struct font_index_face *)(font_index + header->faces);
+    for (i = 0; i < header->face_count; i++)
+    {
+        if (!check_index_string( faces[i].family, sizeof(WCHAR), FALSE ) ||
+            !check_index_string( faces[i].english, sizeof(WCHAR), TRUE ) ||
+            !check_index_string( faces[i].style, sizeof(WCHAR), TRUE ) ||
+            !check_index_string( faces[i].full, sizeof(WCHAR), TRUE ))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static void map_font_index(void)
+{
+    struct stat st;
+    char *path;
+    void *ptr;
+    int fd;
+
+    if (!(path = get_font_index_path())) return;
+    fd = open( path, O_RDONLY );
+    HeapFree( GetProcessHeap(), 0, path );
+    if (fd == -1) return;
+
+    if (!fstat( fd, &st ) && st.st_size > 0 && st.st_size < 0x7fffffff &&
+        (ptr = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 )) != MAP_FAILED)
+    {
+        font_index = ptr;
+        font_index_size = st.st_size;
+        if (!check_font_index())
+        {
+            WARN( "ignoring invalid or incompatible font index\n" );
+            munmap( ptr, st.st_size );
+            font_index = NULL;
+            font_index_size = 0;
+        }
+    }
+    close( fd );
+}
+
+static void *grow_index_array( void *array, UINT *size, UINT count, SIZE_T elem_size )
+{
+    UINT new_size;
+
+    if (count < *size) return array;
+    new_size = max( 64, *size * 2 );
+    if (array) array = HeapReAlloc( GetProcessHeap(), 0, array, new_size * elem_size );
+    else array = HeapAlloc( GetProcessHeap(), 0, new_size * elem_size );
+    if (array) *size = new_size;
+    return array;
+}
+
+static void record_index_face( Face *face, const Family *family )
+{
+    struct font_index_builder *builder = font_index_builder;
+    struct index_builder_face *faces, *entry;
+
+    if (!builder || !builder->current) return;
+    if (!(faces = grow_index_array( builder->faces, &builder->face_size, builder->face_count, sizeof(*faces) )))
+    {
+        builder->failed = TRUE;
+        return;
+    }
+    builder->faces = faces;
+    entry = &faces[builder->face_count++];
+    entry->face = *face;
+    entry->face.StyleName = face->StyleName ? strdupW( face->StyleName ) : NULL;
+    entry->face.FullName = face->FullName ? strdupW( face->FullName ) : NULL;
+    entry->family = strdupW( family->FamilyName );
+    entry->english = family->EnglishName ? strdupW( family->EnglishName ) : NULL;
+    builder->current->face_count++;
+    face->indexed = TRUE;
+}
+
+/* add the faces of a file of the index to the font list */
+static INT load_index_file( const struct font_index_file *file )
+{
+    const struct font_index_header *header = get_font_index_header();
+    const struct font_index_face *rec = (const struct font_index_face *)(font_index + header->faces);
+    Family *family;
+    Face *face;
+    UINT i;
+
+    for (i = file->first_face; i < file->first_face + file->face_count; i++)
+    {
+        if (!(face = HeapAlloc( GetProcessHeap(), 0, sizeof(*face) ))) break;
+        face->refcount = 1;
+        face->StyleName = get_index_string( rec[i].style );
+        face->FullName = get_index_string( rec[i].full );
+        face->file = get_index_string( file->nameW );
+        face->dev = file->dev;
+        face->ino = file->ino;
+        face->font_data_ptr = NULL;
+        face->font_data_size = 0;
+        face->face_index = rec[i].face_index;
+        face->fs = rec[i].fs;
+        face->ntmFlags = rec[i].ntm_flags;
+        face->font_version = rec[i].version;
+        face->scalable = rec[i].scalable;
+        face->size.height = rec[i].height;
+        face->size.width = rec[i].width;
+        face->size.size = rec[i].size;
+        face->size.x_ppem = rec[i].x_ppem;
+        face->size.y_ppem = rec[i].y_ppem;
+        face->size.internal_leading = rec[i].internal_leading;
+        face->flags = rec[i].flags;
+        face->indexed = TRUE;
+        face->family = NULL;
+        face->cached_enum_data = NULL;
+
+        family = get_family_from_names( get_index_string( rec[i].family ), get_index_string( rec[i].english ));
+        record_index_face( face, family );
+        add_face_to_family( face, family );
+    }
+    return file->result;
+}
+
+/* find a file of the previous index that hasn't changed */
+static const struct font_index_file *find_index_file( const char *name, const struct stat *st, DWORD flags )
+{
+    struct font_index_builder *builder = font_index_builder;
+    const struct font_index_file *file;
+    UINT i;
+
+    if (!builder->old_files) return NULL;
+    for (i = hash_index_name( name ); (file = builder->old_files[i & (builder->old_size - 1)]); i++)
+    {
+        /* the same file may be added with different flags */
+        if (file->flags == flags && !strcmp( font_index + file->name, name ) &&
+            file->mtime == get_mtime( st ) && file->size == st->st_size &&
+            file->dev == st->st_dev && file->ino == st->st_ino)
+            return file;
+    }
+    return NULL;
+}
+
+static void add_index_dir( const char *name )
+{
+    struct font_index_builder *builder = font_index_builder;
+    struct index_builder_dir *dirs;
+    struct stat st;
+    UINT i;
+
+    /* files of the same directory are usually added together */
+    for (i = builder->dir_count; i > 0; i--)
+        if (!strcmp( builder->dirs[i - 1].name, name )) return;
+
+    if (!(dirs = grow_index_array( builder->dirs, &builder->dir_size, builder->dir_count, sizeof(*dirs) )) ||
+        !(dirs[builder->dir_count].name = HeapAlloc( GetProcessHeap(), 0, strlen(name) + 1 )))
+    {
+        builder->failed = TRUE;
+        return;
+    }
+    builder->dirs = dirs;
+    strcpy( dirs[builder->dir_count].name, name );
+    dirs[builder->dir_count].mtime = stat( name, &st ) ? 0 : get_mtime( &st );
+    builder->dir_count++;
+}
+
+/* add a font file to the list and to the index being built */
+static INT add_indexed_font( const char *name, DWORD flags )
+{
+    struct font_index_builder *builder = font_index_builder;
+    const struct font_index_file *old;
+    struct index_builder_file *files, *file;
+    struct stat st;
+    char *copy, *p;
+
+    if (stat( name, &st ) == -1) return 0;
+
+    if (!(files = grow_index_array( builder->files, &builder->file_size, builder->file_count, sizeof(*files) )) ||
+        !(copy = HeapAlloc( GetProcessHeap(), 0, strlen(name) + 1 )))
+    {
+        builder->failed = TRUE;
+        return AddFontToList( name, NULL, 0, flags );
+    }
+    builder->files = files;
+
+    /* the index is out of date when a file is added to or removed from the directory */
+    strcpy( copy, name );
+    if ((p = strrchr( copy, '/' )) && p != copy)
+    {
+        *p = 0;
+        add_index_dir( copy );
+        *p = '/';
+    }
+
+    file = &files[builder->file_count++];
+    file->name = copy;
+    file->nameW = towstr( CP_UNIXCP, name );
+    file->mtime = get_mtime( &st );
+    file->size = st.st_size;
+    file->dev = st.st_dev;
+    file->ino = st.st_ino;
+    file->flags = flags;
+    file->first_face = builder->face_count;
+    file->face_count = 0;
+
+    builder->current = file;
+    if ((old = find_index_file( name, &st, flags ))) file->result = load_index_file( old );
+    else file->result = AddFontToList( name, NULL, 0, flags );
+    builder->current = NULL;
+    return file->result;
+}
+
+static void begin_font_index(void)
+{
+    const struct font_index_header *header = get_font_index_header();
+    const struct font_index_file *files;
+    struct font_index_builder *builder;
+    UINT i, j;
+
+    if (!(builder = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*builder) ))) return;
+
+    if (font_index && header->file_count)
+    {
+        files = (const struct font_index_file *)(font_index + header->files);
+        for (builder->old_size = 64; builder->old_size < 2 * header->file_count; builder->old_size *= 2) ;
+        builder->old_files = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                        builder->old_size * sizeof(*builder->old_files) );
+        for (i = 0; builder->old_files && i < header->file_count; i++)
+        {
+            for (j = hash_index_name( font_index + files[i].name ); builder->old_files[j & (builder->old_size - 1)]; j++) ;
+            builder->old_files[j & (builder->old_size - 1)] = &files[i];
+        }
+    }
+    font_index_builder = builder;
+}
+
+struct index_strings
+{
+    char *data;
+    DWORD base;  /* offset of the strings in the file */
+    DWORD len;
+    DWORD size;
+    BOOL  failed;
+};
+
+static DWORD add_index_data( struct index_strings *strings, const void *data, DWORD len )
+{
+    DWORD offset = strings->base + strings->len;
+    DWORD padded = (len + 1) & ~1;  /* keep WCHAR strings aligned */
+    char *new_data;
+
+    if (strings->len + padded > strings->size)
+    {
+        DWORD new_size = max( strings->size * 2, strings->len + padded + 4096 );
+        if (strings->data) new_data = HeapReAlloc( GetProcessHeap(), 0, strings->data, new_size );
+        else new_data = HeapAlloc( GetProcessHeap(), 0, new_size );
+        if (!new_data)
+        {
+            strings->failed = TRUE;
+            return 0;
+        }
+        strings->data = new_data;
+        strings->size = new_size;
+    }
+    memcpy( strings->data + strings->len, data, len );
+    if (padded > len) strings->data[strings->len + len] = 0;
+    strings->len += padded;
+    return offset;
+}
+
+static DWORD add_index_string( struct index_strings *strings, const WCHAR *str )
+{
+    if (!str) return 0;
+    return add_index_data( strings, str, (strlenW( str ) + 1) * sizeof(WCHAR) );
+}
+
+static DWORD add_index_stringA( struct index_strings *strings, const char *str )
+{
+    return add_index_data( strings, str, strlen( str ) + 1 );
+}
+
+static BOOL write_index_data( int fd, const char *data, DWORD size )
+{
+    int ret;
+
+    while (size)
+    {
+        if ((ret = write( fd, data, size )) <= 0) return FALSE;
+        data += ret;
+        size -= ret;
+    }
+    return TRUE;
+}
+
+static BOOL write_font_index( const struct font_index_builder *builder )
+{
+    static const WCHAR terminator;
+    struct font_index_header *header;
+    struct font_index_dir *dirs;
+    struct font_index_file *files;
+    struct font_index_face *faces;
+    struct index_strings strings;
+    const struct index_builder_face *face;
+    DWORD fixed;
+    char *path = NULL, *tmp = NULL;
+    BOOL ret = FALSE;
+    int fd;
+    UINT i;
+
+    fixed = sizeof(*header) + builder->dir_count * sizeof(*dirs) +
+            builder->file_count * sizeof(*files) + builder->face_count * sizeof(*faces);
+    if (!(header = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY, fixed ))) return FALSE;
+    memset( &strings, 0, sizeof(strings) );
+    strings.base = fixed;
+
+    header->magic = FONT_INDEX_MAGIC;
+    header->version = FONT_INDEX_VERSION;
+    header->lcid = GetSystemDefaultLCID();
+    header->aa_flags = default_aa_flags;
+    header->config = get_font_index_config();
+    header->dir_count = builder->dir_count;
+    header->dirs = sizeof(*header);
+    header->file_count = builder->file_count;
+    header->files = header->dirs + builder->dir_count * sizeof(*dirs);
+    header->face_count = builder->face_count;
+    header->faces = header->files + builder->file_count * sizeof(*files);
+
+    dirs = (struct font_index_dir *)((char *)header + header->dirs);
+    for (i = 0; i < builder->dir_count; i++)
+    {
+        dirs[i].mtime = builder->dirs[i].mtime;
+        dirs[i].name = add_index_stringA( &strings, builder->dirs[i].name );
+    }
+
+    files = (struct font_index_file *)((char *)header + header->files);
+    for (i = 0; i < builder->file_count; i++)
+    {
+        files[i].mtime = builder->files[i].mtime;
+        files[i].size = builder->files[i].size;
+        files[i].dev = builder->files[i].dev;
+        files[i].ino = builder->files[i].ino;
+        files[i].name = add_index_stringA( &strings, builder->files[i].name );
+        files[i].nameW = add_index_string( &strings, builder->files[i].nameW );
+        files[i].flags = builder->files[i].flags;
+        files[i].result = builder->files[i].result;
+        files[i].first_face = builder->files[i].first_face;
+        files[i].face_count = builder->files[i].face_count;
+    }
+
+    faces = (struct font_index_face *)((char *)header + header->faces);
+    for (i = 0, face = builder->faces; i < builder->face_count; i++, face++)
+    {
+        faces[i].family = add_index_string( &strings, face->family );
+        faces[i].english = add_index_string( &strings, face->english );
+        faces[i].style = add_index_string( &strings, face->face.StyleName );
+        faces[i].full = add_index_string( &strings, face->face.FullName );
+        faces[i].face_index = face->face.face_index;
+        faces[i].ntm_flags = face->face.ntmFlags;
+        faces[i].flags = face->face.flags;
+        faces[i].version = face->face.font_version;
+        faces[i].size = face->face.size.size;
+        faces[i].x_ppem = face->face.size.x_ppem;
+        faces[i].y_ppem = face->face.size.y_ppem;
+        faces[i].height = face->face.size.height;
+        faces[i].width = face->face.size.width;
+        faces[i].internal_leading = face->face.size.internal_leading;
+        faces[i].scalable = face->face.scalable;
+        faces[i].fs = face->face.fs;
+    }
+    add_index_data( &strings, &terminator, sizeof(terminator) );
+    header->size = fixed + strings.len;
+
+    if (strings.failed || !(path = get_font_index_path()) ||
+        !(tmp = HeapAlloc( GetProcessHeap(), 0, strlen(path) + 16 )))
+        goto done;
+
+    /* write a new file and rename it, processes that mapped the old one keep it */
+    sprintf( tmp, "%s.%x", path, GetCurrentProcessId() );
+    if ((fd = open( tmp, O_WRONLY | O_CREAT | O_TRUNC, 0666 )) == -1)
+    {
+        WARN( "can't create %s\n", debugstr_a(tmp) );
+        goto done;
+    }
+    ret = write_index_data( fd, (const char *)header, fixed ) &&
+          write_index_data( fd, strings.data, strings.len );
+    close( fd );
+
+    if (!ret || rename( tmp, path ) == -1)
+    {
+        WARN( "can't write %s\n", debugstr_a(path) );
+        unlink( tmp );
+        ret = FALSE;
+    }
+    else TRACE( "wrote %u files and %u faces to %s\n", builder->file_count, builder->face_count, debugstr_a(path) );
+
+done:
+    HeapFree( GetProcessHeap(), 0, tmp );
+    HeapFree( GetProcessHeap(), 0, path );
+    HeapFree( GetProcessHeap(), 0, strings.data );
+    HeapFree( GetProcessHeap(), 0, header );
+    return ret;
+}
+
+/* without an index other processes load the whole list from the registry cache */
+static void add_indexed_faces_to_cache(void)
+{
+    Family *family;
+    Face *face;
+
+    LIST_FOR_EACH_ENTRY( family, &font_list, Family, entry )
+    {
+        LIST_FOR_EACH_ENTRY( face, &family->faces, Face, entry )
+        {
+            if (!face->indexed) continue;
+            face->indexed = FALSE;
+            if (face->flags & ADDFONT_ADD_TO_CACHE) add_face_to_cache( face );
+        }
+    }
+    reg_save_dword( hkey_font_cache, font_list_value, 1 );
+}
+
+static void end_font_index(void)
+{
+    struct font_index_builder *builder = font_index_builder;
+    UINT i;
+
+    if (!builder) return;
+    font_index_builder = NULL;
+
+    if (builder->failed || !write_font_index( builder )) add_indexed_faces_to_cache();
+
+    for (i = 0; i < builder->dir_count; i++) HeapFree( GetProcessHeap(), 0, builder->dirs[i].name );
+    for (i = 0; i < builder->file_count; i++)
+    {
+        HeapFree( GetProcessHeap(), 0, builder->files[i].name );
+        HeapFree( GetProcessHeap(), 0, builder->files[i].nameW );
+    }
+    for (i = 0; i < builder->face_count; i++)
+    {
+        HeapFree( GetProcessHeap(), 0, builder->faces[i].face.StyleName );
+        HeapFree( GetProcessHeap(), 0, builder->faces[i].face.FullName );
+        HeapFree( GetProcessHeap(), 0, builder->faces[i].family );
+        HeapFree( GetProcessHeap(), 0, builder->faces[i].english );
+    }
+    HeapFree( GetProcessHeap(), 0, builder->dirs );
+    HeapFree( GetProcessHeap(), 0, builder->files );
+    HeapFree( GetProcessHeap(), 0, builder->faces );
+    HeapFree( GetProcessHeap(), 0, builder->old_files );
+    HeapFree( GetProcessHeap(), 0, builder );
+}
+
+/* WINEFONTINDEX=0 scans all the fonts again and replaces the index */
+static BOOL rescan_fonts(void)
+{
+    const char *env = getenv( "WINEFONTINDEX" );
+
+    return env && !atoi( env );
+}
+
+/* load the font list from the index if it's up to date */
+static BOOL load_font_index(void)
+{
+    const struct font_index_header *header;
+    const struct font_index_dir *dirs;
+    const struct font_index_file *files;
+    struct stat st;
+    UINT i;
+
+    if (rescan_fonts()) return FALSE;
+    map_font_index();
+    if (!font_index) return FALSE;
+
+    /* an out of date index is kept to rebuild the list */
+    header = get_font_index_header();
+    if (header->config != get_font_index_config())
+    {
+        TRACE( "font path changed\n" );
+        return FALSE;
+    }
+    dirs = (const struct font_index_dir *)(font_index + header->dirs);
+    for (i = 0; i < header->dir_count; i++)
+    {
+        const char *name = font_index + dirs[i].name;
+        if ((stat( name, &st ) ? 0 : get_mtime( &st )) != dirs[i].mtime)
+        {
+            TRACE( "%s changed\n", debugstr_a(name) );
+            return FALSE;
+        }
+    }
+
+    files = (const struct font_index_file *)(font_index + header->files);
+    for (i = 0; i < header->file_count; i++) load_index_file( &files[i] );
+    TRACE( "loaded %u files from the font index\n", header->file_count );
+    return TRUE;
+}
+
+static void AddFaceToList(FT_Face ft_face, const char *file, void *font_data_ptr, DWORD font_data_size,
+                          FT_Long face_index, DWORD flags )
+{
+    Face *face;
+    Family *family;
+
+    face = create_face( ft_face, face_index, file, font_data_ptr, font_data_size, flags );
+    family = get_family( ft_face, flags & ADDFONT_VERTICAL_FONT );
+    record_index_face( face, family );
+    add_face_to_family( face, family );
+}
+
 static FT_Face new_ft_face( const char *file, void *font_data_ptr, DWORD font_data_size,
                             FT_Long face_index, BOOL allow_bitmap )
 {
@@ -2216,6 +3014,10 @@ static INT AddFontToList(const char *file, void *font_data_ptr, DWORD font_data_
     /* we always load external fonts from files - otherwise we would get a crash in update_reg_entries */
     assert(file || !(flags & ADDFONT_EXTERNAL_FONT));
 
+    if (file && (flags & ADDFONT_ADD_TO_CACHE) && font_index_builder &&
+        !font_index_builder->current && !font_index_builder->failed)
+        return add_indexed_font( file, flags );
+
 #ifdef HAVE_CARBON_CARBON_H
     if(file)
     {
@@ -2324,7 +3126,9 @@ static BOOL map_font_family(const WCHAR *orig, const WCHAR *repl)
             new_family->EnglishName = NULL;
             list_init(&new_family->faces);
             new_family->replacement = &family->faces;
+            new_family->seq = next_family_seq++;
             list_add_tail(&font_list, &new_family->entry);
+            add_family_to_table(new_family);
             return TRUE;
         }
     }
@@ -2693,6 +3497,7 @@ static BOOL ReadFontDir(const char *dirname, BOOL external_fonts)
     char path[MAX_PATH];
 
     TRACE("Loading fonts from %s\n", debugstr_a(dirname));
+    if (font_index_builder) add_index_dir( dirname );
 
     dir = opendir(dirname);
     if(!dir) {
@@ -2765,6 +3570,8 @@ static void init_fontconfig(void)
     }
 
 #define LOAD_FUNCPTR(f) if((p##f = wine_dlsym(fc_handle, #f, NULL, 0)) == NULL){WARN("Can't find symbol %s\n", #f); return;}
+    LOAD_FUNCPTR(FcConfigGetConfigFiles);
+    LOAD_FUNCPTR(FcConfigGetFontDirs);
     LOAD_FUNCPTR(FcConfigSubstitute);
     LOAD_FUNCPTR(FcFontList);
     LOAD_FUNCPTR(FcFontSetDestroy);
@@ -2777,6 +3584,8 @@ static void init_fontconfig(void)
     LOAD_FUNCPTR(FcPatternGetBool);
     LOAD_FUNCPTR(FcPatternGetInteger);
     LOAD_FUNCPTR(FcPatternGetString);
+    LOAD_FUNCPTR(FcStrListDone);
+    LOAD_FUNCPTR(FcStrListNext);
 #undef LOAD_FUNCPTR
 
     if (pFcInit())
@@ -2841,6 +3650,24 @@ static void load_fontconfig_fonts(void)
     pFcFontSetDestroy(fontset);
     pFcObjectSetDestroy(os);
     pFcPatternDestroy(pat);
+
+    if (font_index_builder)
+    {
+        /* the font directories include their subdirectories, so new ones are noticed too */
+        FcStrList *list;
+        FcChar8 *name;
+
+        if ((list = pFcConfigGetFontDirs( NULL )))
+        {
+            while ((name = pFcStrListNext( list ))) add_index_dir( (const char *)name );
+            pFcStrListDone( list );
+        }
+        if ((list = pFcConfigGetConfigFiles( NULL )))
+        {
+            while ((name = pFcStrListNext( list ))) add_index_dir( (const char *)name );
+            pFcStrListDone( list );
+        }
+    }
 }
 
 #elif defined(HAVE_CARBON_CARBON_H)
@@ -4123,6 +4950,7 @@ static void init_font_list(void)
     char *unixname;
     const char *data_dir;
 
+    begin_font_index();
     delete_external_font_keys();
 
     /* load the system bitmap fonts */
@@ -4251,6 +5079,8 @@ static void init_font_list(void)
         }
         RegCloseKey(hkey);
     }
+
+    end_font_index();
 }
 
 static BOOL move_to_front(const WCHAR *name)
@@ -4284,6 +5114,7 @@ static void reorder_font_list(void)
     set_default( default_serif_list );
     set_default( default_fixed_list );
     set_default( default_sans_list );
+    renumber_families();
 }
 
 /*************************************************************
@@ -4294,7 +5125,7 @@ static void reorder_font_list(void)
 BOOL WineEngInit(void)
 {
     HKEY hkey;
-    DWORD disposition;
+    DWORD disposition, font_list;
     HANDLE font_mutex;
 
     /* update locale dependent font info in registry */
@@ -4302,6 +5133,8 @@ BOOL WineEngInit(void)
 
     if(!init_freetype()) return FALSE;
 
+    init_font_tables();
+
 #ifdef SONAME_LIBFONTCONFIG
     init_fontconfig();
 #endif
@@ -4332,9 +5165,14 @@ BOOL WineEngInit(void)
 
     create_font_cache_key(&hkey_font_cache, &disposition);
 
-    if(disposition == REG_CREATED_NEW_KEY)
+    /* when the index can't be written, the whole list is in the cache */
+    if (disposition != REG_CREATED_NEW_KEY && !reg_load_dword( hkey_font_cache, font_list_value, &font_list ) &&
+        font_list && !rescan_fonts())
+        TRACE( "loading the font list from the registry cache\n" );
+    else if (!load_font_index())
         init_font_list();
-    else
+    /* fonts added at run time by other processes */
+    if (disposition != REG_CREATED_NEW_KEY)
         load_font_list_from_cache(hkey_font_cache);
 
     reorder_font_list();
@@ -4813,11 +5651,14 @@ static LONG load_VDMX(GdiFont *font, LONG height)
 static void dump_gdi_font_list(void)
 {
     GdiFont *font;
+    unsigned int i;
 
     TRACE("---------- Font Cache ----------\n");
-    LIST_FOR_EACH_ENTRY( font, &gdi_font_list, struct tagGdiFont, entry )
-        TRACE("font=%p ref=%u %s %d\n", font, font->refcount,
-              debugstr_w(font->font_desc.lf.lfFaceName), font->font_desc.lf.lfHeight);
+    TRACE("hits %u unused hits %u misses %u\n", font_cache_hits, font_cache_unused_hits, font_cache_misses);
+    for (i = 0; i < GDI_FONT_HASH_SIZE; i++)
+        LIST_FOR_EACH_ENTRY( font, &gdi_font_table[i], struct tagGdiFont, entry )
+            TRACE("font=%p ref=%u %s %d\n", font, font->refcount,
+                  debugstr_w(font->font_desc.lf.lfFaceName), font->font_desc.lf.lfHeight);
 }
 
 static void grab_font( GdiFont *font )
@@ -4885,26 +5726,36 @@ static void calc_hash(FONT_DESC *pfd)
     pfd->hash = hash;
 }
 
+static struct list *get_font_bucket( DWORD hash )
+{
+    return &gdi_font_table[(hash ^ (hash >> 8) ^ (hash >> 16) ^ (hash >> 24)) % GDI_FONT_HASH_SIZE];
+}
+
 static GdiFont *find_in_cache(HFONT hfont, const LOGFONTW *plf, const FMAT2 *pmat, BOOL can_use_bitmap)
 {
     GdiFont *ret;
     FONT_DESC fd;
+    struct list *bucket;
 
     fd.lf = *plf;
     fd.matrix = *pmat;
     fd.can_use_bitmap = can_use_bitmap;
     calc_hash(&fd);
+    bucket = get_font_bucket( fd.hash );
 
-    /* try the in-use list */
-    LIST_FOR_EACH_ENTRY( ret, &gdi_font_list, struct tagGdiFont, entry )
+    /* buckets are kept in most recently used order */
+    LIST_FOR_EACH_ENTRY( ret, bucket, struct tagGdiFont, entry )
     {
         if(fontcmp(ret, &fd)) continue;
         if(!can_use_bitmap && !FT_IS_SCALABLE(ret->ft_face)) continue;
         list_remove( &ret->entry );
-        list_add_head( &gdi_font_list, &ret->entry );
+        list_add_head( bucket, &ret->entry );
+        if (ret->refcount) font_cache_hits++;
+        else font_cache_unused_hits++;
         grab_font( ret );
         return ret;
     }
+    font_cache_misses++;
     return NULL;
 }
 
@@ -4913,7 +5764,7 @@ static void add_to_cache(GdiFont *font)
     static DWORD cache_num = 1;
 
     font->cache_num = cache_num++;
-    list_add_head(&gdi_font_list, &font->entry);
+    list_add_head(get_font_bucket(font->font_desc.hash), &font->entry);
     TRACE( "font %p\n", font );
 }
 
@@ -5279,9 +6130,9 @@ static HFONT freetype_SelectFont( PHYSDEV dev, HFONT hfont, UINT *aa_flags )
     struct freetype_physdev *physdev = get_freetype_dev( dev );
     GdiFont *ret;
     Face *face, *best, *best_bitmap;
-    Family *family, *last_resort_family;
+    Family *family, *last_resort_family, *families[2];
     const struct list *face_list;
-    INT height, width = 0;
+    INT height, width = 0, i;
     unsigned int score = 0, new_score;
     signed int diff = 0, newdiff;
     BOOL bd, it, can_use_bitmap, want_vertical;
@@ -5397,23 +6248,29 @@ static HFONT freetype_SelectFont( PHYSDEV dev, HFONT hfont, UINT *aa_flags )
 	   where we'll either use the charset of the current ansi codepage
 	   or if that's unavailable the first charset that the font supports.
 	*/
-        LIST_FOR_EACH_ENTRY( family, &font_list, Family, entry ) {
-            if (!strcmpiW(family->FamilyName, FaceName) ||
-                (psub && !strcmpiW(family->FamilyName, psub->to.name)))
-            {
-                font_link = find_font_link(family->FamilyName);
-                face_list = get_face_list_from_family(family);
-                LIST_FOR_EACH_ENTRY( face, face_list, Face, entry ) {
-                    if (!(face->scalable || can_use_bitmap))
-                        continue;
-                    if (csi.fs.fsCsb[0] & face->fs.fsCsb[0])
-                        goto found;
-                    if (font_link != NULL &&
-                        csi.fs.fsCsb[0] & font_link->fs.fsCsb[0])
-                        goto found;
-                    if (!csi.fs.fsCsb[0])
-                        goto found;
-                }
+        families[0] = find_family_from_name(FaceName);
+        families[1] = psub ? find_family_from_name(psub->to.name) : NULL;
+        if (families[0] == families[1]) families[1] = NULL;
+        else if (families[0] && families[1] && family_precedes(families[1], families[0]))
+        {
+            family = families[0];
+            families[0] = families[1];
+            families[1] = family;
+        }
+        for (i = 0; i < 2; i++) {
+            if (!(family = families[i])) continue;
+            font_link = find_font_link(family->FamilyName);
+            face_list = get_face_list_from_family(family);
+            LIST_FOR_EACH_ENTRY( face, face_list, Face, entry ) {
+                if (!(face->scalable || can_use_bitmap))
+                    continue;
+                if (csi.fs.fsCsb[0] & face->fs.fsCsb[0])
+                    goto found;
+                if (font_link != NULL &&
+                    csi.fs.fsCsb[0] & font_link->fs.fsCsb[0])
+                    goto found;
+                if (!csi.fs.fsCsb[0])
+                    goto found;
             }
 	}
 
@@ -5490,18 +6347,16 @@ static HFONT freetype_SelectFont( PHYSDEV dev, HFONT hfont, UINT *aa_flags )
         strcpyW(lf.lfFaceName, defSans);
     else
         strcpyW(lf.lfFaceName, defSans);
-    LIST_FOR_EACH_ENTRY( family, &font_list, Family, entry ) {
-        if(!strcmpiW(family->FamilyName, lf.lfFaceName)) {
-            font_link = find_font_link(family->FamilyName);
-            face_list = get_face_list_from_family(family);
-            LIST_FOR_EACH_ENTRY( face, face_list, Face, entry ) {
-                if (!(face->scalable || can_use_bitmap))
-                    continue;
-                if (csi.fs.fsCsb[0] & face->fs.fsCsb[0])
-                    goto found;
-                if (font_link != NULL && csi.fs.fsCsb[0] & font_link->fs.fsCsb[0])
-                    goto found;
-            }
+    if ((family = find_family_from_name(lf.lfFaceName)) != NULL) {
+        font_link = find_font_link(family->FamilyName);
+        face_list = get_face_list_from_family(family);
+        LIST_FOR_EACH_ENTRY( face, face_list, Face, entry ) {
+            if (!(face->scalable || can_use_bitmap))
+                continue;
+            if (csi.fs.fsCsb[0] & face->fs.fsCsb[0])
+                goto found;
+            if (font_link != NULL && csi.fs.fsCsb[0] & font_link->fs.fsCsb[0])
+                goto found;
         }
     }
 
@@ -22,6 +22,7 @@
 #include <stdarg.h>
 #include <assert.h>
 #include <string.h>
+#include <stdio.h>
 
 #include "windef.h"
 #include "winbase.h"
@@ -3068,6 +3069,523 @@ static void test_BitBlt(void)
     DeleteDC(hdcScreen);
 }
 
+static DWORD rop3_pixel(DWORD rop, DWORD pat, DWORD src, DWORD dst)
+{
+    DWORD ret = 0;
+    int i;
+
+    for (i = 0; i < 8; i++)
+        if ((rop >> 16) & (1 << i))
+            ret |= ((i & 4) ? pat : ~pat) & ((i & 2) ? src : ~src) & ((i & 1) ? dst : ~dst);
+    return ret;
+}
+
+static DWORD get_dib_pixel(const BYTE *bits, int bpp, int width, int x, int y)
+{
+    const BYTE *ptr = bits + y * get_dib_stride(width, bpp) + x * bpp / 8;
+
+    if (bpp == 32) return *(const DWORD *)ptr;
+    if (bpp == 24) return ptr[0] | (ptr[1] << 8) | (ptr[2] << 16);
+    return *(const WORD *)ptr;
+}
+
+static void set_dib_pixel(BYTE *bits, int bpp, int width, int x, int y, DWORD val)
+{
+    BYTE *ptr = bits + y * get_dib_stride(width, bpp) + x * bpp / 8;
+
+    if (bpp == 32) *(DWORD *)ptr = val;
+    else if (bpp == 24)
+    {
+        ptr[0] = val;
+        ptr[1] = val >> 8;
+        ptr[2] = val >> 16;
+    }
+    else *(WORD *)ptr = val;
+}
+
+/* the colours used here have exact 555 equivalents */
+static DWORD pixel_from_rgb(int bpp, DWORD rgb)
+{
+    if (bpp != 16) return rgb;
+    return ((rgb >> 19) & 0x1f) << 10 | ((rgb >> 11) & 0x1f) << 5 | ((rgb >> 3) & 0x1f);
+}
+
+static BYTE blend_channel(BYTE dst, BYTE src, DWORD alpha)
+{
+    return (src * alpha + dst * (255 - alpha) + 127) / 255;
+}
+
+static DWORD blend_pixel(DWORD dst, DWORD src, BLENDFUNCTION blend)
+{
+    DWORD alpha = blend.SourceConstantAlpha, ret = 0;
+    int i;
+
+    if (!(blend.AlphaFormat & AC_SRC_ALPHA))
+    {
+        for (i = 0; i < 32; i += 8)
+            ret |= blend_channel(dst >> i, src >> i, alpha) << i;
+        return ret;
+    }
+    for (i = 0; i < 32; i += 8)
+        ret |= (((BYTE)(src >> i) * alpha + 127) / 255) << i;
+    alpha = ret >> 24;
+    for (i = 0; i < 32; i += 8)
+        ret += (((BYTE)(dst >> i) * (255 - alpha) + 127) / 255) << i;
+    return ret;
+}
+
+static BOOL match_dib_pixel(DWORD val, DWORD exp, int tolerance)
+{
+    int i;
+
+    for (i = 0; i < 32; i += 8)
+        if (abs((int)((val >> i) & 0xff) - (int)((exp >> i) & 0xff)) > tolerance) return FALSE;
+    return TRUE;
+}
+
+static unsigned int blt_seed;
+
+static BYTE blt_rand(void)
+{
+    blt_seed = blt_seed * 1103515245 + 12345;
+    return blt_seed >> 16;
+}
+
+/* checksums of the destination after each operation, compared between processes */
+static DWORD span_sums[32768];
+static int span_count;
+
+static void record_dib_sum(const BYTE *bits, int bpp, int width, int height, DWORD mask)
+{
+    DWORD sum = 0;
+    int i, j;
+
+    for (j = 0; j < height; j++)
+        for (i = 0; i < width; i++)
+            sum = sum * 31 + (get_dib_pixel(bits, bpp, width, i, j) & mask);
+    if (span_count < sizeof(span_sums) / sizeof(span_sums[0])) span_sums[span_count++] = sum;
+}
+
+static void check_dib_pixels(const BYTE *bits, const BYTE *expect, int bpp, int width, int height,
+                             DWORD mask, int tolerance, const char *func, DWORD rop, int x, int count)
+{
+    DWORD val = 0, exp = 0;
+    int i, j;
+
+    record_dib_sum(bits, bpp, width, height, mask);
+    for (j = 0; j < height; j++)
+    {
+        for (i = 0; i < width; i++)
+        {
+            val = get_dib_pixel(bits, bpp, width, i, j) & mask;
+            exp = get_dib_pixel(expect, bpp, width, i, j) & mask;
+            if (!match_dib_pixel(val, exp, tolerance)) break;
+        }
+        if (i < width) break;
+    }
+    ok(j == height, "%u bpp %s %06x at %d width %d: pixel %d,%d got %08x expected %08x\n",
+       bpp, func, rop, x, count, i, j, val, exp);
+}
+
+/* spans of every length up to a few vectors at odd starts, compared pixel by pixel with
+   the raster operations */
+static void test_blt_spans(void)
+{
+    static const DWORD pat_rops[] = { PATCOPY, PATINVERT, DSTINVERT, BLACKNESS, WHITENESS,
+                                      0x00a000c9 /* DPa */, 0x00fa0089 /* DPo */, 0x000a0329 /* DPna */ };
+    static const DWORD src_rops[] = { SRCCOPY, SRCPAINT, SRCAND, SRCINVERT, SRCERASE,
+                                      NOTSRCCOPY, NOTSRCERASE, MERGEPAINT };
+    static const BLENDFUNCTION blends[] = { { AC_SRC_OVER, 0, 255, AC_SRC_ALPHA },
+                                            { AC_SRC_OVER, 0, 0x80, AC_SRC_ALPHA },
+                                            { AC_SRC_OVER, 0, 0x60, 0 } };
+    static const COLORREF text_colors[] = { RGB(0, 0, 0), RGB(0xff, 0xff, 0xff), RGB(0x20, 0xc0, 0x70) };
+    static const int bpps[] = { 32, 24, 16 };
+    static const int offsets[] = { 0, 1, 2, 3, 5 };
+    const int width = 64, height = 3, brush_width = 7, brush_height = 3;
+    const int text_width = 96, text_height = 32;
+    struct
+    {
+        BITMAPINFOHEADER header;
+        DWORD bits[7 * 3];
+    } packed;
+    BITMAPINFO info;
+    HDC hdc_dst, hdc_src;
+    HBITMAP dst, src, old_dst, old_src;
+    HBRUSH brush, pat_brush, old_brush;
+    HFONT font, old_font;
+    BYTE *dst_bits, *src_bits, *expect, *orig;
+    DWORD pat, mask, val;
+    int b, o, w, r, i, j, x, dx, size;
+
+    memset(&info, 0, sizeof(info));
+    info.bmiHeader.biSize = sizeof(info.bmiHeader);
+    info.bmiHeader.biWidth = width;
+    info.bmiHeader.biHeight = -height;
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biCompression = BI_RGB;
+
+    /* a brush narrower than a vector and not a power of two, so rows wrap at odd places */
+    packed.header = info.bmiHeader;
+    packed.header.biWidth = brush_width;
+    packed.header.biHeight = brush_height;
+    packed.header.biBitCount = 32;
+    blt_seed = 7;
+    for (i = 0; i < brush_width * brush_height; i++)
+        packed.bits[i] = (blt_rand() << 16 | blt_rand() << 8 | blt_rand()) & 0xf8f8f8;
+
+    hdc_dst = CreateCompatibleDC(0);
+    hdc_src = CreateCompatibleDC(0);
+    brush = CreateSolidBrush(RGB(0x18, 0x50, 0xa8));
+    pat_brush = CreateDIBPatternBrushPt(&packed, DIB_RGB_COLORS);
+    ok(pat_brush != NULL, "failed to create pattern brush\n");
+    old_brush = SelectObject(hdc_dst, brush);
+
+    for (b = 0; b < sizeof(bpps) / sizeof(bpps[0]); b++)
+    {
+        info.bmiHeader.biBitCount = bpps[b];
+        dst = CreateDIBSection(0, &info, DIB_RGB_COLORS, (void **)&dst_bits, NULL, 0);
+        src = CreateDIBSection(0, &info, DIB_RGB_COLORS, (void **)&src_bits, NULL, 0);
+        ok(dst != NULL && src != NULL, "failed to create %u bpp dibs\n", bpps[b]);
+        old_dst = SelectObject(hdc_dst, dst);
+        old_src = SelectObject(hdc_src, src);
+
+        pat = pixel_from_rgb(bpps[b], 0x1850a8);
+        /* the top bit of 555 pixels isn't defined */
+        mask = bpps[b] == 16 ? 0x7fff : ~0u;
+        size = get_dib_stride(width, bpps[b]) * height;
+        expect = HeapAlloc(GetProcessHeap(), 0, size);
+        orig = HeapAlloc(GetProcessHeap(), 0, size);
+        blt_seed = bpps[b];
+        for (i = 0; i < size; i++) src_bits[i] = blt_rand();
+
+        for (o = 0; o < sizeof(offsets) / sizeof(offsets[0]); o++)
+        {
+            x = offsets[o];
+            for (w = 1; w <= 40; w++)
+            {
+                for (r = 0; r < sizeof(pat_rops) / sizeof(pat_rops[0]); r++)
+                {
+                    for (i = 0; i < size; i++) dst_bits[i] = expect[i] = blt_rand();
+                    PatBlt(hdc_dst, x, 1, w, 1, pat_rops[r]);
+                    for (i = x; i < x + w; i++)
+                    {
+                        val = get_dib_pixel(expect, bpps[b], width, i, 1);
+                        set_dib_pixel(expect, bpps[b], width, i, 1, rop3_pixel(pat_rops[r], pat, 0, val));
+                    }
+                    check_dib_pixels(dst_bits, expect, bpps[b], width, height, mask, 0, "PatBlt", pat_rops[r], x, w);
+                }
+
+                SelectObject(hdc_dst, pat_brush);
+                for (r = 0; r < sizeof(pat_rops) / sizeof(pat_rops[0]); r++)
+                {
+                    for (i = 0; i < size; i++) dst_bits[i] = expect[i] = blt_rand();
+                    PatBlt(hdc_dst, x, 0, w, height, pat_rops[r]);
+                    for (j = 0; j < height; j++)
+                        for (i = x; i < x + w; i++)
+                        {
+                            val = packed.bits[(brush_height - 1 - j % brush_height) * brush_width + i % brush_width];
+                            val = rop3_pixel(pat_rops[r], pixel_from_rgb(bpps[b], val), 0,
+                                             get_dib_pixel(expect, bpps[b], width, i, j));
+                            set_dib_pixel(expect, bpps[b], width, i, j, val);
+                        }
+                    check_dib_pixels(dst_bits, expect, bpps[b], width, height, mask, 0, "pattern PatBlt", pat_rops[r], x, w);
+                }
+                SelectObject(hdc_dst, brush);
+
+                for (r = 0; r < sizeof(src_rops) / sizeof(src_rops[0]); r++)
+                {
+                    for (i = 0; i < size; i++) dst_bits[i] = expect[i] = blt_rand();
+                    BitBlt(hdc_dst, x, 1, w, 1, hdc_src, 5, 2, src_rops[r]);
+                    for (i = 0; i < w; i++)
+                    {
+                        val = rop3_pixel(src_rops[r], 0, get_dib_pixel(src_bits, bpps[b], width, 5 + i, 2),
+                                         get_dib_pixel(expect, bpps[b], width, x + i, 1));
+                        set_dib_pixel(expect, bpps[b], width, x + i, 1, val);
+                    }
+                    check_dib_pixels(dst_bits, expect, bpps[b], width, height, mask, 0, "BitBlt", src_rops[r], x, w);
+                }
+
+                /* overlapping source and destination on the same line */
+                for (dx = -3; dx <= 3; dx++)
+                {
+                    if (!dx) continue;
+                    for (i = 0; i < size; i++) dst_bits[i] = expect[i] = orig[i] = blt_rand();
+                    BitBlt(hdc_dst, x + 4, 1, w, 1, hdc_dst, x + 4 + dx, 1, SRCINVERT);
+                    for (i = 0; i < w; i++)
+                    {
+                        val = rop3_pixel(SRCINVERT, 0, get_dib_pixel(orig, bpps[b], width, x + 4 + dx + i, 1),
+                                         get_dib_pixel(orig, bpps[b], width, x + 4 + i, 1));
+                        set_dib_pixel(expect, bpps[b], width, x + 4 + i, 1, val);
+                    }
+                    check_dib_pixels(dst_bits, expect, bpps[b], width, height, mask, 0, "overlapping BitBlt", SRCINVERT, x + 4 + dx, w);
+                }
+
+                if (bpps[b] != 32 || !pGdiAlphaBlend) continue;
+
+                /* the rounding of the blend varies between implementations */
+                for (r = 0; r < sizeof(blends) / sizeof(blends[0]); r++)
+                {
+                    for (i = 0; i < size; i++) dst_bits[i] = expect[i] = blt_rand();
+                    for (i = 0; i < size; i += 4)  /* premultiplied source */
+                    {
+                        src_bits[i + 3] = blt_rand();
+                        src_bits[i] = blt_rand() % (src_bits[i + 3] + 1);
+                        src_bits[i + 1] = blt_rand() % (src_bits[i + 3] + 1);
+                        src_bits[i + 2] = blt_rand() % (src_bits[i + 3] + 1);
+                    }
+                    pGdiAlphaBlend(hdc_dst, x, 1, w, 1, hdc_src, 5, 2, w, 1, blends[r]);
+                    for (i = 0; i < w; i++)
+                    {
+                        val = blend_pixel(get_dib_pixel(expect, 32, width, x + i, 1),
+                                          get_dib_pixel(src_bits, 32, width, 5 + i, 2), blends[r]);
+                        set_dib_pixel(expect, 32, width, x + i, 1, val);
+                    }
+                    check_dib_pixels(dst_bits, expect, 32, width, height, mask, 2, "GdiAlphaBlend",
+                                     blends[r].SourceConstantAlpha | (blends[r].AlphaFormat << 8), x, w);
+                }
+            }
+        }
+
+        HeapFree(GetProcessHeap(), 0, orig);
+        HeapFree(GetProcessHeap(), 0, expect);
+        SelectObject(hdc_src, old_src);
+        SelectObject(hdc_dst, old_dst);
+        DeleteObject(src);
+        DeleteObject(dst);
+    }
+
+    /* anti-aliased glyphs, only compared with the scalar primitives */
+    info.bmiHeader.biWidth = text_width;
+    info.bmiHeader.biHeight = -text_height;
+    info.bmiHeader.biBitCount = 32;
+    dst = CreateDIBSection(0, &info, DIB_RGB_COLORS, (void **)&dst_bits, NULL, 0);
+    ok(dst != NULL, "failed to create text dib\n");
+    old_dst = SelectObject(hdc_dst, dst);
+    font = CreateFontA(-20, 0, 0, 0, FW_NORMAL, FALSE, FALSE, FALSE, ANSI_CHARSET, OUT_DEFAULT_PRECIS,
+                       CLIP_DEFAULT_PRECIS, ANTIALIASED_QUALITY, DEFAULT_PITCH, "Arial");
+    old_font = SelectObject(hdc_dst, font);
+    SetBkMode(hdc_dst, TRANSPARENT);
+    blt_seed = 96;
+    for (o = 0; o < sizeof(offsets) / sizeof(offsets[0]); o++)
+    {
+        for (r = 0; r < sizeof(text_colors) / sizeof(text_colors[0]); r++)
+        {
+            for (i = 0; i < text_width * text_height * 4; i++) dst_bits[i] = blt_rand();
+            SetTextColor(hdc_dst, text_colors[r]);
+            TextOutA(hdc_dst, offsets[o], 4, "AWgjl@%Qy", 9);
+            record_dib_sum(dst_bits, 32, text_width, text_height, ~0u);
+        }
+    }
+    SelectObject(hdc_dst, old_font);
+    DeleteObject(font);
+    SelectObject(hdc_dst, old_dst);
+    DeleteObject(dst);
+
+    SelectObject(hdc_dst, old_brush);
+    DeleteObject(pat_brush);
+    DeleteObject(brush);
+    DeleteDC(hdc_src);
+    DeleteDC(hdc_dst);
+}
+
+/* operations large enough to be split into bands drawn by several threads */
+static void test_large_bands(void)
+{
+    static const BLENDFUNCTION blend = { AC_SRC_OVER, 0, 0xc0, AC_SRC_ALPHA };
+    static const int bpps[] = { 32, 24 };
+    const int width = 640, height = 480, src_width = 213, src_height = 157;
+    TRIVERTEX vt[2] = { { 0, 0, 0xff00, 0x4000, 0x0000, 0x8000 },
+                        { 640, 480, 0x0000, 0xc000, 0xff00, 0xff00 } };
+    GRADIENT_RECT rect = { 0, 1 };
+    struct
+    {
+        BITMAPINFOHEADER header;
+        DWORD bits[8 * 8];
+    } packed;
+    BITMAPINFO info;
+    HDC hdc_dst, hdc_src;
+    HBITMAP dst, src, old_dst, old_src;
+    HBRUSH brush, pat_brush, old_brush;
+    HRGN rgn, rgn2;
+    BYTE *dst_bits, *src_bits;
+    DWORD val;
+    int b, i, x, y, size;
+
+    memset(&info, 0, sizeof(info));
+    info.bmiHeader.biSize = sizeof(info.bmiHeader);
+    info.bmiHeader.biWidth = width;
+    info.bmiHeader.biHeight = -height;
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biBitCount = 32;
+    info.bmiHeader.biCompression = BI_RGB;
+
+    packed.header = info.bmiHeader;
+    packed.header.biWidth = 8;
+    packed.header.biHeight = 8;
+    blt_seed = 640;
+    for (i = 0; i < 8 * 8; i++) packed.bits[i] = blt_rand() << 16 | blt_rand() << 8 | blt_rand();
+
+    hdc_dst = CreateCompatibleDC(0);
+    hdc_src = CreateCompatibleDC(0);
+    brush = CreateSolidBrush(RGB(0x30, 0x60, 0x90));
+    pat_brush = CreateDIBPatternBrushPt(&packed, DIB_RGB_COLORS);
+    old_brush = SelectObject(hdc_dst, brush);
+
+    /* premultiplied source, larger than the stretched one so both fit */
+    src = CreateDIBSection(0, &info, DIB_RGB_COLORS, (void **)&src_bits, NULL, 0);
+    ok(src != NULL, "failed to create source dib\n");
+    old_src = SelectObject(hdc_src, src);
+    for (i = 0; i < width * height * 4; i += 4)
+    {
+        src_bits[i + 3] = blt_rand();
+        src_bits[i] = blt_rand() % (src_bits[i + 3] + 1);
+        src_bits[i + 1] = blt_rand() % (src_bits[i + 3] + 1);
+        src_bits[i + 2] = blt_rand() % (src_bits[i + 3] + 1);
+    }
+
+    for (b = 0; b < sizeof(bpps) / sizeof(bpps[0]); b++)
+    {
+        info.bmiHeader.biBitCount = bpps[b];
+        dst = CreateDIBSection(0, &info, DIB_RGB_COLORS, (void **)&dst_bits, NULL, 0);
+        ok(dst != NULL, "failed to create %u bpp dib\n", bpps[b]);
+        old_dst = SelectObject(hdc_dst, dst);
+        size = get_dib_stride(width, bpps[b]) * height;
+
+        for (i = 0; i < size; i++) dst_bits[i] = blt_rand();
+        PatBlt(hdc_dst, 0, 0, width, height, PATCOPY);
+        for (y = 0; y < height; y++)
+        {
+            for (x = 0; x < width; x++)
+                if ((val = get_dib_pixel(dst_bits, bpps[b], width, x, y)) != 0x306090) break;
+            if (x < width) break;
+        }
+        ok(y == height, "%u bpp: pixel %d,%d got %06x\n", bpps[b], x, y, val);
+        record_dib_sum(dst_bits, bpps[b], width, height, ~0u);
+
+        /* several rectangles, some of them sharing rows */
+        rgn = CreateRectRgn(3, 5, 300, 401);
+        rgn2 = CreateRectRgn(320, 40, 637, 470);
+        CombineRgn(rgn, rgn, rgn2, RGN_OR);
+        SelectClipRgn(hdc_dst, rgn);
+        DeleteObject(rgn2);
+        DeleteObject(rgn);
+
+        for (i = 0; i < size; i++) dst_bits[i] = blt_rand();
+        PatBlt(hdc_dst, 0, 0, width, height, DSTINVERT);
+        record_dib_sum(dst_bits, bpps[b], width, height, ~0u);
+
+        SelectObject(hdc_dst, pat_brush);
+        PatBlt(hdc_dst, 0, 0, width, height, PATINVERT);
+        record_dib_sum(dst_bits, bpps[b], width, height, ~0u);
+        PatBlt(hdc_dst, 1, 2, width - 1, height - 2, PATCOPY);
+        for (y = 5; y < 401; y++)
+        {
+            for (x = 3; x < 300; x++)
+                if ((val = get_dib_pixel(dst_bits, bpps[b], width, x, y)) !=
+                    (packed.bits[(7 - y % 8) * 8 + x % 8] & 0xffffff)) break;
+            if (x < 300) break;
+        }
+        ok(y == 401, "%u bpp: pattern pixel %d,%d got %06x\n", bpps[b], x, y, val);
+        record_dib_sum(dst_bits, bpps[b], width, height, ~0u);
+        SelectObject(hdc_dst, brush);
+        SelectClipRgn(hdc_dst, NULL);
+
+        if (pGdiAlphaBlend)
+        {
+            pGdiAlphaBlend(hdc_dst, 0, 0, width, height, hdc_src, 0, 0, width, height, blend);
+            record_dib_sum(dst_bits, bpps[b], width, height, ~0u);
+            pGdiAlphaBlend(hdc_dst, 7, 3, width - 7, height - 3, hdc_src, 0, 0, src_width, src_height, blend);
+            record_dib_sum(dst_bits, bpps[b], width, height, ~0u);
+        }
+
+        if (pGdiGradientFill)
+        {
+            pGdiGradientFill(hdc_dst, vt, 2, &rect, 1, GRADIENT_FILL_RECT_V);
+            record_dib_sum(dst_bits, bpps[b], width, height, ~0u);
+        }
+
+        SetStretchBltMode(hdc_dst, COLORONCOLOR);
+        StretchBlt(hdc_dst, 0, 0, width, height, hdc_src, 0, 0, src_width, src_height, SRCCOPY);
+        record_dib_sum(dst_bits, bpps[b], width, height, ~0u);
+        StretchBlt(hdc_dst, width - 1, 5, -width + 2, height - 9, hdc_src, 11, 7, src_width, src_height, SRCINVERT);
+        record_dib_sum(dst_bits, bpps[b], width, height, ~0u);
+        SetStretchBltMode(hdc_dst, HALFTONE);
+        StretchBlt(hdc_dst, 0, 0, width, height, hdc_src, 0, 0, src_width, src_height, SRCCOPY);
+        record_dib_sum(dst_bits, bpps[b], width, height, ~0u);
+        SetStretchBltMode(hdc_dst, BLACKONWHITE);
+
+        SelectObject(hdc_dst, old_dst);
+        DeleteObject(dst);
+    }
+
+    SelectObject(hdc_src, old_src);
+    DeleteObject(src);
+    SelectObject(hdc_dst, old_brush);
+    DeleteObject(pat_brush);
+    DeleteObject(brush);
+    DeleteDC(hdc_src);
+    DeleteDC(hdc_dst);
+}
+
+static void test_child_sums(const char *mode, const char *filename)
+{
+    HANDLE file;
+    DWORD written;
+
+    if (!strcmp(mode, "spans")) test_blt_spans();
+    else test_large_bands();
+    file = CreateFileA(filename, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, 0);
+    ok(file != INVALID_HANDLE_VALUE, "failed to open %s error %u\n", filename, GetLastError());
+    WriteFile(file, span_sums, span_count * sizeof(span_sums[0]), &written, NULL);
+    CloseHandle(file);
+}
+
+/* Run the same operations in a child with one of Wine's optimizations disabled through
+   the environment, and compare the checksums it recorded with ours. */
+static void compare_child_sums(const char *argv0, const char *mode, const char *var)
+{
+    PROCESS_INFORMATION pi;
+    STARTUPINFOA startup;
+    char cmdline[2 * MAX_PATH + 16], filename[MAX_PATH];
+    DWORD *sums, size;
+    HANDLE file;
+    int i, count;
+    BOOL ret;
+
+    GetTempFileNameA(".", "dib", 0, filename);
+    memset(&startup, 0, sizeof(startup));
+    startup.cb = sizeof(startup);
+    sprintf(cmdline, "\"%s\" bitmap %s %s", argv0, mode, filename);
+    SetEnvironmentVariableA(var, "0");
+    ret = CreateProcessA(NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &pi);
+    SetEnvironmentVariableA(var, NULL);
+    ok(ret, "CreateProcess failed %u\n", GetLastError());
+    if (!ret)
+    {
+        DeleteFileA(filename);
+        return;
+    }
+    winetest_wait_child_process(pi.hProcess);
+    CloseHandle(pi.hProcess);
+    CloseHandle(pi.hThread);
+
+    sums = HeapAlloc(GetProcessHeap(), 0, sizeof(span_sums));
+    file = CreateFileA(filename, GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, 0);
+    ok(file != INVALID_HANDLE_VALUE, "failed to open %s error %u\n", filename, GetLastError());
+    ret = ReadFile(file, sums, sizeof(span_sums), &size, NULL);
+    ok(ret, "ReadFile failed error %u\n", GetLastError());
+    CloseHandle(file);
+    DeleteFileA(filename);
+
+    count = ret ? size / sizeof(sums[0]) : 0;
+    ok(count == span_count, "%s: child drew %d operations, expected %d\n", mode, count, span_count);
+    count = min(count, span_count);
+    for (i = 0; i < count; i++) if (sums[i] != span_sums[i]) break;
+    ok(i == count, "%s: operation %d differs: got %08x expected %08x\n",
+       mode, i, i < count ? sums[i] : 0, i < count ? span_sums[i] : 0);
+    HeapFree(GetProcessHeap(), 0, sums);
+}
+
 static void check_StretchBlt_pixel(HDC hdcDst, HDC hdcSrc, UINT32 *dstBuffer, UINT32 *srcBuffer,
                                    DWORD dwRop, UINT32 expected, int line)
 {
@@ -5645,12 +6163,21 @@ static void test_SetDIBitsToDevice_RLE8(void)
 START_TEST(bitmap)
 {
     HMODULE hdll;
+    char **argv;
+    int argc;
 
     hdll = GetModuleHandleA("gdi32.dll");
     pGdiAlphaBlend   = (void*)GetProcAddress(hdll, "GdiAlphaBlend");
     pGdiGradientFill = (void*)GetProcAddress(hdll, "GdiGradientFill");
     pSetLayout       = (void*)GetProcAddress(hdll, "SetLayout");
 
+    argc = winetest_get_mainargs(&argv);
+    if (argc >= 4 && (!strcmp(argv[2], "spans") || !strcmp(argv[2], "bands")))
+    {
+        test_child_sums(argv[2], argv[3]);
+        return;
+    }
+
     test_createdibitmap();
     test_dibsections();
     test_dib_formats();
@@ -5668,6 +6195,13 @@ START_TEST(bitmap)
     test_select_object();
     test_CreateBitmap();
     test_BitBlt();
+    /* Wine only uses vector code for some of the primitives, the scalar ones must draw the same pixels */
+    test_blt_spans();
+    compare_child_sums(argv[0], "spans", "WINEDIBSIMD");
+    /* large operations drawn in bands must give the same pixels as drawn in one go */
+    span_count = 0;
+    test_large_bands();
+    compare_child_sums(argv[0], "bands", "WINEDIBBANDS");
     test_StretchBlt();
     test_StretchDIBits();
     test_GdiAlphaBlend();
@@ -21,6 +21,7 @@
 
 #include <stdarg.h>
 #include <assert.h>
+#include <stdio.h>
 
 #include "windef.h"
 #include "winbase.h"
@@ -5559,6 +5560,164 @@ todo_wine
     ReleaseDC(NULL, hdc);
 }
 
+struct font_list
+{
+    char **entries;
+    int    count;
+    int    size;
+};
+
+static void add_font_list_entry(struct font_list *list, const char *str)
+{
+    if (list->count == list->size)
+    {
+        list->size = list->size ? list->size * 2 : 256;
+        if (list->entries)
+            list->entries = HeapReAlloc(GetProcessHeap(), 0, list->entries, list->size * sizeof(char *));
+        else
+            list->entries = HeapAlloc(GetProcessHeap(), 0, list->size * sizeof(char *));
+    }
+    list->entries[list->count] = HeapAlloc(GetProcessHeap(), 0, strlen(str) + 1);
+    strcpy(list->entries[list->count++], str);
+}
+
+static void free_font_list(struct font_list *list)
+{
+    int i;
+
+    for (i = 0; i < list->count; i++) HeapFree(GetProcessHeap(), 0, list->entries[i]);
+    HeapFree(GetProcessHeap(), 0, list->entries);
+}
+
+static int compare_font_list_entries(const void *a, const void *b)
+{
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static int CALLBACK font_list_family_proc(const LOGFONTA *lf, const TEXTMETRICA *tm, DWORD type, LPARAM lparam)
+{
+    struct font_list *list = (struct font_list *)lparam;
+
+    if (!list->count || strcmp(list->entries[list->count - 1], lf->lfFaceName))
+        add_font_list_entry(list, lf->lfFaceName);
+    return 1;
+}
+
+static int CALLBACK font_list_face_proc(const LOGFONTA *lf, const TEXTMETRICA *tm, DWORD type, LPARAM lparam)
+{
+    const ENUMLOGFONTEXA *elf = (const ENUMLOGFONTEXA *)lf;
+    const NEWTEXTMETRICEXA *ntm = (const NEWTEXTMETRICEXA *)tm;
+    char buf[LF_FACESIZE + 2 * LF_FULLFACESIZE + 128];
+
+    sprintf(buf, "%s|%s|%s|%s|%d|%x|%d|%d|%d|%d", lf->lfFaceName, elf->elfFullName, elf->elfStyle,
+            elf->elfScript, lf->lfCharSet, type, tm->tmHeight, tm->tmWeight, tm->tmAveCharWidth,
+            tm->tmPitchAndFamily);
+    if (type & TRUETYPE_FONTTYPE)
+        sprintf(buf + strlen(buf), "|%x|%08x|%08x", ntm->ntmTm.ntmFlags,
+                ntm->ntmFontSig.fsCsb[0], ntm->ntmFontSig.fsCsb[1]);
+    add_font_list_entry((struct font_list *)lparam, buf);
+    return 1;
+}
+
+/* every face of every family, sorted */
+static void get_font_list(struct font_list *list)
+{
+    struct font_list families;
+    LOGFONTA lf;
+    HDC hdc;
+    int i;
+
+    memset(list, 0, sizeof(*list));
+    memset(&families, 0, sizeof(families));
+    memset(&lf, 0, sizeof(lf));
+    lf.lfCharSet = DEFAULT_CHARSET;
+    hdc = CreateCompatibleDC(0);
+    EnumFontFamiliesExA(hdc, &lf, font_list_family_proc, (LPARAM)&families, 0);
+    for (i = 0; i < families.count; i++)
+    {
+        lstrcpynA(lf.lfFaceName, families.entries[i], LF_FACESIZE);
+        EnumFontFamiliesExA(hdc, &lf, font_list_face_proc, (LPARAM)list, 0);
+    }
+    DeleteDC(hdc);
+    free_font_list(&families);
+    qsort(list->entries, list->count, sizeof(list->entries[0]), compare_font_list_entries);
+}
+
+static void test_font_list_child(const char *filename)
+{
+    struct font_list list;
+    HANDLE file;
+    DWORD written;
+    int i;
+
+    get_font_list(&list);
+    file = CreateFileA(filename, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, 0);
+    ok(file != INVALID_HANDLE_VALUE, "failed to open %s error %u\n", filename, GetLastError());
+    for (i = 0; i < list.count; i++)
+    {
+        WriteFile(file, list.entries[i], strlen(list.entries[i]), &written, NULL);
+        WriteFile(file, "\n", 1, &written, NULL);
+    }
+    CloseHandle(file);
+    free_font_list(&list);
+}
+
+/* Wine keeps the font list in an index in the prefix, a child that ignores it
+   with WINEFONTINDEX=0 scans all the fonts again and must find the same ones. */
+static void test_font_list_index(const char *argv0)
+{
+    PROCESS_INFORMATION pi;
+    STARTUPINFOA startup;
+    char cmdline[2 * MAX_PATH + 16], tmp_path[MAX_PATH], filename[MAX_PATH], *data, *line, *end;
+    struct font_list list;
+    DWORD size, read;
+    HANDLE file;
+    int i;
+    BOOL ret;
+
+    GetTempPathA(MAX_PATH, tmp_path);
+    GetTempFileNameA(tmp_path, "fnt", 0, filename);
+    memset(&startup, 0, sizeof(startup));
+    startup.cb = sizeof(startup);
+    sprintf(cmdline, "\"%s\" font fontlist %s", argv0, filename);
+    SetEnvironmentVariableA("WINEFONTINDEX", "0");
+    ret = CreateProcessA(NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &pi);
+    SetEnvironmentVariableA("WINEFONTINDEX", NULL);
+    ok(ret, "CreateProcess failed %u\n", GetLastError());
+    if (!ret)
+    {
+        DeleteFileA(filename);
+        return;
+    }
+    winetest_wait_child_process(pi.hProcess);
+    CloseHandle(pi.hProcess);
+    CloseHandle(pi.hThread);
+
+    file = CreateFileA(filename, GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, 0);
+    ok(file != INVALID_HANDLE_VALUE, "failed to open %s error %u\n", filename, GetLastError());
+    size = GetFileSize(file, NULL);
+    data = HeapAlloc(GetProcessHeap(), 0, size + 1);
+    ret = ReadFile(file, data, size, &read, NULL);
+    ok(ret && read == size, "ReadFile failed error %u\n", GetLastError());
+    data[ret ? read : 0] = 0;
+    CloseHandle(file);
+    DeleteFileA(filename);
+
+    get_font_list(&list);
+    ok(list.count > 0, "no fonts found\n");
+    for (i = 0, line = data; i < list.count && *line; i++, line = end + 1)
+    {
+        if (!(end = strchr(line, '\n'))) break;
+        *end = 0;
+        if (strcmp(line, list.entries[i])) break;
+    }
+    ok(i == list.count && !*line, "face %d differs: %s / %s\n", i,
+       i < list.count ? list.entries[i] : "(end)", *line ? line : "(end)");
+
+    HeapFree(GetProcessHeap(), 0, data);
+    free_font_list(&list);
+}
+
 static void test_CreateScalableFontResource(void)
 {
     char ttf_name[MAX_PATH];
@@ -6495,8 +6654,20 @@ static void test_bitmap_font_glyph_index(void)
 
 START_TEST(font)
 {
+    char **argv;
+    int argc;
+
     init();
 
+    argc = winetest_get_mainargs(&argv);
+    if (argc >= 4 && !strcmp(argv[2], "fontlist"))
+    {
+        test_font_list_child(argv[3]);
+        return;
+    }
+
+    /* before any font is added at run time */
+    test_font_list_index(argv[0]);
     test_stock_fonts();
     test_logfont();
     test_bitmap_font();
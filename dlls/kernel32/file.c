@@ -2077,19 +2077,34 @@ HANDLE WINAPI FindFirstFileExW( LPCWSTR filename, FINDEX_INFO_LEVELS level,
         IO_STATUS_BLOCK io;
         BOOL has_wildcard = strpbrkW( info->mask.Buffer, wildcardsW ) != NULL;
 
+        UINT last = 0;
+
         info->data_size = has_wildcard ? 8192 : max_entry_size * 2;
+        info->data_len = 0;
 
+        /* grow the buffer and keep reading where we stopped, instead of starting over */
         while (info->data_size)
         {
-            if (!(info->data = HeapAlloc( GetProcessHeap(), 0, info->data_size )))
+            BYTE *data = info->data ? HeapReAlloc( GetProcessHeap(), 0, info->data, info->data_size )
+                                    : HeapAlloc( GetProcessHeap(), 0, info->data_size );
+            FILE_BOTH_DIR_INFORMATION *dir_info;
+
+            if (!data)
             {
                 FindClose( info );
                 SetLastError( ERROR_NOT_ENOUGH_MEMORY );
                 return INVALID_HANDLE_VALUE;
             }
+            info->data = data;
 
-            NtQueryDirectoryFile( info->handle, 0, NULL, NULL, &io, info->data, info->data_size,
-                                  FileBothDirectoryInformation, FALSE, &info->mask, TRUE );
+            NtQueryDirectoryFile( info->handle, 0, NULL, NULL, &io, info->data + info->data_len,
+                                  info->data_size - info->data_len, FileBothDirectoryInformation,
+                                  FALSE, &info->mask, !info->data_len );
+            if (io.u.Status == STATUS_NO_MORE_FILES && info->data_len)
+            {
+                info->data_size = 0;  /* we read everything */
+                break;
+            }
             if (io.u.Status)
             {
                 FindClose( info );
@@ -2097,19 +2112,33 @@ HANDLE WINAPI FindFirstFileExW( LPCWSTR filename, FINDEX_INFO_LEVELS level,
                 return INVALID_HANDLE_VALUE;
             }
 
-            if (io.Information < info->data_size - max_entry_size)
+            /* chain the new entries after the previous ones */
+            if (info->data_len)
             {
+                dir_info = (FILE_BOTH_DIR_INFORMATION *)(info->data + last);
+                dir_info->NextEntryOffset = info->data_len - last;
+            }
+            last = info->data_len;
+            for (;;)
+            {
+                dir_info = (FILE_BOTH_DIR_INFORMATION *)(info->data + last);
+                if (!dir_info->NextEntryOffset) break;
+                last += dir_info->NextEntryOffset;
+            }
+
+            if (io.Information < info->data_size - info->data_len - max_entry_size)
+            {
+                info->data_len += io.Information;
                 info->data_size = 0;  /* we read everything */
             }
-            else if (info->data_size < 1024 * 1024)
+            else
             {
-                HeapFree( GetProcessHeap(), 0, info->data );
-                info->data_size *= 2;
+                info->data_len += io.Information;
+                if (info->data_size < 1024 * 1024) info->data_size *= 2;
+                else break;
             }
-            else break;
         }
 
-        info->data_len = io.Information;
         if (!info->data_size && has_wildcard)  /* release unused buffer space */
             HeapReAlloc( GetProcessHeap(), HEAP_REALLOC_IN_PLACE_ONLY, info->data, info->data_len );
 
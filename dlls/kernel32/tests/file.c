@@ -4682,6 +4682,184 @@ static void test_GetFileAttributesExW(void)
     ok(GetLastError() == ERROR_FILE_NOT_FOUND, "Expected error ERROR_FILE_NOT_FOUND, got %u\n", GetLastError());
 }
 
+static void build_path(char *path, const char *dir, const char *name)
+{
+    lstrcpyA(path, dir);
+    lstrcatA(path, "\\");
+    lstrcatA(path, name);
+}
+
+static BOOL file_exists(const char *dir, const char *name)
+{
+    char path[MAX_PATH];
+
+    build_path(path, dir, name);
+    return GetFileAttributesA(path) != INVALID_FILE_ATTRIBUTES;
+}
+
+static void create_test_file(const char *dir, const char *name)
+{
+    char path[MAX_PATH];
+    HANDLE file;
+
+    build_path(path, dir, name);
+    file = CreateFileA(path, GENERIC_WRITE, 0, NULL, CREATE_NEW, 0, 0);
+    ok(file != INVALID_HANDLE_VALUE, "failed to create %s, error %u\n", path, GetLastError());
+    CloseHandle(file);
+}
+
+static void test_case_insensitive_lookup(void)
+{
+    char temp_path[MAX_PATH], dir[MAX_PATH], path[MAX_PATH], path2[MAX_PATH], name[32];
+    DWORD i, start, count = 1000;
+    BOOL ret;
+
+    GetTempPathA(MAX_PATH, temp_path);
+    lstrcpyA(dir, temp_path);
+    lstrcatA(dir, "CaseTest");
+    ret = CreateDirectoryA(dir, NULL);
+    ok(ret, "CreateDirectoryA error %u\n", GetLastError());
+
+    for (i = 0; i < count; i++)
+    {
+        sprintf(name, "MixedCase%04u.Txt", i);
+        create_test_file(dir, name);
+    }
+
+    start = GetTickCount();
+    for (i = 0; i < count; i++)
+    {
+        sprintf(name, "MIXEDCASE%04u.TXT", i);
+        ok(file_exists(dir, name), "%s not found\n", name);
+    }
+    trace("%u case-insensitive lookups in %u ms\n", count, GetTickCount() - start);
+
+    /* changes to the directory must be visible right away */
+    ok(!file_exists(dir, "newfile.txt"), "newfile.txt found\n");
+    create_test_file(dir, "NewFile.Txt");
+    ok(file_exists(dir, "NEWFILE.TXT"), "NEWFILE.TXT not found\n");
+
+    build_path(path, dir, "NewFile.Txt");
+    build_path(path2, dir, "Renamed.Txt");
+    ret = MoveFileA(path, path2);
+    ok(ret, "MoveFileA error %u\n", GetLastError());
+    ok(!file_exists(dir, "NEWFILE.TXT"), "NEWFILE.TXT found after rename\n");
+    ok(file_exists(dir, "RENAMED.TXT"), "RENAMED.TXT not found\n");
+
+    ret = DeleteFileA(path2);
+    ok(ret, "DeleteFileA error %u\n", GetLastError());
+    ok(!file_exists(dir, "renamed.txt"), "renamed.txt found after delete\n");
+
+    for (i = 0; i < count; i++)
+    {
+        sprintf(name, "mixedcase%04u.txt", i);
+        build_path(path, dir, name);
+        ret = DeleteFileA(path);
+        ok(ret, "DeleteFileA %s error %u\n", path, GetLastError());
+    }
+    ret = RemoveDirectoryA(dir);
+    ok(ret, "RemoveDirectoryA error %u\n", GetLastError());
+}
+
+static void test_FindFirstFile_large_dir(void)
+{
+    char temp_path[MAX_PATH], dir[MAX_PATH], path[MAX_PATH], name[64];
+    WIN32_FIND_DATAA data;
+    DWORD i, count = 2000, found = 0, dots = 0, start;
+    BOOL *seen, ret;
+    HANDLE handle;
+
+    GetTempPathA(MAX_PATH, temp_path);
+    lstrcpyA(dir, temp_path);
+    lstrcatA(dir, "FindLargeDir");
+    ret = CreateDirectoryA(dir, NULL);
+    ok(ret, "CreateDirectoryA error %u\n", GetLastError());
+
+    seen = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, count * sizeof(*seen));
+    for (i = 0; i < count; i++)
+    {
+        sprintf(name, "a_fairly_long_file_name_%04u.txt", i);
+        create_test_file(dir, name);
+    }
+
+    build_path(path, dir, "*");
+    start = GetTickCount();
+    handle = FindFirstFileA(path, &data);
+    ok(handle != INVALID_HANDLE_VALUE, "FindFirstFileA error %u\n", GetLastError());
+    do
+    {
+        if (!strcmp(data.cFileName, ".") || !strcmp(data.cFileName, "..")) dots++;
+        else if (sscanf(data.cFileName, "a_fairly_long_file_name_%04u.txt", &i) == 1 && i < count)
+        {
+            ok(!seen[i], "%s returned twice\n", data.cFileName);
+            seen[i] = TRUE;
+            found++;
+        }
+        else ok(0, "unexpected file %s\n", data.cFileName);
+    } while (FindNextFileA(handle, &data));
+    ok(GetLastError() == ERROR_NO_MORE_FILES, "FindNextFileA error %u\n", GetLastError());
+    FindClose(handle);
+    trace("enumerated %u files in %u ms\n", found, GetTickCount() - start);
+
+    ok(dots == 2, "got %u dot entries\n", dots);
+    ok(found == count, "found %u files instead of %u\n", found, count);
+
+    for (i = 0; i < count; i++)
+    {
+        sprintf(name, "a_fairly_long_file_name_%04u.txt", i);
+        build_path(path, dir, name);
+        ret = DeleteFileA(path);
+        ok(ret, "DeleteFileA %s error %u\n", path, GetLastError());
+    }
+    HeapFree(GetProcessHeap(), 0, seen);
+    ret = RemoveDirectoryA(dir);
+    ok(ret, "RemoveDirectoryA error %u\n", GetLastError());
+}
+
+static void test_duplicated_handle_io(void)
+{
+    char temp_path[MAX_PATH], path[MAX_PATH], buf[16];
+    HANDLE file, dup, dup2;
+    DWORD count;
+    BOOL ret;
+
+    GetTempPathA(MAX_PATH, temp_path);
+    GetTempFileNameA(temp_path, "dup", 0, path);
+    file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, 0);
+    ok(file != INVALID_HANDLE_VALUE, "CreateFileA error %u\n", GetLastError());
+    ret = WriteFile(file, "0123456789", 10, &count, NULL);
+    ok(ret && count == 10, "WriteFile error %u\n", GetLastError());
+
+    /* the copy keeps working once the source is closed */
+    ret = DuplicateHandle(GetCurrentProcess(), file, GetCurrentProcess(), &dup, 0, FALSE, DUPLICATE_SAME_ACCESS);
+    ok(ret, "DuplicateHandle error %u\n", GetLastError());
+    CloseHandle(file);
+    SetFilePointer(dup, 0, NULL, FILE_BEGIN);
+    ret = ReadFile(dup, buf, sizeof(buf), &count, NULL);
+    ok(ret && count == 10, "ReadFile error %u, count %u\n", GetLastError(), count);
+    ok(!memcmp(buf, "0123456789", 10), "wrong data %.10s\n", buf);
+
+    ret = DuplicateHandle(GetCurrentProcess(), dup, GetCurrentProcess(), &dup2, 0, FALSE,
+                          DUPLICATE_SAME_ACCESS | DUPLICATE_CLOSE_SOURCE);
+    ok(ret, "DuplicateHandle error %u\n", GetLastError());
+    ret = WriteFile(dup2, "abc", 3, &count, NULL);
+    ok(ret && count == 3, "WriteFile error %u\n", GetLastError());
+
+    /* a copy with less access doesn't inherit the access of the source */
+    ret = DuplicateHandle(GetCurrentProcess(), dup2, GetCurrentProcess(), &dup, GENERIC_READ, FALSE, 0);
+    ok(ret, "DuplicateHandle error %u\n", GetLastError());
+    SetLastError(0xdeadbeef);
+    ret = WriteFile(dup, "abc", 3, &count, NULL);
+    ok(!ret, "WriteFile succeeded\n");
+    ok(GetLastError() == ERROR_ACCESS_DENIED, "wrong error %u\n", GetLastError());
+    ok(GetFileSize(dup, NULL) == 13, "wrong size %u\n", GetFileSize(dup, NULL));
+
+    CloseHandle(dup);
+    CloseHandle(dup2);
+    ret = DeleteFileA(path);
+    ok(ret, "DeleteFileA error %u\n", GetLastError());
+}
+
 START_TEST(file)
 {
     InitFunctionPointers();
@@ -4739,4 +4917,7 @@ START_TEST(file)
     test_GetFinalPathNameByHandleW();
     test_SetFileInformationByHandle();
     test_GetFileAttributesExW();
+    test_case_insensitive_lookup();
+    test_FindFirstFile_large_dir();
+    test_duplicated_handle_io();
 }
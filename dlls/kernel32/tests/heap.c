@@ -39,6 +39,7 @@
 #define HEAP_VALIDATE_PARAMS  0x40000000
 
 static BOOL (WINAPI *pHeapQueryInformation)(HANDLE, HEAP_INFORMATION_CLASS, PVOID, SIZE_T, PSIZE_T);
+static BOOL (WINAPI *pHeapSetInformation)(HANDLE, HEAP_INFORMATION_CLASS, PVOID, SIZE_T);
 static BOOL (WINAPI *pGetPhysicallyInstalledSystemMemory)(ULONGLONG *);
 static ULONG (WINAPI *pRtlGetNtGlobalFlags)(void);
 
@@ -854,6 +855,97 @@ static void test_HeapQueryInformation(void)
     ok(info == 0 || info == 1 || info == 2, "expected 0, 1 or 2, got %u\n", info);
 }
 
+static DWORD WINAPI lfh_free_thread( void *arg )
+{
+    void **blocks = arg;
+    HANDLE heap = blocks[0];
+    unsigned int i;
+
+    for (i = 1; i < 100; i++)
+        ok( HeapFree( heap, 0, blocks[i] ), "HeapFree failed for block %u\n", i );
+    blocks[0] = HeapAlloc( heap, HEAP_ZERO_MEMORY, 24 );
+    return 0;
+}
+
+static void test_low_fragmentation_heap(void)
+{
+    void *blocks[100], *p;
+    HANDLE heap, thread;
+    unsigned int i, j;
+    ULONG info;
+    SIZE_T size;
+    BOOL ret;
+
+    pHeapSetInformation = (void *)GetProcAddress(GetModuleHandleA("kernel32.dll"), "HeapSetInformation");
+    if (!pHeapSetInformation || !pHeapQueryInformation)
+    {
+        win_skip("HeapSetInformation is not available\n");
+        return;
+    }
+
+    heap = HeapCreate( HEAP_NO_SERIALIZE, 0, 0 );
+    ok( heap != NULL, "HeapCreate failed\n" );
+    info = 2;
+    ret = pHeapSetInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) );
+    ok( !ret, "HeapSetInformation succeeded on a HEAP_NO_SERIALIZE heap\n" );
+    HeapDestroy( heap );
+
+    heap = HeapCreate( 0, 0, 0 );
+    ok( heap != NULL, "HeapCreate failed\n" );
+    info = 2;
+    ret = pHeapSetInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) );
+    ok( ret, "HeapSetInformation error %u\n", GetLastError() );
+    info = 0xdeadbeef;
+    ret = pHeapQueryInformation( heap, HeapCompatibilityInformation, &info, sizeof(info), NULL );
+    ok( ret, "HeapQueryInformation error %u\n", GetLastError() );
+    ok( info == 2, "expected 2, got %u\n", info );
+
+    for (i = 0; i < 100; i++)
+    {
+        size = 1 + i * 13;
+        blocks[i] = HeapAlloc( heap, HEAP_ZERO_MEMORY, size );
+        ok( blocks[i] != NULL, "HeapAlloc %lu failed\n", size );
+        ok( !((ULONG_PTR)blocks[i] & (2 * sizeof(void *) - 1)), "block %p not aligned\n", blocks[i] );
+        ok( HeapSize( heap, 0, blocks[i] ) == size, "wrong size %lu/%lu\n", HeapSize( heap, 0, blocks[i] ), size );
+        ok( HeapValidate( heap, 0, blocks[i] ), "HeapValidate failed for %p\n", blocks[i] );
+        for (j = 0; j < size; j++) if (((BYTE *)blocks[i])[j]) break;
+        ok( j == size, "block %u not zeroed at %u\n", i, j );
+        memset( blocks[i], i, size );
+    }
+    for (i = 0; i < 100; i++)
+    {
+        size = 1 + i * 13;
+        for (j = 0; j < size; j++) if (((BYTE *)blocks[i])[j] != i) break;
+        ok( j == size, "block %u corrupted at %u\n", i, j );
+    }
+
+    p = HeapReAlloc( heap, HEAP_ZERO_MEMORY, blocks[1], 20 );
+    ok( p != NULL, "HeapReAlloc failed\n" );
+    ok( HeapSize( heap, 0, p ) == 20, "wrong size %lu\n", HeapSize( heap, 0, p ) );
+    ok( !memcmp( p, "\1\1\1\1\1\1\1\1\1\1\1\1\1\1", 14 ), "data not preserved\n" );
+    ok( !((BYTE *)p)[14] && !((BYTE *)p)[19], "new data not zeroed\n" );
+    blocks[1] = HeapReAlloc( heap, 0, p, 5000 );
+    ok( blocks[1] != NULL, "HeapReAlloc failed\n" );
+    ok( HeapSize( heap, 0, blocks[1] ) == 5000, "wrong size %lu\n", HeapSize( heap, 0, blocks[1] ) );
+    ok( !memcmp( blocks[1], "\1\1\1\1\1\1\1\1\1\1\1\1\1\1", 14 ), "data not preserved\n" );
+    p = HeapReAlloc( heap, HEAP_REALLOC_IN_PLACE_ONLY, blocks[2], 2000 );
+    ok( !p, "HeapReAlloc succeeded\n" );
+    ok( HeapSize( heap, 0, blocks[2] ) == 27, "wrong size %lu\n", HeapSize( heap, 0, blocks[2] ) );
+    ok( HeapValidate( heap, 0, NULL ), "HeapValidate failed\n" );
+
+    /* blocks can be freed from a different thread */
+    blocks[0] = heap;
+    thread = CreateThread( NULL, 0, lfh_free_thread, blocks, 0, NULL );
+    ok( WaitForSingleObject( thread, 5000 ) == WAIT_OBJECT_0, "thread did not exit\n" );
+    CloseHandle( thread );
+    ok( blocks[0] != NULL, "HeapAlloc failed in thread\n" );
+    ok( HeapSize( heap, 0, blocks[0] ) == 24, "wrong size %lu\n", HeapSize( heap, 0, blocks[0] ) );
+    ok( HeapFree( heap, 0, blocks[0] ), "HeapFree failed\n" );
+    ok( HeapValidate( heap, 0, NULL ), "HeapValidate failed\n" );
+
+    HeapDestroy( heap );
+}
+
 static void test_heap_checks( DWORD flags )
 {
     BYTE old, *p, *p2;
@@ -1207,6 +1299,7 @@ START_TEST(heap)
     test_sized_HeapReAlloc((1 << 20), 1);
 
     test_HeapQueryInformation();
+    test_low_fragmentation_heap();
     test_GetPhysicallyInstalledSystemMemory();
 
     if (pRtlGetNtGlobalFlags)
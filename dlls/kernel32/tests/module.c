@@ -233,6 +233,43 @@ static void testGetProcAddress_Wrong(void)
         "Expected ERROR_MOD_NOT_FOUND or ERROR_INVALID_HANDLE(win9x), got %d\n", GetLastError());
 }
 
+static void testGetProcAddress_Exports(const char *dll)
+{
+    HMODULE module = GetModuleHandleA(dll);
+    const IMAGE_DOS_HEADER *dos = (const IMAGE_DOS_HEADER *)module;
+    const IMAGE_NT_HEADERS *nt;
+    const IMAGE_DATA_DIRECTORY *dir;
+    const IMAGE_EXPORT_DIRECTORY *exports;
+    const DWORD *names;
+    const WORD *ordinals;
+    DWORD i, pass, start;
+
+    ok( module != NULL, "%s not loaded\n", dll );
+    if (!module) return;
+    nt = (const IMAGE_NT_HEADERS *)((const char *)module + dos->e_lfanew);
+    dir = &nt->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT];
+    ok( dir->VirtualAddress != 0, "%s has no exports\n", dll );
+    if (!dir->VirtualAddress) return;
+    exports = (const IMAGE_EXPORT_DIRECTORY *)((const char *)module + dir->VirtualAddress);
+    names = (const DWORD *)((const char *)module + exports->AddressOfNames);
+    ordinals = (const WORD *)((const char *)module + exports->AddressOfNameOrdinals);
+
+    /* the second pass goes through the cached lookups */
+    for (pass = 0; pass < 2; pass++)
+    {
+        start = GetTickCount();
+        for (i = 0; i < exports->NumberOfNames; i++)
+        {
+            const char *name = (const char *)module + names[i];
+            FARPROC by_name = GetProcAddress( module, name );
+            FARPROC by_ordinal = GetProcAddress( module, (const char *)(ULONG_PTR)(ordinals[i] + exports->Base) );
+
+            ok( by_name == by_ordinal, "%s: %s got %p by name, %p by ordinal\n", dll, name, by_name, by_ordinal );
+        }
+        trace( "%s: looked up %u names in %u ms\n", dll, exports->NumberOfNames, GetTickCount() - start );
+    }
+}
+
 static void testLoadLibraryEx(void)
 {
     CHAR path[MAX_PATH];
@@ -765,6 +802,8 @@ START_TEST(module)
     testNestedLoadLibraryA();
     testLoadLibraryA_Wrong();
     testGetProcAddress_Wrong();
+    testGetProcAddress_Exports("kernel32.dll");
+    testGetProcAddress_Exports("ntdll.dll");
     testLoadLibraryEx();
     testGetModuleHandleEx();
     testK32GetModuleInformation();
@@ -61,6 +61,7 @@ static NTSTATUS (WINAPI *pNtAllocateVirtualMemory)(HANDLE, PVOID *, ULONG, SIZE_
 static NTSTATUS (WINAPI *pNtFreeVirtualMemory)(HANDLE, PVOID *, SIZE_T *, ULONG);
 static NTSTATUS (WINAPI *pNtWaitForSingleObject)(HANDLE, BOOLEAN, const LARGE_INTEGER *);
 static NTSTATUS (WINAPI *pNtWaitForMultipleObjects)(ULONG,const HANDLE*,BOOLEAN,BOOLEAN,const LARGE_INTEGER*);
+static BOOL   (WINAPI *pGetQueuedCompletionStatusEx)(HANDLE,OVERLAPPED_ENTRY*,ULONG,ULONG*,DWORD,BOOL);
 
 static void test_signalandwait(void)
 {
@@ -645,6 +646,60 @@ static void test_iocp_callback(void)
        "Last error is %d\n", GetLastError());
 }
 
+static void test_completion_port_batch(void)
+{
+    OVERLAPPED_ENTRY entries[8];
+    ULONG i, count, total;
+    HANDLE port;
+    BOOL ret;
+
+    if (!pGetQueuedCompletionStatusEx)
+    {
+        win_skip("GetQueuedCompletionStatusEx not available\n");
+        return;
+    }
+
+    port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 0);
+    ok(port != NULL, "CreateIoCompletionPort failed, error %u\n", GetLastError());
+
+    SetLastError(0xdeadbeef);
+    count = 0xdeadbeef;
+    ret = pGetQueuedCompletionStatusEx(port, entries, 8, &count, 0, FALSE);
+    ok(!ret, "GetQueuedCompletionStatusEx succeeded\n");
+    ok(GetLastError() == WAIT_TIMEOUT, "wrong error %u\n", GetLastError());
+
+    for (i = 0; i < 20; i++)
+    {
+        ret = PostQueuedCompletionStatus(port, i * 10, i + 1, (OVERLAPPED *)(ULONG_PTR)(i + 100));
+        ok(ret, "PostQueuedCompletionStatus failed, error %u\n", GetLastError());
+    }
+
+    /* the packets are returned in order, at most count at a time */
+    for (total = 0; total < 20; total += count)
+    {
+        count = 0;
+        ret = pGetQueuedCompletionStatusEx(port, entries, 8, &count, 0, FALSE);
+        ok(ret, "GetQueuedCompletionStatusEx failed, error %u\n", GetLastError());
+        ok(count == min(8, 20 - total), "got %u packets after %u\n", count, total);
+        if (!count) break;
+        for (i = 0; i < count; i++)
+        {
+            ok(entries[i].lpCompletionKey == total + i + 1, "wrong key %u\n", (DWORD)entries[i].lpCompletionKey);
+            ok(entries[i].lpOverlapped == (OVERLAPPED *)(ULONG_PTR)(total + i + 100),
+               "wrong overlapped %p\n", entries[i].lpOverlapped);
+            ok(entries[i].dwNumberOfBytesTransferred == (total + i) * 10,
+               "wrong size %u\n", entries[i].dwNumberOfBytesTransferred);
+        }
+    }
+
+    SetLastError(0xdeadbeef);
+    ret = pGetQueuedCompletionStatusEx(port, entries, 8, &count, 10, FALSE);
+    ok(!ret, "GetQueuedCompletionStatusEx succeeded\n");
+    ok(GetLastError() == WAIT_TIMEOUT, "wrong error %u\n", GetLastError());
+
+    CloseHandle(port);
+}
+
 static void CALLBACK timer_queue_cb1(PVOID p, BOOLEAN timedOut)
 {
     int *pn = p;
@@ -2538,6 +2593,101 @@ static void test_apc_deadlock(void)
     CloseHandle(pi.hProcess);
 }
 
+static DWORD WINAPI private_objects_thread( void *arg )
+{
+    HANDLE *handles = arg;
+    DWORD ret;
+
+    ret = WaitForSingleObject( handles[0], 5000 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret );
+    /* exit without releasing the mutex */
+    ret = WaitForSingleObject( handles[1], 0 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret );
+    return 0;
+}
+
+static void test_private_objects(void)
+{
+    HANDLE event, sem, mutex, dup, thread, handles[2];
+    LONG prev;
+    DWORD ret;
+    BOOL res;
+
+    event = CreateEventA( NULL, FALSE, FALSE, NULL );
+    ok( event != NULL, "CreateEvent failed %u\n", GetLastError() );
+    ret = WaitForSingleObject( event, 0 );
+    ok( ret == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", ret );
+    SetEvent( event );
+    ret = WaitForSingleObject( event, 0 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret );
+    ret = WaitForSingleObject( event, 0 );
+    ok( ret == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", ret );
+
+    /* a duplicated handle must see the same state */
+    res = DuplicateHandle( GetCurrentProcess(), event, GetCurrentProcess(), &dup,
+                           0, FALSE, DUPLICATE_SAME_ACCESS );
+    ok( res, "DuplicateHandle failed %u\n", GetLastError() );
+    SetEvent( dup );
+    ret = WaitForSingleObject( event, 0 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret );
+    SetEvent( event );
+    ret = WaitForSingleObject( dup, 0 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret );
+    ret = WaitForSingleObject( event, 0 );
+    ok( ret == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", ret );
+    CloseHandle( dup );
+
+    sem = CreateSemaphoreA( NULL, 1, 2, NULL );
+    ok( sem != NULL, "CreateSemaphore failed %u\n", GetLastError() );
+    res = ReleaseSemaphore( sem, 1, &prev );
+    ok( res, "ReleaseSemaphore failed %u\n", GetLastError() );
+    ok( prev == 1, "got prev %d\n", prev );
+    SetLastError( 0xdeadbeef );
+    res = ReleaseSemaphore( sem, 1, &prev );
+    ok( !res, "ReleaseSemaphore succeeded\n" );
+    ok( GetLastError() == ERROR_TOO_MANY_POSTS, "got error %u\n", GetLastError() );
+    ret = WaitForSingleObject( sem, 0 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret );
+    ret = WaitForSingleObject( sem, 0 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret );
+    ret = WaitForSingleObject( sem, 0 );
+    ok( ret == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", ret );
+    CloseHandle( sem );
+
+    mutex = CreateMutexA( NULL, FALSE, NULL );
+    ok( mutex != NULL, "CreateMutex failed %u\n", GetLastError() );
+    ret = WaitForSingleObject( mutex, 0 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret );
+    ret = WaitForSingleObject( mutex, 0 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret );
+    res = ReleaseMutex( mutex );
+    ok( res, "ReleaseMutex failed %u\n", GetLastError() );
+    res = ReleaseMutex( mutex );
+    ok( res, "ReleaseMutex failed %u\n", GetLastError() );
+    SetLastError( 0xdeadbeef );
+    res = ReleaseMutex( mutex );
+    ok( !res, "ReleaseMutex succeeded\n" );
+    ok( GetLastError() == ERROR_NOT_OWNER, "got error %u\n", GetLastError() );
+
+    /* the thread blocks in the server until we signal the event */
+    handles[0] = event;
+    handles[1] = mutex;
+    thread = CreateThread( NULL, 0, private_objects_thread, handles, 0, NULL );
+    Sleep( 100 );
+    SetEvent( event );
+    ret = WaitForSingleObject( thread, 5000 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret );
+    CloseHandle( thread );
+
+    ret = WaitForSingleObject( mutex, 0 );
+    ok( ret == WAIT_ABANDONED, "WaitForSingleObject returned %u\n", ret );
+    res = ReleaseMutex( mutex );
+    ok( res, "ReleaseMutex failed %u\n", GetLastError() );
+
+    CloseHandle( mutex );
+    CloseHandle( event );
+}
+
 START_TEST(sync)
 {
     char **argv;
@@ -2574,6 +2724,7 @@ START_TEST(sync)
     pNtFreeVirtualMemory = (void *)GetProcAddress(hntdll, "NtFreeVirtualMemory");
     pNtWaitForSingleObject = (void *)GetProcAddress(hntdll, "NtWaitForSingleObject");
     pNtWaitForMultipleObjects = (void *)GetProcAddress(hntdll, "NtWaitForMultipleObjects");
+    pGetQueuedCompletionStatusEx = (void *)GetProcAddress(hdll, "GetQueuedCompletionStatusEx");
 
     argc = winetest_get_mainargs( &argv );
     if (argc >= 3)
@@ -2592,6 +2743,7 @@ START_TEST(sync)
     test_semaphore();
     test_waitable_timer();
     test_iocp_callback();
+    test_completion_port_batch();
     test_timer_queue();
     test_WaitForSingleObject();
     test_WaitForMultipleObjects();
@@ -2602,4 +2754,5 @@ START_TEST(sync)
     test_srwlock_example();
     test_alertable_wait();
     test_apc_deadlock();
+    test_private_objects();
 }
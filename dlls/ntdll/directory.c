@@ -47,6 +47,9 @@
 #ifdef HAVE_SYS_ATTR_H
 #include <sys/attr.h>
 #endif
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
 #ifdef HAVE_SYS_VNODE_H
 /* Work around a conflict with Solaris' system list defined in sys/list.h. */
 #define list SYSLIST
@@ -107,6 +110,7 @@ WINE_DEFAULT_DEBUG_CHANNEL(file);
 /* just in case... */
 #undef VFAT_IOCTL_READDIR_BOTH
 #undef USE_GETDENTS
+#undef USE_DIR_ENUM_CACHE
 
 #ifdef linux
 
@@ -142,6 +146,9 @@ static inline int getdents64( int fd, char *de, unsigned int size )
     return syscall( __NR_getdents64, fd, de, size );
 }
 #define USE_GETDENTS
+#ifdef AT_SYMLINK_NOFOLLOW
+#define USE_DIR_ENUM_CACHE  /* the cached enumeration stats the entries with fstatat() */
+#endif
 #endif
 
 #endif  /* linux */
@@ -1370,61 +1377,76 @@ static BOOLEAN match_filename( const UNICODE_STRING *name_str, const UNICODE_STR
 }
 
 
+/* Unicode long and short names of a directory entry */
+struct entry_names
+{
+    WCHAR long_name[MAX_DIR_ENTRY_LEN];
+    WCHAR short_name[12];
+    int   long_len;
+    int   short_len;
+};
+
 /***********************************************************************
- *           append_entry
+ *           match_entry
  *
- * helper for NtQueryDirectoryFile
+ * Convert the names of a directory entry and check them against the mask.
  */
-static union file_directory_info *append_entry( void *info_ptr, IO_STATUS_BLOCK *io, ULONG max_length,
-                                                const char *long_name, const char *short_name,
-                                                const UNICODE_STRING *mask, FILE_INFORMATION_CLASS class )
+static BOOL match_entry( struct entry_names *names, const char *long_name, const char *short_name,
+                         const UNICODE_STRING *mask )
 {
-    union file_directory_info *info;
-    int i, long_len, short_len, total_len;
-    struct stat st;
-    WCHAR long_nameW[MAX_DIR_ENTRY_LEN];
-    WCHAR short_nameW[12];
-    WCHAR *filename;
     UNICODE_STRING str;
-    ULONG attributes;
 
-    io->u.Status = STATUS_SUCCESS;
-    long_len = ntdll_umbstowcs( 0, long_name, strlen(long_name), long_nameW, MAX_DIR_ENTRY_LEN );
-    if (long_len == -1) return NULL;
+    names->long_len = ntdll_umbstowcs( 0, long_name, strlen(long_name), names->long_name, MAX_DIR_ENTRY_LEN );
+    if (names->long_len == -1) return FALSE;
 
-    str.Buffer = long_nameW;
-    str.Length = long_len * sizeof(WCHAR);
-    str.MaximumLength = sizeof(long_nameW);
+    str.Buffer = names->long_name;
+    str.Length = names->long_len * sizeof(WCHAR);
+    str.MaximumLength = sizeof(names->long_name);
 
     if (short_name)
     {
-        short_len = ntdll_umbstowcs( 0, short_name, strlen(short_name),
-                                     short_nameW, sizeof(short_nameW) / sizeof(WCHAR) );
-        if (short_len == -1) short_len = sizeof(short_nameW) / sizeof(WCHAR);
+        names->short_len = ntdll_umbstowcs( 0, short_name, strlen(short_name), names->short_name,
+                                            sizeof(names->short_name) / sizeof(WCHAR) );
+        if (names->short_len == -1) names->short_len = sizeof(names->short_name) / sizeof(WCHAR);
     }
     else  /* generate a short name if necessary */
     {
         BOOLEAN spaces;
 
-        short_len = 0;
+        names->short_len = 0;
         if (!RtlIsNameLegalDOS8Dot3( &str, NULL, &spaces ) || spaces)
-            short_len = hash_short_file_name( &str, short_nameW );
+            names->short_len = hash_short_file_name( &str, names->short_name );
     }
 
     TRACE( "long %s short %s mask %s\n",
-           debugstr_us(&str), debugstr_wn(short_nameW, short_len), debugstr_us(mask) );
+           debugstr_us(&str), debugstr_wn(names->short_name, names->short_len), debugstr_us(mask) );
 
     if (mask && !match_filename( &str, mask ))
     {
-        if (!short_len) return NULL;  /* no short name to match */
-        str.Buffer = short_nameW;
-        str.Length = short_len * sizeof(WCHAR);
-        str.MaximumLength = sizeof(short_nameW);
-        if (!match_filename( &str, mask )) return NULL;
+        if (!names->short_len) return FALSE;  /* no short name to match */
+        str.Buffer = names->short_name;
+        str.Length = names->short_len * sizeof(WCHAR);
+        str.MaximumLength = sizeof(names->short_name);
+        if (!match_filename( &str, mask )) return FALSE;
     }
+    return TRUE;
+}
 
-    if (get_file_info( long_name, &st, &attributes ) == -1) return NULL;
-    if (is_ignored_file( &st ))
+/***********************************************************************
+ *           fill_entry
+ *
+ * Store a matching directory entry in the NtQueryDirectoryFile buffer.
+ */
+static union file_directory_info *fill_entry( void *info_ptr, IO_STATUS_BLOCK *io, ULONG max_length,
+                                              const struct entry_names *names, const char *long_name,
+                                              struct stat *st, ULONG attributes, FILE_INFORMATION_CLASS class )
+{
+    union file_directory_info *info;
+    int i, long_len = names->long_len, short_len = names->short_len, total_len;
+    const WCHAR *short_nameW = names->short_name;
+    WCHAR *filename;
+
+    if (is_ignored_file( st ))
     {
         TRACE( "ignoring file %s\n", long_name );
         return NULL;
@@ -1439,9 +1461,9 @@ static union file_directory_info *append_entry( void *info_ptr, IO_STATUS_BLOCK
         io->u.Status = STATUS_BUFFER_OVERFLOW;
     }
     info = (union file_directory_info *)((char *)info_ptr + io->Information);
-    if (st.st_dev != curdir.dev) st.st_ino = 0;  /* ignore inode if on a different device */
+    if (st->st_dev != curdir.dev) st->st_ino = 0;  /* ignore inode if on a different device */
     /* all the structures start with a FileDirectoryInformation layout */
-    fill_file_info( &st, attributes, info, class );
+    fill_file_info( st, attributes, info, class );
     info->dir.NextEntryOffset = total_len;
     info->dir.FileIndex = 0;  /* NTFS always has 0 here, so let's not bother with it */
 
@@ -1484,11 +1506,30 @@ static union file_directory_info *append_entry( void *info_ptr, IO_STATUS_BLOCK
         assert(0);
         return NULL;
     }
-    memcpy( filename, long_nameW, long_len * sizeof(WCHAR) );
+    memcpy( filename, names->long_name, long_len * sizeof(WCHAR) );
     io->Information += total_len;
     return info;
 }
 
+/***********************************************************************
+ *           append_entry
+ *
+ * helper for NtQueryDirectoryFile
+ */
+static union file_directory_info *append_entry( void *info_ptr, IO_STATUS_BLOCK *io, ULONG max_length,
+                                                const char *long_name, const char *short_name,
+                                                const UNICODE_STRING *mask, FILE_INFORMATION_CLASS class )
+{
+    struct entry_names names;
+    struct stat st;
+    ULONG attributes;
+
+    io->u.Status = STATUS_SUCCESS;
+    if (!match_entry( &names, long_name, short_name, mask )) return NULL;
+    if (get_file_info( long_name, &st, &attributes ) == -1) return NULL;
+    return fill_entry( info_ptr, io, max_length, &names, long_name, &st, attributes, class );
+}
+
 
 #ifdef VFAT_IOCTL_READDIR_BOTH
 
@@ -1644,6 +1685,56 @@ static char *read_first_dent_name( int which, int fd, off_t second_offs, KERNEL_
     return de->d_ino ? de->d_name : NULL;
 }
 
+/* position of the second entry of the recently enumerated directories */
+struct second_entry
+{
+    struct file_identity id;
+    off_t                pos;
+};
+
+static struct second_entry second_entries[16];
+static unsigned int next_second_entry;
+
+/***********************************************************************
+ *           get_second_entry_pos
+ *
+ * Find the position of the second entry of the current directory, if known.
+ * dir_section must be held by caller.
+ */
+static BOOL get_second_entry_pos( off_t *pos )
+{
+    unsigned int i;
+
+    for (i = 0; i < sizeof(second_entries) / sizeof(second_entries[0]); i++)
+    {
+        if (second_entries[i].id.dev != curdir.dev || second_entries[i].id.ino != curdir.ino) continue;
+        *pos = second_entries[i].pos;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/***********************************************************************
+ *           set_second_entry_pos
+ *
+ * Remember the position of the second entry of the current directory.
+ * dir_section must be held by caller.
+ */
+static void set_second_entry_pos( off_t pos )
+{
+    unsigned int i;
+
+    for (i = 0; i < sizeof(second_entries) / sizeof(second_entries[0]); i++)
+        if (second_entries[i].id.dev == curdir.dev && second_entries[i].id.ino == curdir.ino) break;
+
+    if (i == sizeof(second_entries) / sizeof(second_entries[0]))
+    {
+        i = next_second_entry++ % (sizeof(second_entries) / sizeof(second_entries[0]));
+        second_entries[i].id = curdir;
+    }
+    second_entries[i].pos = pos;
+}
+
 /***********************************************************************
  *           read_directory_getdents
  *
@@ -1653,9 +1744,7 @@ static int read_directory_getdents( int fd, IO_STATUS_BLOCK *io, void *buffer, U
                                     BOOLEAN single_entry, const UNICODE_STRING *mask,
                                     BOOLEAN restart_scan, FILE_INFORMATION_CLASS class )
 {
-    static off_t second_entry_pos;
-    static struct file_identity last_dir_id;
-    off_t old_pos = 0, next_pos;
+    off_t old_pos = 0, next_pos, second_entry_pos = 0;
     size_t size = length;
     char *data, local_buffer[8192];
     KERNEL_DIRENT64 *de, *de_first_two = NULL;
@@ -1686,15 +1775,16 @@ static int read_directory_getdents( int fd, IO_STATUS_BLOCK *io, void *buffer, U
     de = (KERNEL_DIRENT64 *)data;
 
     /* if old_pos is not 0 we don't know how many entries have been returned already,
-     * so maintain second_entry_pos to know when to return '..' */
-    if (old_pos != 0 && (last_dir_id.dev != curdir.dev || last_dir_id.ino != curdir.ino))
+     * so maintain second_entry_pos to know when to return '..'. It is remembered for
+     * a few directories, since recursive walks interleave their enumerations. */
+    if (old_pos != 0 && !get_second_entry_pos( &second_entry_pos ))
     {
         lseek( fd, 0, SEEK_SET );
         res = getdents64( fd, data, size );
         if (res > 0)
         {
             second_entry_pos = de->d_off;
-            last_dir_id = curdir;
+            set_second_entry_pos( second_entry_pos );
         }
         lseek( fd, old_pos, SEEK_SET );
     }
@@ -1713,7 +1803,7 @@ static int read_directory_getdents( int fd, IO_STATUS_BLOCK *io, void *buffer, U
     if (old_pos == 0 && res > 0)
     {
         second_entry_pos = de->d_off;
-        last_dir_id = curdir;
+        set_second_entry_pos( second_entry_pos );
         if (res > de->d_reclen)
             de_first_two = de;
     }
@@ -1783,6 +1873,178 @@ done:
     return res;
 }
 
+#ifdef USE_DIR_ENUM_CACHE
+
+/* Enumeration in progress on a directory handle. The names are read in large batches
+ * and kept until they have been returned, so that the following calls continue from
+ * the buffer instead of seeking back in the directory, and the attributes are fetched
+ * in the same pass relative to the directory fd, without changing the current directory.
+ * The snapshot is dropped when the enumeration is restarted or complete, or when the
+ * handle is closed. */
+
+#define DIR_ENUM_MAX        64      /* maximum number of enumerations kept at the same time */
+#define DIR_ENUM_BATCH_SIZE 65536   /* size of the getdents batches */
+
+struct dir_enum
+{
+    struct list   entry;    /* entry in the list of enumerations */
+    HANDLE        handle;   /* directory handle */
+    dev_t         dev;      /* identity of the directory */
+    ino_t         ino;
+    unsigned int  dots;     /* number of '.' and '..' entries returned already */
+    unsigned int  pos;      /* offset of the next entry in the batch */
+    unsigned int  size;     /* size of the batch */
+    char          data[DIR_ENUM_BATCH_SIZE];  /* batch of getdents entries */
+};
+
+static struct list dir_enums = LIST_INIT( dir_enums );
+static unsigned int dir_enum_count;
+
+/* dir_section must be held by caller */
+static struct dir_enum *find_dir_enum( HANDLE handle )
+{
+    struct dir_enum *dir;
+
+    LIST_FOR_EACH_ENTRY( dir, &dir_enums, struct dir_enum, entry )
+        if (dir->handle == handle) return dir;
+    return NULL;
+}
+
+/* dir_section must be held by caller */
+static void free_dir_enum( struct dir_enum *dir )
+{
+    list_remove( &dir->entry );
+    dir_enum_count--;
+    RtlFreeHeap( GetProcessHeap(), 0, dir );
+}
+
+/***********************************************************************
+ *           read_dir_enum_batch
+ *
+ * Read the next batch of entries, return FALSE at the end of the directory or on error.
+ */
+static BOOL read_dir_enum_batch( int fd, struct dir_enum *dir, IO_STATUS_BLOCK *io )
+{
+    int res = getdents64( fd, dir->data, sizeof(dir->data) );
+
+    dir->pos = dir->size = 0;
+    if (res <= 0)
+    {
+        if (res == -1) io->u.Status = FILE_GetNtStatus();
+        return FALSE;
+    }
+    dir->size = res;
+    return TRUE;
+}
+
+/***********************************************************************
+ *           read_directory_cached
+ *
+ * Read a directory through the enumeration snapshot of the handle; helper for NtQueryDirectoryFile.
+ * Returns -1 if the snapshot can't be used. dir_section must be held by caller.
+ */
+static int read_directory_cached( HANDLE handle, int fd, const struct stat *st, IO_STATUS_BLOCK *io,
+                                  void *buffer, ULONG length, BOOLEAN single_entry,
+                                  const UNICODE_STRING *mask, BOOLEAN restart_scan,
+                                  FILE_INFORMATION_CLASS class )
+{
+    union file_directory_info *info, *last_info = NULL;
+    struct dir_enum *dir = find_dir_enum( handle );
+    KERNEL_DIRENT64 *de = NULL;
+    struct entry_names names;
+    struct stat file_st;
+    const char *name;
+    ULONG attributes;
+    BOOL is_link;
+
+    if (dir && (dir->dev != st->st_dev || dir->ino != st->st_ino))
+    {
+        free_dir_enum( dir );
+        dir = NULL;
+    }
+
+    if (!dir)
+    {
+#ifdef VFAT_IOCTL_READDIR_BOTH
+        struct statfs stfs;
+#endif
+        /* an enumeration that was started before is continued from the file position */
+        if (!restart_scan || dir_enum_count >= DIR_ENUM_MAX) return -1;
+#ifdef VFAT_IOCTL_READDIR_BOTH
+        /* the VFAT ioctl returns the real short names */
+        if (!fstatfs( fd, &stfs ) && stfs.f_type == 0x4d44 /* MSDOS_SUPER_MAGIC */) return -1;
+#endif
+        if (!(dir = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*dir) ))) return -1;
+        dir->handle = handle;
+        dir->dev = st->st_dev;
+        dir->ino = st->st_ino;
+        list_add_head( &dir_enums, &dir->entry );
+        dir_enum_count++;
+    }
+
+    io->u.Status = STATUS_SUCCESS;
+    if (restart_scan)
+    {
+        lseek( fd, 0, SEEK_SET );
+        dir->dots = dir->pos = dir->size = 0;
+        if (!read_dir_enum_batch( fd, dir, io ) && io->u.Status && errno == ENOSYS)
+        {
+            free_dir_enum( dir );
+            return -1;
+        }
+    }
+
+    for (;;)
+    {
+        /* '.' and '..' always come first, wherever getdents returns them */
+        if (dir->dots < 2)
+        {
+            name = dir->dots ? ".." : ".";
+            is_link = FALSE;
+        }
+        else
+        {
+            if (dir->pos >= dir->size && !read_dir_enum_batch( fd, dir, io )) break;
+            de = (KERNEL_DIRENT64 *)(dir->data + dir->pos);
+            if (!de->d_ino || !strcmp( de->d_name, "." ) || !strcmp( de->d_name, ".." ))
+            {
+                dir->pos += de->d_reclen;
+                continue;
+            }
+            name = de->d_name;
+            is_link = (de->d_type == DT_LNK);
+        }
+
+        info = NULL;
+        io->u.Status = STATUS_SUCCESS;
+        if (match_entry( &names, name, NULL, mask ) &&
+            get_file_info_at( fd, name, is_link, &file_st, &attributes ) != -1)
+            info = fill_entry( buffer, io, length, &names, name, &file_st, attributes, class );
+
+        if (info)
+        {
+            last_info = info;
+            /* the entry is returned again by the next call */
+            if (io->u.Status == STATUS_BUFFER_OVERFLOW) break;
+        }
+        if (dir->dots < 2) dir->dots++;
+        else dir->pos += de->d_reclen;
+        /* check if we still have enough space for the largest possible entry */
+        if (info && (single_entry || io->Information + max_dir_info_size(class) > length)) break;
+    }
+
+    if (last_info) last_info->next = 0;
+    else
+    {
+        if (!io->u.Status) io->u.Status = restart_scan ? STATUS_NO_SUCH_FILE : STATUS_NO_MORE_FILES;
+        /* the file position is at the end of the directory, so it can continue without us */
+        free_dir_enum( dir );
+    }
+    return 0;
+}
+
+#endif  /* USE_DIR_ENUM_CACHE */
+
 #elif defined HAVE_GETDIRENTRIES
 
 #ifdef _DARWIN_FEATURE_64_BIT_INODE
@@ -2255,6 +2517,27 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event,
 
     RtlEnterCriticalSection( &dir_section );
 
+#ifdef USE_DIR_ENUM_CACHE
+    if (has_wildcard( mask ))
+    {
+        struct stat st;
+
+        if (!fstat( fd, &st ))
+        {
+            curdir.dev = st.st_dev;
+            curdir.ino = st.st_ino;
+            if (read_directory_cached( handle, fd, &st, io, buffer, length, single_entry,
+                                       mask, restart_scan, info_class ) != -1)
+            {
+                RtlLeaveCriticalSection( &dir_section );
+                if (needs_close) close( fd );
+                TRACE( "=> %x (%ld)\n", io->u.Status, io->Information );
+                return io->u.Status;
+            }
+        }
+    }
+#endif
+
     cwd = open( ".", O_RDONLY );
     if (fchdir( fd ) != -1)
     {
@@ -2298,6 +2581,274 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event,
 }
 
 
+/***********************************************************************
+ *           DIR_close_handle
+ *
+ * Drop the enumeration in progress on a handle that is being closed.
+ */
+void DIR_close_handle( HANDLE handle )
+{
+#ifdef USE_DIR_ENUM_CACHE
+    struct dir_enum *dir;
+
+    if (!dir_enum_count) return;
+    RtlEnterCriticalSection( &dir_section );
+    if ((dir = find_dir_enum( handle ))) free_dir_enum( dir );
+    RtlLeaveCriticalSection( &dir_section );
+#endif
+}
+
+
+#ifdef HAVE_SYS_INOTIFY_H
+
+/* Cache of the names of the directories that had to be scanned for a case-insensitive
+ * match. Each directory is watched with inotify, and its cache is dropped as soon as
+ * an entry is added, removed or renamed, or the directory itself goes away. */
+
+#define DIR_CACHE_MAX_DIRS 64
+#define DIR_CACHE_EVENTS   (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | \
+                            IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+
+struct dir_cache_entry
+{
+    struct dir_cache_entry *next;   /* next entry in the list of all entries */
+    struct dir_cache_entry *chain;  /* next entry in the same hash bucket */
+    ULONG                   hash;   /* hash of the lower-case name */
+    USHORT                  len;    /* length of the name in chars */
+    WCHAR                   name[1];  /* followed by the null-terminated Unix name */
+};
+
+struct dir_cache
+{
+    struct list              entry;    /* entry in the most recently used list */
+    dev_t                    dev;      /* identity of the directory */
+    ino_t                    ino;
+    int                      wd;       /* inotify watch descriptor */
+    ULONG                    mask;     /* number of buckets minus one */
+    struct dir_cache_entry **buckets;
+    struct dir_cache_entry  *entries;  /* all the entries, in reverse directory order */
+};
+
+static struct list dir_caches = LIST_INIT( dir_caches );
+static unsigned int dir_caches_count;
+static int dir_cache_fd = -2;  /* -2 if not initialized, -1 if not available */
+
+static RTL_CRITICAL_SECTION dir_cache_section;
+static RTL_CRITICAL_SECTION_DEBUG dir_cache_critsect_debug =
+{
+    0, 0, &dir_cache_section,
+    { &dir_cache_critsect_debug.ProcessLocksList, &dir_cache_critsect_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": dir_cache_section") }
+};
+static RTL_CRITICAL_SECTION dir_cache_section = { &dir_cache_critsect_debug, -1, 0, 0, 0, 0 };
+
+static ULONG hash_dir_cache_name( const WCHAR *name, int len )
+{
+    ULONG hash = 0;
+    while (len--) hash = hash * 65599 + tolowerW( *name++ );
+    return hash;
+}
+
+static void free_dir_cache( struct dir_cache *cache, BOOL remove_watch )
+{
+    struct dir_cache_entry *entry, *next;
+
+    if (remove_watch) inotify_rm_watch( dir_cache_fd, cache->wd );
+    for (entry = cache->entries; entry; entry = next)
+    {
+        next = entry->next;
+        RtlFreeHeap( GetProcessHeap(), 0, entry );
+    }
+    RtlFreeHeap( GetProcessHeap(), 0, cache->buckets );
+    list_remove( &cache->entry );
+    RtlFreeHeap( GetProcessHeap(), 0, cache );
+    dir_caches_count--;
+}
+
+/* drop the caches of all the directories that changed since the last call */
+static void read_dir_cache_events(void)
+{
+    union
+    {
+        struct inotify_event ie;
+        char buffer[4096];
+    } data;
+    struct dir_cache *cache, *next;
+    int ret, ofs;
+
+    while ((ret = read( dir_cache_fd, &data, sizeof(data) )) > 0)
+    {
+        for (ofs = 0; ofs + (int)sizeof(struct inotify_event) <= ret; )
+        {
+            struct inotify_event *ie = (struct inotify_event *)(data.buffer + ofs);
+
+            ofs += sizeof(*ie) + ie->len;
+            LIST_FOR_EACH_ENTRY_SAFE( cache, next, &dir_caches, struct dir_cache, entry )
+            {
+                if (ie->mask & IN_Q_OVERFLOW) free_dir_cache( cache, TRUE );
+                else if (cache->wd == ie->wd)
+                {
+                    free_dir_cache( cache, !(ie->mask & IN_IGNORED) );
+                    break;
+                }
+            }
+        }
+    }
+}
+
+static inline const char *get_dir_cache_unix_name( const struct dir_cache_entry *entry )
+{
+    return (const char *)(entry->name + entry->len);
+}
+
+static BOOL add_dir_cache_entry( struct dir_cache *cache, const WCHAR *name, int len, const char *unix_name )
+{
+    struct dir_cache_entry *entry;
+    size_t size = offsetof( struct dir_cache_entry, name[len] ) + strlen( unix_name ) + 1;
+
+    if (!(entry = RtlAllocateHeap( GetProcessHeap(), 0, size ))) return FALSE;
+    entry->hash = hash_dir_cache_name( name, len );
+    entry->len  = len;
+    memcpy( entry->name, name, len * sizeof(WCHAR) );
+    strcpy( (char *)(entry->name + len), unix_name );
+    entry->next = cache->entries;
+    cache->entries = entry;
+    return TRUE;
+}
+
+/* read the contents of a directory into a new cache */
+static struct dir_cache *create_dir_cache( const char *dir_name, const struct stat *st )
+{
+    WCHAR buffer[MAX_DIR_ENTRY_LEN], short_nameW[12];
+    struct dir_cache_entry *entry, *next;
+    struct dir_cache *cache;
+    struct stat dir_st;
+    UNICODE_STRING str;
+    BOOLEAN spaces;
+    struct dirent *de;
+    ULONG count = 0, size;
+    DIR *dir;
+    int ret;
+
+    if (dir_caches_count >= DIR_CACHE_MAX_DIRS)
+        free_dir_cache( LIST_ENTRY( list_tail( &dir_caches ), struct dir_cache, entry ), TRUE );
+
+    if (!(cache = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*cache) ))) return NULL;
+    cache->dev = st->st_dev;
+    cache->ino = st->st_ino;
+    list_add_head( &dir_caches, &cache->entry );
+    dir_caches_count++;
+
+    /* the watch must exist before the directory is read, so that no change can be missed */
+    if ((cache->wd = inotify_add_watch( dir_cache_fd, dir_name, DIR_CACHE_EVENTS )) == -1)
+    {
+        free_dir_cache( cache, FALSE );
+        return NULL;
+    }
+    if (!(dir = opendir( dir_name ))) goto failed;
+    if (fstat( dirfd( dir ), &dir_st ) == -1 || dir_st.st_dev != st->st_dev || dir_st.st_ino != st->st_ino)
+        goto failed_close;
+
+    str.Buffer = buffer;
+    str.MaximumLength = sizeof(buffer);
+    while ((de = readdir( dir )))
+    {
+        ret = ntdll_umbstowcs( 0, de->d_name, strlen(de->d_name), buffer, MAX_DIR_ENTRY_LEN );
+        if (!add_dir_cache_entry( cache, buffer, ret, de->d_name )) goto failed_close;
+        count++;
+
+        /* also store the hashed short name of names that don't fit in 8.3 */
+        str.Length = ret * sizeof(WCHAR);
+        if (!RtlIsNameLegalDOS8Dot3( &str, NULL, &spaces ) || spaces)
+        {
+            ret = hash_short_file_name( &str, short_nameW );
+            if (!add_dir_cache_entry( cache, short_nameW, ret, de->d_name )) goto failed_close;
+            count++;
+        }
+    }
+    closedir( dir );
+
+    for (size = 16; size < count; size *= 2) /* nothing */;
+    if (!(cache->buckets = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, size * sizeof(*cache->buckets) )))
+        goto failed;
+    cache->mask = size - 1;
+
+    /* the entries are in reverse order, so prepending them keeps the first match first */
+    for (entry = cache->entries; entry; entry = next)
+    {
+        next = entry->next;
+        entry->chain = cache->buckets[entry->hash & cache->mask];
+        cache->buckets[entry->hash & cache->mask] = entry;
+    }
+    TRACE( "cached %u names for %s\n", count, debugstr_a(dir_name) );
+    return cache;
+
+failed_close:
+    closedir( dir );
+failed:
+    free_dir_cache( cache, TRUE );
+    return NULL;
+}
+
+/***********************************************************************
+ *           lookup_dir_cache
+ *
+ * Look for a file in the cached contents of a directory, reading it if necessary.
+ * The Unix name of the file found is copied to unix_name.
+ * Returns STATUS_NOT_SUPPORTED if the directory can't be cached.
+ */
+static NTSTATUS lookup_dir_cache( const char *dir_name, const WCHAR *name, int length, char *unix_name )
+{
+    struct dir_cache_entry *entry;
+    struct dir_cache *cache;
+    struct stat st;
+    NTSTATUS status = STATUS_NOT_SUPPORTED;
+    ULONG hash;
+
+    if (stat( dir_name, &st ) == -1 || !S_ISDIR( st.st_mode )) return STATUS_NOT_SUPPORTED;
+
+    RtlEnterCriticalSection( &dir_cache_section );
+
+    if (dir_cache_fd == -2)
+    {
+        if ((dir_cache_fd = inotify_init()) != -1)
+        {
+            fcntl( dir_cache_fd, F_SETFD, FD_CLOEXEC );
+            fcntl( dir_cache_fd, F_SETFL, O_NONBLOCK );
+        }
+    }
+    if (dir_cache_fd == -1) goto done;
+
+    read_dir_cache_events();
+
+    LIST_FOR_EACH_ENTRY( cache, &dir_caches, struct dir_cache, entry )
+        if (cache->dev == st.st_dev && cache->ino == st.st_ino) break;
+
+    if (&cache->entry == &dir_caches && !(cache = create_dir_cache( dir_name, &st ))) goto done;
+
+    /* move it to the front of the most recently used list */
+    list_remove( &cache->entry );
+    list_add_head( &dir_caches, &cache->entry );
+
+    status = STATUS_OBJECT_PATH_NOT_FOUND;
+    hash = hash_dir_cache_name( name, length );
+    for (entry = cache->buckets[hash & cache->mask]; entry; entry = entry->chain)
+    {
+        if (entry->hash != hash || entry->len != length) continue;
+        if (memicmpW( entry->name, name, length )) continue;
+        strcpy( unix_name, get_dir_cache_unix_name( entry ));
+        status = STATUS_SUCCESS;
+        break;
+    }
+
+done:
+    RtlLeaveCriticalSection( &dir_cache_section );
+    return status;
+}
+
+#endif  /* HAVE_SYS_INOTIFY_H */
+
+
 /***********************************************************************
  *           find_file_in_dir
  *
@@ -2408,6 +2959,19 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
     }
 #endif /* VFAT_IOCTL_READDIR_BOTH */
 
+#ifdef HAVE_SYS_INOTIFY_H
+    switch (lookup_dir_cache( unix_name, name, length, unix_name + pos ))
+    {
+    case STATUS_SUCCESS:
+        unix_name[pos - 1] = '/';
+        goto success;
+    case STATUS_OBJECT_PATH_NOT_FOUND:
+        goto not_found;
+    default:  /* do it the hard way */
+        break;
+    }
+#endif
+
     if (!(dir = opendir( unix_name )))
     {
         if (errno == ENOENT) return STATUS_OBJECT_PATH_NOT_FOUND;
@@ -24,12 +24,22 @@
 #include <stdio.h>
 #include <errno.h>
 #include <assert.h>
+#include <fcntl.h>
 #ifdef HAVE_UNISTD_H
 # include <unistd.h>
 #endif
 #ifdef HAVE_LINUX_MAJOR_H
 # include <linux/major.h>
 #endif
+#ifdef HAVE_LINUX_IO_URING_H
+# include <linux/io_uring.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+#ifdef HAVE_SYS_UIO_H
+# include <sys/uio.h>
+#endif
 #ifdef HAVE_SYS_STATVFS_H
 # include <sys/statvfs.h>
 #endif
@@ -162,6 +172,31 @@ int get_file_info( const char *path, struct stat *st, ULONG *attr )
     return ret;
 }
 
+#ifdef AT_SYMLINK_NOFOLLOW
+/* get the stat info and file attributes for a file relative to a directory fd,
+ * skipping the lstat when the file is already known to be a symlink */
+int get_file_info_at( int dir_fd, const char *name, BOOL is_link, struct stat *st, ULONG *attr )
+{
+    int ret = 0;
+
+    *attr = 0;
+    if (!is_link)
+    {
+        ret = fstatat( dir_fd, name, st, AT_SYMLINK_NOFOLLOW );
+        if (ret == -1) return ret;
+    }
+    if (is_link || S_ISLNK( st->st_mode ))
+    {
+        ret = fstatat( dir_fd, name, st, 0 );
+        if (ret == -1) return ret;
+        /* is a symbolic link and a directory, consider these "reparse points" */
+        if (S_ISDIR( st->st_mode )) *attr |= FILE_ATTRIBUTE_REPARSE_POINT;
+    }
+    *attr |= get_file_attributes( st );
+    return ret;
+}
+#endif
+
 /**************************************************************************
  *                 FILE_CreateFile                    (internal)
  * Open a file.
@@ -778,6 +813,328 @@ static NTSTATUS get_io_avail_mode( HANDLE handle, enum server_fd_type type, BOOL
 }
 
 
+/***********************************************************************
+ *                  io_uring support                                   *
+ *
+ * Overlapped reads and writes at an explicit offset on regular files are
+ * submitted to an io_uring shared by the whole process when enabled with
+ * WINEIOURING=1. A dedicated thread waits for the completions and reports
+ * them to the I/O status block, event, APC and completion port. When the
+ * ring can't be used the I/O is done synchronously as before.
+ */
+#if defined(HAVE_LINUX_IO_URING_H) && defined(__NR_io_uring_setup)
+
+#define URING_ENTRIES 256
+
+struct uring_request
+{
+    struct iovec         iov;       /* buffer, must stay valid until completion */
+    HANDLE               handle;    /* file handle, for traces only as it may be closed */
+    HANDLE               event;     /* copy of the caller's event */
+    HANDLE               thread;    /* thread to queue the APC to */
+    PIO_APC_ROUTINE      apc;
+    void                *apc_user;
+    HANDLE               port;      /* completion port of the file */
+    ULONG_PTR            ckey;
+    ULONG_PTR            cvalue;
+    IO_STATUS_BLOCK     *io;
+    BOOL                 read;
+};
+
+static struct
+{
+    int                  fd;        /* ring fd, -1 if not available */
+    unsigned int        *sq_head;
+    unsigned int        *sq_tail;
+    unsigned int        *sq_mask;
+    unsigned int        *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned int        *cq_head;
+    unsigned int        *cq_tail;
+    unsigned int        *cq_mask;
+    struct io_uring_cqe *cqes;
+    unsigned int         cq_entries;
+    unsigned int         inflight;  /* requests not completed yet, limited to the cq size */
+} uring = { -1 };
+
+static RTL_RUN_ONCE uring_once = RTL_RUN_ONCE_INIT;
+static RTL_CRITICAL_SECTION uring_cs;
+static RTL_CRITICAL_SECTION_DEBUG uring_cs_debug =
+{
+    0, 0, &uring_cs,
+    { &uring_cs_debug.ProcessLocksList, &uring_cs_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": uring_cs") }
+};
+static RTL_CRITICAL_SECTION uring_cs = { &uring_cs_debug, -1, 0, 0, 0, 0 };
+
+static inline int uring_enter( unsigned int to_submit, unsigned int min_complete, unsigned int flags )
+{
+    return syscall( __NR_io_uring_enter, uring.fd, to_submit, min_complete, flags, NULL, 0 );
+}
+
+/* report the result of a completed request */
+static void uring_complete( struct uring_request *req, int res )
+{
+    NTSTATUS status;
+    ULONG total = 0;
+
+    if (res >= 0)
+    {
+        total = res;
+        status = (!total && req->read && req->iov.iov_len) ? STATUS_END_OF_FILE : STATUS_SUCCESS;
+    }
+    else if (res == -EFAULT)
+        status = req->read ? STATUS_ACCESS_VIOLATION : STATUS_INVALID_USER_BUFFER;
+    else
+    {
+        errno = -res;
+        status = FILE_GetNtStatus();
+    }
+
+    TRACE( "%p: %s %u bytes status %08x\n", req->handle, req->read ? "read" : "wrote", total, status );
+
+    req->io->Information = total;
+    interlocked_xchg( (LONG *)&req->io->u.Status, status );
+    /* queue the APC before setting the event, so that it's there once the wait returns */
+    if (req->apc)
+    {
+        NtQueueApcThread( req->thread, (PNTAPCFUNC)req->apc,
+                          (ULONG_PTR)req->apc_user, (ULONG_PTR)req->io, 0 );
+        NtClose( req->thread );
+    }
+    if (req->port)
+    {
+        NtSetIoCompletion( req->port, req->ckey, req->cvalue, status, total );
+        NtClose( req->port );
+    }
+    if (req->event)
+    {
+        NtSetEvent( req->event, NULL );
+        NtClose( req->event );
+    }
+    RtlFreeHeap( GetProcessHeap(), 0, req );
+}
+
+/* thread waiting for the ring completions */
+static void CALLBACK uring_thread_proc( void *arg )
+{
+    struct io_uring_cqe *cqe;
+    unsigned int head, tail, count;
+
+    for (;;)
+    {
+        /* the kernel still owns the buffers of the pending requests, so keep waiting for them */
+        if (uring_enter( 0, 1, IORING_ENTER_GETEVENTS ) == -1 && errno != EINTR)
+        {
+            LARGE_INTEGER delay;
+
+            WARN( "io_uring_enter failed: %s\n", strerror(errno) );
+            delay.QuadPart = -10 * 10000;  /* 10 ms */
+            NtDelayExecution( FALSE, &delay );
+        }
+
+        head = *uring.cq_head;
+        tail = interlocked_cmpxchg( (LONG *)uring.cq_tail, 0, 0 );
+        for (count = 0; head != tail; head++, count++)
+        {
+            cqe = &uring.cqes[head & *uring.cq_mask];
+            uring_complete( (struct uring_request *)(ULONG_PTR)cqe->user_data, cqe->res );
+        }
+        interlocked_xchg( (LONG *)uring.cq_head, head );
+
+        if (count)
+        {
+            RtlEnterCriticalSection( &uring_cs );
+            uring.inflight -= count;
+            RtlLeaveCriticalSection( &uring_cs );
+        }
+    }
+}
+
+static DWORD WINAPI init_uring( RTL_RUN_ONCE *once, void *param, void **context )
+{
+    struct io_uring_params params;
+    const char *env = getenv( "WINEIOURING" );
+    size_t sq_size, cq_size;
+    char *sq_ring, *cq_ring;
+    void *sqes;
+    HANDLE thread;
+    int fd;
+
+    if (!env || !atoi( env )) return TRUE;
+
+    memset( &params, 0, sizeof(params) );
+    if ((fd = syscall( __NR_io_uring_setup, URING_ENTRIES, &params )) == -1)
+    {
+        WARN( "io_uring not available: %s\n", strerror(errno) );
+        return TRUE;
+    }
+    fcntl( fd, F_SETFD, FD_CLOEXEC );
+
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    sq_ring = mmap( NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING );
+    cq_ring = mmap( NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING );
+    sqes = mmap( NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES );
+    if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes == MAP_FAILED)
+    {
+        WARN( "failed to map the io_uring: %s\n", strerror(errno) );
+        goto error;
+    }
+
+    uring.sq_head    = (unsigned int *)(sq_ring + params.sq_off.head);
+    uring.sq_tail    = (unsigned int *)(sq_ring + params.sq_off.tail);
+    uring.sq_mask    = (unsigned int *)(sq_ring + params.sq_off.ring_mask);
+    uring.sq_array   = (unsigned int *)(sq_ring + params.sq_off.array);
+    uring.sqes       = sqes;
+    uring.cq_head    = (unsigned int *)(cq_ring + params.cq_off.head);
+    uring.cq_tail    = (unsigned int *)(cq_ring + params.cq_off.tail);
+    uring.cq_mask    = (unsigned int *)(cq_ring + params.cq_off.ring_mask);
+    uring.cqes       = (struct io_uring_cqe *)(cq_ring + params.cq_off.cqes);
+    uring.cq_entries = params.cq_entries;
+    uring.fd         = fd;
+
+    if (RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                             uring_thread_proc, NULL, &thread, NULL ))
+    {
+        uring.fd = -1;
+        goto error;
+    }
+    NtClose( thread );
+    TRACE( "using io_uring with %u entries\n", params.sq_entries );
+    return TRUE;
+
+error:
+    if (sq_ring != MAP_FAILED) munmap( sq_ring, sq_size );
+    if (cq_ring != MAP_FAILED) munmap( cq_ring, cq_size );
+    if (sqes != MAP_FAILED) munmap( sqes, params.sq_entries * sizeof(struct io_uring_sqe) );
+    close( fd );
+    return TRUE;
+}
+
+/***********************************************************************
+ *           uring_submit
+ *
+ * Submit a read or write to the ring. Return STATUS_NOT_SUPPORTED if the
+ * I/O has to be done synchronously instead.
+ */
+static NTSTATUS uring_submit( HANDLE handle, int fd, BOOL read, void *buffer, ULONG length, off_t offset,
+                              HANDLE event, PIO_APC_ROUTINE apc, void *apc_user, ULONG_PTR cvalue,
+                              IO_STATUS_BLOCK *io )
+{
+    struct uring_request *req;
+    struct io_uring_sqe *sqe;
+    struct stat st;
+    unsigned int tail, index;
+    HANDLE port = 0;
+    ULONG_PTR ckey = 0;
+    NTSTATUS status = STATUS_PENDING;
+
+    RtlRunOnceExecuteOnce( &uring_once, init_uring, NULL, NULL );
+    if (uring.fd == -1) return STATUS_NOT_SUPPORTED;
+
+    /* end of file is reported synchronously */
+    if (read && (fstat( fd, &st ) == -1 || offset >= st.st_size)) return STATUS_NOT_SUPPORTED;
+
+    if (cvalue)
+    {
+        /* keep the port around, the file handle may be closed before the completion */
+        SERVER_START_REQ( get_fd_completion )
+        {
+            req->handle = wine_server_obj_handle( handle );
+            if (!wine_server_call( req ))
+            {
+                port = wine_server_ptr_handle( reply->completion );
+                ckey = reply->ckey;
+            }
+        }
+        SERVER_END_REQ;
+    }
+
+    if (!(req = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*req) )))
+    {
+        if (port) NtClose( port );
+        return STATUS_NOT_SUPPORTED;
+    }
+    req->iov.iov_base = buffer;
+    req->iov.iov_len  = length;
+    req->handle       = handle;
+    req->event        = 0;
+    req->thread       = 0;
+    req->apc          = apc;
+    req->apc_user     = apc_user;
+    req->port         = port;
+    req->ckey         = ckey;
+    req->cvalue       = cvalue;
+    req->io           = io;
+    req->read         = read;
+    /* the caller's handles may be closed or reused before the completion */
+    if ((apc && NtDuplicateObject( GetCurrentProcess(), GetCurrentThread(), GetCurrentProcess(),
+                                   &req->thread, 0, 0, DUPLICATE_SAME_ACCESS )) ||
+        (event && NtDuplicateObject( GetCurrentProcess(), event, GetCurrentProcess(),
+                                     &req->event, 0, 0, DUPLICATE_SAME_ACCESS )))
+    {
+        if (req->thread) NtClose( req->thread );
+        if (port) NtClose( port );
+        RtlFreeHeap( GetProcessHeap(), 0, req );
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    if (event) NtResetEvent( event, NULL );
+    io->u.Status = STATUS_PENDING;
+    io->Information = 0;
+
+    RtlEnterCriticalSection( &uring_cs );
+    if (uring.inflight < uring.cq_entries)
+    {
+        tail = *uring.sq_tail;
+        index = tail & *uring.sq_mask;
+        sqe = &uring.sqes[index];
+        memset( sqe, 0, sizeof(*sqe) );
+        sqe->opcode    = read ? IORING_OP_READV : IORING_OP_WRITEV;
+        sqe->fd        = fd;
+        sqe->off       = offset;
+        sqe->addr      = (ULONG_PTR)&req->iov;
+        sqe->len       = 1;
+        sqe->user_data = (ULONG_PTR)req;
+        uring.sq_array[index] = index;
+        interlocked_xchg( (LONG *)uring.sq_tail, tail + 1 );
+
+        /* the ring holds a reference to the file once the request is submitted */
+        if (uring_enter( 1, 0, 0 ) == 1) uring.inflight++;
+        else
+        {
+            WARN( "io_uring submission failed: %s\n", strerror(errno) );
+            *uring.sq_tail = tail;
+            status = STATUS_NOT_SUPPORTED;
+        }
+    }
+    else status = STATUS_NOT_SUPPORTED;
+    RtlLeaveCriticalSection( &uring_cs );
+
+    if (status == STATUS_NOT_SUPPORTED)
+    {
+        if (req->thread) NtClose( req->thread );
+        if (req->event) NtClose( req->event );
+        if (req->port) NtClose( req->port );
+        RtlFreeHeap( GetProcessHeap(), 0, req );
+    }
+    return status;
+}
+
+#else  /* HAVE_LINUX_IO_URING_H */
+
+static NTSTATUS uring_submit( HANDLE handle, int fd, BOOL read, void *buffer, ULONG length, off_t offset,
+                              HANDLE event, PIO_APC_ROUTINE apc, void *apc_user, ULONG_PTR cvalue,
+                              IO_STATUS_BLOCK *io )
+{
+    return STATUS_NOT_SUPPORTED;
+}
+
+#endif  /* HAVE_LINUX_IO_URING_H */
+
+
 /******************************************************************************
  *  NtReadFile					[NTDLL.@]
  *  ZwReadFile					[NTDLL.@]
@@ -844,7 +1201,12 @@ NTSTATUS WINAPI NtReadFile(HANDLE hFile, HANDLE hEvent,
 
         if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION)
         {
-            /* async I/O doesn't make sense on regular files */
+            if (async_read &&
+                (status = uring_submit( hFile, unix_handle, TRUE, buffer, length, offset->QuadPart,
+                                        hEvent, apc, apc_user, cvalue, io_status )) != STATUS_NOT_SUPPORTED)
+                goto err;
+
+            /* otherwise do the I/O synchronously */
             while ((result = pread( unix_handle, buffer, length, offset->QuadPart )) == -1)
             {
                 if (errno != EINTR)
@@ -1261,7 +1623,12 @@ NTSTATUS WINAPI NtWriteFile(HANDLE hFile, HANDLE hEvent,
                 goto done;
             }
 
-            /* async I/O doesn't make sense on regular files */
+            if (async_write && offset->QuadPart >= 0 &&
+                (status = uring_submit( hFile, unix_handle, FALSE, (void *)buffer, length, off,
+                                        hEvent, apc, apc_user, cvalue, io_status )) != STATUS_NOT_SUPPORTED)
+                goto err;
+
+            /* otherwise do the I/O synchronously */
             while ((result = pwrite( unix_handle, buffer, length, off )) == -1)
             {
                 if (errno != EINTR)
@@ -85,6 +85,8 @@ typedef struct
 #define ARENA_PENDING_MAGIC    0xbedead
 #define ARENA_FREE_MAGIC       0x45455246
 #define ARENA_LARGE_MAGIC      0x6752614c
+#define ARENA_LFH_MAGIC        0x484c46
+#define ARENA_LFH_FREE_MAGIC   0x664c66
 
 #define ARENA_INUSE_FILLER     0x55
 #define ARENA_TAIL_FILLER      0xab
@@ -158,6 +160,7 @@ typedef struct tagHEAP
     ARENA_INUSE    **pending_free;  /* Ring buffer for pending free requests */
     RTL_CRITICAL_SECTION critSection; /* Critical section for serialization */
     FREE_LIST_ENTRY *freeList;      /* Free lists */
+    struct lfh_heap *lfh;           /* Low fragmentation heap data, if enabled */
 } HEAP;
 
 #define HEAP_MAGIC       ((DWORD)('H' | ('E'<<8) | ('A'<<16) | ('P'<<24)))
@@ -175,6 +178,7 @@ typedef struct tagHEAP
 static HEAP *processHeap;  /* main process heap */
 
 static BOOL HEAP_IsRealArena( HEAP *heapPtr, DWORD flags, LPCVOID block, BOOL quiet );
+static struct lfh_slab *find_lfh_slab( const HEAP *heap, const ARENA_INUSE *arena );
 
 /* mark a block of memory as free for debugging purposes */
 static inline void mark_block_free( void *ptr, SIZE_T size, DWORD flags )
@@ -1348,7 +1352,10 @@ static BOOL HEAP_IsRealArena( HEAP *heapPtr,   /* [in] ptr to the heap */
             }
             else
                 ret = validate_large_arena( heapPtr, large_arena, quiet );
-        } else
+        }
+        else if (find_lfh_slab( heapPtr, arena ))
+            ret = TRUE;
+        else
             ret = HEAP_ValidateInUseArena( subheap, arena, quiet );
 
         if (!(flags & HEAP_NO_SERIALIZE))
@@ -1520,6 +1527,493 @@ void heap_set_debug_flags( HANDLE handle )
 }
 
 
+/***********************************************************************
+ *           allocate_block
+ *
+ * Allocate a block from the heap arenas.
+ */
+static void *allocate_block( HEAP *heap, DWORD flags, SIZE_T size )
+{
+    ARENA_FREE *pArena;
+    ARENA_INUSE *pInUse;
+    SUBHEAP *subheap;
+    SIZE_T rounded_size;
+
+    rounded_size = ROUND_SIZE(size) + HEAP_TAIL_EXTRA_SIZE( flags );
+    if (rounded_size < size)  /* overflow */
+    {
+        if (flags & HEAP_GENERATE_EXCEPTIONS) RtlRaiseStatus( STATUS_NO_MEMORY );
+        return NULL;
+    }
+    if (rounded_size < HEAP_MIN_DATA_SIZE) rounded_size = HEAP_MIN_DATA_SIZE;
+
+    if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heap->critSection );
+
+    if (rounded_size >= HEAP_MIN_LARGE_BLOCK_SIZE && (flags & HEAP_GROWABLE))
+    {
+        void *ret = allocate_large_block( heap, flags, size );
+        if (!(flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heap->critSection );
+        if (!ret && (flags & HEAP_GENERATE_EXCEPTIONS)) RtlRaiseStatus( STATUS_NO_MEMORY );
+        TRACE("(%p,%08x,%08lx): returning %p\n", heap, flags, size, ret );
+        return ret;
+    }
+
+    /* Locate a suitable free block */
+
+    if (!(pArena = HEAP_FindFreeBlock( heap, rounded_size, &subheap )))
+    {
+        TRACE("(%p,%08x,%08lx): returning NULL\n",
+                  heap, flags, size  );
+        if (!(flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heap->critSection );
+        if (flags & HEAP_GENERATE_EXCEPTIONS) RtlRaiseStatus( STATUS_NO_MEMORY );
+        return NULL;
+    }
+
+    /* Remove the arena from the free list */
+
+    list_remove( &pArena->entry );
+
+    /* Build the in-use arena */
+
+    pInUse = (ARENA_INUSE *)pArena;
+
+    /* in-use arena is smaller than free arena,
+     * so we have to add the difference to the size */
+    pInUse->size  = (pInUse->size & ~ARENA_FLAG_FREE) + sizeof(ARENA_FREE) - sizeof(ARENA_INUSE);
+    pInUse->magic = ARENA_INUSE_MAGIC;
+
+    /* Shrink the block */
+
+    HEAP_ShrinkBlock( subheap, pInUse, rounded_size );
+    pInUse->unused_bytes = (pInUse->size & ARENA_SIZE_MASK) - size;
+
+    notify_alloc( pInUse + 1, size, flags & HEAP_ZERO_MEMORY );
+    initialize_block( pInUse + 1, size, pInUse->unused_bytes, flags );
+
+    if (!(flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heap->critSection );
+
+    TRACE("(%p,%08x,%08lx): returning %p\n", heap, flags, size, pInUse + 1 );
+    return pInUse + 1;
+}
+
+
+/* Low fragmentation heap
+ *
+ * Once enabled with HeapSetInformation(HeapCompatibilityInformation), small
+ * blocks are carved out of slabs of a fixed size class, the slabs themselves
+ * being normal in-use arenas of the heap. Every thread keeps a cache of free
+ * blocks for each size class, so that most allocations and frees don't take
+ * any lock; caches are refilled from and flushed back to the slabs in batches
+ * under a per-class lock. Larger blocks, and all blocks of heaps using
+ * debugging flags, still go through the arena code.
+ */
+
+#define LFH_MAX_BLOCK_SIZE  0x400    /* largest block size served by the LFH */
+#define LFH_NB_CLASSES      28       /* 16-byte classes up to 0x100, 64-byte classes up to 0x400 */
+#define LFH_SLAB_SIZE       0x10000  /* size of the arenas split into LFH blocks */
+#define LFH_CACHE_MAX       32       /* max number of free blocks per class in a thread cache */
+#define LFH_CACHE_BATCH     16       /* number of blocks moved at once between caches and slabs */
+
+/* heap flags that require the arena code */
+#define LFH_DISABLE_FLAGS   (HEAP_TAIL_CHECKING_ENABLED | HEAP_FREE_CHECKING_ENABLED | \
+                             HEAP_PAGE_ALLOCS | HEAP_VALIDATE)
+
+#define LFH_SLAB_MAGIC      ((DWORD)('L' | ('F'<<8) | ('H'<<16) | ('S'<<24)))
+
+struct lfh_block
+{
+    struct lfh_block *next;        /* next free block, stored in the user data */
+};
+
+struct lfh_slab
+{
+    struct list       entry;       /* entry in the class list of slabs with free blocks */
+    HEAP             *heap;        /* heap owning the slab */
+    struct lfh_block *free;        /* free blocks of the slab */
+    unsigned int      nb_used;     /* number of blocks allocated or in thread caches */
+    unsigned int      nb_blocks;   /* total number of blocks */
+    unsigned int      class;       /* size class of the blocks */
+    DWORD             magic;       /* LFH_SLAB_MAGIC */
+};
+
+#define LFH_SLAB_HEADER     ((sizeof(struct lfh_slab) + ALIGNMENT - 1) & ~(ALIGNMENT - 1))
+
+struct lfh_class
+{
+    RTL_SRWLOCK       lock;        /* lock protecting the slabs */
+    struct list       slabs;       /* slabs with free blocks */
+};
+
+struct lfh_heap
+{
+    struct lfh_class  classes[LFH_NB_CLASSES];
+};
+
+struct heap_thread_cache
+{
+    struct list               entry;    /* entry in the global list of caches */
+    struct heap_thread_cache *next;     /* next cache of the same thread */
+    HEAP                     *heap;     /* heap of the cache, NULL once it has been destroyed */
+    struct lfh_block         *blocks[LFH_NB_CLASSES];  /* free blocks for each class */
+    unsigned int              count[LFH_NB_CLASSES];   /* number of blocks for each class */
+};
+
+static struct list lfh_caches = LIST_INIT( lfh_caches );
+static struct heap_thread_cache *orphan_caches;  /* caches of terminated threads */
+
+static RTL_CRITICAL_SECTION lfh_section;
+static RTL_CRITICAL_SECTION_DEBUG lfh_critsect_debug =
+{
+    0, 0, &lfh_section,
+    { &lfh_critsect_debug.ProcessLocksList, &lfh_critsect_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": lfh_section") }
+};
+static RTL_CRITICAL_SECTION lfh_section = { &lfh_critsect_debug, -1, 0, 0, 0, 0 };
+
+static inline unsigned int get_lfh_class( SIZE_T size )
+{
+    if (size <= 0x100) return size ? (size - 1) / 0x10 : 0;
+    return 0x10 + (size - 0x101) / 0x40;
+}
+
+static inline SIZE_T get_lfh_class_size( unsigned int class )
+{
+    if (class < 0x10) return (class + 1) * 0x10;
+    return 0x100 + (class - 0x0f) * 0x40;
+}
+
+static inline struct lfh_slab *get_block_slab( struct lfh_block *block )
+{
+    ARENA_INUSE *arena = (ARENA_INUSE *)block - 1;
+    return (struct lfh_slab *)((char *)block - arena->size);
+}
+
+/* return the slab containing an in-use block, or NULL if it's not a LFH block of the heap */
+static struct lfh_slab *find_lfh_slab( const HEAP *heap, const ARENA_INUSE *arena )
+{
+    struct lfh_slab *slab;
+
+    if (!heap->lfh || (heap->flags & LFH_DISABLE_FLAGS)) return NULL;
+    if ((ULONG_PTR)arena % ALIGNMENT != ARENA_OFFSET) return NULL;
+    if (arena->magic != ARENA_LFH_MAGIC) return NULL;
+    if (arena->size < LFH_SLAB_HEADER || arena->size >= LFH_SLAB_SIZE) return NULL;
+    slab = (struct lfh_slab *)((const char *)(arena + 1) - arena->size);
+    if (slab->magic != LFH_SLAB_MAGIC || slab->heap != heap) return NULL;
+    return slab;
+}
+
+/* allocate a new slab and split it into free blocks */
+static struct lfh_slab *create_lfh_slab( HEAP *heap, unsigned int class )
+{
+    SIZE_T stride = get_lfh_class_size( class ) + ALIGNMENT;
+    struct lfh_slab *slab;
+    struct lfh_block *block;
+    ARENA_INUSE *arena;
+    char *ptr;
+    unsigned int i;
+
+    if (!(slab = allocate_block( heap, heap->flags & ~HEAP_GENERATE_EXCEPTIONS, LFH_SLAB_SIZE )))
+        return NULL;
+    slab->heap      = heap;
+    slab->free      = NULL;
+    slab->nb_used   = 0;
+    slab->nb_blocks = (LFH_SLAB_SIZE - LFH_SLAB_HEADER) / stride;
+    slab->class     = class;
+    slab->magic     = LFH_SLAB_MAGIC;
+
+    /* build the free list backwards so that blocks get allocated in address order */
+    ptr = (char *)slab + LFH_SLAB_HEADER + slab->nb_blocks * stride;
+    for (i = 0; i < slab->nb_blocks; i++)
+    {
+        ptr -= stride;
+        arena = (ARENA_INUSE *)(ptr + ARENA_OFFSET);
+        arena->size = (char *)(arena + 1) - (char *)slab;
+        arena->magic = ARENA_LFH_FREE_MAGIC;
+        arena->unused_bytes = 0;
+        block = (struct lfh_block *)(arena + 1);
+        block->next = slab->free;
+        slab->free = block;
+    }
+    return slab;
+}
+
+/* move a batch of free blocks from the class slabs to a thread cache */
+static BOOL refill_thread_cache( HEAP *heap, struct heap_thread_cache *cache, unsigned int class )
+{
+    struct lfh_class *lfh_class = &heap->lfh->classes[class];
+    struct lfh_slab *slab;
+    struct lfh_block *block;
+    struct list *ptr;
+    unsigned int count = 0;
+
+    for (;;)
+    {
+        RtlAcquireSRWLockExclusive( &lfh_class->lock );
+        while (count < LFH_CACHE_BATCH && (ptr = list_head( &lfh_class->slabs )))
+        {
+            slab = LIST_ENTRY( ptr, struct lfh_slab, entry );
+            while (count < LFH_CACHE_BATCH && (block = slab->free))
+            {
+                slab->free = block->next;
+                slab->nb_used++;
+                block->next = cache->blocks[class];
+                cache->blocks[class] = block;
+                count++;
+            }
+            if (!slab->free) list_remove( &slab->entry );
+        }
+        RtlReleaseSRWLockExclusive( &lfh_class->lock );
+        if (count) break;
+
+        /* the heap lock is taken without holding the class one, since it can be held across
+         * allocations with RtlLockHeap */
+        if (!(slab = create_lfh_slab( heap, class ))) return FALSE;
+        RtlAcquireSRWLockExclusive( &lfh_class->lock );
+        list_add_head( &lfh_class->slabs, &slab->entry );
+        RtlReleaseSRWLockExclusive( &lfh_class->lock );
+    }
+    cache->count[class] += count;
+    return TRUE;
+}
+
+/* give a chain of free blocks back to their slabs, optionally releasing the empty slabs */
+static void release_lfh_blocks( HEAP *heap, unsigned int class, struct lfh_block *block, BOOL free_slabs )
+{
+    struct lfh_class *lfh_class = &heap->lfh->classes[class];
+    struct list empty = LIST_INIT( empty );
+    struct lfh_slab *slab, *next_slab;
+    struct lfh_block *next;
+
+    RtlAcquireSRWLockExclusive( &lfh_class->lock );
+    for ( ; block; block = next)
+    {
+        next = block->next;
+        slab = get_block_slab( block );
+        if (!slab->free) list_add_tail( &lfh_class->slabs, &slab->entry );
+        block->next = slab->free;
+        slab->free = block;
+        if (--slab->nb_used || !free_slabs) continue;
+        /* keep the last slab around to avoid going back to the arenas for every batch */
+        if (list_head( &lfh_class->slabs ) == &slab->entry && list_tail( &lfh_class->slabs ) == &slab->entry)
+            continue;
+        list_remove( &slab->entry );
+        list_add_tail( &empty, &slab->entry );
+    }
+    RtlReleaseSRWLockExclusive( &lfh_class->lock );
+
+    LIST_FOR_EACH_ENTRY_SAFE( slab, next_slab, &empty, struct lfh_slab, entry )
+    {
+        slab->magic = 0;
+        RtlFreeHeap( heap, 0, slab );
+    }
+}
+
+/* give the blocks of a cache back to its heap and free it */
+static void free_thread_cache( struct heap_thread_cache *cache )
+{
+    unsigned int i;
+
+    /* empty slabs are not released here, as that would need the heap lock */
+    RtlEnterCriticalSection( &lfh_section );
+    if (cache->heap)
+        for (i = 0; i < LFH_NB_CLASSES; i++)
+            release_lfh_blocks( cache->heap, i, cache->blocks[i], FALSE );
+    list_remove( &cache->entry );
+    RtlLeaveCriticalSection( &lfh_section );
+    RtlFreeHeap( processHeap, 0, cache );
+}
+
+/* free the caches left behind by threads that have been terminated */
+static void free_orphan_caches(void)
+{
+    struct heap_thread_cache *cache, *next;
+
+    if (!orphan_caches) return;
+    for (cache = interlocked_xchg_ptr( (void **)&orphan_caches, NULL ); cache; cache = next)
+    {
+        next = cache->next;
+        free_thread_cache( cache );
+    }
+}
+
+/* free the caches of the current thread whose heap has been destroyed */
+static void purge_thread_caches( struct ntdll_thread_data *thread_data )
+{
+    struct heap_thread_cache *cache, **prev = &thread_data->heap_cache;
+
+    while ((cache = *prev))
+    {
+        if (cache->heap)
+        {
+            prev = &cache->next;
+            continue;
+        }
+        *prev = cache->next;
+        free_thread_cache( cache );
+    }
+}
+
+/* get the cache of the current thread for a heap, creating it if needed */
+static struct heap_thread_cache *get_thread_cache( HEAP *heap )
+{
+    struct ntdll_thread_data *thread_data = ntdll_get_thread_data();
+    struct heap_thread_cache *cache;
+
+    for (cache = thread_data->heap_cache; cache; cache = cache->next)
+        if (cache->heap == heap) return cache;
+
+    free_orphan_caches();
+    purge_thread_caches( thread_data );
+
+    /* the process heap may use the LFH too, so bypass it */
+    if (!(cache = allocate_block( processHeap, processHeap->flags, sizeof(*cache) ))) return NULL;
+    memset( cache, 0, sizeof(*cache) );
+    cache->heap = heap;
+    RtlEnterCriticalSection( &lfh_section );
+    list_add_tail( &lfh_caches, &cache->entry );
+    RtlLeaveCriticalSection( &lfh_section );
+    cache->next = thread_data->heap_cache;
+    thread_data->heap_cache = cache;
+    return cache;
+}
+
+/* allocate a block from the thread cache */
+static void *lfh_allocate( HEAP *heap, DWORD flags, SIZE_T size )
+{
+    unsigned int class = get_lfh_class( size );
+    struct heap_thread_cache *cache;
+    struct lfh_block *block;
+    ARENA_INUSE *arena;
+
+    if (!(cache = get_thread_cache( heap ))) return NULL;
+    if (!cache->blocks[class] && !refill_thread_cache( heap, cache, class )) return NULL;
+
+    block = cache->blocks[class];
+    cache->blocks[class] = block->next;
+    cache->count[class]--;
+
+    arena = (ARENA_INUSE *)block - 1;
+    arena->magic = ARENA_LFH_MAGIC;
+    arena->unused_bytes = get_lfh_class_size( class ) - size;
+    if (flags & HEAP_ZERO_MEMORY) memset( block, 0, size );
+    return block;
+}
+
+/* free a block to the thread cache, flushing part of it if it grows too large */
+static void lfh_free( HEAP *heap, struct lfh_slab *slab, ARENA_INUSE *arena )
+{
+    struct lfh_block *next, *block = (struct lfh_block *)(arena + 1);
+    struct heap_thread_cache *cache;
+    unsigned int i, class = slab->class;
+
+    arena->magic = ARENA_LFH_FREE_MAGIC;
+    if (!(cache = get_thread_cache( heap )))
+    {
+        block->next = NULL;
+        release_lfh_blocks( heap, class, block, TRUE );
+        return;
+    }
+
+    block->next = cache->blocks[class];
+    cache->blocks[class] = block;
+    if (++cache->count[class] <= LFH_CACHE_MAX) return;
+
+    /* keep the most recently freed blocks, they are more likely to be in the CPU cache */
+    for (i = 1; i < LFH_CACHE_MAX - LFH_CACHE_BATCH; i++) block = block->next;
+    next = block->next;
+    block->next = NULL;
+    cache->count[class] = LFH_CACHE_MAX - LFH_CACHE_BATCH;
+    release_lfh_blocks( heap, class, next, TRUE );
+}
+
+/* resize a LFH block, in place if it still fits in its size class */
+static void *lfh_reallocate( HEAP *heap, DWORD flags, struct lfh_slab *slab, void *ptr, SIZE_T size )
+{
+    ARENA_INUSE *arena = (ARENA_INUSE *)ptr - 1;
+    SIZE_T class_size = get_lfh_class_size( slab->class );
+    SIZE_T old_size = class_size - arena->unused_bytes;
+    void *ret;
+
+    if (size <= class_size && class_size - size <= 0xff)
+    {
+        if (size > old_size && (flags & HEAP_ZERO_MEMORY))
+            memset( (char *)ptr + old_size, 0, size - old_size );
+        arena->unused_bytes = class_size - size;
+        return ptr;
+    }
+
+    if ((flags & HEAP_REALLOC_IN_PLACE_ONLY) || !(ret = RtlAllocateHeap( heap, flags, size )))
+    {
+        if (flags & HEAP_GENERATE_EXCEPTIONS) RtlRaiseStatus( STATUS_NO_MEMORY );
+        RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_NO_MEMORY );
+        return NULL;
+    }
+    memcpy( ret, ptr, min( old_size, size ));
+    lfh_free( heap, slab, arena );
+    return ret;
+}
+
+/* detach the caches of a heap that is being destroyed; they are freed by their
+ * thread the next time it creates a cache, or when it exits */
+static void destroy_thread_caches( HEAP *heap )
+{
+    struct heap_thread_cache *cache, *next;
+
+    RtlEnterCriticalSection( &lfh_section );
+    LIST_FOR_EACH_ENTRY_SAFE( cache, next, &lfh_caches, struct heap_thread_cache, entry )
+    {
+        if (cache->heap != heap) continue;
+        cache->heap = NULL;
+        list_remove( &cache->entry );
+        list_init( &cache->entry );
+    }
+    RtlLeaveCriticalSection( &lfh_section );
+    purge_thread_caches( ntdll_get_thread_data() );
+}
+
+
+/***********************************************************************
+ *           heap_free_thread_caches
+ *
+ * Give the blocks of the current thread caches back to their heaps on thread exit.
+ */
+void heap_free_thread_caches(void)
+{
+    struct ntdll_thread_data *thread_data = ntdll_get_thread_data();
+    struct heap_thread_cache *cache, *next;
+
+    for (cache = thread_data->heap_cache; cache; cache = next)
+    {
+        next = cache->next;
+        free_thread_cache( cache );
+    }
+    thread_data->heap_cache = NULL;
+    free_orphan_caches();
+}
+
+
+/***********************************************************************
+ *           heap_orphan_thread_caches
+ *
+ * Hand the caches of a thread that is being terminated over to the other threads.
+ * This can run in a signal handler, so it doesn't take any lock.
+ */
+void heap_orphan_thread_caches(void)
+{
+    struct ntdll_thread_data *thread_data = ntdll_get_thread_data();
+    struct heap_thread_cache *head, *tail, *first = thread_data->heap_cache;
+
+    if (!first) return;
+    thread_data->heap_cache = NULL;
+    for (tail = first; tail->next; tail = tail->next) ;
+    do
+    {
+        head = orphan_caches;
+        tail->next = head;
+    } while (interlocked_cmpxchg_ptr( (void **)&orphan_caches, first, head ) != head);
+}
+
+
 /***********************************************************************
  *           RtlCreateHeap   (NTDLL.@)
  *
@@ -1602,6 +2096,8 @@ HANDLE WINAPI RtlDestroyHeap( HANDLE heap )
     list_remove( &heapPtr->entry );
     RtlLeaveCriticalSection( &processHeap->critSection );
 
+    if (heapPtr->lfh) destroy_thread_caches( heapPtr );
+
     heapPtr->critSection.DebugInfo->Spare[0] = 0;
     RtlDeleteCriticalSection( &heapPtr->critSection );
 
@@ -1654,72 +2150,22 @@ HANDLE WINAPI RtlDestroyHeap( HANDLE heap )
  */
 PVOID WINAPI RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_T size )
 {
-    ARENA_FREE *pArena;
-    ARENA_INUSE *pInUse;
-    SUBHEAP *subheap;
     HEAP *heapPtr = HEAP_GetPtr( heap );
-    SIZE_T rounded_size;
+    void *ret;
 
     /* Validate the parameters */
 
     if (!heapPtr) return NULL;
     flags &= HEAP_GENERATE_EXCEPTIONS | HEAP_NO_SERIALIZE | HEAP_ZERO_MEMORY;
     flags |= heapPtr->flags;
-    rounded_size = ROUND_SIZE(size) + HEAP_TAIL_EXTRA_SIZE( flags );
-    if (rounded_size < size)  /* overflow */
-    {
-        if (flags & HEAP_GENERATE_EXCEPTIONS) RtlRaiseStatus( STATUS_NO_MEMORY );
-        return NULL;
-    }
-    if (rounded_size < HEAP_MIN_DATA_SIZE) rounded_size = HEAP_MIN_DATA_SIZE;
-
-    if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
-    if (rounded_size >= HEAP_MIN_LARGE_BLOCK_SIZE && (flags & HEAP_GROWABLE))
+    if (heapPtr->lfh && size <= LFH_MAX_BLOCK_SIZE && !(flags & LFH_DISABLE_FLAGS) &&
+        (ret = lfh_allocate( heapPtr, flags, size )))
     {
-        void *ret = allocate_large_block( heap, flags, size );
-        if (!(flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heapPtr->critSection );
-        if (!ret && (flags & HEAP_GENERATE_EXCEPTIONS)) RtlRaiseStatus( STATUS_NO_MEMORY );
         TRACE("(%p,%08x,%08lx): returning %p\n", heap, flags, size, ret );
         return ret;
     }
-
-    /* Locate a suitable free block */
-
-    if (!(pArena = HEAP_FindFreeBlock( heapPtr, rounded_size, &subheap )))
-    {
-        TRACE("(%p,%08x,%08lx): returning NULL\n",
-                  heap, flags, size  );
-        if (!(flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heapPtr->critSection );
-        if (flags & HEAP_GENERATE_EXCEPTIONS) RtlRaiseStatus( STATUS_NO_MEMORY );
-        return NULL;
-    }
-
-    /* Remove the arena from the free list */
-
-    list_remove( &pArena->entry );
-
-    /* Build the in-use arena */
-
-    pInUse = (ARENA_INUSE *)pArena;
-
-    /* in-use arena is smaller than free arena,
-     * so we have to add the difference to the size */
-    pInUse->size  = (pInUse->size & ~ARENA_FLAG_FREE) + sizeof(ARENA_FREE) - sizeof(ARENA_INUSE);
-    pInUse->magic = ARENA_INUSE_MAGIC;
-
-    /* Shrink the block */
-
-    HEAP_ShrinkBlock( subheap, pInUse, rounded_size );
-    pInUse->unused_bytes = (pInUse->size & ARENA_SIZE_MASK) - size;
-
-    notify_alloc( pInUse + 1, size, flags & HEAP_ZERO_MEMORY );
-    initialize_block( pInUse + 1, size, pInUse->unused_bytes, flags );
-
-    if (!(flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heapPtr->critSection );
-
-    TRACE("(%p,%08x,%08lx): returning %p\n", heap, flags, size, pInUse + 1 );
-    return pInUse + 1;
+    return allocate_block( heapPtr, flags, size );
 }
 
 
@@ -1742,6 +2188,7 @@ BOOLEAN WINAPI RtlFreeHeap( HANDLE heap, ULONG flags, PVOID ptr )
     ARENA_INUSE *pInUse;
     SUBHEAP *subheap;
     HEAP *heapPtr;
+    struct lfh_slab *slab;
 
     /* Validate the parameters */
 
@@ -1756,6 +2203,14 @@ BOOLEAN WINAPI RtlFreeHeap( HANDLE heap, ULONG flags, PVOID ptr )
 
     flags &= HEAP_NO_SERIALIZE;
     flags |= heapPtr->flags;
+
+    if ((slab = find_lfh_slab( heapPtr, (ARENA_INUSE *)ptr - 1 )))
+    {
+        lfh_free( heapPtr, slab, (ARENA_INUSE *)ptr - 1 );
+        TRACE("(%p,%08x,%p): returning TRUE\n", heap, flags, ptr );
+        return TRUE;
+    }
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     /* Inform valgrind we are trying to free memory, so it can throw up an error message */
@@ -1802,6 +2257,7 @@ PVOID WINAPI RtlReAllocateHeap( HANDLE heap, ULONG flags, PVOID ptr, SIZE_T size
     ARENA_INUSE *pArena;
     HEAP *heapPtr;
     SUBHEAP *subheap;
+    struct lfh_slab *slab;
     SIZE_T oldBlockSize, oldActualSize, rounded_size;
     void *ret;
 
@@ -1817,6 +2273,14 @@ PVOID WINAPI RtlReAllocateHeap( HANDLE heap, ULONG flags, PVOID ptr, SIZE_T size
     flags &= HEAP_GENERATE_EXCEPTIONS | HEAP_NO_SERIALIZE | HEAP_ZERO_MEMORY |
              HEAP_REALLOC_IN_PLACE_ONLY;
     flags |= heapPtr->flags;
+
+    if ((slab = find_lfh_slab( heapPtr, (ARENA_INUSE *)ptr - 1 )))
+    {
+        ret = lfh_reallocate( heapPtr, flags, slab, ptr, size );
+        TRACE("(%p,%08x,%p,%08lx): returning %p\n", heap, flags, ptr, size, ret );
+        return ret;
+    }
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     rounded_size = ROUND_SIZE(size) + HEAP_TAIL_EXTRA_SIZE(flags);
@@ -2017,6 +2481,7 @@ SIZE_T WINAPI RtlSizeHeap( HANDLE heap, ULONG flags, const void *ptr )
     SIZE_T ret;
     const ARENA_INUSE *pArena;
     SUBHEAP *subheap;
+    struct lfh_slab *slab;
     HEAP *heapPtr = HEAP_GetPtr( heap );
 
     if (!heapPtr)
@@ -2026,9 +2491,17 @@ SIZE_T WINAPI RtlSizeHeap( HANDLE heap, ULONG flags, const void *ptr )
     }
     flags &= HEAP_NO_SERIALIZE;
     flags |= heapPtr->flags;
-    if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     pArena = (const ARENA_INUSE *)ptr - 1;
+    if ((slab = find_lfh_slab( heapPtr, pArena )))
+    {
+        ret = get_lfh_class_size( slab->class ) - pArena->unused_bytes;
+        TRACE("(%p,%08x,%p): returning %08lx\n", heap, flags, ptr, ret );
+        return ret;
+    }
+
+    if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
+
     if (!validate_block_pointer( heapPtr, &subheap, pArena ))
     {
         RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_INVALID_PARAMETER );
@@ -2236,6 +2709,8 @@ ULONG WINAPI RtlGetProcessHeaps( ULONG count, HANDLE *heaps )
 NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS info_class,
                                          PVOID info, SIZE_T size_in, PSIZE_T size_out)
 {
+    HEAP *heapPtr;
+
     switch (info_class)
     {
     case HeapCompatibilityInformation:
@@ -2244,7 +2719,8 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS inf
         if (size_in < sizeof(ULONG))
             return STATUS_BUFFER_TOO_SMALL;
 
-        *(ULONG *)info = 0; /* standard heap */
+        if (!(heapPtr = HEAP_GetPtr( heap ))) return STATUS_INVALID_HANDLE;
+        *(ULONG *)info = heapPtr->lfh ? 2 : 0;  /* low fragmentation or standard heap */
         return STATUS_SUCCESS;
 
     default:
@@ -2258,6 +2734,36 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS inf
  */
 NTSTATUS WINAPI RtlSetHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS info_class, PVOID info, SIZE_T size)
 {
-    FIXME("%p %d %p %ld stub\n", heap, info_class, info, size);
-    return STATUS_SUCCESS;
+    struct lfh_heap *lfh;
+    HEAP *heapPtr;
+    unsigned int i;
+
+    switch (info_class)
+    {
+    case HeapCompatibilityInformation:
+        if (size < sizeof(ULONG)) return STATUS_BUFFER_TOO_SMALL;
+        if (!(heapPtr = HEAP_GetPtr( heap ))) return STATUS_INVALID_HANDLE;
+        if (*(ULONG *)info != 2)
+        {
+            FIXME("%p: unsupported compatibility mode %u\n", heap, *(ULONG *)info);
+            return STATUS_SUCCESS;
+        }
+        if (heapPtr->flags & HEAP_NO_SERIALIZE) return STATUS_INVALID_PARAMETER;
+        if (heapPtr->lfh || RUNNING_ON_VALGRIND) return STATUS_SUCCESS;
+
+        if (!(lfh = allocate_block( heapPtr, heapPtr->flags & ~HEAP_GENERATE_EXCEPTIONS, sizeof(*lfh) )))
+            return STATUS_NO_MEMORY;
+        for (i = 0; i < LFH_NB_CLASSES; i++)
+        {
+            RtlInitializeSRWLock( &lfh->classes[i].lock );
+            list_init( &lfh->classes[i].slabs );
+        }
+        if (interlocked_cmpxchg_ptr( (void **)&heapPtr->lfh, lfh, NULL )) RtlFreeHeap( heap, 0, lfh );
+        else TRACE( "%p: enabled low fragmentation heap\n", heap );
+        return STATUS_SUCCESS;
+
+    default:
+        FIXME("%p %d %p %ld stub\n", heap, info_class, info, size);
+        return STATUS_SUCCESS;
+    }
 }
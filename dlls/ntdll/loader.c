@@ -84,8 +84,20 @@ typedef struct _wine_modref
     LDR_MODULE            ldr;
     int                   nDeps;
     struct _wine_modref **deps;
+    struct export_hash_entry *export_hash;  /* hash table of the export names */
+    DWORD                 export_hash_mask; /* size of the hash table minus one */
+    FARPROC              *forwards;         /* resolved forwarded exports, indexed by ordinal */
 } WINE_MODREF;
 
+struct export_hash_entry
+{
+    DWORD hash;   /* hash of the export name */
+    DWORD index;  /* index in the name table plus one, 0 if the entry is free */
+};
+
+/* modules with fewer exported names are simply binary-searched */
+#define EXPORT_HASH_MIN_NAMES 16
+
 /* info about the current builtin dll load */
 /* used to keep track of things across the register_dll constructor call */
 struct builtin_load_info
@@ -415,6 +427,71 @@ static WINE_MODREF *find_fullname_module( LPCWSTR name )
 }
 
 
+/*************************************************************************
+ *		hash_export_name
+ */
+static inline DWORD hash_export_name( const char *name )
+{
+    DWORD hash = 0;
+    while (*name) hash = hash * 65599 + (unsigned char)*name++;
+    return hash;
+}
+
+
+/*************************************************************************
+ *		get_export_hash
+ *
+ * Return the hash table of the export names of a module, building it on first use.
+ * The loader_section must be locked while calling this function.
+ */
+static const struct export_hash_entry *get_export_hash( WINE_MODREF *wm, const IMAGE_EXPORT_DIRECTORY *exports )
+{
+    const DWORD *names = get_rva( wm->ldr.BaseAddress, exports->AddressOfNames );
+    struct export_hash_entry *table;
+    DWORD i, size;
+
+    if (wm->export_hash) return wm->export_hash;
+    if (exports->NumberOfNames < EXPORT_HASH_MIN_NAMES) return NULL;
+
+    /* keep the table at most half full */
+    for (size = 2 * EXPORT_HASH_MIN_NAMES; size < 2 * exports->NumberOfNames; size *= 2) /* nothing */;
+    if (!(table = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, size * sizeof(*table) )))
+        return NULL;
+
+    for (i = 0; i < exports->NumberOfNames; i++)
+    {
+        DWORD hash = hash_export_name( get_rva( wm->ldr.BaseAddress, names[i] ));
+        DWORD pos = hash & (size - 1);
+
+        while (table[pos].index) pos = (pos + 1) & (size - 1);
+        table[pos].hash = hash;
+        table[pos].index = i + 1;
+    }
+    wm->export_hash_mask = size - 1;
+    return wm->export_hash = table;
+}
+
+
+/*************************************************************************
+ *		flush_forward_caches
+ *
+ * Forget all the resolved forwarders, since their target may be unloaded.
+ * The loader_section must be locked while calling this function.
+ */
+static void flush_forward_caches(void)
+{
+    PLIST_ENTRY mark, entry;
+
+    mark = &NtCurrentTeb()->Peb->LdrData->InLoadOrderModuleList;
+    for (entry = mark->Flink; entry != mark; entry = entry->Flink)
+    {
+        WINE_MODREF *wm = CONTAINING_RECORD( entry, WINE_MODREF, ldr.InLoadOrderModuleList );
+        RtlFreeHeap( GetProcessHeap(), 0, wm->forwards );
+        wm->forwards = NULL;
+    }
+}
+
+
 /*************************************************************************
  *		find_forwarded_export
  *
@@ -481,6 +558,36 @@ static FARPROC find_forwarded_export( HMODULE module, const char *forward, LPCWS
 }
 
 
+/*************************************************************************
+ *		find_cached_forward
+ *
+ * Resolve a forwarded export, remembering the result for the next lookups.
+ * The loader_section must be locked while calling this function.
+ */
+static FARPROC find_cached_forward( HMODULE module, const IMAGE_EXPORT_DIRECTORY *exports,
+                                    DWORD ordinal, const char *forward, LPCWSTR load_path )
+{
+    WINE_MODREF *wm;
+    FARPROC proc;
+
+    /* relay and snoop thunks depend on the importing module */
+    if (TRACE_ON(relay) || TRACE_ON(snoop) || !(wm = get_modref( module )))
+        return find_forwarded_export( module, forward, load_path );
+
+    if (wm->forwards && wm->forwards[ordinal]) return wm->forwards[ordinal];
+
+    if (!(proc = find_forwarded_export( module, forward, load_path ))) return NULL;
+
+    /* the module list may have changed while loading the forward target */
+    if (!(wm = get_modref( module ))) return proc;
+    if (!wm->forwards)
+        wm->forwards = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                        exports->NumberOfFunctions * sizeof(*wm->forwards) );
+    if (wm->forwards) wm->forwards[ordinal] = proc;
+    return proc;
+}
+
+
 /*************************************************************************
  *		find_ordinal_export
  *
@@ -506,7 +613,7 @@ static FARPROC find_ordinal_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY
     /* if the address falls into the export dir, it's a forward */
     if (((const char *)proc >= (const char *)exports) && 
         ((const char *)proc < (const char *)exports + exp_size))
-        return find_forwarded_export( module, (const char *)proc, load_path );
+        return find_cached_forward( module, exports, ordinal, (const char *)proc, load_path );
 
     if (TRACE_ON(snoop))
     {
@@ -533,6 +640,8 @@ static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *
 {
     const WORD *ordinals = get_rva( module, exports->AddressOfNameOrdinals );
     const DWORD *names = get_rva( module, exports->AddressOfNames );
+    const struct export_hash_entry *table;
+    WINE_MODREF *wm;
     int min = 0, max = exports->NumberOfNames - 1;
 
     /* first check the hint */
@@ -543,7 +652,23 @@ static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *
             return find_ordinal_export( module, exports, exp_size, ordinals[hint], load_path );
     }
 
-    /* then do a binary search */
+    /* then look it up in the hash table */
+    if ((wm = get_modref( module )) && (table = get_export_hash( wm, exports )))
+    {
+        DWORD hash = hash_export_name( name ), pos = hash;
+
+        for (;;)
+        {
+            const struct export_hash_entry *entry = &table[pos & wm->export_hash_mask];
+            if (!entry->index) return NULL;
+            if (entry->hash == hash && !strcmp( get_rva( module, names[entry->index - 1] ), name ))
+                return find_ordinal_export( module, exports, exp_size,
+                                            ordinals[entry->index - 1], load_path );
+            pos++;
+        }
+    }
+
+    /* else do a binary search */
     while (min <= max)
     {
         int res, pos = (min + max) / 2;
@@ -927,6 +1052,9 @@ static WINE_MODREF *alloc_module( HMODULE hModule, LPCWSTR filename )
 
     wm->nDeps    = 0;
     wm->deps     = NULL;
+    wm->export_hash = NULL;
+    wm->export_hash_mask = 0;
+    wm->forwards = NULL;
 
     wm->ldr.BaseAddress   = hModule;
     wm->ldr.EntryPoint    = NULL;
@@ -2817,7 +2945,10 @@ static void free_modref( WINE_MODREF *wm )
     if (cached_modref == wm) cached_modref = NULL;
     RtlFreeUnicodeString( &wm->ldr.FullDllName );
     RtlFreeHeap( GetProcessHeap(), 0, wm->deps );
+    RtlFreeHeap( GetProcessHeap(), 0, wm->export_hash );
+    RtlFreeHeap( GetProcessHeap(), 0, wm->forwards );
     RtlFreeHeap( GetProcessHeap(), 0, wm );
+    flush_forward_caches();
 }
 
 /***********************************************************************
@@ -30,6 +30,9 @@
 #ifdef HAVE_UNISTD_H
 # include <unistd.h>
 #endif
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -41,6 +44,55 @@
 
 WINE_DEFAULT_DEBUG_CHANNEL(ntdll);
 
+static const unsigned int *handle_shm;
+static RTL_RUN_ONCE handle_shm_once = RTL_RUN_ONCE_INIT;
+
+static DWORD WINAPI init_handle_shm( RTL_RUN_ONCE *once, void *param, void **context )
+{
+    unsigned int *ptr;
+    unsigned int ret;
+    int fd;
+
+    if ((fd = server_create_shm_fd( "wine-handles", HANDLE_SHM_SIZE )) == -1) return TRUE;
+
+    /* the mirror is only written by the server */
+    if ((ptr = mmap( NULL, HANDLE_SHM_SIZE, PROT_READ, MAP_SHARED, fd, 0 )) == MAP_FAILED)
+    {
+        close( fd );
+        return TRUE;
+    }
+
+    wine_server_send_fd( fd );
+    SERVER_START_REQ( set_handle_shm )
+    {
+        req->shm_fd = fd;
+        ret = wine_server_call( req );
+    }
+    SERVER_END_REQ;
+    close( fd );
+
+    if (!ret) handle_shm = ptr;
+    else munmap( ptr, HANDLE_SHM_SIZE );
+    return TRUE;
+}
+
+/***********************************************************************
+ *           get_handle_shm_state
+ *
+ * Retrieve the state of a handle from the mirror of the process handle table.
+ * Return FALSE if it's not mirrored (pseudo-handles, global handles, or handles
+ * beyond the mirrored range) and the server needs to be asked.
+ */
+static BOOL get_handle_shm_state( HANDLE handle, unsigned int *state )
+{
+    unsigned int index = (wine_server_obj_handle( handle ) >> 2) - 1;
+
+    RtlRunOnceExecuteOnce( &handle_shm_once, init_handle_shm, NULL, NULL );
+    if (!handle_shm || index >= HANDLE_SHM_SLOTS) return FALSE;
+    *state = *(volatile const unsigned int *)&handle_shm[index];
+    return TRUE;
+}
+
 
 /*
  *	Generic object functions
@@ -189,9 +241,20 @@ NTSTATUS WINAPI NtQueryObject(IN HANDLE handle,
     case ObjectDataInformation:
         {
             OBJECT_DATA_INFORMATION* p = ptr;
+            unsigned int state;
 
             if (len < sizeof(*p)) return STATUS_INVALID_BUFFER_SIZE;
 
+            if (get_handle_shm_state( handle, &state ))
+            {
+                if (!(state & HANDLE_SHM_VALID)) return STATUS_INVALID_HANDLE;
+                p->InheritHandle = (state & HANDLE_SHM_INHERIT) != 0;
+                p->ProtectFromClose = (state & HANDLE_SHM_PROTECT) != 0;
+                if (used_len) *used_len = sizeof(*p);
+                status = STATUS_SUCCESS;
+                break;
+            }
+
             SERVER_START_REQ( set_handle_info )
             {
                 req->handle = wine_server_obj_handle( handle );
@@ -366,11 +429,22 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source,
         if (!(ret = wine_server_call( req )))
         {
             if (dest) *dest = wine_server_ptr_handle( reply->handle );
-            if (reply->closed && reply->self)
+            /* a copy with the same access can share the cached fd */
+            if (reply->self && dest && dest_process == NtCurrentProcess() &&
+                (options & DUPLICATE_SAME_ACCESS))
+            {
+                server_dup_cached_fd( source, *dest, reply->closed );
+            }
+            else if (reply->closed && reply->self)
             {
                 int fd = server_remove_fd_from_cache( source );
                 if (fd != -1) close( fd );
             }
+            if (reply->closed && reply->self)
+            {
+                remove_sync_shm_from_cache( source );
+                DIR_close_handle( source );
+            }
         }
     }
     SERVER_END_REQ;
@@ -381,8 +455,23 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source,
 NTSTATUS close_handle( HANDLE handle )
 {
     NTSTATUS ret;
+    unsigned int state;
     int fd = server_remove_fd_from_cache( handle );
 
+    remove_sync_shm_from_cache( handle );
+    DIR_close_handle( handle );
+    if (get_handle_shm_state( handle, &state ))
+    {
+        /* invalid and protected handles are rejected without a server round-trip */
+        ret = STATUS_SUCCESS;
+        if (!(state & HANDLE_SHM_VALID)) ret = STATUS_INVALID_HANDLE;
+        else if (state & HANDLE_SHM_PROTECT) ret = STATUS_HANDLE_NOT_CLOSABLE;
+        if (ret)
+        {
+            if (fd != -1) close( fd );
+            return ret;
+        }
+    }
     SERVER_START_REQ( close_handle )
     {
         req->handle = wine_server_obj_handle( handle );
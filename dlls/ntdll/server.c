@@ -28,12 +28,16 @@
 #endif
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #ifdef HAVE_LWP_H
 #include <lwp.h>
 #endif
 #ifdef HAVE_PTHREAD_NP_H
 # include <pthread_np.h>
 #endif
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
 #include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -93,6 +97,18 @@ WINE_DEFAULT_DEBUG_CHANNEL(server);
 #define MSG_CMSG_CLOEXEC 0
 #endif
 
+/* memfd definitions, missing from older headers */
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC       0x0001
+#define MFD_ALLOW_SEALING 0x0002
+#endif
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS    1033
+#define F_SEAL_SEAL    0x0001
+#define F_SEAL_SHRINK  0x0002
+#define F_SEAL_GROW    0x0004
+#endif
+
 #define SOCKETNAME "socket"        /* name of the socket file */
 #define LOCKNAME   "lock"          /* name of the lock file */
 
@@ -277,6 +293,173 @@ static inline unsigned int wait_reply( struct __server_request_info *req )
 }
 
 
+#if defined(__linux__) && defined(__NR_futex) && defined(__NR_memfd_create)
+
+#define REQUEST_SHM_SPIN_COUNT 1000  /* number of polls of the reply before sleeping */
+
+static inline int shm_futex_wait( int *addr, int val, const struct timespec *timeout )
+{
+    /* the futex is shared with the server process, so it can't be private */
+    return syscall( __NR_futex, addr, 0 /* FUTEX_WAIT */, val, timeout, 0, 0 );
+}
+
+static inline void small_pause(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__( "rep;nop" : : : "memory" );
+#else
+    __asm__ __volatile__( "" : : : "memory" );
+#endif
+}
+
+
+/***********************************************************************
+ *           check_server_connection
+ *
+ * Make sure the server is still there while waiting for a shared memory reply.
+ */
+static void check_server_connection(void)
+{
+    struct pollfd pfd;
+
+    pfd.fd      = ntdll_get_thread_data()->reply_fd;
+    pfd.events  = POLLIN;
+    pfd.revents = 0;
+    /* the server closed the connection; time to die... */
+    if (poll( &pfd, 1, 0 ) == 1 && (pfd.revents & (POLLHUP | POLLERR))) abort_thread(0);
+}
+
+
+/***********************************************************************
+ *           wait_reply_shm
+ *
+ * Wait for a reply stored in the shared memory area of the current thread.
+ */
+static unsigned int wait_reply_shm( struct __server_request_info *req, struct request_shm *shm )
+{
+    static const struct timespec timeout = { 1, 0 };
+    unsigned int i;
+    int state;
+
+    /* the server usually replies quickly, so poll a bit before going to sleep */
+    if (NtCurrentTeb()->Peb->NumberOfProcessors > 1)
+    {
+        for (i = 0; i < REQUEST_SHM_SPIN_COUNT; i++)
+        {
+            if (*(volatile int *)&shm->state != REQUEST_SHM_PENDING) break;
+            small_pause();
+        }
+    }
+
+    while ((state = interlocked_cmpxchg( &shm->state, REQUEST_SHM_IDLE,
+                                         REQUEST_SHM_REPLIED )) == REQUEST_SHM_PENDING)
+    {
+        /* the full barrier orders the waiting flag with the state check done by the futex */
+        interlocked_xchg( &shm->waiting, 1 );
+        if (shm_futex_wait( &shm->state, REQUEST_SHM_PENDING, &timeout ) == -1 && errno == ETIMEDOUT)
+            check_server_connection();
+    }
+    shm->waiting = 0;
+    if (state != REQUEST_SHM_REPLIED) abort_thread(0);  /* thread got killed */
+
+    memcpy( &req->u.reply, &shm->reply, sizeof(req->u.reply) );
+    if (req->u.reply.reply_header.reply_size)
+        memcpy( req->reply_data, shm->data, req->u.reply.reply_header.reply_size );
+    return req->u.reply.reply_header.error;
+}
+
+
+/***********************************************************************
+ *           server_create_shm_fd
+ *
+ * Create a memory file of fixed size that can be shared with the server.
+ */
+int server_create_shm_fd( const char *name, size_t size )
+{
+    int fd;
+
+    if ((fd = syscall( __NR_memfd_create, name, MFD_CLOEXEC | MFD_ALLOW_SEALING )) == -1)
+        return -1;
+
+    /* the server refuses to map files that could shrink under its feet */
+    if (ftruncate( fd, size ) == -1 ||
+        fcntl( fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL ) == -1)
+    {
+        close( fd );
+        return -1;
+    }
+    return fd;
+}
+
+
+/***********************************************************************
+ *           init_request_shm
+ *
+ * Setup the shared memory area used for the replies to small requests.
+ * The pipe protocol is used for everything if this fails.
+ */
+static void init_request_shm(void)
+{
+    struct request_shm *shm;
+    unsigned int ret;
+    int fd;
+
+    if ((fd = server_create_shm_fd( "wine-request", sizeof(*shm) )) == -1) return;
+
+    if ((shm = mmap( NULL, sizeof(*shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 )) == MAP_FAILED)
+    {
+        close( fd );
+        return;
+    }
+
+    wine_server_send_fd( fd );
+    SERVER_START_REQ( set_request_shm )
+    {
+        req->shm_fd = fd;
+        ret = wine_server_call( req );
+    }
+    SERVER_END_REQ;
+    close( fd );
+
+    if (!ret) ntdll_get_thread_data()->request_shm = shm;
+    else munmap( shm, sizeof(*shm) );
+}
+
+#else  /* __linux__ */
+
+static unsigned int wait_reply_shm( struct __server_request_info *req, struct request_shm *shm )
+{
+    assert( 0 );  /* init_request_shm never sets up the area */
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+int server_create_shm_fd( const char *name, size_t size )
+{
+    return -1;
+}
+
+static void init_request_shm(void)
+{
+}
+
+#endif  /* __linux__ */
+
+
+/***********************************************************************
+ *           server_free_request_shm
+ *
+ * Release the shared memory area of the current thread.
+ */
+void server_free_request_shm(void)
+{
+    struct request_shm *shm = ntdll_get_thread_data()->request_shm;
+
+    if (!shm) return;
+    ntdll_get_thread_data()->request_shm = NULL;
+    munmap( shm, sizeof(*shm) );
+}
+
+
 /***********************************************************************
  *           wine_server_call (NTDLL.@)
  *
@@ -302,12 +485,28 @@ static inline unsigned int wait_reply( struct __server_request_info *req )
 unsigned int wine_server_call( void *req_ptr )
 {
     struct __server_request_info * const req = req_ptr;
+    struct request_shm *shm = ntdll_get_thread_data()->request_shm;
     sigset_t old_set;
     unsigned int ret;
 
     pthread_sigmask( SIG_BLOCK, &server_block_set, &old_set );
-    ret = send_request( req );
-    if (!ret) ret = wait_reply( req );
+    if (shm && !req->u.req.request_header.request_size &&
+        req->u.req.request_header.reply_size <= REQUEST_SHM_DATA_SIZE)
+    {
+        /* the fixed part still goes through the pipe to wake up the server,
+         * but the reply is returned through the shared memory area */
+        shm->state = REQUEST_SHM_PENDING;
+        req->u.req.request_header.req |= REQUEST_SHM_FLAG;
+        ret = send_request( req );
+        req->u.req.request_header.req &= ~REQUEST_SHM_FLAG;
+        if (!ret) ret = wait_reply_shm( req, shm );
+        else shm->state = REQUEST_SHM_IDLE;
+    }
+    else
+    {
+        ret = send_request( req );
+        if (!ret) ret = wait_reply( req );
+    }
     pthread_sigmask( SIG_SETMASK, &old_set, NULL );
     return ret;
 }
@@ -914,6 +1113,79 @@ int server_remove_fd_from_cache( HANDLE handle )
 }
 
 
+/***********************************************************************
+ *           server_dup_cached_fd
+ *
+ * Give a handle duplicated in the current process the cached fd of its
+ * source, so that it doesn't need a server round-trip on first use.
+ */
+void server_dup_cached_fd( HANDLE source, HANDLE dest, BOOL source_closed )
+{
+    enum server_fd_type type;
+    unsigned int access, options;
+    sigset_t sigset;
+    int fd;
+
+    fd = get_cached_fd( source, &type, &access, &options );
+    if (source_closed) fd = server_remove_fd_from_cache( source );
+    else if (fd != -1 && (fd = dup( fd )) != -1) fcntl( fd, F_SETFD, FD_CLOEXEC );
+    if (fd == -1) return;
+
+    server_enter_uninterrupted_section( &fd_cache_section, &sigset );
+    if (get_cached_fd( dest, NULL, NULL, NULL ) != -1 || !add_fd_to_cache( dest, fd, type, access, options ))
+        close( fd );
+    server_leave_uninterrupted_section( &fd_cache_section, &sigset );
+}
+
+
+/***********************************************************************
+ *           server_prefetch_fds
+ *
+ * Fill the fd cache for several handles with a single server call.
+ */
+void server_prefetch_fds( const HANDLE *handles, unsigned int count )
+{
+    struct handle_fd_info infos[16];
+    obj_handle_t list[16], fd_handle;
+    unsigned int i, n = 0;
+    sigset_t sigset;
+    int fd;
+
+    server_enter_uninterrupted_section( &fd_cache_section, &sigset );
+
+    for (i = 0; i < count && n < sizeof(list) / sizeof(list[0]); i++)
+        if (handles[i] && get_cached_fd( handles[i], NULL, NULL, NULL ) == -1)
+            list[n++] = wine_server_obj_handle( handles[i] );
+
+    if (n)
+    {
+        SERVER_START_REQ( get_handle_fds )
+        {
+            wine_server_add_data( req, list, n * sizeof(list[0]) );
+            wine_server_set_reply( req, infos, n * sizeof(infos[0]) );
+            if (wine_server_call( req )) n = 0;
+            else n = wine_server_reply_size( reply ) / sizeof(infos[0]);
+        }
+        SERVER_END_REQ;
+    }
+
+    /* the fds are sent in the order of the infos */
+    for (i = 0; i < n; i++)
+    {
+        HANDLE handle = wine_server_ptr_handle( infos[i].handle );
+
+        if ((fd = receive_fd( &fd_handle )) == -1) continue;
+        assert( fd_handle == infos[i].handle );
+        /* the same handle may have been passed twice */
+        if (!infos[i].cacheable || get_cached_fd( handle, NULL, NULL, NULL ) != -1 ||
+            !add_fd_to_cache( handle, fd, infos[i].type, infos[i].access, infos[i].options ))
+            close( fd );
+    }
+
+    server_leave_uninterrupted_section( &fd_cache_section, &sigset );
+}
+
+
 /***********************************************************************
  *           server_get_unix_fd
  *
@@ -1518,6 +1790,7 @@ size_t server_init_thread( void *entry_point )
                 fatal_error( "WINEARCH set to win64 but '%s' is a 32-bit installation.\n",
                              wine_get_config_dir() );
         }
+        init_request_shm();
         return info_size;
     case STATUS_INVALID_IMAGE_WIN_64:
         fatal_error( "'%s' is a 32-bit installation, it cannot support 64-bit applications.\n",
@@ -36,6 +36,9 @@
 #ifdef HAVE_SYS_POLL_H
 # include <sys/poll.h>
 #endif
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
 #ifdef HAVE_UNISTD_H
 # include <unistd.h>
 #endif
@@ -53,6 +56,7 @@
 #define NONAMELESSUNION
 #include "windef.h"
 #include "winternl.h"
+#include "wine/library.h"
 #include "wine/server.h"
 #include "wine/debug.h"
 #include "ntdll_misc.h"
@@ -142,6 +146,247 @@ void NTDLL_free_struct_sd(struct security_descriptor *server_sd)
     RtlFreeHeap(GetProcessHeap(), 0, server_sd);
 }
 
+/*
+ *	Process-private synchronization objects
+ *
+ * The state of unnamed events, mutexes and semaphores created by the process
+ * lives in a memory area shared with the server, so they can be signaled and
+ * acquired without a server call. As soon as the server has a thread waiting
+ * on an object, it sets the SYNC_SHM_SERVER bit in its state and all the
+ * operations have to go through the server until the waiters are gone.
+ */
+
+#define SYNC_SHM_AUTO_EVENT    1
+#define SYNC_SHM_MANUAL_EVENT  2
+#define SYNC_SHM_SEMAPHORE     3
+#define SYNC_SHM_MUTEX         4
+#define SYNC_SHM_TYPE_MASK     7
+
+#define SYNC_SHM_CACHE_BLOCK_SIZE  (65536 / sizeof(int))
+#define SYNC_SHM_CACHE_ENTRIES     128
+
+static struct sync_shm_slot *sync_shm;
+static RTL_RUN_ONCE sync_shm_once = RTL_RUN_ONCE_INIT;
+
+/* slot index and type of the handles to private objects, indexed like the fd cache */
+static int *sync_shm_cache[SYNC_SHM_CACHE_ENTRIES];
+
+static DWORD WINAPI init_sync_shm( RTL_RUN_ONCE *once, void *param, void **context )
+{
+    struct sync_shm_slot *ptr;
+    unsigned int ret;
+    int fd;
+
+    if ((fd = server_create_shm_fd( "wine-sync", SYNC_SHM_SIZE )) == -1) return TRUE;
+
+    if ((ptr = mmap( NULL, SYNC_SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 )) == MAP_FAILED)
+    {
+        close( fd );
+        return TRUE;
+    }
+
+    wine_server_send_fd( fd );
+    SERVER_START_REQ( set_sync_shm )
+    {
+        req->shm_fd = fd;
+        ret = wine_server_call( req );
+    }
+    SERVER_END_REQ;
+    close( fd );
+
+    if (!ret) sync_shm = ptr;
+    else munmap( ptr, SYNC_SHM_SIZE );
+    return TRUE;
+}
+
+static inline unsigned int sync_shm_cache_index( HANDLE handle, unsigned int *entry )
+{
+    unsigned int idx = (wine_server_obj_handle( handle ) >> 2) - 1;
+    *entry = idx / SYNC_SHM_CACHE_BLOCK_SIZE;
+    return idx % SYNC_SHM_CACHE_BLOCK_SIZE;
+}
+
+/* remember the shared state of a newly created object */
+static void add_sync_shm_to_cache( HANDLE handle, int shm_idx, unsigned int type )
+{
+    unsigned int entry, idx = sync_shm_cache_index( handle, &entry );
+
+    if (shm_idx < 0 || shm_idx >= SYNC_SHM_SLOTS || entry >= SYNC_SHM_CACHE_ENTRIES) return;
+
+    if (!sync_shm_cache[entry])  /* do we need to allocate a new block of entries? */
+    {
+        void *ptr = wine_anon_mmap( NULL, SYNC_SHM_CACHE_BLOCK_SIZE * sizeof(int),
+                                    PROT_READ | PROT_WRITE, 0 );
+        if (ptr == MAP_FAILED) return;
+        if (interlocked_cmpxchg_ptr( (void **)&sync_shm_cache[entry], ptr, NULL ))
+            munmap( ptr, SYNC_SHM_CACHE_BLOCK_SIZE * sizeof(int) );
+    }
+    interlocked_xchg( &sync_shm_cache[entry][idx], (shm_idx << 3) | type );
+}
+
+static struct sync_shm_slot *get_cached_sync_shm( HANDLE handle, unsigned int *type )
+{
+    unsigned int entry, idx = sync_shm_cache_index( handle, &entry );
+    int value;
+
+    if (entry >= SYNC_SHM_CACHE_ENTRIES || !sync_shm_cache[entry]) return NULL;
+    if (!(value = *(volatile int *)&sync_shm_cache[entry][idx])) return NULL;
+    *type = value & SYNC_SHM_TYPE_MASK;
+    return &sync_shm[value >> 3];
+}
+
+/***********************************************************************
+ *           remove_sync_shm_from_cache
+ */
+void remove_sync_shm_from_cache( HANDLE handle )
+{
+    unsigned int entry, idx = sync_shm_cache_index( handle, &entry );
+
+    if (entry < SYNC_SHM_CACHE_ENTRIES && sync_shm_cache[entry])
+        interlocked_xchg( &sync_shm_cache[entry][idx], 0 );
+}
+
+/* get the shared state of a private event */
+static inline struct sync_shm_slot *get_sync_shm_event( HANDLE handle )
+{
+    struct sync_shm_slot *slot;
+    unsigned int type;
+
+    if (!(slot = get_cached_sync_shm( handle, &type ))) return NULL;
+    if (type != SYNC_SHM_AUTO_EVENT && type != SYNC_SHM_MANUAL_EVENT) return NULL;
+    return slot;
+}
+
+/* change the state of an object, unless the server has taken it over */
+static BOOL update_sync_shm_state( struct sync_shm_slot *slot, int clear, int set )
+{
+    int state, prev = *(volatile int *)&slot->state;
+
+    do
+    {
+        if (prev & SYNC_SHM_SERVER) return FALSE;
+        state = prev;
+        prev = interlocked_cmpxchg( &slot->state, (state & ~clear) | set, state );
+    } while (prev != state);
+    return TRUE;
+}
+
+/* release a private semaphore, returning FALSE if it has to be done by the server */
+static BOOL release_sync_shm_semaphore( struct sync_shm_slot *slot, ULONG count,
+                                        ULONG *previous, NTSTATUS *status )
+{
+    int state, prev = *(volatile int *)&slot->state;
+
+    do
+    {
+        if (prev & SYNC_SHM_SERVER) return FALSE;
+        state = prev;
+        if ((unsigned int)state + count < (unsigned int)state || (unsigned int)state + count > slot->count)
+        {
+            *status = STATUS_SEMAPHORE_LIMIT_EXCEEDED;
+            return TRUE;
+        }
+        prev = interlocked_cmpxchg( &slot->state, state + count, state );
+    } while (prev != state);
+
+    if (previous) *previous = state;
+    *status = STATUS_SUCCESS;
+    return TRUE;
+}
+
+/* release a private mutex, returning FALSE if it has to be done by the server */
+static BOOL release_sync_shm_mutex( struct sync_shm_slot *slot, LONG *prev_count, NTSTATUS *status )
+{
+    int state = *(volatile int *)&slot->state;
+    unsigned int count;
+
+    if ((state & SYNC_SHM_OWNER_MASK) != HandleToULong( NtCurrentTeb()->ClientId.UniqueThread ))
+    {
+        /* only the server could make us the owner, and only while we are waiting */
+        if (prev_count) *prev_count = 0;
+        *status = STATUS_MUTANT_NOT_OWNED;
+        return TRUE;
+    }
+    if (state & SYNC_SHM_SERVER) return FALSE;
+
+    /* the recursion count is only changed by the owner */
+    count = slot->count;
+    if (count > 1) slot->count = count - 1;
+    else
+    {
+        slot->count = 0;
+        if (interlocked_cmpxchg( &slot->state, state & ~SYNC_SHM_OWNER_MASK, state ) != state)
+        {
+            /* the server got a waiter in the meantime, let it wake it up */
+            slot->count = count;
+            return FALSE;
+        }
+    }
+    if (prev_count) *prev_count = count;
+    *status = STATUS_SUCCESS;
+    return TRUE;
+}
+
+/* try to acquire a private object, returning FALSE if the server has to do the wait */
+static BOOL wait_sync_shm( HANDLE handle, const LARGE_INTEGER *timeout, NTSTATUS *status )
+{
+    DWORD tid = HandleToULong( NtCurrentTeb()->ClientId.UniqueThread );
+    struct sync_shm_slot *slot;
+    unsigned int type;
+    int state, new_state;
+
+    if (!(slot = get_cached_sync_shm( handle, &type ))) return FALSE;
+
+    for (;;)
+    {
+        state = *(volatile int *)&slot->state;
+        if (state & SYNC_SHM_SERVER) return FALSE;
+
+        switch (type)
+        {
+        case SYNC_SHM_MANUAL_EVENT:
+            if (!(state & SYNC_SHM_SIGNALED)) goto unavailable;
+            *status = STATUS_WAIT_0;
+            return TRUE;
+        case SYNC_SHM_AUTO_EVENT:
+            if (!(state & SYNC_SHM_SIGNALED)) goto unavailable;
+            new_state = state & ~SYNC_SHM_SIGNALED;
+            break;
+        case SYNC_SHM_SEMAPHORE:
+            if (!state) goto unavailable;
+            new_state = state - 1;
+            break;
+        case SYNC_SHM_MUTEX:
+            if ((state & SYNC_SHM_OWNER_MASK) == tid)
+            {
+                slot->count++;
+                *status = STATUS_WAIT_0;
+                return TRUE;
+            }
+            if (state & SYNC_SHM_OWNER_MASK) goto unavailable;
+            new_state = tid;
+            break;
+        default:
+            return FALSE;
+        }
+        if (interlocked_cmpxchg( &slot->state, new_state, state ) == state) break;
+    }
+
+    *status = STATUS_WAIT_0;
+    if (type == SYNC_SHM_MUTEX)
+    {
+        slot->count = 1;
+        if (state & SYNC_SHM_ABANDONED) *status = STATUS_ABANDONED_WAIT_0;
+    }
+    return TRUE;
+
+unavailable:
+    /* blocking waits are done by the server */
+    if (!timeout || timeout->QuadPart) return FALSE;
+    *status = STATUS_TIMEOUT;
+    return TRUE;
+}
+
 /*
  *	Semaphores
  */
@@ -172,6 +417,7 @@ NTSTATUS WINAPI NtCreateSemaphore( OUT PHANDLE SemaphoreHandle,
         ret = NTDLL_create_struct_sd( attr->SecurityDescriptor, &sd, &objattr.sd_len );
         if (ret != STATUS_SUCCESS) return ret;
     }
+    if (!len) RtlRunOnceExecuteOnce( &sync_shm_once, init_sync_shm, NULL, NULL );
 
     SERVER_START_REQ( create_semaphore )
     {
@@ -184,6 +430,7 @@ NTSTATUS WINAPI NtCreateSemaphore( OUT PHANDLE SemaphoreHandle,
         if (len) wine_server_add_data( req, attr->ObjectName->Buffer, len );
         ret = wine_server_call( req );
         *SemaphoreHandle = wine_server_ptr_handle( reply->handle );
+        if (!ret && sync_shm) add_sync_shm_to_cache( *SemaphoreHandle, reply->shm_idx, SYNC_SHM_SEMAPHORE );
     }
     SERVER_END_REQ;
 
@@ -254,7 +501,14 @@ NTSTATUS WINAPI NtQuerySemaphore( HANDLE handle, SEMAPHORE_INFORMATION_CLASS cla
  */
 NTSTATUS WINAPI NtReleaseSemaphore( HANDLE handle, ULONG count, PULONG previous )
 {
+    struct sync_shm_slot *slot;
+    unsigned int type;
     NTSTATUS ret;
+
+    if ((slot = get_cached_sync_shm( handle, &type )) && type == SYNC_SHM_SEMAPHORE &&
+        release_sync_shm_semaphore( slot, count, previous, &ret ))
+        return ret;
+
     SERVER_START_REQ( release_semaphore )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -294,6 +548,7 @@ NTSTATUS WINAPI NtCreateEvent( PHANDLE EventHandle, ACCESS_MASK DesiredAccess,
         ret = NTDLL_create_struct_sd( attr->SecurityDescriptor, &sd, &objattr.sd_len );
         if (ret != STATUS_SUCCESS) return ret;
     }
+    if (!len) RtlRunOnceExecuteOnce( &sync_shm_once, init_sync_shm, NULL, NULL );
 
     SERVER_START_REQ( create_event )
     {
@@ -306,6 +561,9 @@ NTSTATUS WINAPI NtCreateEvent( PHANDLE EventHandle, ACCESS_MASK DesiredAccess,
         if (len) wine_server_add_data( req, attr->ObjectName->Buffer, len );
         ret = wine_server_call( req );
         *EventHandle = wine_server_ptr_handle( reply->handle );
+        if (!ret && sync_shm)
+            add_sync_shm_to_cache( *EventHandle, reply->shm_idx, (type == NotificationEvent) ?
+                                   SYNC_SHM_MANUAL_EVENT : SYNC_SHM_AUTO_EVENT );
     }
     SERVER_END_REQ;
 
@@ -348,10 +606,14 @@ NTSTATUS WINAPI NtOpenEvent(
  */
 NTSTATUS WINAPI NtSetEvent( HANDLE handle, PULONG NumberOfThreadsReleased )
 {
+    struct sync_shm_slot *slot;
     NTSTATUS ret;
 
     /* FIXME: set NumberOfThreadsReleased */
 
+    if ((slot = get_sync_shm_event( handle )) && update_sync_shm_state( slot, 0, SYNC_SHM_SIGNALED ))
+        return STATUS_SUCCESS;
+
     SERVER_START_REQ( event_op )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -367,11 +629,15 @@ NTSTATUS WINAPI NtSetEvent( HANDLE handle, PULONG NumberOfThreadsReleased )
  */
 NTSTATUS WINAPI NtResetEvent( HANDLE handle, PULONG NumberOfThreadsReleased )
 {
+    struct sync_shm_slot *slot;
     NTSTATUS ret;
 
     /* resetting an event can't release any thread... */
     if (NumberOfThreadsReleased) *NumberOfThreadsReleased = 0;
 
+    if ((slot = get_sync_shm_event( handle )) && update_sync_shm_state( slot, SYNC_SHM_SIGNALED, 0 ))
+        return STATUS_SUCCESS;
+
     SERVER_START_REQ( event_op )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -401,11 +667,16 @@ NTSTATUS WINAPI NtClearEvent ( HANDLE handle )
  */
 NTSTATUS WINAPI NtPulseEvent( HANDLE handle, PULONG PulseCount )
 {
+    struct sync_shm_slot *slot;
     NTSTATUS ret;
 
     if (PulseCount)
       FIXME("(%p,%d)\n", handle, *PulseCount);
 
+    /* without server waiters there's nobody to wake, so this is a plain reset */
+    if ((slot = get_sync_shm_event( handle )) && update_sync_shm_state( slot, SYNC_SHM_SIGNALED, 0 ))
+        return STATUS_SUCCESS;
+
     SERVER_START_REQ( event_op )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -477,6 +748,7 @@ NTSTATUS WINAPI NtCreateMutant(OUT HANDLE* MutantHandle,
         status = NTDLL_create_struct_sd( attr->SecurityDescriptor, &sd, &objattr.sd_len );
         if (status != STATUS_SUCCESS) return status;
     }
+    if (!len) RtlRunOnceExecuteOnce( &sync_shm_once, init_sync_shm, NULL, NULL );
 
     SERVER_START_REQ( create_mutex )
     {
@@ -488,6 +760,7 @@ NTSTATUS WINAPI NtCreateMutant(OUT HANDLE* MutantHandle,
         if (len) wine_server_add_data( req, attr->ObjectName->Buffer, len );
         status = wine_server_call( req );
         *MutantHandle = wine_server_ptr_handle( reply->handle );
+        if (!status && sync_shm) add_sync_shm_to_cache( *MutantHandle, reply->shm_idx, SYNC_SHM_MUTEX );
     }
     SERVER_END_REQ;
 
@@ -528,8 +801,14 @@ NTSTATUS WINAPI NtOpenMutant(OUT HANDLE* MutantHandle,
  */
 NTSTATUS WINAPI NtReleaseMutant( IN HANDLE handle, OUT PLONG prev_count OPTIONAL)
 {
+    struct sync_shm_slot *slot;
+    unsigned int type;
     NTSTATUS    status;
 
+    if ((slot = get_cached_sync_shm( handle, &type )) && type == SYNC_SHM_MUTEX &&
+        release_sync_shm_mutex( slot, prev_count, &status ))
+        return status;
+
     SERVER_START_REQ( release_mutex )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -1022,6 +1301,10 @@ NTSTATUS WINAPI NtWaitForMultipleObjects( DWORD count, const HANDLE *handles,
  */
 NTSTATUS WINAPI NtWaitForSingleObject(HANDLE handle, BOOLEAN alertable, const LARGE_INTEGER *timeout )
 {
+    NTSTATUS ret;
+
+    /* alertable waits need the server to check for pending APCs */
+    if (!alertable && wait_sync_shm( handle, timeout, &ret )) return ret;
     return wait_objects( 1, &handle, FALSE, alertable, timeout );
 }
 
@@ -1317,6 +1600,61 @@ NTSTATUS WINAPI NtRemoveIoCompletion( HANDLE CompletionPort, PULONG_PTR Completi
     return status;
 }
 
+/******************************************************************
+ *              NtRemoveIoCompletionEx (NTDLL.@)
+ *              ZwRemoveIoCompletionEx (NTDLL.@)
+ *
+ * Removes up to count completion packets from the queue with a single
+ * server call, waiting if the queue is empty.
+ */
+NTSTATUS WINAPI NtRemoveIoCompletionEx( HANDLE port, FILE_IO_COMPLETION_INFORMATION *info, ULONG count,
+                                        ULONG *written, LARGE_INTEGER *timeout, BOOLEAN alertable )
+{
+    struct completion_packet packets[64];
+    LARGE_INTEGER when;
+    NTSTATUS status;
+    ULONG i, n = 0;
+
+    TRACE("(%p %p %u %p %p %u)\n", port, info, count, written, timeout, alertable);
+
+    if (!count) return STATUS_INVALID_PARAMETER;
+    count = min( count, sizeof(packets) / sizeof(packets[0]) );
+
+    /* the wait may have to be restarted, so don't let a relative timeout start over */
+    if (timeout && timeout->QuadPart < 0)
+    {
+        NtQuerySystemTime( &when );
+        when.QuadPart -= timeout->QuadPart;
+        timeout = &when;
+    }
+
+    for (;;)
+    {
+        SERVER_START_REQ( remove_completions )
+        {
+            req->handle = wine_server_obj_handle( port );
+            wine_server_set_reply( req, packets, count * sizeof(packets[0]) );
+            if (!(status = wine_server_call( req )))
+                n = wine_server_reply_size( reply ) / sizeof(packets[0]);
+        }
+        SERVER_END_REQ;
+        if (status != STATUS_PENDING) break;
+
+        status = NtWaitForSingleObject( port, alertable, timeout );
+        if (status != WAIT_OBJECT_0) break;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        info[i].CompletionKey             = packets[i].ckey;
+        info[i].CompletionValue           = packets[i].cvalue;
+        info[i].IoStatusBlock.Information = packets[i].information;
+        info[i].IoStatusBlock.u.Status    = packets[i].status;
+    }
+    *written = n;
+    return status;
+}
+
 /******************************************************************
  *              NtOpenIoCompletion (NTDLL.@)
  *              ZwOpenIoCompletion (NTDLL.@)
@@ -311,6 +311,132 @@ done:
     pRtlFreeUnicodeString(&ntdirname);
 }
 
+#define RESTART_TEST_FILES 200
+
+/* read one batch of entries and count the test files, return the number of entries */
+static int read_restart_test_batch(HANDLE dirh, BYTE *data, UINT data_size, BOOLEAN single_entry,
+                                   BOOLEAN restart, int *counts, int *dots, int *pos)
+{
+    FILE_BOTH_DIRECTORY_INFORMATION *dir_info;
+    IO_STATUS_BLOCK io;
+    UINT data_pos = 0;
+    char name[MAX_PATH];
+    int i, len, index, ret = 0;
+
+    pNtQueryDirectoryFile( dirh, NULL, NULL, NULL, &io, data, data_size,
+                           FileBothDirectoryInformation, single_entry, NULL, restart );
+    if (U(io).Status == STATUS_NO_MORE_FILES) return 0;
+    ok (U(io).Status == STATUS_SUCCESS, "failed to query directory; status %x\n", U(io).Status);
+    if (U(io).Status != STATUS_SUCCESS) return 0;
+
+    for (;;)
+    {
+        dir_info = (FILE_BOTH_DIRECTORY_INFORMATION *)(data + data_pos);
+        len = min(dir_info->FileNameLength / sizeof(WCHAR), sizeof(name) - 1);
+        for (i = 0; i < len; i++) name[i] = dir_info->FileName[i];  /* the test names are ASCII */
+        name[len] = 0;
+        if (!strcmp(name, ".") || !strcmp(name, ".."))
+        {
+            ok(*pos == (name[1] ? 1 : 0), "%s returned at position %d\n", name, *pos);
+            (*dots)++;
+        }
+        else if (sscanf(name, "file%03d.tmp", &index) == 1 && index >= 0 && index < RESTART_TEST_FILES)
+            counts[index]++;
+        else
+            ok(0, "unexpected file %s\n", name);
+        (*pos)++;
+        ret++;
+        if (!dir_info->NextEntryOffset) break;
+        data_pos += dir_info->NextEntryOffset;
+    }
+    ok(!single_entry || ret == 1, "got %d entries for a single entry query\n", ret);
+    return ret;
+}
+
+static void test_NtQueryDirectoryFile_restart(void)
+{
+    OBJECT_ATTRIBUTES attr;
+    UNICODE_STRING ntdirname;
+    IO_STATUS_BLOCK io;
+    char testdirA[MAX_PATH], buf[MAX_PATH];
+    WCHAR testdirW[MAX_PATH];
+    int counts1[RESTART_TEST_FILES], counts2[RESTART_TEST_FILES];
+    int dots1 = 0, dots2 = 0, pos1 = 0, pos2 = 0, i;
+    BYTE data[4096];
+    HANDLE h, dirh1, dirh2;
+    DWORD status;
+    BOOL ret;
+
+    GetTempPathA(MAX_PATH, testdirA);
+    strcat(testdirA, "NtQueryDirectoryFile_restart.tmp");
+    ret = CreateDirectoryA(testdirA, NULL);
+    ok(ret, "couldn't create dir '%s', error %d\n", testdirA, GetLastError());
+    for (i = 0; i < RESTART_TEST_FILES; i++)
+    {
+        sprintf(buf, "%s\\file%03d.tmp", testdirA, i);
+        h = CreateFileA(buf, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, 0);
+        ok(h != INVALID_HANDLE_VALUE, "failed to create temp file '%s'\n", buf);
+        CloseHandle(h);
+    }
+
+    pRtlMultiByteToUnicodeN(testdirW, sizeof(testdirW), NULL, testdirA, strlen(testdirA)+1);
+    if (!pRtlDosPathNameToNtPathName_U(testdirW, &ntdirname, NULL, NULL))
+    {
+        ok(0, "RtlDosPathNametoNtPathName_U failed\n");
+        goto done;
+    }
+    InitializeObjectAttributes(&attr, &ntdirname, OBJ_CASE_INSENSITIVE, 0, NULL);
+
+    status = pNtOpenFile(&dirh1, SYNCHRONIZE | FILE_LIST_DIRECTORY, &attr, &io, FILE_SHARE_READ,
+                         FILE_SYNCHRONOUS_IO_NONALERT | FILE_OPEN_FOR_BACKUP_INTENT | FILE_DIRECTORY_FILE);
+    ok(status == STATUS_SUCCESS, "failed to open dir '%s', ret 0x%x\n", testdirA, status);
+    status = pNtOpenFile(&dirh2, SYNCHRONIZE | FILE_LIST_DIRECTORY, &attr, &io, FILE_SHARE_READ,
+                         FILE_SYNCHRONOUS_IO_NONALERT | FILE_OPEN_FOR_BACKUP_INTENT | FILE_DIRECTORY_FILE);
+    ok(status == STATUS_SUCCESS, "failed to open dir '%s', ret 0x%x\n", testdirA, status);
+    pRtlFreeUnicodeString(&ntdirname);
+
+    /* interleave a single entry enumeration with a buffered one on the same directory */
+    memset(counts1, 0, sizeof(counts1));
+    memset(counts2, 0, sizeof(counts2));
+    for (i = 0; i < 50; i++)
+        ok(read_restart_test_batch(dirh1, data, sizeof(data), TRUE, !i, counts1, &dots1, &pos1) == 1,
+           "enumeration ended early\n");
+    while (read_restart_test_batch(dirh2, data, sizeof(data), FALSE, !pos2, counts2, &dots2, &pos2)) ;
+    while (read_restart_test_batch(dirh1, data, sizeof(data), TRUE, FALSE, counts1, &dots1, &pos1)) ;
+
+    ok(dots1 == 2, "got %d dot entries\n", dots1);
+    ok(dots2 == 2, "got %d dot entries\n", dots2);
+    for (i = 0; i < RESTART_TEST_FILES; i++)
+    {
+        ok(counts1[i] == 1, "file%03d.tmp found %d times with single entries\n", i, counts1[i]);
+        ok(counts2[i] == 1, "file%03d.tmp found %d times\n", i, counts2[i]);
+    }
+
+    /* restart in the middle of an enumeration */
+    memset(counts1, 0, sizeof(counts1));
+    dots1 = pos1 = 0;
+    for (i = 0; i < 20; i++)
+        read_restart_test_batch(dirh1, data, sizeof(data), TRUE, !i, counts1, &dots1, &pos1);
+    memset(counts1, 0, sizeof(counts1));
+    dots1 = pos1 = 0;
+    read_restart_test_batch(dirh1, data, sizeof(data), FALSE, TRUE, counts1, &dots1, &pos1);
+    while (read_restart_test_batch(dirh1, data, sizeof(data), FALSE, FALSE, counts1, &dots1, &pos1)) ;
+    ok(dots1 == 2, "got %d dot entries\n", dots1);
+    for (i = 0; i < RESTART_TEST_FILES; i++)
+        ok(counts1[i] == 1, "file%03d.tmp found %d times after restart\n", i, counts1[i]);
+
+    pNtClose(dirh1);
+    pNtClose(dirh2);
+
+done:
+    for (i = 0; i < RESTART_TEST_FILES; i++)
+    {
+        sprintf(buf, "%s\\file%03d.tmp", testdirA, i);
+        DeleteFileA(buf);
+    }
+    RemoveDirectoryA(testdirA);
+}
+
 static void set_up_case_test(const char *testdir)
 {
     BOOL ret;
@@ -475,6 +601,7 @@ START_TEST(directory)
     pRtlWow64EnableFsRedirectionEx = (void *)GetProcAddress(hntdll,"RtlWow64EnableFsRedirectionEx");
 
     test_NtQueryDirectoryFile();
+    test_NtQueryDirectoryFile_restart();
     test_NtQueryDirectoryFile_case();
     test_redirection();
 }
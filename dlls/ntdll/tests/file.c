@@ -4192,10 +4192,83 @@ static void test_read_write(void)
     CloseHandle(hfile);
 }
 
+static void test_overlapped_completion(void)
+{
+    static const char text[] = "foobar";
+    FILE_COMPLETION_INFORMATION fci;
+    IO_STATUS_BLOCK iosb;
+    LARGE_INTEGER offset;
+    HANDLE port, handle;
+    NTSTATUS status;
+    char buffer[16];
+
+    status = pNtCreateIoCompletion( &port, IO_COMPLETION_ALL_ACCESS, NULL, 0 );
+    ok( status == STATUS_SUCCESS, "NtCreateIoCompletion failed %x\n", status );
+    if (!(handle = create_temp_file( FILE_FLAG_OVERLAPPED )))
+    {
+        pNtClose( port );
+        return;
+    }
+    fci.CompletionPort = port;
+    fci.CompletionKey = CKEY_FIRST;
+    status = pNtSetInformationFile( handle, &iosb, &fci, sizeof(fci), FileCompletionInformation );
+    ok( status == STATUS_SUCCESS, "NtSetInformationFile failed %x\n", status );
+
+    offset.QuadPart = 0;
+    status = pNtWriteFile( handle, 0, NULL, (void *)CVALUE_FIRST, &iosb, text, sizeof(text), &offset, NULL );
+    ok( status == STATUS_SUCCESS || status == STATUS_PENDING, "wrong status %x\n", status );
+    if (get_msg( port ))
+    {
+        ok( completionKey == CKEY_FIRST, "wrong key %lx\n", completionKey );
+        ok( completionValue == CVALUE_FIRST, "wrong value %lx\n", completionValue );
+        ok( U(ioSb).Status == STATUS_SUCCESS, "wrong status %x\n", U(ioSb).Status );
+        ok( ioSb.Information == sizeof(text), "wrong info %lu\n", ioSb.Information );
+    }
+
+    /* the completion is still reported when the handle is closed right away */
+    memset( buffer, 0, sizeof(buffer) );
+    status = pNtReadFile( handle, 0, NULL, (void *)CVALUE_FIRST, &iosb, buffer, sizeof(buffer), &offset, NULL );
+    ok( status == STATUS_SUCCESS || status == STATUS_PENDING, "wrong status %x\n", status );
+    CloseHandle( handle );
+    if (get_msg( port ))
+    {
+        ok( completionKey == CKEY_FIRST, "wrong key %lx\n", completionKey );
+        ok( completionValue == CVALUE_FIRST, "wrong value %lx\n", completionValue );
+        ok( U(ioSb).Status == STATUS_SUCCESS, "wrong status %x\n", U(ioSb).Status );
+        ok( ioSb.Information == sizeof(text), "wrong info %lu\n", ioSb.Information );
+        ok( !memcmp( buffer, text, sizeof(text) ), "wrong data %s\n", buffer );
+    }
+    ok( !get_pending_msgs( port ), "unexpected messages\n" );
+    pNtClose( port );
+}
+
+/* run the overlapped I/O tests again in a child process using io_uring in Wine */
+static void test_overlapped_iouring( const char *argv0 )
+{
+    PROCESS_INFORMATION info;
+    STARTUPINFOA startup;
+    char cmdline[MAX_PATH + 16];
+    BOOL ret;
+
+    memset( &startup, 0, sizeof(startup) );
+    startup.cb = sizeof(startup);
+    sprintf( cmdline, "\"%s\" file iouring", argv0 );
+    SetEnvironmentVariableA( "WINEIOURING", "1" );
+    ret = CreateProcessA( NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &info );
+    SetEnvironmentVariableA( "WINEIOURING", NULL );
+    ok( ret, "CreateProcess failed %u\n", GetLastError() );
+    if (!ret) return;
+    winetest_wait_child_process( info.hProcess );
+    CloseHandle( info.hProcess );
+    CloseHandle( info.hThread );
+}
+
 START_TEST(file)
 {
     HMODULE hkernel32 = GetModuleHandleA("kernel32.dll");
     HMODULE hntdll = GetModuleHandleA("ntdll.dll");
+    char **argv;
+    int argc;
     if (!hntdll)
     {
         skip("not running on NT, skipping test\n");
@@ -4229,6 +4302,15 @@ START_TEST(file)
     pNtQueryVolumeInformationFile = (void *)GetProcAddress(hntdll, "NtQueryVolumeInformationFile");
     pNtQueryFullAttributesFile = (void *)GetProcAddress(hntdll, "NtQueryFullAttributesFile");
 
+    argc = winetest_get_mainargs( &argv );
+    if (argc >= 3 && !strcmp( argv[2], "iouring" ))
+    {
+        read_file_test();
+        test_read_write();
+        test_overlapped_completion();
+        return;
+    }
+
     test_read_write();
     test_NtCreateFile();
     create_file_test();
@@ -4238,6 +4320,8 @@ START_TEST(file)
     append_file_test();
     nt_mailslot_test();
     test_iocompletion();
+    test_overlapped_completion();
+    test_overlapped_iouring( argv[0] );
     test_file_basic_information();
     test_file_all_information();
     test_file_both_information();
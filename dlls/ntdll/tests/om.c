@@ -1190,6 +1190,97 @@ static void test_null_device(void)
     CloseHandle(ov.hEvent);
 }
 
+static void test_handle_flags(void)
+{
+    OBJECT_DATA_INFORMATION info;
+    NTSTATUS status;
+    HANDLE event, dup;
+    ULONG len;
+    BOOL ret;
+
+    event = CreateEventA(NULL, TRUE, FALSE, NULL);
+    ok(event != NULL, "CreateEvent failed %u\n", GetLastError());
+
+    memset(&info, 0xcc, sizeof(info));
+    status = pNtQueryObject(event, ObjectDataInformation, &info, sizeof(info), &len);
+    ok(status == STATUS_SUCCESS, "NtQueryObject failed %08x\n", status);
+    ok(len == sizeof(info), "wrong len %u\n", len);
+    ok(!info.InheritHandle, "handle is inheritable\n");
+    ok(!info.ProtectFromClose, "handle is protected\n");
+
+    ret = SetHandleInformation(event, HANDLE_FLAG_INHERIT | HANDLE_FLAG_PROTECT_FROM_CLOSE,
+                               HANDLE_FLAG_INHERIT | HANDLE_FLAG_PROTECT_FROM_CLOSE);
+    ok(ret, "SetHandleInformation failed %u\n", GetLastError());
+    status = pNtQueryObject(event, ObjectDataInformation, &info, sizeof(info), NULL);
+    ok(status == STATUS_SUCCESS, "NtQueryObject failed %08x\n", status);
+    ok(info.InheritHandle, "handle is not inheritable\n");
+    ok(info.ProtectFromClose, "handle is not protected\n");
+
+    status = pNtClose(event);
+    ok(status == STATUS_HANDLE_NOT_CLOSABLE, "NtClose returned %08x\n", status);
+    ret = SetEvent(event);
+    ok(ret, "SetEvent failed %u\n", GetLastError());
+
+    ret = SetHandleInformation(event, HANDLE_FLAG_INHERIT | HANDLE_FLAG_PROTECT_FROM_CLOSE, 0);
+    ok(ret, "SetHandleInformation failed %u\n", GetLastError());
+    ret = DuplicateHandle(GetCurrentProcess(), event, GetCurrentProcess(), &dup,
+                          0, TRUE, DUPLICATE_SAME_ACCESS | DUPLICATE_CLOSE_SOURCE);
+    ok(ret, "DuplicateHandle failed %u\n", GetLastError());
+    status = pNtQueryObject(dup, ObjectDataInformation, &info, sizeof(info), NULL);
+    ok(status == STATUS_SUCCESS, "NtQueryObject failed %08x\n", status);
+    ok(info.InheritHandle, "handle is not inheritable\n");
+    ok(!info.ProtectFromClose, "handle is protected\n");
+
+    status = pNtClose(dup);
+    ok(status == STATUS_SUCCESS, "NtClose failed %08x\n", status);
+    status = pNtClose(dup);
+    ok(status == STATUS_INVALID_HANDLE, "NtClose returned %08x\n", status);
+    status = pNtQueryObject(dup, ObjectDataInformation, &info, sizeof(info), NULL);
+    ok(status == STATUS_INVALID_HANDLE, "NtQueryObject returned %08x\n", status);
+}
+
+static void test_many_names(void)
+{
+    static const unsigned int count = 2000;
+    char name[64];
+    HANDLE *events, handle;
+    unsigned int i;
+    DWORD ret;
+
+    events = HeapAlloc(GetProcessHeap(), 0, count * sizeof(*events));
+    for (i = 0; i < count; i++)
+    {
+        sprintf(name, "wine_test_many_names_%u", i);
+        events[i] = CreateEventA(NULL, TRUE, FALSE, name);
+        ok(events[i] != NULL, "CreateEvent %u failed %u\n", i, GetLastError());
+        ok(GetLastError() != ERROR_ALREADY_EXISTS, "event %u already exists\n", i);
+    }
+
+    for (i = 0; i < count; i += 2)
+    {
+        CloseHandle(events[i]);
+        events[i] = NULL;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        sprintf(name, "wine_test_many_names_%u", i);
+        handle = OpenEventA(EVENT_MODIFY_STATE, FALSE, name);
+        if (!events[i])
+        {
+            ok(!handle, "event %u still exists\n", i);
+            continue;
+        }
+        ok(handle != NULL, "OpenEvent %u failed %u\n", i, GetLastError());
+        SetEvent(handle);
+        ret = WaitForSingleObject(events[i], 0);
+        ok(ret == WAIT_OBJECT_0, "event %u: got %u\n", i, ret);
+        CloseHandle(handle);
+        CloseHandle(events[i]);
+    }
+    HeapFree(GetProcessHeap(), 0, events);
+}
+
 START_TEST(om)
 {
     HMODULE hntdll = GetModuleHandleA("ntdll.dll");
@@ -1241,4 +1332,6 @@ START_TEST(om)
     test_event();
     test_keyed_events();
     test_null_device();
+    test_handle_flags();
+    test_many_names();
 }
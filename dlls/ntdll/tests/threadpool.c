@@ -1278,6 +1278,108 @@ static void test_tp_window_length(void)
     CloseHandle(semaphore);
 }
 
+struct many_timers_info
+{
+    HANDLE semaphore;
+    LONG calls;
+};
+
+static void CALLBACK many_timers_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_TIMER *timer)
+{
+    struct many_timers_info *info = userdata;
+    InterlockedIncrement(&info->calls);
+    ReleaseSemaphore(info->semaphore, 1, NULL);
+}
+
+static void test_tp_many_timers(void)
+{
+    struct many_timers_info info[64];
+    TP_CALLBACK_ENVIRON environment;
+    TP_TIMER *timers[64];
+    LARGE_INTEGER when;
+    HANDLE semaphore;
+    NTSTATUS status;
+    TP_POOL *pool;
+    DWORD result;
+    int i;
+
+    semaphore = CreateSemaphoreA(NULL, 0, 64, NULL);
+    ok(semaphore != NULL, "CreateSemaphoreA failed %u\n", GetLastError());
+
+    /* allocate new threadpool */
+    pool = NULL;
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "TpAllocPool failed with status %x\n", status);
+    ok(pool != NULL, "expected pool != NULL\n");
+
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = pool;
+
+    for (i = 0; i < 64; i++)
+    {
+        info[i].semaphore = semaphore;
+        info[i].calls = 0;
+        timers[i] = NULL;
+        status = pTpAllocTimer(&timers[i], many_timers_cb, &info[i], &environment);
+        ok(!status, "TpAllocTimer failed with status %x\n", status);
+        ok(timers[i] != NULL, "expected timers[%u] != NULL\n", i);
+    }
+
+    /* timers expiring soon, set in reverse order */
+    for (i = 47; i >= 0; i--)
+    {
+        when.QuadPart = (ULONGLONG)i * -100000;
+        pTpSetTimer(timers[i], &when, 0, 0);
+    }
+
+    /* timers expiring in one hour or later */
+    for (i = 48; i < 64; i++)
+    {
+        when.QuadPart = ((ULONGLONG)3600 + (i - 48) * 86400) * -10000000;
+        pTpSetTimer(timers[i], &when, 0, 0);
+    }
+
+    for (i = 0; i < 48; i++)
+    {
+        result = WaitForSingleObject(semaphore, 1000);
+        ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+    }
+    result = WaitForSingleObject(semaphore, 100);
+    ok(result == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", result);
+
+    for (i = 0; i < 64; i++)
+        ok(info[i].calls == (i < 48), "timer %u: got %u calls\n", i, info[i].calls);
+
+    /* move some of the late timers forward */
+    for (i = 48; i < 64; i += 2)
+    {
+        when.QuadPart = (ULONGLONG)50 * -10000;
+        pTpSetTimer(timers[i], &when, 0, 0);
+    }
+
+    for (i = 0; i < 8; i++)
+    {
+        result = WaitForSingleObject(semaphore, 1000);
+        ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+    }
+    result = WaitForSingleObject(semaphore, 100);
+    ok(result == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", result);
+
+    for (i = 48; i < 64; i++)
+        ok(info[i].calls == !(i & 1), "timer %u: got %u calls\n", i, info[i].calls);
+
+    /* cleanup */
+    for (i = 0; i < 64; i++)
+    {
+        pTpSetTimer(timers[i], NULL, 0, 0);
+        pTpWaitForTimer(timers[i], TRUE);
+        pTpReleaseTimer(timers[i]);
+    }
+    pTpReleasePool(pool);
+    CloseHandle(semaphore);
+}
+
 struct wait_info
 {
     HANDLE semaphore;
@@ -1654,6 +1756,122 @@ static void test_tp_multi_wait(void)
     CloseHandle(semaphore);
 }
 
+struct benchmark_info
+{
+    TP_CALLBACK_ENVIRON environment;
+    HANDLE              start_event;
+    HANDLE              done_event;
+    LONG                remaining;
+    unsigned int        count;
+};
+
+struct benchmark_item
+{
+    struct benchmark_info *info;
+    LARGE_INTEGER       submitted;
+    LARGE_INTEGER       executed;
+};
+
+static void CALLBACK benchmark_cb(TP_CALLBACK_INSTANCE *instance, void *userdata)
+{
+    struct benchmark_item *item = userdata;
+    QueryPerformanceCounter(&item->executed);
+    if (!InterlockedDecrement(&item->info->remaining))
+        SetEvent(item->info->done_event);
+}
+
+static DWORD CALLBACK benchmark_submit_thread(void *arg)
+{
+    struct benchmark_item *items = arg;
+    struct benchmark_info *info = items[0].info;
+    NTSTATUS status;
+    unsigned int i;
+
+    WaitForSingleObject(info->start_event, INFINITE);
+    for (i = 0; i < info->count; i++)
+    {
+        QueryPerformanceCounter(&items[i].submitted);
+        status = pTpSimpleTryPost(benchmark_cb, &items[i], &info->environment);
+        ok(!status, "TpSimpleTryPost failed with status %x\n", status);
+    }
+    return 0;
+}
+
+static void test_tp_benchmark(void)
+{
+    static const unsigned int thread_counts[] = {1, 2, 4, 8, 16, 32, 64};
+    unsigned int total = winetest_interactive ? 200000 : 4000;
+    struct benchmark_item *items;
+    struct benchmark_info info;
+    HANDLE threads[64];
+    LARGE_INTEGER freq;
+    ULONGLONG sum, max_latency, latency;
+    unsigned int i, j, k, count;
+    TP_POOL *pool;
+    NTSTATUS status;
+    DWORD start, ret;
+
+    if (!pTpSimpleTryPost)
+    {
+        win_skip("TpSimpleTryPost is not supported\n");
+        return;
+    }
+
+    QueryPerformanceFrequency(&freq);
+    items = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, total * sizeof(*items));
+
+    for (i = 0; i < sizeof(thread_counts)/sizeof(thread_counts[0]); i++)
+    {
+        count = thread_counts[i];
+        if (!winetest_interactive && count != 1 && count != 8 && count != 64) continue;
+
+        pool = NULL;
+        status = pTpAllocPool(&pool, NULL);
+        ok(!status, "TpAllocPool failed with status %x\n", status);
+
+        memset(&info, 0, sizeof(info));
+        info.environment.Version = 1;
+        info.environment.Pool = pool;
+        info.start_event = CreateEventW(NULL, TRUE, FALSE, NULL);
+        info.done_event = CreateEventW(NULL, TRUE, FALSE, NULL);
+        info.count = total / count;
+        info.remaining = info.count * count;
+
+        for (j = 0; j < count; j++)
+        {
+            for (k = 0; k < info.count; k++) items[j * info.count + k].info = &info;
+            threads[j] = CreateThread(NULL, 0, benchmark_submit_thread, &items[j * info.count], 0, NULL);
+            ok(threads[j] != NULL, "CreateThread failed %u\n", GetLastError());
+        }
+
+        start = GetTickCount();
+        SetEvent(info.start_event);
+        ret = WaitForSingleObject(info.done_event, 60000);
+        ok(ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret);
+        ret = GetTickCount() - start;
+
+        WaitForMultipleObjects(count, threads, TRUE, INFINITE);
+        for (j = 0; j < count; j++) CloseHandle(threads[j]);
+
+        sum = max_latency = 0;
+        for (j = 0; j < info.count * count; j++)
+        {
+            latency = items[j].executed.QuadPart - items[j].submitted.QuadPart;
+            sum += latency;
+            if (latency > max_latency) max_latency = latency;
+        }
+        trace("%u submitting threads: %u callbacks in %u ms, latency avg %u us max %u us\n",
+              count, info.count * count, ret,
+              (DWORD)(sum * 1000000 / freq.QuadPart / (info.count * count)),
+              (DWORD)(max_latency * 1000000 / freq.QuadPart));
+
+        pTpReleasePool(pool);
+        CloseHandle(info.start_event);
+        CloseHandle(info.done_event);
+    }
+    HeapFree(GetProcessHeap(), 0, items);
+}
+
 START_TEST(threadpool)
 {
     test_RtlQueueWorkItem();
@@ -1670,6 +1888,8 @@ START_TEST(threadpool)
     test_tp_disassociate();
     test_tp_timer();
     test_tp_window_length();
+    test_tp_many_timers();
     test_tp_wait();
     test_tp_multi_wait();
+    test_tp_benchmark();
 }
@@ -0,0 +1,114 @@
+/*
+ * Unit test suite for the virtual memory functions
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "ntdll_test.h"
+
+static NTSTATUS (WINAPI *pNtAllocateVirtualMemory)(HANDLE, PVOID *, ULONG_PTR, SIZE_T *, ULONG, ULONG);
+static NTSTATUS (WINAPI *pNtFreeVirtualMemory)(HANDLE, PVOID *, SIZE_T *, ULONG);
+static NTSTATUS (WINAPI *pNtProtectVirtualMemory)(HANDLE, PVOID *, SIZE_T *, ULONG, ULONG *);
+static NTSTATUS (WINAPI *pNtQueryVirtualMemory)(HANDLE, LPCVOID, MEMORY_INFORMATION_CLASS, PVOID, SIZE_T, SIZE_T *);
+
+static void test_many_regions(void)
+{
+    /* each region uses a full allocation granularity unit of address space */
+    const unsigned int count = sizeof(void *) > 4 ? 100000 : 10000;
+    const SIZE_T region_size = 0x10000;
+    MEMORY_BASIC_INFORMATION info;
+    void **regions, *addr;
+    SIZE_T size;
+    DWORD ticks;
+    NTSTATUS status;
+    ULONG old_prot;
+    unsigned int i, nb_regions;
+
+    regions = HeapAlloc( GetProcessHeap(), 0, count * sizeof(*regions) );
+
+    ticks = GetTickCount();
+    for (nb_regions = 0; nb_regions < count; nb_regions++)
+    {
+        addr = NULL;
+        size = region_size;
+        status = pNtAllocateVirtualMemory( NtCurrentProcess(), &addr, 0, &size, MEM_RESERVE, PAGE_NOACCESS );
+        if (status) break;
+        regions[nb_regions] = addr;
+    }
+    ok( nb_regions == count, "allocated only %u regions, status %08x\n", nb_regions, status );
+    trace( "reserved %u regions in %u ms\n", nb_regions, GetTickCount() - ticks );
+
+    /* change whole regions, so that adjacent ones keep the same protections */
+    ticks = GetTickCount();
+    for (i = 0; i < nb_regions; i++)
+    {
+        addr = regions[i];
+        size = region_size;
+        status = pNtAllocateVirtualMemory( NtCurrentProcess(), &addr, 0, &size, MEM_COMMIT, PAGE_READWRITE );
+        if (status) break;
+        addr = regions[i];
+        size = region_size;
+        status = pNtProtectVirtualMemory( NtCurrentProcess(), &addr, &size, PAGE_READONLY, &old_prot );
+        if (status) break;
+        status = pNtQueryVirtualMemory( NtCurrentProcess(), regions[i], MemoryBasicInformation,
+                                        &info, sizeof(info), NULL );
+        if (status || info.AllocationBase != regions[i] || info.Protect != PAGE_READONLY) break;
+    }
+    ok( i == nb_regions, "failed for region %u, status %08x\n", i, status );
+    trace( "committed and protected %u regions in %u ms\n", nb_regions, GetTickCount() - ticks );
+
+    /* free every other region first to leave holes in the address space */
+    ticks = GetTickCount();
+    for (i = 0; i < nb_regions; i += 2)
+    {
+        size = 0;
+        status = pNtFreeVirtualMemory( NtCurrentProcess(), &regions[i], &size, MEM_RELEASE );
+        if (status) break;
+    }
+    ok( i >= nb_regions, "failed to free region %u, status %08x\n", i, status );
+
+    /* and fill them again */
+    for (i = 0; i < nb_regions; i += 2)
+    {
+        regions[i] = NULL;
+        size = region_size;
+        status = pNtAllocateVirtualMemory( NtCurrentProcess(), &regions[i], 0, &size, MEM_RESERVE, PAGE_NOACCESS );
+        if (status) break;
+    }
+    ok( i >= nb_regions, "failed to allocate region %u, status %08x\n", i, status );
+
+    for (i = 0; i < nb_regions; i++)
+    {
+        size = 0;
+        status = pNtFreeVirtualMemory( NtCurrentProcess(), &regions[i], &size, MEM_RELEASE );
+        if (status) break;
+    }
+    ok( i == nb_regions, "failed to free region %u, status %08x\n", i, status );
+    trace( "released and reserved %u regions in %u ms\n", nb_regions, GetTickCount() - ticks );
+
+    HeapFree( GetProcessHeap(), 0, regions );
+}
+
+START_TEST(virtual)
+{
+    HMODULE hntdll = GetModuleHandleA( "ntdll.dll" );
+
+    pNtAllocateVirtualMemory = (void *)GetProcAddress( hntdll, "NtAllocateVirtualMemory" );
+    pNtFreeVirtualMemory = (void *)GetProcAddress( hntdll, "NtFreeVirtualMemory" );
+    pNtProtectVirtualMemory = (void *)GetProcAddress( hntdll, "NtProtectVirtualMemory" );
+    pNtQueryVirtualMemory = (void *)GetProcAddress( hntdll, "NtQueryVirtualMemory" );
+
+    test_many_regions();
+}
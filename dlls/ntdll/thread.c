@@ -216,6 +216,7 @@ HANDLE thread_init(void)
     SIZE_T size, info_size;
     HANDLE exe_file = 0;
     LARGE_INTEGER now;
+    HANDLE std_handles[3];
     NTSTATUS status;
     struct ntdll_thread_data *thread_data;
     static struct debug_info debug_info;  /* debug info for initial thread */
@@ -337,6 +338,12 @@ HANDLE thread_init(void)
             wine_server_fd_to_handle( 2, GENERIC_WRITE|SYNCHRONIZE, OBJ_INHERIT, &params.hStdError );
     }
 
+    /* the standard handles are likely to be used right away */
+    std_handles[0] = peb->ProcessParameters->hStdInput;
+    std_handles[1] = peb->ProcessParameters->hStdOutput;
+    std_handles[2] = peb->ProcessParameters->hStdError;
+    server_prefetch_fds( std_handles, 3 );
+
     /* initialize time values in user_shared_data */
     NtQuerySystemTime( &now );
     user_shared_data->SystemTime.LowPart = now.u.LowPart;
@@ -362,10 +369,12 @@ void terminate_thread( int status )
     pthread_sigmask( SIG_BLOCK, &server_block_set, NULL );
     if (interlocked_xchg_add( &nb_threads, -1 ) <= 1) _exit( status );
 
+    heap_orphan_thread_caches();
     close( ntdll_get_thread_data()->wait_fd[0] );
     close( ntdll_get_thread_data()->wait_fd[1] );
     close( ntdll_get_thread_data()->reply_fd );
     close( ntdll_get_thread_data()->request_fd );
+    server_free_request_shm();
     pthread_exit( UIntToPtr(status) );
 }
 
@@ -397,6 +406,7 @@ void exit_thread( int status )
 
     LdrShutdownThread();
     RtlFreeThreadActivationContextStack();
+    heap_free_thread_caches();
 
     pthread_sigmask( SIG_BLOCK, &server_block_set, NULL );
 
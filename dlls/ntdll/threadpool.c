@@ -24,6 +24,7 @@
 
 #include <assert.h>
 #include <stdarg.h>
+#include <stdlib.h>
 #include <limits.h>
 
 #define NONAMELESSUNION
@@ -51,6 +52,37 @@ struct rtl_work_item
 #define EXPIRE_NEVER       (~(ULONGLONG)0)
 #define TIMER_QUEUE_MAGIC  0x516d6954   /* TimQ */
 
+/* hierarchical timer wheel, used by both the timer queues and the threadpool timers;
+ * each level has TIMER_WHEEL_SLOTS slots, covering TIMER_WHEEL_SLOTS times the range
+ * of the level below, and timers are cascaded to the lower levels when they get close */
+#define TIMER_WHEEL_BITS    6
+#define TIMER_WHEEL_SLOTS   (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK    (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_LEVELS  6
+#define TIMER_WHEEL_NEVER   (~(ULONGLONG)0)
+
+struct timer_wheel_entry
+{
+    struct list             entry;
+    ULONGLONG               expire;     /* expiration tick */
+    ULONGLONG               deadline;   /* latest expiration time, in the units of the caller */
+    unsigned int            level;      /* level and slot containing the entry */
+    unsigned int            slot;
+};
+
+struct timer_wheel
+{
+    ULONGLONG               current;    /* next tick to expire */
+    unsigned int            count;      /* number of entries in the wheel */
+    ULONGLONG               used[TIMER_WHEEL_LEVELS];  /* bitmap of the non-empty slots */
+    struct list             slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    /* earliest deadline of the entries of each slot, and the number of entries with it */
+    ULONGLONG               deadline[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    unsigned int            deadline_count[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    /* latest expiration tick of the entries added to each slot since it became used */
+    ULONGLONG               latest[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+};
+
 static RTL_CRITICAL_SECTION_DEBUG critsect_compl_debug;
 
 static struct
@@ -89,6 +121,8 @@ struct queue_timer
 {
     struct timer_queue *q;
     struct list entry;
+    struct timer_wheel_entry wheel_entry;  /* entry in the queue wheel while the timer is armed */
+    struct list expired_entry;  /* entry in the list of callbacks to run */
     ULONG runcount;             /* number of callbacks pending execution */
     RTL_WAITORTIMERCALLBACKFUNC callback;
     PVOID param;
@@ -103,7 +137,9 @@ struct timer_queue
 {
     DWORD magic;
     RTL_CRITICAL_SECTION cs;
-    struct list timers;         /* sorted by expiration time */
+    struct list timers;         /* all the timers of the queue */
+    struct timer_wheel wheel;   /* armed timers, by expiration time in ms */
+    ULONGLONG wakeup;           /* time at which the queue thread wakes up */
     BOOL quit;                  /* queue should be deleted; once set, never unset */
     HANDLE event;
     HANDLE thread;
@@ -114,23 +150,49 @@ struct timer_queue
  */
 
 #define THREADPOOL_WORKER_TIMEOUT 5000
+#define THREADPOOL_WORKER_MIN_TIMEOUT 500
+#define THREADPOOL_MAX_QUEUES 64
 #define MAXIMUM_WAITQUEUE_OBJECTS (MAXIMUM_WAIT_OBJECTS - 1)
 
-/* internal threadpool representation */
+/* queue of threadpool objects with pending callbacks */
+struct threadpool_queue
+{
+    RTL_SRWLOCK             lock;
+    /* objects with pending callbacks, locked via .lock */
+    struct list             objects;
+};
+
+/* internal threadpool representation
+ *
+ * Objects are spread over several queues, each with its own lock, so that
+ * submitting threads and workers don't all contend on the same lock. Each
+ * worker has its own position in the queues; it takes work from the queue
+ * at that position, or steals it from the following ones when it's empty,
+ * and then moves on so that the objects of all queues are processed in
+ * turn. The pool critical section is only used to start, stop and wake up
+ * worker threads. */
 struct threadpool
 {
     LONG                    refcount;
     LONG                    objcount;
     BOOL                    shutdown;
     CRITICAL_SECTION        cs;
-    /* pool of work items, locked via .cs */
-    struct list             pool;
     RTL_CONDITION_VARIABLE  update_event;
+    /* number of pending callbacks in all the queues, updated with interlocked functions */
+    LONG                    num_pending;
+    /* counters used to pick the queues of new objects and new workers */
+    LONG                    next_object_queue;
+    LONG                    next_worker_queue;
     /* information about worker threads, locked via .cs */
     int                     max_workers;
     int                     min_workers;
-    int                     num_workers;
-    int                     num_busy_workers;
+    LONG                    num_workers;       /* decremented with interlocked functions */
+    LONG                    num_idle_workers;
+    /* also updated with interlocked functions outside of .cs */
+    LONG                    num_busy_workers;
+    /* queues of work items, see above */
+    unsigned int            num_queues;
+    struct threadpool_queue queues[1];
 };
 
 enum threadpool_objtype
@@ -149,6 +211,7 @@ struct threadpool_object
     /* read-only information */
     enum threadpool_objtype type;
     struct threadpool       *pool;
+    struct threadpool_queue *queue;
     struct threadpool_group *group;
     PVOID                   userdata;
     PTP_CLEANUP_GROUP_CANCEL_CALLBACK group_cancel_callback;
@@ -158,7 +221,7 @@ struct threadpool_object
     /* information about the group, locked via .group->cs */
     struct list             group_entry;
     BOOL                    is_group_member;
-    /* information about the pool, locked via .pool->cs */
+    /* information about the pool, locked via .queue->lock */
     struct list             pool_entry;
     RTL_CONDITION_VARIABLE  finished_event;
     RTL_CONDITION_VARIABLE  group_finished_event;
@@ -182,7 +245,7 @@ struct threadpool_object
             /* information about the timer, locked via timerqueue.cs */
             BOOL            timer_initialized;
             BOOL            timer_pending;
-            struct list     timer_entry;
+            struct timer_wheel_entry timer_entry;
             BOOL            timer_set;
             ULONGLONG       timeout;
             LONG            period;
@@ -238,7 +301,8 @@ static struct
     CRITICAL_SECTION        cs;
     LONG                    objcount;
     BOOL                    thread_running;
-    struct list             pending_timers;
+    struct timer_wheel      wheel;          /* pending timers, by expiration time in ms */
+    ULONGLONG               wakeup;         /* time at which the timer thread wakes up */
     RTL_CONDITION_VARIABLE  update_event;
 }
 timerqueue =
@@ -246,7 +310,8 @@ timerqueue =
     { &timerqueue_debug, -1, 0, 0, 0, 0 },      /* cs */
     0,                                          /* objcount */
     FALSE,                                      /* thread_running */
-    LIST_INIT( timerqueue.pending_timers ),     /* pending_timers */
+    { 0 },                                      /* wheel */
+    TIMEOUT_INFINITE,                           /* wakeup */
     RTL_CONDITION_VARIABLE_INIT                 /* update_event */
 };
 
@@ -691,6 +756,179 @@ NTSTATUS WINAPI RtlDeregisterWait(HANDLE WaitHandle)
 }
 
 
+/************************** Timer Wheel Impl **************************/
+
+/* return the bitmap of the used slots of a level, starting at the given slot */
+static inline ULONGLONG timer_wheel_rotate( ULONGLONG used, unsigned int slot )
+{
+    return slot ? (used >> slot) | (used << (TIMER_WHEEL_SLOTS - slot)) : used;
+}
+
+static void timer_wheel_init( struct timer_wheel *wheel, ULONGLONG now )
+{
+    wheel->current = now;
+    wheel->count = 0;
+    memset( wheel->used, 0, sizeof(wheel->used) );
+}
+
+static inline void timer_wheel_update_deadline( struct timer_wheel *wheel, unsigned int level,
+                                                unsigned int slot, ULONGLONG deadline )
+{
+    if (deadline < wheel->deadline[level][slot])
+    {
+        wheel->deadline[level][slot] = deadline;
+        wheel->deadline_count[level][slot] = 0;
+    }
+    if (deadline == wheel->deadline[level][slot]) wheel->deadline_count[level][slot]++;
+}
+
+/* put an entry in the slot matching its expiration tick; the slot lists are
+ * only initialized while the corresponding bit is set in the used bitmap */
+static void timer_wheel_insert( struct timer_wheel *wheel, struct timer_wheel_entry *entry )
+{
+    ULONGLONG expire = max( entry->expire, wheel->current );
+    unsigned int level = 0, slot;
+
+    /* timers beyond the range of the wheel get cascaded again from the last slot */
+    if ((expire - wheel->current) >> (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+        expire = wheel->current + ((ULONGLONG)1 << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1;
+    while (level < TIMER_WHEEL_LEVELS - 1 &&
+           (expire - wheel->current) >> (TIMER_WHEEL_BITS * (level + 1)))
+        level++;
+
+    slot = (expire >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+    if (!(wheel->used[level] & ((ULONGLONG)1 << slot)))
+    {
+        list_init( &wheel->slots[level][slot] );
+        wheel->used[level] |= (ULONGLONG)1 << slot;
+        wheel->deadline[level][slot] = TIMER_WHEEL_NEVER;
+        wheel->deadline_count[level][slot] = 0;
+        wheel->latest[level][slot] = 0;
+    }
+    list_add_tail( &wheel->slots[level][slot], &entry->entry );
+    timer_wheel_update_deadline( wheel, level, slot, entry->deadline );
+    wheel->latest[level][slot] = max( wheel->latest[level][slot], expire );
+    entry->level = level;
+    entry->slot  = slot;
+}
+
+static void timer_wheel_add( struct timer_wheel *wheel, struct timer_wheel_entry *entry,
+                             ULONGLONG expire, ULONGLONG deadline )
+{
+    entry->expire = expire;
+    entry->deadline = deadline;
+    timer_wheel_insert( wheel, entry );
+    wheel->count++;
+}
+
+static void timer_wheel_remove( struct timer_wheel *wheel, struct timer_wheel_entry *entry )
+{
+    unsigned int level = entry->level, slot = entry->slot;
+    struct timer_wheel_entry *other;
+
+    list_remove( &entry->entry );
+    wheel->count--;
+    if (list_empty( &wheel->slots[level][slot] ))
+    {
+        wheel->used[level] &= ~((ULONGLONG)1 << slot);
+        return;
+    }
+
+    /* look for the new earliest deadline once the last entry with it is gone */
+    if (entry->deadline != wheel->deadline[level][slot] || --wheel->deadline_count[level][slot]) return;
+    wheel->deadline[level][slot] = TIMER_WHEEL_NEVER;
+    LIST_FOR_EACH_ENTRY( other, &wheel->slots[level][slot], struct timer_wheel_entry, entry )
+        timer_wheel_update_deadline( wheel, level, slot, other->deadline );
+}
+
+/* return the first tick at which timers expire or have to be cascaded */
+static ULONGLONG timer_wheel_next( const struct timer_wheel *wheel )
+{
+    ULONGLONG next = TIMER_WHEEL_NEVER, base, used;
+    unsigned int level;
+
+    if ((used = timer_wheel_rotate( wheel->used[0], wheel->current & TIMER_WHEEL_MASK )))
+        next = wheel->current + RtlFindLeastSignificantBit( used );
+
+    for (level = 1; level < TIMER_WHEEL_LEVELS; level++)
+    {
+        base = (wheel->current >> (TIMER_WHEEL_BITS * level)) + 1;
+        if (!(used = timer_wheel_rotate( wheel->used[level], base & TIMER_WHEEL_MASK ))) continue;
+        base = (base + RtlFindLeastSignificantBit( used )) << (TIMER_WHEEL_BITS * level);
+        if (base < next) next = base;
+    }
+    return next;
+}
+
+/* move the entries of a slot into the lower levels */
+static void timer_wheel_cascade( struct timer_wheel *wheel, unsigned int level )
+{
+    unsigned int slot = (wheel->current >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+    struct list entries = LIST_INIT( entries ), *ptr;
+
+    if (!(wheel->used[level] & ((ULONGLONG)1 << slot))) return;
+    list_move_tail( &entries, &wheel->slots[level][slot] );
+    wheel->used[level] &= ~((ULONGLONG)1 << slot);
+
+    while ((ptr = list_head( &entries )))
+    {
+        list_remove( ptr );
+        timer_wheel_insert( wheel, LIST_ENTRY( ptr, struct timer_wheel_entry, entry ) );
+    }
+}
+
+/* put all the entries back in the wheel after the clock went backwards */
+static void timer_wheel_rebase( struct timer_wheel *wheel, ULONGLONG now )
+{
+    struct list entries = LIST_INIT( entries ), *ptr;
+    unsigned int level, slot;
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++)
+        for (slot = 0; slot < TIMER_WHEEL_SLOTS; slot++)
+            if (wheel->used[level] & ((ULONGLONG)1 << slot))
+                list_move_tail( &entries, &wheel->slots[level][slot] );
+
+    memset( wheel->used, 0, sizeof(wheel->used) );
+    wheel->current = now;
+    while ((ptr = list_head( &entries )))
+    {
+        list_remove( ptr );
+        timer_wheel_insert( wheel, LIST_ENTRY( ptr, struct timer_wheel_entry, entry ) );
+    }
+}
+
+/* move all the entries expiring up to the given tick to the expired list */
+static void timer_wheel_expire( struct timer_wheel *wheel, ULONGLONG now, struct list *expired )
+{
+    unsigned int level, slot;
+    struct list *ptr;
+
+    if (now + 1 < wheel->current) timer_wheel_rebase( wheel, now );
+
+    while (wheel->current <= now)
+    {
+        slot = wheel->current & TIMER_WHEEL_MASK;
+        if (wheel->used[0] & ((ULONGLONG)1 << slot))
+        {
+            while ((ptr = list_head( &wheel->slots[0][slot] )))
+            {
+                list_remove( ptr );
+                list_add_tail( expired, ptr );
+                wheel->count--;
+            }
+            wheel->used[0] &= ~((ULONGLONG)1 << slot);
+        }
+
+        /* skip directly to the next slot that needs processing */
+        wheel->current = min( timer_wheel_next( wheel ), now + 1 );
+
+        for (level = 1; level < TIMER_WHEEL_LEVELS; level++)
+            if (wheel->current & (((ULONGLONG)1 << (TIMER_WHEEL_BITS * level)) - 1)) break;
+        while (--level) timer_wheel_cascade( wheel, level );
+    }
+}
+
+
 /************************** Timer Queue Impl **************************/
 
 static void queue_remove_timer(struct queue_timer *t)
@@ -704,6 +942,8 @@ static void queue_remove_timer(struct queue_timer *t)
     assert(t->destroy);
 
     list_remove(&t->entry);
+    if (t->expire != EXPIRE_NEVER)
+        timer_wheel_remove(&q->wheel, &t->wheel_entry);
     if (t->event)
         NtSetEvent(t->event, NULL);
     RtlFreeHeap(GetProcessHeap(), 0, t);
@@ -746,24 +986,18 @@ static void queue_add_timer(struct queue_timer *t, ULONGLONG time,
 {
     /* We MUST hold the queue cs while calling this function.  */
     struct timer_queue *q = t->q;
-    struct list *ptr = &q->timers;
 
     assert(!q->quit || (t->destroy && time == EXPIRE_NEVER));
 
-    if (time != EXPIRE_NEVER)
-        LIST_FOR_EACH(ptr, &q->timers)
-        {
-            struct queue_timer *cur = LIST_ENTRY(ptr, struct queue_timer, entry);
-            if (time < cur->expire)
-                break;
-        }
-    list_add_before(ptr, &t->entry);
-
     t->expire = time;
+    if (time == EXPIRE_NEVER)
+        return;
 
-    /* If we insert at the head of the list, we need to expire sooner
-       than expected.  */
-    if (set_event && &t->entry == list_head(&q->timers))
+    timer_wheel_add(&q->wheel, &t->wheel_entry, time, time);
+
+    /* If the timer expires before the queue thread wakes up, we need to
+       expire sooner than expected.  */
+    if (set_event && time < q->wakeup)
         NtSetEvent(q->event, NULL);
 }
 
@@ -771,39 +1005,46 @@ static inline void queue_move_timer(struct queue_timer *t, ULONGLONG time,
                                     BOOL set_event)
 {
     /* We MUST hold the queue cs while calling this function.  */
-    list_remove(&t->entry);
+    if (t->expire != EXPIRE_NEVER)
+        timer_wheel_remove(&t->q->wheel, &t->wheel_entry);
     queue_add_timer(t, time, set_event);
 }
 
 static void queue_timer_expire(struct timer_queue *q)
 {
-    struct queue_timer *t = NULL;
+    struct list expired = LIST_INIT(expired), callbacks = LIST_INIT(callbacks);
+    struct queue_timer *t, *next_timer;
+    struct list *ptr;
+    ULONGLONG now, next;
 
+    /* Collect all the expired timers at once, and run their callbacks
+       without holding the queue cs.  */
     RtlEnterCriticalSection(&q->cs);
-    if (list_head(&q->timers))
+    now = queue_current_time();
+    timer_wheel_expire(&q->wheel, now, &expired);
+    while ((ptr = list_head(&expired)))
     {
-        ULONGLONG now, next;
-        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
-        if (!t->destroy && t->expire <= ((now = queue_current_time())))
+        t = LIST_ENTRY(ptr, struct queue_timer, wheel_entry.entry);
+        list_remove(ptr);
+        assert(!t->destroy);
+
+        ++t->runcount;
+        if (t->period)
         {
-            ++t->runcount;
-            if (t->period)
-            {
-                next = t->expire + t->period;
-                /* avoid trigger cascade if overloaded / hibernated */
-                if (next < now)
-                    next = now + t->period;
-            }
-            else
-                next = EXPIRE_NEVER;
-            queue_move_timer(t, next, FALSE);
+            next = t->expire + t->period;
+            /* avoid trigger cascade if overloaded / hibernated */
+            if (next < now)
+                next = now + t->period;
         }
         else
-            t = NULL;
+            next = EXPIRE_NEVER;
+        queue_add_timer(t, next, FALSE);
+        list_add_tail(&callbacks, &t->expired_entry);
     }
     RtlLeaveCriticalSection(&q->cs);
 
-    if (t)
+    /* The runcount keeps the timers alive until their callback is done.  */
+    LIST_FOR_EACH_ENTRY_SAFE(t, next_timer, &callbacks, struct queue_timer, expired_entry)
     {
         if (t->flags & WT_EXECUTEINTIMERTHREAD)
             timer_callback_wrapper(t);
@@ -822,20 +1063,14 @@ static void queue_timer_expire(struct timer_queue *q)
 
 static ULONG queue_get_timeout(struct timer_queue *q)
 {
-    struct queue_timer *t;
     ULONG timeout = INFINITE;
 
     RtlEnterCriticalSection(&q->cs);
-    if (list_head(&q->timers))
+    q->wakeup = timer_wheel_next(&q->wheel);
+    if (q->wakeup != TIMER_WHEEL_NEVER)
     {
-        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
-        assert(!t->destroy || t->expire == EXPIRE_NEVER);
-
-        if (t->expire != EXPIRE_NEVER)
-        {
-            ULONGLONG time = queue_current_time();
-            timeout = t->expire < time ? 0 : t->expire - time;
-        }
+        ULONGLONG time = queue_current_time();
+        timeout = q->wakeup < time ? 0 : min(q->wakeup - time, INFINITE - 1);
     }
     RtlLeaveCriticalSection(&q->cs);
 
@@ -860,8 +1095,8 @@ static void WINAPI timer_queue_thread_proc(LPVOID p)
         if (status == STATUS_WAIT_0)
         {
             /* There are two possible ways to trigger the event.  Either
-               we are quitting and the last timer got removed, or a new
-               timer got put at the head of the list so we need to adjust
+               we are quitting and the last timer got removed, or a timer
+               got set to expire before our wakeup time so we need to adjust
                our timeout.  */
             RtlEnterCriticalSection(&q->cs);
             if (q->quit && list_empty(&q->timers))
@@ -894,8 +1129,7 @@ static void queue_destroy_timer(struct queue_timer *t)
            cleanup wrapper.  */
         queue_remove_timer(t);
     else
-        /* Make sure no destroyed timer masks an active timer at the head
-           of the sorted list.  */
+        /* Make sure the timer doesn't fire anymore.  */
         queue_move_timer(t, EXPIRE_NEVER, FALSE);
 }
 
@@ -920,6 +1154,8 @@ NTSTATUS WINAPI RtlCreateTimerQueue(PHANDLE NewTimerQueue)
 
     RtlInitializeCriticalSection(&q->cs);
     list_init(&q->timers);
+    timer_wheel_init(&q->wheel, queue_current_time());
+    q->wakeup = EXPIRE_NEVER;
     q->quit = FALSE;
     q->magic = TIMER_QUEUE_MAGIC;
     status = NtCreateEvent(&q->event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
@@ -1081,7 +1317,10 @@ NTSTATUS WINAPI RtlCreateTimer(PHANDLE NewTimer, HANDLE TimerQueue,
     if (q->quit)
         status = STATUS_INVALID_HANDLE;
     else
+    {
+        list_add_tail(&q->timers, &t->entry);
         queue_add_timer(t, queue_current_time() + DueTime, TRUE);
+    }
     RtlLeaveCriticalSection(&q->cs);
 
     if (status == STATUS_SUCCESS)
@@ -1186,15 +1425,80 @@ NTSTATUS WINAPI RtlDeleteTimer(HANDLE TimerQueue, HANDLE Timer,
     return status;
 }
 
+/***********************************************************************
+ *           tp_timerqueue_add    (internal)
+ *
+ * Adds a timer to the timerqueue wheel. The timerqueue lock has to be held.
+ */
+static void tp_timerqueue_add( struct threadpool_object *timer )
+{
+    /* round up to the next tick, so that the timer never expires early */
+    timer_wheel_add( &timerqueue.wheel, &timer->u.timer.timer_entry,
+                     (timer->u.timer.timeout + 9999) / 10000,
+                     timer->u.timer.timeout + (ULONGLONG)timer->u.timer.window_length * 10000 );
+    timer->u.timer.timer_pending = TRUE;
+}
+
+/***********************************************************************
+ *           tp_timerqueue_get_timeout    (internal)
+ *
+ * Determines the next wakeup time of the timer thread. The earliest deadline
+ * of the timers, their timeout plus their window length, is the latest
+ * allowed wakeup time. The thread wakes up when the last timer of the last
+ * slot expiring entirely before it is due, so that as many timers as
+ * possible expire with a single wakeup; otherwise at the start of the first
+ * slot, where it's cascaded to the lower levels.
+ */
+static ULONGLONG tp_timerqueue_get_timeout(void)
+{
+    ULONGLONG deadline = TIMEOUT_INFINITE, timeout = 0, first = TIMEOUT_INFINITE, start, end, used;
+    struct timer_wheel *wheel = &timerqueue.wheel;
+    unsigned int level, shift, slot, i;
+
+    if (!wheel->count)
+        return TIMEOUT_INFINITE;
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++)
+    {
+        for (used = wheel->used[level]; used; used &= used - 1)
+        {
+            slot = RtlFindLeastSignificantBit( used );
+            deadline = min( deadline, wheel->deadline[level][slot] );
+        }
+    }
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++)
+    {
+        shift = TIMER_WHEEL_BITS * level;
+        for (i = 0; i < TIMER_WHEEL_SLOTS; i++)
+        {
+            /* ticks covered by the slot, the timers in it expire after the one before the start */
+            if (!level) start = wheel->current + i;
+            else start = ((wheel->current >> shift) + 1 + i) << shift;
+            if ((start - 1) * 10000 >= deadline) break;
+
+            slot = (start >> shift) & TIMER_WHEEL_MASK;
+            if (!(wheel->used[level] & ((ULONGLONG)1 << slot))) continue;
+
+            end = start + ((ULONGLONG)1 << shift) - 1;
+            if (!level || end * 10000 <= deadline)
+                timeout = max( timeout, wheel->latest[level][slot] * 10000 );
+            else
+                first = min( first, start * 10000 );
+        }
+    }
+
+    return timeout ? timeout : first;
+}
+
 /***********************************************************************
  *           timerqueue_thread_proc    (internal)
  */
 static void CALLBACK timerqueue_thread_proc( void *param )
 {
-    ULONGLONG timeout_lower, timeout_upper, new_timeout;
-    struct threadpool_object *other_timer;
+    struct threadpool_object *timer;
     LARGE_INTEGER now, timeout;
-    struct list *ptr;
+    struct list expired, *ptr;
 
     TRACE( "starting timer queue thread\n" );
 
@@ -1203,17 +1507,17 @@ static void CALLBACK timerqueue_thread_proc( void *param )
     {
         NtQuerySystemTime( &now );
 
-        /* Check for expired timers. */
-        while ((ptr = list_head( &timerqueue.pending_timers )))
+        /* Collect all expired timers at once. */
+        list_init( &expired );
+        timer_wheel_expire( &timerqueue.wheel, now.QuadPart / 10000, &expired );
+        while ((ptr = list_head( &expired )))
         {
-            struct threadpool_object *timer = LIST_ENTRY( ptr, struct threadpool_object, u.timer.timer_entry );
+            timer = LIST_ENTRY( ptr, struct threadpool_object, u.timer.timer_entry.entry );
             assert( timer->type == TP_OBJECT_TYPE_TIMER );
             assert( timer->u.timer.timer_pending );
-            if (timer->u.timer.timeout > now.QuadPart)
-                break;
 
             /* Queue a new callback in one of the worker threads. */
-            list_remove( &timer->u.timer.timer_entry );
+            list_remove( ptr );
             timer->u.timer.timer_pending = FALSE;
             tp_object_submit( timer, FALSE );
 
@@ -1223,46 +1527,21 @@ static void CALLBACK timerqueue_thread_proc( void *param )
                 timer->u.timer.timeout += (ULONGLONG)timer->u.timer.period * 10000;
                 if (timer->u.timer.timeout <= now.QuadPart)
                     timer->u.timer.timeout = now.QuadPart + 1;
-
-                LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
-                                     struct threadpool_object, u.timer.timer_entry )
-                {
-                    assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
-                    if (timer->u.timer.timeout < other_timer->u.timer.timeout)
-                        break;
-                }
-                list_add_before( &other_timer->u.timer.timer_entry, &timer->u.timer.timer_entry );
-                timer->u.timer.timer_pending = TRUE;
+                tp_timerqueue_add( timer );
             }
         }
 
-        timeout_lower = TIMEOUT_INFINITE;
-        timeout_upper = TIMEOUT_INFINITE;
-
-        /* Determine next timeout and use the window length to optimize wakeup times. */
-        LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
-                             struct threadpool_object, u.timer.timer_entry )
-        {
-            assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
-            if (other_timer->u.timer.timeout >= timeout_upper)
-                break;
-
-            timeout_lower = other_timer->u.timer.timeout;
-            new_timeout   = timeout_lower + (ULONGLONG)other_timer->u.timer.window_length * 10000;
-            if (new_timeout < timeout_upper)
-                timeout_upper = new_timeout;
-        }
-
         /* Wait for timer update events or until the next timer expires. */
         if (timerqueue.objcount)
         {
-            timeout.QuadPart = timeout_lower;
+            timerqueue.wakeup = timeout.QuadPart = tp_timerqueue_get_timeout();
             RtlSleepConditionVariableCS( &timerqueue.update_event, &timerqueue.cs, &timeout );
             continue;
         }
 
         /* All timers have been destroyed, if no new timers are created
          * within some amount of time, then we can shutdown this thread. */
+        timerqueue.wakeup = TIMEOUT_INFINITE;
         timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
         if (RtlSleepConditionVariableCS( &timerqueue.update_event, &timerqueue.cs,
             &timeout ) == STATUS_TIMEOUT && !timerqueue.objcount)
@@ -1313,6 +1592,13 @@ static NTSTATUS tp_timerqueue_lock( struct threadpool_object *timer )
 
     if (status == STATUS_SUCCESS)
     {
+        /* The wheel is empty when there are no timers, start it at the current time. */
+        if (!timerqueue.objcount)
+        {
+            LARGE_INTEGER now;
+            NtQuerySystemTime( &now );
+            timer_wheel_init( &timerqueue.wheel, now.QuadPart / 10000 );
+        }
         timer->u.timer.timer_initialized = TRUE;
         timerqueue.objcount++;
     }
@@ -1336,14 +1622,14 @@ static void tp_timerqueue_unlock( struct threadpool_object *timer )
         /* If timer was pending, remove it. */
         if (timer->u.timer.timer_pending)
         {
-            list_remove( &timer->u.timer.timer_entry );
+            timer_wheel_remove( &timerqueue.wheel, &timer->u.timer.timer_entry );
             timer->u.timer.timer_pending = FALSE;
         }
 
         /* If the last timer object was destroyed, then wake up the thread. */
         if (!--timerqueue.objcount)
         {
-            assert( list_empty( &timerqueue.pending_timers ) );
+            assert( !timerqueue.wheel.count );
             RtlWakeAllConditionVariable( &timerqueue.update_event );
         }
 
@@ -1608,9 +1894,19 @@ static void tp_waitqueue_unlock( struct threadpool_object *wait )
  */
 static NTSTATUS tp_threadpool_alloc( struct threadpool **out )
 {
+    static unsigned int num_queues;
     struct threadpool *pool;
+    unsigned int i;
 
-    pool = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*pool) );
+    /* WINETHREADPOOLQUEUES=1 selects a single queue shared by all workers */
+    if (!num_queues)
+    {
+        const char *env = getenv( "WINETHREADPOOLQUEUES" );
+        int count = env ? atoi( env ) : NtCurrentTeb()->Peb->NumberOfProcessors;
+        num_queues = max( 1, min( count, THREADPOOL_MAX_QUEUES ));
+    }
+
+    pool = RtlAllocateHeap( GetProcessHeap(), 0, FIELD_OFFSET( struct threadpool, queues[num_queues] ));
     if (!pool)
         return STATUS_NO_MEMORY;
 
@@ -1621,14 +1917,24 @@ static NTSTATUS tp_threadpool_alloc( struct threadpool **out )
     RtlInitializeCriticalSection( &pool->cs );
     pool->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": threadpool.cs");
 
-    list_init( &pool->pool );
     RtlInitializeConditionVariable( &pool->update_event );
 
+    pool->num_pending           = 0;
+    pool->next_object_queue     = 0;
+    pool->next_worker_queue     = 0;
     pool->max_workers           = 500;
     pool->min_workers           = 0;
     pool->num_workers           = 0;
+    pool->num_idle_workers      = 0;
     pool->num_busy_workers      = 0;
 
+    pool->num_queues            = num_queues;
+    for (i = 0; i < num_queues; i++)
+    {
+        RtlInitializeSRWLock( &pool->queues[i].lock );
+        list_init( &pool->queues[i].objects );
+    }
+
     TRACE( "allocated threadpool %p\n", pool );
 
     *out = pool;
@@ -1664,7 +1970,7 @@ static BOOL tp_threadpool_release( struct threadpool *pool )
 
     assert( pool->shutdown );
     assert( !pool->objcount );
-    assert( list_empty( &pool->pool ) );
+    assert( !pool->num_pending );
 
     pool->cs.DebugInfo->Spare[0] = 0;
     RtlDeleteCriticalSection( &pool->cs );
@@ -1718,7 +2024,7 @@ static NTSTATUS tp_threadpool_lock( struct threadpool **out, TP_CALLBACK_ENVIRON
         {
             interlocked_inc( &pool->refcount );
             pool->num_workers++;
-            pool->num_busy_workers++;
+            interlocked_inc( &pool->num_busy_workers );
             NtClose( thread );
         }
     }
@@ -1826,6 +2132,8 @@ static void tp_object_initialize( struct threadpool_object *object, struct threa
     object->shutdown                = FALSE;
 
     object->pool                    = pool;
+    object->queue                   = &pool->queues[(ULONG)interlocked_inc( &pool->next_object_queue ) %
+                                                    pool->num_queues];
     object->group                   = NULL;
     object->userdata                = userdata;
     object->group_cancel_callback   = NULL;
@@ -1900,11 +2208,32 @@ static void tp_object_initialize( struct threadpool_object *object, struct threa
 static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
 {
     struct threadpool *pool = object->pool;
+    struct threadpool_queue *queue = object->queue;
     NTSTATUS status = STATUS_UNSUCCESSFUL;
 
     assert( !object->shutdown );
     assert( !pool->shutdown );
 
+    /* Queue work item and increment refcount. */
+    interlocked_inc( &object->refcount );
+    RtlAcquireSRWLockExclusive( &queue->lock );
+    if (!object->num_pending_callbacks++)
+        list_add_tail( &queue->objects, &object->pool_entry );
+    interlocked_inc( &pool->num_pending );
+
+    /* Count how often the object was signaled. */
+    if (object->type == TP_OBJECT_TYPE_WAIT && signaled)
+        object->u.wait.signaled++;
+    RtlReleaseSRWLockExclusive( &queue->lock );
+
+    /* Workers increment num_idle_workers before checking num_pending, and
+     * decrement num_workers before their last check when exiting, so at least
+     * one side sees the update of the other one. A worker which is neither
+     * busy nor idle will find the work item before going to sleep. */
+    if (!pool->num_idle_workers && (pool->num_busy_workers < pool->num_workers ||
+                                    pool->num_workers >= pool->max_workers))
+        return;
+
     RtlEnterCriticalSection( &pool->cs );
 
     /* Start new worker threads if required. */
@@ -1918,20 +2247,11 @@ static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
         {
             interlocked_inc( &pool->refcount );
             pool->num_workers++;
-            pool->num_busy_workers++;
+            interlocked_inc( &pool->num_busy_workers );
             NtClose( thread );
         }
     }
 
-    /* Queue work item and increment refcount. */
-    interlocked_inc( &object->refcount );
-    if (!object->num_pending_callbacks++)
-        list_add_tail( &pool->pool, &object->pool_entry );
-
-    /* Count how often the object was signaled. */
-    if (object->type == TP_OBJECT_TYPE_WAIT && signaled)
-        object->u.wait.signaled++;
-
     /* No new thread started - wake up one existing thread. */
     if (status != STATUS_SUCCESS)
     {
@@ -1952,17 +2272,18 @@ static void tp_object_cancel( struct threadpool_object *object, BOOL group_cance
     struct threadpool *pool = object->pool;
     LONG pending_callbacks = 0;
 
-    RtlEnterCriticalSection( &pool->cs );
+    RtlAcquireSRWLockExclusive( &object->queue->lock );
     if (object->num_pending_callbacks)
     {
         pending_callbacks = object->num_pending_callbacks;
         object->num_pending_callbacks = 0;
         list_remove( &object->pool_entry );
+        interlocked_xchg_add( &pool->num_pending, -pending_callbacks );
 
         if (object->type == TP_OBJECT_TYPE_WAIT)
             object->u.wait.signaled = 0;
     }
-    RtlLeaveCriticalSection( &pool->cs );
+    RtlReleaseSRWLockExclusive( &object->queue->lock );
 
     /* Execute group cancellation callback if defined, and if this was actually a group cancel. */
     if (pending_callbacks && group_cancel && object->group_cancel_callback)
@@ -1984,20 +2305,20 @@ static void tp_object_cancel( struct threadpool_object *object, BOOL group_cance
  */
 static void tp_object_wait( struct threadpool_object *object, BOOL group_wait )
 {
-    struct threadpool *pool = object->pool;
+    struct threadpool_queue *queue = object->queue;
 
-    RtlEnterCriticalSection( &pool->cs );
+    RtlAcquireSRWLockExclusive( &queue->lock );
     if (group_wait)
     {
         while (object->num_pending_callbacks || object->num_running_callbacks)
-            RtlSleepConditionVariableCS( &object->group_finished_event, &pool->cs, NULL );
+            RtlSleepConditionVariableSRW( &object->group_finished_event, &queue->lock, NULL, 0 );
     }
     else
     {
         while (object->num_pending_callbacks || object->num_associated_callbacks)
-            RtlSleepConditionVariableCS( &object->finished_event, &pool->cs, NULL );
+            RtlSleepConditionVariableSRW( &object->finished_event, &queue->lock, NULL, 0 );
     }
-    RtlLeaveCriticalSection( &pool->cs );
+    RtlReleaseSRWLockExclusive( &queue->lock );
 }
 
 /***********************************************************************
@@ -2058,6 +2379,63 @@ static BOOL tp_object_release( struct threadpool_object *object )
     return TRUE;
 }
 
+/***********************************************************************
+ *           tp_threadpool_dequeue    (internal)
+ *
+ * Takes the next pending callback out of the threadpool queues, starting
+ * with the queue at index *next and stealing from the other ones if it is
+ * empty. The next lookup starts with the following queue, so that objects
+ * in different queues are processed in turn.
+ */
+static struct threadpool_object *tp_threadpool_dequeue( struct threadpool *pool, unsigned int *next,
+                                                        TP_WAIT_RESULT *wait_result )
+{
+    struct threadpool_object *object;
+    struct threadpool_queue *queue;
+    unsigned int i, index;
+    struct list *ptr;
+
+    for (i = 0; i < pool->num_queues && pool->num_pending > 0; i++)
+    {
+        index = (*next + i) % pool->num_queues;
+        queue = &pool->queues[index];
+
+        /* unlocked check to avoid taking the lock of empty queues, rechecked below */
+        if (list_empty( &queue->objects )) continue;
+
+        RtlAcquireSRWLockExclusive( &queue->lock );
+        if (!(ptr = list_head( &queue->objects )))
+        {
+            RtlReleaseSRWLockExclusive( &queue->lock );
+            continue;
+        }
+        object = LIST_ENTRY( ptr, struct threadpool_object, pool_entry );
+        assert( object->num_pending_callbacks > 0 );
+
+        /* If further pending callbacks are queued, move the work item to
+         * the end of the queue. Otherwise remove it from the queue. */
+        list_remove( &object->pool_entry );
+        if (--object->num_pending_callbacks)
+            list_add_tail( &queue->objects, &object->pool_entry );
+        interlocked_dec( &pool->num_pending );
+
+        /* For wait objects check if they were signaled or have timed out. */
+        if (object->type == TP_OBJECT_TYPE_WAIT)
+        {
+            *wait_result = object->u.wait.signaled ? WAIT_OBJECT_0 : WAIT_TIMEOUT;
+            if (*wait_result == WAIT_OBJECT_0) object->u.wait.signaled--;
+        }
+
+        object->num_associated_callbacks++;
+        object->num_running_callbacks++;
+        RtlReleaseSRWLockExclusive( &queue->lock );
+
+        *next = index + 1;
+        return object;
+    }
+    return NULL;
+}
+
 /***********************************************************************
  *           threadpool_worker_proc    (internal)
  */
@@ -2065,41 +2443,25 @@ static void CALLBACK threadpool_worker_proc( void *param )
 {
     TP_CALLBACK_INSTANCE *callback_instance;
     struct threadpool_instance instance;
+    struct threadpool_object *object;
     struct threadpool *pool = param;
     TP_WAIT_RESULT wait_result = 0;
     LARGE_INTEGER timeout;
-    struct list *ptr;
+    unsigned int next_queue;
     NTSTATUS status;
 
     TRACE( "starting worker thread for pool %p\n", pool );
 
-    RtlEnterCriticalSection( &pool->cs );
-    pool->num_busy_workers--;
+    /* Each worker starts looking for work in a different queue. */
+    next_queue = (ULONG)interlocked_inc( &pool->next_worker_queue ) % pool->num_queues;
+
+    interlocked_dec( &pool->num_busy_workers );
     for (;;)
     {
-        while ((ptr = list_head( &pool->pool )))
+        while ((object = tp_threadpool_dequeue( pool, &next_queue, &wait_result )))
         {
-            struct threadpool_object *object = LIST_ENTRY( ptr, struct threadpool_object, pool_entry );
-            assert( object->num_pending_callbacks > 0 );
-
-            /* If further pending callbacks are queued, move the work item to
-             * the end of the pool list. Otherwise remove it from the pool. */
-            list_remove( &object->pool_entry );
-            if (--object->num_pending_callbacks)
-                list_add_tail( &pool->pool, &object->pool_entry );
-
-            /* For wait objects check if they were signaled or have timed out. */
-            if (object->type == TP_OBJECT_TYPE_WAIT)
-            {
-                wait_result = object->u.wait.signaled ? WAIT_OBJECT_0 : WAIT_TIMEOUT;
-                if (wait_result == WAIT_OBJECT_0) object->u.wait.signaled--;
-            }
-
-            /* Leave critical section and do the actual callback. */
-            object->num_associated_callbacks++;
-            object->num_running_callbacks++;
-            pool->num_busy_workers++;
-            RtlLeaveCriticalSection( &pool->cs );
+            /* Do the actual callback. */
+            interlocked_inc( &pool->num_busy_workers );
 
             /* Initialize threadpool instance struct. */
             callback_instance = (TP_CALLBACK_INSTANCE *)&instance;
@@ -2192,8 +2554,7 @@ static void CALLBACK threadpool_worker_proc( void *param )
             }
 
         skip_cleanup:
-            RtlEnterCriticalSection( &pool->cs );
-            pool->num_busy_workers--;
+            RtlAcquireSRWLockExclusive( &object->queue->lock );
 
             object->num_running_callbacks--;
             if (!object->num_pending_callbacks && !object->num_running_callbacks)
@@ -2206,27 +2567,52 @@ static void CALLBACK threadpool_worker_proc( void *param )
                     RtlWakeAllConditionVariable( &object->finished_event );
             }
 
+            RtlReleaseSRWLockExclusive( &object->queue->lock );
+            interlocked_dec( &pool->num_busy_workers );
+
             tp_object_release( object );
         }
 
+        RtlEnterCriticalSection( &pool->cs );
+
         /* Shutdown worker thread if requested. */
-        if (pool->shutdown)
+        if (pool->shutdown && pool->num_pending <= 0)
+        {
+            interlocked_dec( &pool->num_workers );
             break;
+        }
+
+        /* Submitting threads check num_idle_workers after updating num_pending,
+         * see tp_object_submit. */
+        interlocked_inc( &pool->num_idle_workers );
+        if (pool->num_pending > 0)
+        {
+            interlocked_dec( &pool->num_idle_workers );
+            RtlLeaveCriticalSection( &pool->cs );
+            continue;
+        }
 
         /* Wait for new tasks or until the timeout expires. A thread only terminates
          * when no new tasks are available, and the number of threads can be
          * decreased without violating the min_workers limit. An exception is when
          * min_workers == 0, then objcount is used to detect if the last thread
-         * can be terminated. */
-        timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
-        if (RtlSleepConditionVariableCS( &pool->update_event, &pool->cs, &timeout ) == STATUS_TIMEOUT &&
-            !list_head( &pool->pool ) && (pool->num_workers > max( pool->min_workers, 1 ) ||
-            (!pool->min_workers && !pool->objcount)))
+         * can be terminated. The more workers are idle, the sooner they time out,
+         * so that the threads started for a burst of work items go away quickly. */
+        timeout.QuadPart = (ULONGLONG)max( THREADPOOL_WORKER_TIMEOUT / pool->num_idle_workers,
+                                           THREADPOOL_WORKER_MIN_TIMEOUT ) * -10000;
+        status = RtlSleepConditionVariableCS( &pool->update_event, &pool->cs, &timeout );
+        interlocked_dec( &pool->num_idle_workers );
+        if (status == STATUS_TIMEOUT &&
+            (pool->num_workers > max( pool->min_workers, 1 ) || (!pool->min_workers && !pool->objcount)))
         {
-            break;
+            /* Stop counting this thread before the last check of num_pending: a
+             * submitter that still counts it has already updated num_pending. */
+            interlocked_dec( &pool->num_workers );
+            if (pool->num_pending <= 0) break;
+            interlocked_inc( &pool->num_workers );
         }
+        RtlLeaveCriticalSection( &pool->cs );
     }
-    pool->num_workers--;
     RtlLeaveCriticalSection( &pool->cs );
 
     TRACE( "terminating worker thread for pool %p\n", pool );
@@ -2417,7 +2803,7 @@ NTSTATUS WINAPI TpCallbackMayRunLong( TP_CALLBACK_INSTANCE *instance )
             {
                 interlocked_inc( &pool->refcount );
                 pool->num_workers++;
-                pool->num_busy_workers++;
+                interlocked_inc( &pool->num_busy_workers );
                 NtClose( thread );
             }
         }
@@ -2494,7 +2880,6 @@ VOID WINAPI TpDisassociateCallback( TP_CALLBACK_INSTANCE *instance )
 {
     struct threadpool_instance *this = impl_from_TP_CALLBACK_INSTANCE( instance );
     struct threadpool_object *object = this->object;
-    struct threadpool *pool;
 
     TRACE( "%p\n", instance );
 
@@ -2507,14 +2892,13 @@ VOID WINAPI TpDisassociateCallback( TP_CALLBACK_INSTANCE *instance )
     if (!this->associated)
         return;
 
-    pool = object->pool;
-    RtlEnterCriticalSection( &pool->cs );
+    RtlAcquireSRWLockExclusive( &object->queue->lock );
 
     object->num_associated_callbacks--;
     if (!object->num_pending_callbacks && !object->num_associated_callbacks)
         RtlWakeAllConditionVariable( &object->finished_event );
 
-    RtlLeaveCriticalSection( &pool->cs );
+    RtlReleaseSRWLockExclusive( &object->queue->lock );
     this->associated = FALSE;
 }
 
@@ -2705,7 +3089,7 @@ BOOL WINAPI TpSetPoolMinThreads( TP_POOL *pool, DWORD minimum )
 
         interlocked_inc( &this->refcount );
         this->num_workers++;
-        this->num_busy_workers++;
+        interlocked_inc( &this->num_busy_workers );
         NtClose( thread );
     }
 
@@ -2725,7 +3109,6 @@ BOOL WINAPI TpSetPoolMinThreads( TP_POOL *pool, DWORD minimum )
 VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LONG window_length )
 {
     struct threadpool_object *this = impl_from_TP_TIMER( timer );
-    struct threadpool_object *other_timer;
     BOOL submit_timer = FALSE;
     ULONGLONG timestamp;
 
@@ -2764,7 +3147,7 @@ VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LO
     /* First remove existing timeout. */
     if (this->u.timer.timer_pending)
     {
-        list_remove( &this->u.timer.timer_entry );
+        timer_wheel_remove( &timerqueue.wheel, &this->u.timer.timer_entry );
         this->u.timer.timer_pending = FALSE;
     }
 
@@ -2774,21 +3157,11 @@ VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LO
         this->u.timer.timeout       = timestamp;
         this->u.timer.period        = period;
         this->u.timer.window_length = window_length;
-
-        LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
-                             struct threadpool_object, u.timer.timer_entry )
-        {
-            assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
-            if (this->u.timer.timeout < other_timer->u.timer.timeout)
-                break;
-        }
-        list_add_before( &other_timer->u.timer.timer_entry, &this->u.timer.timer_entry );
+        tp_timerqueue_add( this );
 
         /* Wake up the timer thread when the timeout has to be updated. */
-        if (list_head( &timerqueue.pending_timers ) == &this->u.timer.timer_entry )
+        if (this->u.timer.timeout < timerqueue.wakeup)
             RtlWakeAllConditionVariable( &timerqueue.update_event );
-
-        this->u.timer.timer_pending = TRUE;
     }
 
     RtlLeaveCriticalSection( &timerqueue.cs );
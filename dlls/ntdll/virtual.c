@@ -51,6 +51,7 @@
 #include "wine/server.h"
 #include "wine/exception.h"
 #include "wine/list.h"
+#include "wine/rbtree.h"
 #include "wine/debug.h"
 #include "ntdll_misc.h"
 
@@ -65,6 +66,7 @@ WINE_DECLARE_DEBUG_CHANNEL(module);
 struct file_view
 {
     struct list   entry;       /* Entry in global view list */
+    struct wine_rb_entry tree_entry; /* Entry in global view tree */
     void         *base;        /* Base address */
     size_t        size;        /* Size in bytes */
     HANDLE        mapping;     /* Handle to the file mapping */
@@ -96,6 +98,20 @@ static const BYTE VIRTUAL_Win32Flags[16] =
 };
 
 static struct list views_list = LIST_INIT(views_list);
+static struct wine_rb_tree views_tree;
+
+/* Free range: part of the address space between two views that can hold allocations
+ * aligned to the granularity, i.e. from the end of the previous view rounded up to the
+ * granularity, to the start of the next view. They are kept in a tree sorted by address. */
+struct range_entry
+{
+    struct wine_rb_entry tree_entry; /* Entry in the free ranges tree */
+    void *base;
+    void *end;
+};
+
+static struct wine_rb_tree free_ranges_tree;
+static BOOL free_ranges_valid;  /* cleared if a range couldn't be allocated */
 
 static RTL_CRITICAL_SECTION csVirtual;
 static RTL_CRITICAL_SECTION_DEBUG critsect_debug =
@@ -141,7 +157,13 @@ static const BOOL is_win64 = (sizeof(void *) > sizeof(int));
 #define VIRTUAL_DEBUG_DUMP_VIEW(view) \
     do { if (TRACE_ON(virtual)) VIRTUAL_DumpView(view); } while (0)
 
-#define VIRTUAL_HEAP_SIZE (sizeof(void*)*1024*1024)
+#ifdef _WIN64
+#define VIRTUAL_HEAP_SIZE (32*1024*1024)  /* room for a few hundred thousand views */
+#else
+#define VIRTUAL_HEAP_SIZE (4*1024*1024)
+#endif
+
+static const UINT_PTR granularity_mask = 0xffff;  /* allocation granularity */
 
 static HANDLE virtual_heap;
 static void *preload_reserve_start;
@@ -241,6 +263,117 @@ static void VIRTUAL_Dump(void)
 #endif
 
 
+/***********************************************************************
+ *           compare_view
+ *
+ * Comparison function for the views tree, a view matches all the addresses it contains.
+ */
+static int compare_view( const void *addr, const struct wine_rb_entry *entry )
+{
+    const struct file_view *view = WINE_RB_ENTRY_VALUE( entry, const struct file_view, tree_entry );
+
+    if ((const char *)addr < (const char *)view->base) return -1;
+    if ((const char *)addr >= (const char *)view->base + view->size) return 1;
+    return 0;
+}
+
+static void *views_tree_alloc( size_t size )
+{
+    return RtlAllocateHeap( virtual_heap, 0, size );
+}
+
+static void *views_tree_realloc( void *ptr, size_t size )
+{
+    return RtlReAllocateHeap( virtual_heap, 0, ptr, size );
+}
+
+static void views_tree_free( void *ptr )
+{
+    RtlFreeHeap( virtual_heap, 0, ptr );
+}
+
+static const struct wine_rb_functions views_tree_functions =
+{
+    views_tree_alloc,
+    views_tree_realloc,
+    views_tree_free,
+    compare_view
+};
+
+
+/***********************************************************************
+ *           compare_free_range
+ *
+ * Comparison function for the free ranges tree, a range matches all the addresses it contains.
+ */
+static int compare_free_range( const void *addr, const struct wine_rb_entry *entry )
+{
+    const struct range_entry *range = WINE_RB_ENTRY_VALUE( entry, const struct range_entry, tree_entry );
+
+    if ((const char *)addr < (const char *)range->base) return -1;
+    if ((const char *)addr >= (const char *)range->end) return 1;
+    return 0;
+}
+
+static const struct wine_rb_functions free_ranges_tree_functions =
+{
+    views_tree_alloc,
+    views_tree_realloc,
+    views_tree_free,
+    compare_free_range
+};
+
+
+/***********************************************************************
+ *           find_view_after
+ *
+ * Find the first view that ends after the given address, i.e. the view containing
+ * it or the next one. The csVirtual section must be held by caller.
+ */
+static struct file_view *find_view_after( const void *addr )
+{
+    struct wine_rb_entry *ptr = views_tree.root;
+    struct file_view *view, *ret = NULL;
+
+    while (ptr)
+    {
+        view = WINE_RB_ENTRY_VALUE( ptr, struct file_view, tree_entry );
+        if ((const char *)view->base + view->size > (const char *)addr)
+        {
+            ret = view;
+            ptr = ptr->left;
+        }
+        else ptr = ptr->right;
+    }
+    return ret;
+}
+
+
+/***********************************************************************
+ *           find_view_before
+ *
+ * Find the last view that starts before the given address.
+ * The csVirtual section must be held by caller.
+ */
+static struct file_view *find_view_before( const void *addr )
+{
+    struct wine_rb_entry *ptr = views_tree.root;
+    struct file_view *view, *ret = NULL;
+
+    while (ptr)
+    {
+        view = WINE_RB_ENTRY_VALUE( ptr, struct file_view, tree_entry );
+        if ((const char *)view->base < (const char *)addr)
+        {
+            ret = view;
+            ptr = ptr->right;
+        }
+        else ptr = ptr->left;
+    }
+    return ret;
+}
+
+
 /***********************************************************************
  *           VIRTUAL_FindView
  *
@@ -255,17 +388,14 @@ static void VIRTUAL_Dump(void)
  */
 static struct file_view *VIRTUAL_FindView( const void *addr, size_t size )
 {
+    struct wine_rb_entry *ptr = wine_rb_get( &views_tree, addr );
     struct file_view *view;
 
-    LIST_FOR_EACH_ENTRY( view, &views_list, struct file_view, entry )
-    {
-        if (view->base > addr) break;  /* no matching view */
-        if ((const char *)view->base + view->size <= (const char *)addr) continue;
-        if ((const char *)view->base + view->size < (const char *)addr + size) break;  /* size too large */
-        if ((const char *)addr + size < (const char *)addr) break; /* overflow */
-        return view;
-    }
-    return NULL;
+    if (!ptr) return NULL;  /* no matching view */
+    view = WINE_RB_ENTRY_VALUE( ptr, struct file_view, tree_entry );
+    if ((const char *)view->base + view->size < (const char *)addr + size) return NULL;  /* size too large */
+    if ((const char *)addr + size < (const char *)addr) return NULL; /* overflow */
+    return view;
 }
 
 
@@ -288,12 +418,206 @@ static inline UINT_PTR get_mask( ULONG zero_bits )
  */
 static struct file_view *find_view_range( const void *addr, size_t size )
 {
-    struct file_view *view;
+    struct file_view *view = find_view_after( addr );
 
-    LIST_FOR_EACH_ENTRY( view, &views_list, struct file_view, entry )
+    if (view && (const char *)view->base < (const char *)addr + size) return view;
+    return NULL;
+}
+
+
+/***********************************************************************
+ *           free_ranges_lower_bound
+ *
+ * Find the first free range that ends after the given address.
+ */
+static struct range_entry *free_ranges_lower_bound( const void *addr )
+{
+    struct wine_rb_entry *ptr = free_ranges_tree.root;
+    struct range_entry *range, *ret = NULL;
+
+    while (ptr)
+    {
+        range = WINE_RB_ENTRY_VALUE( ptr, struct range_entry, tree_entry );
+        if ((const char *)range->end > (const char *)addr)
+        {
+            ret = range;
+            ptr = ptr->left;
+        }
+        else ptr = ptr->right;
+    }
+    return ret;
+}
+
+
+/***********************************************************************
+ *           free_ranges_before
+ *
+ * Find the last free range that starts before the given address.
+ */
+static struct range_entry *free_ranges_before( const void *addr )
+{
+    struct wine_rb_entry *ptr = free_ranges_tree.root;
+    struct range_entry *range, *ret = NULL;
+
+    while (ptr)
+    {
+        range = WINE_RB_ENTRY_VALUE( ptr, struct range_entry, tree_entry );
+        if ((const char *)range->base < (const char *)addr)
+        {
+            ret = range;
+            ptr = ptr->right;
+        }
+        else ptr = ptr->left;
+    }
+    return ret;
+}
+
+
+static void free_range_entry( struct wine_rb_entry *entry, void *context )
+{
+    RtlFreeHeap( virtual_heap, 0, WINE_RB_ENTRY_VALUE( entry, struct range_entry, tree_entry ));
+}
+
+
+/***********************************************************************
+ *           free_ranges_insert
+ *
+ * Add a free range. The csVirtual section must be held by caller.
+ */
+static void free_ranges_insert( void *base, void *end )
+{
+    struct range_entry *range;
+
+    if (!free_ranges_valid || base >= end) return;
+    if ((range = RtlAllocateHeap( virtual_heap, 0, sizeof(*range) )))
+    {
+        range->base = base;
+        range->end = end;
+        if (!wine_rb_put( &free_ranges_tree, base, &range->tree_entry )) return;
+        RtlFreeHeap( virtual_heap, 0, range );
+    }
+    /* fall back to scanning the views list */
+    WARN( "out of memory for free ranges\n" );
+    wine_rb_destroy( &free_ranges_tree, free_range_entry, NULL );
+    free_ranges_valid = FALSE;
+}
+
+
+/***********************************************************************
+ *           free_ranges_remove
+ *
+ * Remove a free range. The csVirtual section must be held by caller.
+ */
+static void free_ranges_remove( void *base, void *end )
+{
+    struct wine_rb_entry *entry;
+    struct range_entry *range;
+
+    if (!free_ranges_valid || base >= end) return;
+    entry = wine_rb_get( &free_ranges_tree, base );
+    assert( entry );
+    range = WINE_RB_ENTRY_VALUE( entry, struct range_entry, tree_entry );
+    assert( range->base == base && range->end == end );
+    wine_rb_remove( &free_ranges_tree, base );
+    RtlFreeHeap( virtual_heap, 0, range );
+}
+
+
+/* start of the free range following a view */
+static inline void *free_range_start( const struct file_view *view )
+{
+    void *end;
+
+    if (!view) return NULL;
+    end = (char *)view->base + view->size;
+    if ((UINT_PTR)end & granularity_mask)
+    {
+        void *ret = ROUND_ADDR( (char *)end + granularity_mask, granularity_mask );
+        return ret > end ? ret : (void *)~(UINT_PTR)0;
+    }
+    return end;
+}
+
+/* end of the free range preceding a view */
+static inline void *free_range_end( const struct file_view *view )
+{
+    return view ? view->base : (void *)~(UINT_PTR)0;
+}
+
+
+/***********************************************************************
+ *           free_ranges_add_view
+ *
+ * Split the free range around a view that has just been inserted.
+ * The csVirtual section must be held by caller.
+ */
+static void free_ranges_add_view( struct file_view *view )
+{
+    struct list *ptr;
+    struct file_view *prev = NULL, *next = NULL;
+
+    if ((ptr = list_prev( &views_list, &view->entry ))) prev = LIST_ENTRY( ptr, struct file_view, entry );
+    if ((ptr = list_next( &views_list, &view->entry ))) next = LIST_ENTRY( ptr, struct file_view, entry );
+
+    free_ranges_remove( free_range_start( prev ), free_range_end( next ));
+    free_ranges_insert( free_range_start( prev ), free_range_end( view ));
+    free_ranges_insert( free_range_start( view ), free_range_end( next ));
+}
+
+
+/***********************************************************************
+ *           free_ranges_remove_view
+ *
+ * Merge the free ranges around a view that is about to be removed.
+ * The csVirtual section must be held by caller.
+ */
+static void free_ranges_remove_view( struct file_view *view )
+{
+    struct list *ptr;
+    struct file_view *prev = NULL, *next = NULL;
+
+    if ((ptr = list_prev( &views_list, &view->entry ))) prev = LIST_ENTRY( ptr, struct file_view, entry );
+    if ((ptr = list_next( &views_list, &view->entry ))) next = LIST_ENTRY( ptr, struct file_view, entry );
+
+    free_ranges_remove( free_range_start( prev ), free_range_end( view ));
+    free_ranges_remove( free_range_start( view ), free_range_end( next ));
+    free_ranges_insert( free_range_start( prev ), free_range_end( next ));
+}
+
+
+/***********************************************************************
+ *           find_free_range
+ *
+ * Find a free area using the free ranges, for granularity-aligned allocations.
+ * The csVirtual section must be held by caller.
+ */
+static void *find_free_range( void *base, void *end, size_t size, size_t mask, int top_down )
+{
+    struct range_entry *range;
+    void *start, *range_end;
+
+    if (top_down)
+    {
+        for (range = free_ranges_before( end ); range; range = free_ranges_before( range->base ))
+        {
+            if ((char *)range->end <= (char *)base) break;
+            range_end = min( range->end, end );
+            if ((char *)range_end - (char *)range->base < size) continue;
+            start = ROUND_ADDR( (char *)range_end - size, mask );
+            if (start < range->base) continue;
+            return start >= base ? start : NULL;
+        }
+    }
+    else
     {
-        if ((const char *)view->base >= (const char *)addr + size) break;
-        if ((const char *)view->base + view->size > (const char *)addr) return view;
+        for (range = free_ranges_lower_bound( base ); range; range = free_ranges_lower_bound( range->end ))
+        {
+            if (range->base >= end) break;
+            start = ROUND_ADDR( (char *)max( range->base, base ) + mask, mask );
+            if (start < base) break;  /* overflow */
+            range_end = min( range->end, end );
+            if (start < range_end && (char *)range_end - (char *)start >= size) return start;
+        }
     }
     return NULL;
 }
@@ -307,17 +631,22 @@ static struct file_view *find_view_range( const void *addr, size_t size )
  */
 static void *find_free_area( void *base, void *end, size_t size, size_t mask, int top_down )
 {
+    struct file_view *view;
     struct list *ptr;
     void *start;
 
+    if (free_ranges_valid && mask >= granularity_mask)
+        return find_free_range( base, end, size, mask, top_down );
+
     if (top_down)
     {
         start = ROUND_ADDR( (char *)end - size, mask );
         if (start >= end || start < base) return NULL;
 
-        for (ptr = views_list.prev; ptr != &views_list; ptr = ptr->prev)
+        if (!(view = find_view_before( (char *)start + size ))) return start;
+        for (ptr = &view->entry; ptr; ptr = list_prev( &views_list, ptr ))
         {
-            struct file_view *view = LIST_ENTRY( ptr, struct file_view, entry );
+            view = LIST_ENTRY( ptr, struct file_view, entry );
 
             if ((char *)view->base + view->size <= (char *)start) break;
             if ((char *)view->base >= (char *)start + size) continue;
@@ -331,9 +660,10 @@ static void *find_free_area( void *base, void *end, size_t size, size_t mask, in
         start = ROUND_ADDR( (char *)base + mask, mask );
         if (start >= end || (char *)end - (char *)start < size) return NULL;
 
-        for (ptr = views_list.next; ptr != &views_list; ptr = ptr->next)
+        if (!(view = find_view_after( start ))) return start;
+        for (ptr = &view->entry; ptr; ptr = list_next( &views_list, ptr ))
         {
-            struct file_view *view = LIST_ENTRY( ptr, struct file_view, entry );
+            view = LIST_ENTRY( ptr, struct file_view, entry );
 
             if ((char *)view->base >= (char *)start + size) break;
             if ((char *)view->base + view->size <= (char *)start) continue;
@@ -379,13 +709,16 @@ static void add_reserved_area( void *addr, size_t size )
 static void remove_reserved_area( void *addr, size_t size )
 {
     struct file_view *view;
+    struct list *ptr;
 
     TRACE( "removing %p-%p\n", addr, (char *)addr + size );
     wine_mmap_remove_reserved_area( addr, size, 0 );
 
     /* unmap areas not covered by an existing view */
-    LIST_FOR_EACH_ENTRY( view, &views_list, struct file_view, entry )
+    view = find_view_after( addr );
+    for (ptr = view ? &view->entry : NULL; ptr; ptr = list_next( &views_list, ptr ))
     {
+        view = LIST_ENTRY( ptr, struct file_view, entry );
         if ((char *)view->base >= (char *)addr + size)
         {
             munmap( addr, size );
@@ -436,6 +769,8 @@ static inline void unmap_area( void *addr, size_t size )
 static void delete_view( struct file_view *view ) /* [in] View */
 {
     if (!(view->protect & VPROT_SYSTEM)) unmap_area( view->base, view->size );
+    free_ranges_remove_view( view );
+    wine_rb_remove( &views_tree, view->base );
     list_remove( &view->entry );
     if (view->mapping) close_handle( view->mapping );
     RtlFreeHeap( virtual_heap, 0, view );
@@ -449,13 +784,33 @@ static void delete_view( struct file_view *view ) /* [in] View */
  */
 static NTSTATUS create_view( struct file_view **view_ret, void *base, size_t size, unsigned int vprot )
 {
-    struct file_view *view;
-    struct list *ptr;
+    struct file_view *view, *prev, *next;
     int unix_prot = VIRTUAL_GetUnixProt( vprot );
 
     assert( !((UINT_PTR)base & page_mask) );
     assert( !(size & page_mask) );
 
+    /* Check for overlapping views. This can happen if the previous view
+     * was a system view that got unmapped behind our back. In that case
+     * we recover by simply deleting it. */
+
+    if ((prev = find_view_after( base )) && prev->base < base)
+    {
+        TRACE( "overlapping prev view %p-%p for %p-%p\n",
+               prev->base, (char *)prev->base + prev->size,
+               base, (char *)base + size );
+        assert( prev->protect & VPROT_SYSTEM );
+        delete_view( prev );
+    }
+    if ((next = find_view_range( base, size )))
+    {
+        TRACE( "overlapping next view %p-%p for %p-%p\n",
+               next->base, (char *)next->base + next->size,
+               base, (char *)base + size );
+        assert( next->protect & VPROT_SYSTEM );
+        delete_view( next );
+    }
+
     /* Create the view structure */
 
     if (!(view = RtlAllocateHeap( virtual_heap, 0, sizeof(*view) + (size >> page_shift) - 1 )))
@@ -471,43 +826,17 @@ static NTSTATUS create_view( struct file_view **view_ret, void *base, size_t siz
     view->protect = vprot;
     memset( view->prot, vprot, size >> page_shift );
 
-    /* Insert it in the linked list */
-
-    LIST_FOR_EACH( ptr, &views_list )
-    {
-        struct file_view *next = LIST_ENTRY( ptr, struct file_view, entry );
-        if (next->base > base) break;
-    }
-    list_add_before( ptr, &view->entry );
+    /* Insert it in the tree and the sorted list */
 
-    /* Check for overlapping views. This can happen if the previous view
-     * was a system view that got unmapped behind our back. In that case
-     * we recover by simply deleting it. */
-
-    if ((ptr = list_prev( &views_list, &view->entry )) != NULL)
-    {
-        struct file_view *prev = LIST_ENTRY( ptr, struct file_view, entry );
-        if ((char *)prev->base + prev->size > (char *)base)
-        {
-            TRACE( "overlapping prev view %p-%p for %p-%p\n",
-                   prev->base, (char *)prev->base + prev->size,
-                   base, (char *)base + view->size );
-            assert( prev->protect & VPROT_SYSTEM );
-            delete_view( prev );
-        }
-    }
-    if ((ptr = list_next( &views_list, &view->entry )) != NULL)
+    if (wine_rb_put( &views_tree, base, &view->tree_entry ))
     {
-        struct file_view *next = LIST_ENTRY( ptr, struct file_view, entry );
-        if ((char *)base + view->size > (char *)next->base)
-        {
-            TRACE( "overlapping next view %p-%p for %p-%p\n",
-                   next->base, (char *)next->base + next->size,
-                   base, (char *)base + view->size );
-            assert( next->protect & VPROT_SYSTEM );
-            delete_view( next );
-        }
+        FIXME( "out of memory in virtual heap for %p-%p\n", base, (char *)base + size );
+        RtlFreeHeap( virtual_heap, 0, view );
+        return STATUS_NO_MEMORY;
     }
+    if ((prev = find_view_before( base ))) list_add_after( &prev->entry, &view->entry );
+    else list_add_head( &views_list, &view->entry );
+    free_ranges_add_view( view );
 
     *view_ret = view;
     VIRTUAL_DEBUG_DUMP_VIEW( view );
@@ -1333,6 +1662,13 @@ void virtual_init(void)
     assert( heap_base != (void *)-1 );
     virtual_heap = RtlCreateHeap( HEAP_NO_SERIALIZE, heap_base, VIRTUAL_HEAP_SIZE,
                                   VIRTUAL_HEAP_SIZE, NULL, NULL );
+    if (wine_rb_init( &views_tree, &views_tree_functions ))
+    {
+        ERR( "cannot initialize the views tree\n" );
+        exit(1);
+    }
+    if (!wine_rb_init( &free_ranges_tree, &free_ranges_tree_functions )) free_ranges_valid = TRUE;
+    free_ranges_insert( NULL, (void *)~(UINT_PTR)0 );
     create_view( &heap_view, heap_base, VIRTUAL_HEAP_SIZE, VPROT_COMMITTED | VPROT_READ | VPROT_WRITE );
 
     /* make the DOS area accessible (except the low 64K) to hide bugs in broken apps like Excel 2003 */
@@ -2297,30 +2633,21 @@ NTSTATUS WINAPI NtQueryVirtualMemory( HANDLE process, LPCVOID addr,
     /* Find the view containing the address */
 
     server_enter_uninterrupted_section( &csVirtual, &sigset );
-    ptr = list_head( &views_list );
-    for (;;)
+    if ((view = find_view_after( base )) && (char *)view->base <= base)
     {
-        if (!ptr)
-        {
-            size = (char *)working_set_limit - alloc_base;
-            view = NULL;
-            break;
-        }
-        view = LIST_ENTRY( ptr, struct file_view, entry );
-        if ((char *)view->base > base)
-        {
-            size = (char *)view->base - alloc_base;
-            view = NULL;
-            break;
-        }
-        if ((char *)view->base + view->size > base)
+        alloc_base = view->base;
+        size = view->size;
+    }
+    else
+    {
+        ptr = view ? list_prev( &views_list, &view->entry ) : list_tail( &views_list );
+        if (ptr)
         {
-            alloc_base = view->base;
-            size = view->size;
-            break;
+            struct file_view *prev = LIST_ENTRY( ptr, struct file_view, entry );
+            alloc_base = (char *)prev->base + prev->size;
         }
-        alloc_base = (char *)view->base + view->size;
-        ptr = list_next( &views_list, ptr );
+        size = (view ? (char *)view->base : (char *)working_set_limit) - alloc_base;
+        view = NULL;
     }
 
     /* Fill the info structure */
@@ -61,6 +61,9 @@
 #ifdef HAVE_SYS_WAIT_H
 # include <sys/wait.h>
 #endif
+#ifdef HAVE_SYS_SENDFILE_H
+# include <sys/sendfile.h>
+#endif
 #ifdef HAVE_SYS_UIO_H
 # include <sys/uio.h>
 #endif
@@ -521,7 +524,7 @@ struct ws2_accept_async
 struct ws2_transmitfile_async
 {
     struct ws2_async_io   io;
-    char                  *buffer;
+    char                  *buffer;       /* bounce buffer, only allocated when the file has to be read */
     HANDLE                file;
     DWORD                 file_read;
     DWORD                 file_bytes;
@@ -529,7 +532,8 @@ struct ws2_transmitfile_async
     TRANSMIT_FILE_BUFFERS buffers;
     DWORD                 flags;
     LARGE_INTEGER         offset;
-    struct ws2_async      write;
+    BOOL                  use_sendfile;  /* send the file directly from its unix fd */
+    struct ws2_async      write;         /* must be last, has room for two iovecs */
 };
 
 static struct ws2_async_io *async_io_freelist;
@@ -590,8 +594,32 @@ struct per_thread_data
     int se_len;
     int pe_len;
     char ntoa_buffer[16]; /* 4*3 digits + 3 '.' + 1 '\0' */
+    struct pollfd *poll_fds;  /* poll array reused by select and WSAPoll */
+    unsigned int poll_fds_size;
+    struct poll_cache_entry *poll_cache;  /* state of the sockets passed to select */
+    unsigned int poll_cache_mask;
+    LONG poll_cache_serial;   /* value of sockets_serial when the cache was filled */
 };
 
+/* socket state that doesn't need to be queried again on every select call */
+struct poll_cache_entry
+{
+    SOCKET       sock;
+    int          fd;
+    unsigned int flags;
+};
+
+#define POLL_CACHE_BOUND      0x01  /* socket is known to be bound */
+#define POLL_CACHE_TYPE_KNOWN 0x02  /* socket type has been checked */
+#define POLL_CACHE_DGRAM      0x04  /* socket is a datagram socket */
+
+#define POLL_CACHE_MAX_SIZE   65536
+
+/* incremented whenever the cached select state may belong to another socket: on every
+ * socket creation, since the handle and fd of a socket closed with CloseHandle may get
+ * reused, on every closesocket, and when a socket passed to select is no longer valid */
+static LONG sockets_serial;
+
 /* internal: routing description information */
 struct route {
     struct in_addr addr;
@@ -1170,6 +1198,8 @@ static void free_per_thread_data(void)
     HeapFree( GetProcessHeap(), 0, ptb->he_buffer );
     HeapFree( GetProcessHeap(), 0, ptb->se_buffer );
     HeapFree( GetProcessHeap(), 0, ptb->pe_buffer );
+    HeapFree( GetProcessHeap(), 0, ptb->poll_fds );
+    HeapFree( GetProcessHeap(), 0, ptb->poll_cache );
     ptb->he_buffer = NULL;
     ptb->se_buffer = NULL;
     ptb->pe_buffer = NULL;
@@ -2653,6 +2683,7 @@ SOCKET WINAPI WS_accept(SOCKET s, struct WS_sockaddr *addr, int *addrlen32)
         SERVER_END_REQ;
         if (!status)
         {
+            InterlockedIncrement( &sockets_serial );
             if (addr && WS_getpeername(as, addr, addrlen32))
             {
                 WS_closesocket(as);
@@ -2853,6 +2884,14 @@ static NTSTATUS WS2_transmitfile_getbuffer( int fd, struct ws2_transmitfile_asyn
         wsa->write.iovec[0].iov_base = wsa->buffers.Head;
         wsa->write.iovec[0].iov_len  = wsa->buffers.HeadLength;
         wsa->buffers.Head            = NULL;
+        /* without any file data in between, the footer can go out with the header */
+        if (!wsa->file && wsa->buffers.Tail)
+        {
+            wsa->write.n_iovecs          = 2;
+            wsa->write.iovec[1].iov_base = wsa->buffers.Tail;
+            wsa->write.iovec[1].iov_len  = wsa->buffers.TailLength;
+            wsa->buffers.Tail            = NULL;
+        }
         return STATUS_PENDING;
     }
 
@@ -2863,6 +2902,12 @@ static NTSTATUS WS2_transmitfile_getbuffer( int fd, struct ws2_transmitfile_asyn
         IO_STATUS_BLOCK iosb;
         NTSTATUS status;
 
+        /* the data is sent by WS2_transmitfile_sendfile */
+        if (wsa->use_sendfile) return STATUS_PENDING;
+
+        if (!wsa->buffer && !(wsa->buffer = HeapAlloc( GetProcessHeap(), 0, wsa->bytes_per_send )))
+            return STATUS_NO_MEMORY;
+
         iosb.Information = 0;
         /* when the size of the transfer is limited ensure that we don't go past that limit */
         if (wsa->file_bytes != 0)
@@ -2906,6 +2951,63 @@ static NTSTATUS WS2_transmitfile_getbuffer( int fd, struct ws2_transmitfile_asyn
     return STATUS_SUCCESS;
 }
 
+/***********************************************************************
+ *     WS2_transmitfile_sendfile        (INTERNAL)
+ *
+ * Send the next chunk of the main file without copying it through a buffer.
+ */
+static NTSTATUS WS2_transmitfile_sendfile( int fd, struct ws2_transmitfile_async *wsa )
+{
+#ifdef HAVE_SYS_SENDFILE_H
+    IO_STATUS_BLOCK *iosb = (IO_STATUS_BLOCK *)wsa->write.user_overlapped;
+    DWORD bytes_per_send = wsa->bytes_per_send;
+    NTSTATUS status;
+    ssize_t ret;
+    off_t offset;
+    int file_fd;
+
+    status = wine_server_handle_to_fd( wsa->file, FILE_READ_DATA, &file_fd, NULL );
+    if (status) return status;
+
+    /* when the size of the transfer is limited ensure that we don't go past that limit */
+    if (wsa->file_bytes != 0)
+        bytes_per_send = min(bytes_per_send, wsa->file_bytes - wsa->file_read);
+    do
+    {
+        if (wsa->offset.QuadPart != FILE_USE_FILE_POINTER_POSITION)
+        {
+            offset = wsa->offset.QuadPart;
+            ret = sendfile( fd, file_fd, &offset, bytes_per_send );
+        }
+        else
+            ret = sendfile( fd, file_fd, NULL, bytes_per_send );
+    }
+    while (ret == -1 && errno == EINTR);
+    wine_server_release_fd( wsa->file, file_fd );
+
+    TRACE( "sent %ld bytes from %p\n", (long)ret, wsa->file );
+    if (ret > 0)
+    {
+        if (wsa->offset.QuadPart != FILE_USE_FILE_POINTER_POSITION)
+            wsa->offset.QuadPart += ret;
+        wsa->file_read += ret;
+        if (iosb) iosb->Information += ret;
+        if (wsa->file_bytes != 0 && wsa->file_read >= wsa->file_bytes)
+            wsa->file = NULL;
+    }
+    else if (!ret)
+        wsa->file = NULL; /* continue on to the footer */
+    else if (errno == EINVAL || errno == ENOSYS)
+        wsa->use_sendfile = FALSE; /* not supported for this file, fall back to reading it */
+    else if (errno != EAGAIN)
+        return wsaErrStatus();
+    return STATUS_PENDING;
+#else
+    wsa->use_sendfile = FALSE;
+    return STATUS_PENDING;
+#endif
+}
+
 /***********************************************************************
  *     WS2_transmitfile_base            (INTERNAL)
  *
@@ -2921,6 +3023,9 @@ static NTSTATUS WS2_transmitfile_base( int fd, struct ws2_transmitfile_async *ws
         IO_STATUS_BLOCK *iosb = (IO_STATUS_BLOCK *)wsa->write.user_overlapped;
         int n;
 
+        if (wsa->use_sendfile && wsa->file && wsa->write.first_iovec == wsa->write.n_iovecs)
+            return WS2_transmitfile_sendfile( fd, wsa );
+
         n = WS2_send( fd, &wsa->write, convert_flags(wsa->write.flags) );
         if (n >= 0)
         {
@@ -2956,6 +3061,7 @@ static NTSTATUS WS2_async_transmitfile( void *user, IO_STATUS_BLOCK *iosb,
     }
 
     iosb->u.Status = status;
+    HeapFree( GetProcessHeap(), 0, wsa->buffer );
     release_async_io( &wsa->io );
     return status;
 }
@@ -2971,7 +3077,7 @@ static BOOL WINAPI WS2_TransmitFile( SOCKET s, HANDLE h, DWORD file_bytes, DWORD
     unsigned int uaddrlen = sizeof(uaddr);
     struct ws2_transmitfile_async *wsa;
     NTSTATUS status;
-    int fd;
+    int fd, file_fd;
 
     TRACE("(%lx, %p, %d, %d, %p, %p, %d)\n", s, h, file_bytes, bytes_per_send, overlapped,
             buffers, flags );
@@ -3003,7 +3109,8 @@ static BOOL WINAPI WS2_TransmitFile( SOCKET s, HANDLE h, DWORD file_bytes, DWORD
     if (!bytes_per_send)
         bytes_per_send = (1 << 16); /* Depends on OS version: PAGE_SIZE, 2*PAGE_SIZE, or 2^16 */
 
-    if (!(wsa = (struct ws2_transmitfile_async *)alloc_async_io( sizeof(*wsa) + bytes_per_send )))
+    if (!(wsa = (struct ws2_transmitfile_async *)alloc_async_io( offsetof(struct ws2_transmitfile_async,
+                                                                          write.iovec[2]) )))
     {
         release_sock_fd( s, fd );
         WSASetLastError( WSAEFAULT );
@@ -3013,13 +3120,14 @@ static BOOL WINAPI WS2_TransmitFile( SOCKET s, HANDLE h, DWORD file_bytes, DWORD
         wsa->buffers = *buffers;
     else
         memset(&wsa->buffers, 0x0, sizeof(wsa->buffers));
-    wsa->buffer                = (char *)(wsa + 1);
+    wsa->buffer                = NULL;
     wsa->file                  = h;
     wsa->file_read             = 0;
     wsa->file_bytes            = file_bytes;
     wsa->bytes_per_send        = bytes_per_send;
     wsa->flags                 = flags;
     wsa->offset.QuadPart       = FILE_USE_FILE_POINTER_POSITION;
+    wsa->use_sendfile          = FALSE;
     wsa->write.hSocket         = SOCKET2HANDLE(s);
     wsa->write.addr            = NULL;
     wsa->write.addrlen.val     = 0;
@@ -3029,6 +3137,12 @@ static BOOL WINAPI WS2_TransmitFile( SOCKET s, HANDLE h, DWORD file_bytes, DWORD
     wsa->write.n_iovecs        = 0;
     wsa->write.first_iovec     = 0;
     wsa->write.user_overlapped = overlapped;
+    /* only handles without a unix fd need to go through the buffer */
+    if (h && !wine_server_handle_to_fd( h, FILE_READ_DATA, &file_fd, NULL ))
+    {
+        wsa->use_sendfile = TRUE;
+        wine_server_release_fd( h, file_fd );
+    }
     if (overlapped)
     {
         IO_STATUS_BLOCK *iosb = (IO_STATUS_BLOCK *)overlapped;
@@ -3071,6 +3185,7 @@ static BOOL WINAPI WS2_TransmitFile( SOCKET s, HANDLE h, DWORD file_bytes, DWORD
 
     if (status != STATUS_SUCCESS)
         WSASetLastError( NtStatusToWSAError(status) );
+    HeapFree( GetProcessHeap(), 0, wsa->buffer );
     HeapFree( GetProcessHeap(), 0, wsa );
     return (status == STATUS_SUCCESS);
 }
@@ -3320,6 +3435,7 @@ int WINAPI WS_closesocket(SOCKET s)
         if (fd >= 0)
         {
             release_sock_fd(s, fd);
+            InterlockedIncrement( &sockets_serial );
             if (CloseHandle(SOCKET2HANDLE(s)))
                 res = 0;
         }
@@ -5040,10 +5156,90 @@ int WINAPI WS_recvfrom(SOCKET s, char *buf, INT len, int flags,
         return n;
 }
 
-/* allocate a poll array for the corresponding fd sets */
+/* get a poll array from the per-thread data, growing it if needed */
+static struct pollfd *get_poll_array( unsigned int count )
+{
+    struct per_thread_data *ptb = get_per_thread_data();
+    struct pollfd *fds;
+
+    if (count <= ptb->poll_fds_size) return ptb->poll_fds;
+
+    if (ptb->poll_fds)
+        fds = HeapReAlloc( GetProcessHeap(), 0, ptb->poll_fds, count * sizeof(fds[0]) );
+    else
+        fds = HeapAlloc( GetProcessHeap(), 0, count * sizeof(fds[0]) );
+    if (!fds) return NULL;
+    ptb->poll_fds = fds;
+    ptb->poll_fds_size = count;
+    return fds;
+}
+
+/* find the cached state of a socket for select, resetting it if the fd changed */
+static struct poll_cache_entry *get_poll_cache_entry( struct per_thread_data *ptb, SOCKET s, int fd )
+{
+    struct poll_cache_entry *entry;
+
+    if (!ptb->poll_cache) return NULL;
+    entry = &ptb->poll_cache[(s >> 2) & ptb->poll_cache_mask];
+    if (entry->sock != s || entry->fd != fd)
+    {
+        entry->sock  = s;
+        entry->fd    = fd;
+        entry->flags = 0;
+    }
+    return entry;
+}
+
+/* make sure the select cache can hold count sockets, and flush it if sockets have changed */
+static void init_poll_cache( struct per_thread_data *ptb, unsigned int count )
+{
+    LONG serial = sockets_serial;
+    unsigned int size = 64;
+
+    while (size < 2 * count && size < POLL_CACHE_MAX_SIZE) size *= 2;
+
+    if (ptb->poll_cache && size <= ptb->poll_cache_mask + 1)
+    {
+        if (ptb->poll_cache_serial != serial)
+            memset( ptb->poll_cache, 0, (ptb->poll_cache_mask + 1) * sizeof(*ptb->poll_cache) );
+    }
+    else
+    {
+        HeapFree( GetProcessHeap(), 0, ptb->poll_cache );
+        ptb->poll_cache_mask = 0;
+        if (!(ptb->poll_cache = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY, size * sizeof(*ptb->poll_cache) )))
+            return;
+        ptb->poll_cache_mask = size - 1;
+    }
+    ptb->poll_cache_serial = serial;
+}
+
+/* check if a socket is bound, remembering the answer once it is */
+static BOOL is_poll_fd_bound( struct poll_cache_entry *entry, int fd )
+{
+    if (entry && (entry->flags & POLL_CACHE_BOUND)) return TRUE;
+    if (is_fd_bound( fd, NULL, NULL ) != 1) return FALSE;
+    if (entry) entry->flags |= POLL_CACHE_BOUND;
+    return TRUE;
+}
+
+/* check if a socket is a datagram socket, remembering the answer */
+static BOOL is_poll_fd_dgram( struct poll_cache_entry *entry, int fd )
+{
+    if (!entry) return _get_fd_type( fd ) == SOCK_DGRAM;
+    if (!(entry->flags & POLL_CACHE_TYPE_KNOWN))
+    {
+        entry->flags |= POLL_CACHE_TYPE_KNOWN;
+        if (_get_fd_type( fd ) == SOCK_DGRAM) entry->flags |= POLL_CACHE_DGRAM;
+    }
+    return (entry->flags & POLL_CACHE_DGRAM) != 0;
+}
+
+/* fill the per-thread poll array for the corresponding fd sets */
 static struct pollfd *fd_sets_to_poll( const WS_fd_set *readfds, const WS_fd_set *writefds,
                                        const WS_fd_set *exceptfds, int *count_ptr )
 {
+    struct per_thread_data *ptb = get_per_thread_data();
     unsigned int i, j = 0, count = 0;
     struct pollfd *fds;
 
@@ -5056,18 +5252,19 @@ static struct pollfd *fd_sets_to_poll( const WS_fd_set *readfds, const WS_fd_set
         SetLastError(WSAEINVAL);
         return NULL;
     }
-    if (!(fds = HeapAlloc( GetProcessHeap(), 0, count * sizeof(fds[0]))))
+    if (!(fds = get_poll_array( count )))
     {
         SetLastError( ERROR_NOT_ENOUGH_MEMORY );
         return NULL;
     }
+    init_poll_cache( ptb, count );
     if (readfds)
         for (i = 0; i < readfds->fd_count; i++, j++)
         {
             fds[j].fd = get_sock_fd( readfds->fd_array[i], FILE_READ_DATA, NULL );
             if (fds[j].fd == -1) goto failed;
             fds[j].revents = 0;
-            if (is_fd_bound(fds[j].fd, NULL, NULL) == 1)
+            if (is_poll_fd_bound( get_poll_cache_entry( ptb, readfds->fd_array[i], fds[j].fd ), fds[j].fd ))
             {
                 fds[j].events = POLLIN;
             }
@@ -5081,11 +5278,13 @@ static struct pollfd *fd_sets_to_poll( const WS_fd_set *readfds, const WS_fd_set
     if (writefds)
         for (i = 0; i < writefds->fd_count; i++, j++)
         {
+            struct poll_cache_entry *entry;
+
             fds[j].fd = get_sock_fd( writefds->fd_array[i], FILE_WRITE_DATA, NULL );
             if (fds[j].fd == -1) goto failed;
             fds[j].revents = 0;
-            if (is_fd_bound(fds[j].fd, NULL, NULL) == 1 ||
-                _get_fd_type(fds[j].fd) == SOCK_DGRAM)
+            entry = get_poll_cache_entry( ptb, writefds->fd_array[i], fds[j].fd );
+            if (is_poll_fd_bound( entry, fds[j].fd ) || is_poll_fd_dgram( entry, fds[j].fd ))
             {
                 fds[j].events = POLLOUT;
             }
@@ -5102,7 +5301,7 @@ static struct pollfd *fd_sets_to_poll( const WS_fd_set *readfds, const WS_fd_set
             fds[j].fd = get_sock_fd( exceptfds->fd_array[i], 0, NULL );
             if (fds[j].fd == -1) goto failed;
             fds[j].revents = 0;
-            if (is_fd_bound(fds[j].fd, NULL, NULL) == 1)
+            if (is_poll_fd_bound( get_poll_cache_entry( ptb, exceptfds->fd_array[i], fds[j].fd ), fds[j].fd ))
             {
                 int oob_inlined = 0;
                 socklen_t olen = sizeof(oob_inlined);
@@ -5124,6 +5323,8 @@ static struct pollfd *fd_sets_to_poll( const WS_fd_set *readfds, const WS_fd_set
     return fds;
 
 failed:
+    /* the socket may have been closed with CloseHandle, don't trust the cache anymore */
+    InterlockedIncrement( &sockets_serial );
     count = j;
     j = 0;
     if (readfds)
@@ -5135,7 +5336,6 @@ failed:
     if (exceptfds)
         for (i = 0; i < exceptfds->fd_count && j < count; i++, j++)
             if (fds[j].fd != -1) release_sock_fd( exceptfds->fd_array[i], fds[j].fd );
-    HeapFree( GetProcessHeap(), 0, fds );
     return NULL;
 }
 
@@ -5268,7 +5468,6 @@ int WINAPI WS_select(int nfds, WS_fd_set *ws_readfds,
 
     if (ret == -1) SetLastError(wsaErrno());
     else ret = get_poll_results( ws_readfds, ws_writefds, ws_exceptfds, pollfds );
-    HeapFree( GetProcessHeap(), 0, pollfds );
     return ret;
 }
 
@@ -5291,7 +5490,7 @@ int WINAPI WSAPoll(WSAPOLLFD *wfds, ULONG count, int timeout)
         return SOCKET_ERROR;
     }
 
-    if (!(ufds = HeapAlloc(GetProcessHeap(), 0, count * sizeof(ufds[0]))))
+    if (!(ufds = get_poll_array(count)))
     {
         SetLastError(WSAENOBUFS);
         return SOCKET_ERROR;
@@ -5317,7 +5516,6 @@ int WINAPI WSAPoll(WSAPOLLFD *wfds, ULONG count, int timeout)
             wfds[i].revents = WS_POLLNVAL;
     }
 
-    HeapFree(GetProcessHeap(), 0, ufds);
     return ret;
 }
 
@@ -7029,6 +7227,7 @@ SOCKET WINAPI WSASocketW(int af, int type, int protocol,
     /* hack for WSADuplicateSocket */
     if (lpProtocolInfo && lpProtocolInfo->dwServiceFlags4 == 0xff00ff00) {
       ret = lpProtocolInfo->dwServiceFlags3;
+      InterlockedIncrement( &sockets_serial );
       TRACE("\tgot duplicate %04lx\n", ret);
       return ret;
     }
@@ -7127,6 +7326,7 @@ SOCKET WINAPI WSASocketW(int af, int type, int protocol,
     SERVER_END_REQ;
     if (ret)
     {
+        InterlockedIncrement( &sockets_serial );
         TRACE("\tcreated %04lx\n", ret );
         if (ipxptype > 0)
             set_ipx_packettype(ret, ipxptype);
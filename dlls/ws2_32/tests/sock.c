@@ -3957,6 +3957,73 @@ todo_wine
 #undef FD_SET_ALL
 #undef FD_ZERO_ALL
 
+static void test_select_repeated(void)
+{
+    SOCKET src[32], dst[32], sock;
+    struct timeval select_timeout;
+    fd_set readfds;
+    unsigned int i, j;
+    char buffer;
+    int ret;
+
+    for (i = 0; i < 32; i++)
+    {
+        if (tcp_socketpair(&src[i], &dst[i]))
+        {
+            skip("failed to create socket pair %u\n", i);
+            while (i--)
+            {
+                closesocket(src[i]);
+                closesocket(dst[i]);
+            }
+            return;
+        }
+    }
+
+    /* the same set only reports the socket that has data */
+    for (i = 0; i < 32; i++)
+    {
+        ret = send(src[i], "x", 1, 0);
+        ok(ret == 1, "send failed, error %d\n", WSAGetLastError());
+        select_timeout.tv_sec = 0;
+        select_timeout.tv_usec = 100000;
+        FD_ZERO(&readfds);
+        for (j = 0; j < 32; j++) FD_SET(dst[j], &readfds);
+        ret = select(0, &readfds, NULL, NULL, &select_timeout);
+        ok(ret == 1, "%u: expected 1, got %d\n", i, ret);
+        ok(FD_ISSET(dst[i], &readfds), "%u: socket is not in the set\n", i);
+        ret = recv(dst[i], &buffer, 1, 0);
+        ok(ret == 1, "recv failed, error %d\n", WSAGetLastError());
+    }
+
+    /* a new unbound socket that may reuse a closed handle is not readable */
+    closesocket(dst[0]);
+    sock = socket(AF_INET, SOCK_STREAM, 0);
+    ok(sock != INVALID_SOCKET, "socket failed, error %d\n", WSAGetLastError());
+    dst[0] = sock;
+    select_timeout.tv_usec = 0;
+    FD_ZERO(&readfds);
+    for (j = 0; j < 32; j++) FD_SET(dst[j], &readfds);
+    ret = select(0, &readfds, NULL, NULL, &select_timeout);
+    ok(ret == 0, "expected 0, got %d\n", ret);
+
+    /* same thing with a socket closed behind the back of ws2_32 */
+    CloseHandle((HANDLE)dst[1]);
+    sock = socket(AF_INET, SOCK_STREAM, 0);
+    ok(sock != INVALID_SOCKET, "socket failed, error %d\n", WSAGetLastError());
+    dst[1] = sock;
+    FD_ZERO(&readfds);
+    for (j = 0; j < 32; j++) FD_SET(dst[j], &readfds);
+    ret = select(0, &readfds, NULL, NULL, &select_timeout);
+    ok(ret == 0, "expected 0, got %d\n", ret);
+
+    for (i = 0; i < 32; i++)
+    {
+        closesocket(src[i]);
+        closesocket(dst[i]);
+    }
+}
+
 static DWORD WINAPI AcceptKillThread(void *param)
 {
     select_thread_params *par = param;
@@ -7967,6 +8034,24 @@ static void test_TransmitFile(void)
     ok(memcmp(buf, &footer_msg[0], sizeof(footer_msg)+1) == 0,
        "TransmitFile footer buffer did not match!\n");
 
+    /* Test TransmitFile with a limited size sent in small chunks */
+    total_sent = min(file_size, 100);
+    SetFilePointer(file, 0, NULL, FILE_BEGIN);
+    bret = pTransmitFile(client, file, total_sent, 16, NULL, &buffers, 0);
+    ok(bret, "TransmitFile failed unexpectedly.\n");
+    iret = recv(dest, buf, sizeof(header_msg)+1, 0);
+    ok(memcmp(buf, &header_msg[0], sizeof(header_msg)+1) == 0,
+       "TransmitFile header buffer did not match!\n");
+    iret = recv(dest, buf, total_sent, 0);
+    ok(iret == total_sent, "Returned an unexpected buffer from TransmitFile (%d != %d).\n", iret, total_sent);
+    SetFilePointer(file, 0, NULL, FILE_BEGIN);
+    bret = ReadFile(file, buf + total_sent, total_sent, &num_bytes, NULL);
+    ok(bret && num_bytes == total_sent, "Failed to read from file.\n");
+    ok(memcmp(buf, buf + total_sent, total_sent) == 0, "TransmitFile file data did not match!\n");
+    iret = recv(dest, buf, sizeof(footer_msg)+1, 0);
+    ok(memcmp(buf, &footer_msg[0], sizeof(footer_msg)+1) == 0,
+       "TransmitFile footer buffer did not match!\n");
+
     /* Test overlapped TransmitFile */
     ov.hEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
     if (ov.hEvent == INVALID_HANDLE_VALUE)
@@ -9560,6 +9645,7 @@ START_TEST( sock )
     test_errors();
     test_listen();
     test_select();
+    test_select_repeated();
     test_accept();
     test_getpeername();
     test_getsockname();
@@ -50,6 +50,48 @@ struct request_max_size
     int pad[16];
 };
 
+
+#define REQUEST_SHM_SIZE 4096
+struct request_shm
+{
+    int                     state;
+    int                     waiting;
+    struct request_max_size reply;
+    char                    data[REQUEST_SHM_SIZE - 2 * sizeof(int) - sizeof(struct request_max_size)];
+};
+#define REQUEST_SHM_DATA_SIZE (sizeof(((struct request_shm *)0)->data))
+
+#define REQUEST_SHM_IDLE     0
+#define REQUEST_SHM_PENDING  1
+#define REQUEST_SHM_REPLIED  2
+#define REQUEST_SHM_CLOSED   3
+
+
+#define REQUEST_SHM_FLAG 0x10000
+
+
+#define SYNC_SHM_SIZE 0x40000
+struct sync_shm_slot
+{
+    int          state;
+    unsigned int count;
+};
+#define SYNC_SHM_SLOTS (SYNC_SHM_SIZE / sizeof(struct sync_shm_slot))
+
+#define SYNC_SHM_SIGNALED   0x00000001
+#define SYNC_SHM_OWNER_MASK 0x3fffffff
+#define SYNC_SHM_ABANDONED  0x40000000
+#define SYNC_SHM_SERVER     0x80000000
+
+
+#define HANDLE_SHM_SIZE 0x40000
+#define HANDLE_SHM_SLOTS (HANDLE_SHM_SIZE / sizeof(unsigned int))
+
+#define HANDLE_SHM_ACCESS   0x1fffffff
+#define HANDLE_SHM_PROTECT  0x20000000
+#define HANDLE_SHM_INHERIT  0x40000000
+#define HANDLE_SHM_VALID    0x80000000
+
 #define FIRST_USER_HANDLE 0x0020
 #define LAST_USER_HANDLE  0xffef
 
@@ -808,6 +850,42 @@ struct init_thread_reply
 
 
 
+struct set_request_shm_request
+{
+    struct request_header __header;
+    int          shm_fd;
+};
+struct set_request_shm_reply
+{
+    struct reply_header __header;
+};
+
+
+
+struct set_sync_shm_request
+{
+    struct request_header __header;
+    int          shm_fd;
+};
+struct set_sync_shm_reply
+{
+    struct reply_header __header;
+};
+
+
+
+struct set_handle_shm_request
+{
+    struct request_header __header;
+    int          shm_fd;
+};
+struct set_handle_shm_reply
+{
+    struct reply_header __header;
+};
+
+
+
 struct terminate_process_request
 {
     struct request_header __header;
@@ -1167,7 +1245,7 @@ struct create_event_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
-    char __pad_12[4];
+    int          shm_idx;
 };
 
 
@@ -1259,7 +1337,7 @@ struct create_mutex_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
-    char __pad_12[4];
+    int          shm_idx;
 };
 
 
@@ -1309,7 +1387,7 @@ struct create_semaphore_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
-    char __pad_12[4];
+    int          shm_idx;
 };
 
 
@@ -1457,6 +1535,28 @@ enum server_fd_type
     FD_TYPE_NB_TYPES
 };
 
+struct handle_fd_info
+{
+    obj_handle_t handle;
+    int          type;
+    int          cacheable;
+    unsigned int access;
+    unsigned int options;
+};
+
+
+struct get_handle_fds_request
+{
+    struct request_header __header;
+    /* VARARG(handles,handles); */
+    char __pad_12[4];
+};
+struct get_handle_fds_reply
+{
+    struct reply_header __header;
+    /* VARARG(infos,handle_fd_infos); */
+};
+
 
 
 struct flush_request
@@ -5062,6 +5162,28 @@ struct remove_completion_reply
 };
 
 
+struct completion_packet
+{
+    apc_param_t   ckey;
+    apc_param_t   cvalue;
+    apc_param_t   information;
+    unsigned int  status;
+    unsigned int  __pad;
+};
+
+
+struct remove_completions_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct remove_completions_reply
+{
+    struct reply_header __header;
+    /* VARARG(packets,completion_packets); */
+};
+
+
 
 struct query_completion_request
 {
@@ -5108,6 +5230,21 @@ struct add_fd_completion_reply
 
 
 
+struct get_fd_completion_request
+{
+    struct request_header __header;
+    obj_handle_t   handle;
+};
+struct get_fd_completion_reply
+{
+    struct reply_header __header;
+    obj_handle_t   completion;
+    char __pad_12[4];
+    apc_param_t    ckey;
+};
+
+
+
 struct set_fd_disp_info_request
 {
     struct request_header __header;
@@ -5362,6 +5499,9 @@ enum request
     REQ_get_startup_info,
     REQ_init_process_done,
     REQ_init_thread,
+    REQ_set_request_shm,
+    REQ_set_sync_shm,
+    REQ_set_handle_shm,
     REQ_terminate_process,
     REQ_terminate_thread,
     REQ_get_process_info,
@@ -5400,6 +5540,7 @@ enum request
     REQ_alloc_file_handle,
     REQ_get_handle_unix_name,
     REQ_get_handle_fd,
+    REQ_get_handle_fds,
     REQ_flush,
     REQ_lock_file,
     REQ_unlock_file,
@@ -5607,9 +5748,11 @@ enum request
     REQ_open_completion,
     REQ_add_completion,
     REQ_remove_completion,
+    REQ_remove_completions,
     REQ_query_completion,
     REQ_set_completion_info,
     REQ_add_fd_completion,
+    REQ_get_fd_completion,
     REQ_set_fd_disp_info,
     REQ_set_fd_name_info,
     REQ_get_window_layered_info,
@@ -5639,6 +5782,9 @@ union generic_request
     struct get_startup_info_request get_startup_info_request;
     struct init_process_done_request init_process_done_request;
     struct init_thread_request init_thread_request;
+    struct set_request_shm_request set_request_shm_request;
+    struct set_sync_shm_request set_sync_shm_request;
+    struct set_handle_shm_request set_handle_shm_request;
     struct terminate_process_request terminate_process_request;
     struct terminate_thread_request terminate_thread_request;
     struct get_process_info_request get_process_info_request;
@@ -5677,6 +5823,7 @@ union generic_request
     struct alloc_file_handle_request alloc_file_handle_request;
     struct get_handle_unix_name_request get_handle_unix_name_request;
     struct get_handle_fd_request get_handle_fd_request;
+    struct get_handle_fds_request get_handle_fds_request;
     struct flush_request flush_request;
     struct lock_file_request lock_file_request;
     struct unlock_file_request unlock_file_request;
@@ -5884,9 +6031,11 @@ union generic_request
     struct open_completion_request open_completion_request;
     struct add_completion_request add_completion_request;
     struct remove_completion_request remove_completion_request;
+    struct remove_completions_request remove_completions_request;
     struct query_completion_request query_completion_request;
     struct set_completion_info_request set_completion_info_request;
     struct add_fd_completion_request add_fd_completion_request;
+    struct get_fd_completion_request get_fd_completion_request;
     struct set_fd_disp_info_request set_fd_disp_info_request;
     struct set_fd_name_info_request set_fd_name_info_request;
     struct get_window_layered_info_request get_window_layered_info_request;
@@ -5914,6 +6063,9 @@ union generic_reply
     struct get_startup_info_reply get_startup_info_reply;
     struct init_process_done_reply init_process_done_reply;
     struct init_thread_reply init_thread_reply;
+    struct set_request_shm_reply set_request_shm_reply;
+    struct set_sync_shm_reply set_sync_shm_reply;
+    struct set_handle_shm_reply set_handle_shm_reply;
     struct terminate_process_reply terminate_process_reply;
     struct terminate_thread_reply terminate_thread_reply;
     struct get_process_info_reply get_process_info_reply;
@@ -5952,6 +6104,7 @@ union generic_reply
     struct alloc_file_handle_reply alloc_file_handle_reply;
     struct get_handle_unix_name_reply get_handle_unix_name_reply;
     struct get_handle_fd_reply get_handle_fd_reply;
+    struct get_handle_fds_reply get_handle_fds_reply;
     struct flush_reply flush_reply;
     struct lock_file_reply lock_file_reply;
     struct unlock_file_reply unlock_file_reply;
@@ -6159,9 +6312,11 @@ union generic_reply
     struct open_completion_reply open_completion_reply;
     struct add_completion_reply add_completion_reply;
     struct remove_completion_reply remove_completion_reply;
+    struct remove_completions_reply remove_completions_reply;
     struct query_completion_reply query_completion_reply;
     struct set_completion_info_reply set_completion_info_reply;
     struct add_fd_completion_reply add_fd_completion_reply;
+    struct get_fd_completion_reply get_fd_completion_reply;
     struct set_fd_disp_info_reply set_fd_disp_info_reply;
     struct set_fd_name_info_reply set_fd_name_info_reply;
     struct get_window_layered_info_reply get_window_layered_info_reply;
@@ -6180,6 +6335,6 @@ union generic_reply
     struct terminate_job_reply terminate_job_reply;
 };
 
-#define SERVER_PROTOCOL_VERSION 492
+#define SERVER_PROTOCOL_VERSION 498
 
 #endif /* __WINE_WINE_SERVER_PROTOCOL_H */
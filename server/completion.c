@@ -253,6 +253,38 @@ DECL_HANDLER(remove_completion)
     release_object( completion );
 }
 
+/* get multiple completions from completion port */
+DECL_HANDLER(remove_completions)
+{
+    struct completion* completion = get_completion_obj( current->process, req->handle, IO_COMPLETION_MODIFY_STATE );
+    struct completion_packet *packets;
+    struct comp_msg *msg;
+    unsigned int i, count;
+
+    if (!completion) return;
+
+    count = min( completion->depth, get_reply_max_size() / sizeof(*packets) );
+    if (!count)
+        set_error( STATUS_PENDING );
+    else if ((packets = set_reply_data_size( count * sizeof(*packets) )))
+    {
+        for (i = 0; i < count; i++)
+        {
+            msg = LIST_ENTRY( list_head( &completion->queue ), struct comp_msg, queue_entry );
+            list_remove( &msg->queue_entry );
+            packets[i].ckey = msg->ckey;
+            packets[i].cvalue = msg->cvalue;
+            packets[i].status = msg->status;
+            packets[i].information = msg->information;
+            packets[i].__pad = 0;
+            free( msg );
+        }
+        completion->depth -= count;
+    }
+
+    release_object( completion );
+}
+
 /* get queue depth for completion port */
 DECL_HANDLER(query_completion)
 {
@@ -129,6 +129,7 @@ static void directory_dump( struct object *obj, int verbose )
     fputs( "Directory ", stderr );
     dump_object_name( obj );
     fputc( '\n', stderr );
+    if (verbose) dump_namespace( ((struct directory *)obj)->entries );
 }
 
 static struct object_type *directory_get_type( struct object *obj )
@@ -185,7 +186,7 @@ static void directory_destroy( struct object *obj )
 {
     struct directory *dir = (struct directory *)obj;
     assert( obj->ops == &directory_ops );
-    free( dir->entries );
+    free_namespace( dir->entries );
 }
 
 static struct directory *create_directory( struct directory *root, const struct unicode_str *name,
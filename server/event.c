@@ -38,25 +38,31 @@
 
 struct event
 {
-    struct object  obj;             /* object header */
-    int            manual_reset;    /* is it a manual reset event? */
-    int            signaled;        /* event has been signaled */
+    struct object         obj;             /* object header */
+    int                   manual_reset;    /* is it a manual reset event? */
+    struct sync_shm_slot *slot;            /* signaled state, local or in the sync shared memory */
+    struct sync_shm_slot  local;           /* local state when not using the shared memory */
+    struct sync_shm      *shm;             /* shared memory holding the state, if any */
+    int                   shm_idx;         /* index of the state in the shared memory */
 };
 
 static void event_dump( struct object *obj, int verbose );
 static struct object_type *event_get_type( struct object *obj );
+static int event_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void event_remove_queue( struct object *obj, struct wait_queue_entry *entry );
 static int event_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void event_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static unsigned int event_map_access( struct object *obj, unsigned int access );
 static int event_signal( struct object *obj, unsigned int access);
+static void event_destroy( struct object *obj );
 
 static const struct object_ops event_ops =
 {
     sizeof(struct event),      /* size */
     event_dump,                /* dump */
     event_get_type,            /* get_type */
-    add_queue,                 /* add_queue */
-    remove_queue,              /* remove_queue */
+    event_add_queue,           /* add_queue */
+    event_remove_queue,        /* remove_queue */
     event_signaled,            /* signaled */
     event_satisfied,           /* satisfied */
     event_signal,              /* signal */
@@ -67,7 +73,7 @@ static const struct object_ops event_ops =
     no_lookup_name,            /* lookup_name */
     no_open_file,              /* open_file */
     no_close_handle,           /* close_handle */
-    no_destroy                 /* destroy */
+    event_destroy              /* destroy */
 };
 
 
@@ -114,7 +120,11 @@ struct event *create_event( struct directory *root, const struct unicode_str *na
         {
             /* initialize it if it didn't already exist */
             event->manual_reset = manual_reset;
-            event->signaled     = initial_state;
+            event->slot         = &event->local;
+            event->local.state  = initial_state ? SYNC_SHM_SIGNALED : 0;
+            event->local.count  = 0;
+            event->shm          = NULL;
+            event->shm_idx      = -1;
             if (sd) default_set_sd( &event->obj, sd, OWNER_SECURITY_INFORMATION|
                                                      GROUP_SECURITY_INFORMATION|
                                                      DACL_SECURITY_INFORMATION|
@@ -124,6 +134,18 @@ struct event *create_event( struct directory *root, const struct unicode_str *na
     return event;
 }
 
+/* move the state of a new private event to the sync shared memory of the process */
+static int use_sync_shm( struct event *event, struct process *process )
+{
+    if ((event->shm_idx = alloc_sync_shm_slot( process, &event->obj, &event->shm )) != -1)
+    {
+        event->slot = get_sync_shm_slot( event->shm, event->shm_idx );
+        event->slot->state = event->local.state;
+        event->slot->count = 0;
+    }
+    return event->shm_idx;
+}
+
 struct event *get_event_obj( struct process *process, obj_handle_t handle, unsigned int access )
 {
     return (struct event *)get_handle_obj( process, handle, access, &event_ops );
@@ -131,30 +153,30 @@ struct event *get_event_obj( struct process *process, obj_handle_t handle, unsig
 
 void pulse_event( struct event *event )
 {
-    event->signaled = 1;
+    update_sync_shm_state( event->slot, 0, SYNC_SHM_SIGNALED );
     /* wake up all waiters if manual reset, a single one otherwise */
     wake_up( &event->obj, !event->manual_reset );
-    event->signaled = 0;
+    update_sync_shm_state( event->slot, SYNC_SHM_SIGNALED, 0 );
 }
 
 void set_event( struct event *event )
 {
-    event->signaled = 1;
+    update_sync_shm_state( event->slot, 0, SYNC_SHM_SIGNALED );
     /* wake up all waiters if manual reset, a single one otherwise */
     wake_up( &event->obj, !event->manual_reset );
 }
 
 void reset_event( struct event *event )
 {
-    event->signaled = 0;
+    update_sync_shm_state( event->slot, SYNC_SHM_SIGNALED, 0 );
 }
 
 static void event_dump( struct object *obj, int verbose )
 {
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
-    fprintf( stderr, "Event manual=%d signaled=%d ",
-             event->manual_reset, event->signaled );
+    fprintf( stderr, "Event manual=%d signaled=%d shm=%d ",
+             event->manual_reset, event->slot->state & SYNC_SHM_SIGNALED, event->shm_idx );
     dump_object_name( &event->obj );
     fputc( '\n', stderr );
 }
@@ -166,11 +188,25 @@ static struct object_type *event_get_type( struct object *obj )
     return get_object_type( &str );
 }
 
+static int event_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    return sync_shm_add_queue( obj, entry, event->slot );
+}
+
+static void event_remove_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    sync_shm_remove_queue( obj, entry, event->slot );
+}
+
 static int event_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
-    return event->signaled;
+    return event->slot->state & SYNC_SHM_SIGNALED;
 }
 
 static void event_satisfied( struct object *obj, struct wait_queue_entry *entry )
@@ -178,7 +214,7 @@ static void event_satisfied( struct object *obj, struct wait_queue_entry *entry
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
     /* Reset if it's an auto-reset event */
-    if (!event->manual_reset) event->signaled = 0;
+    if (!event->manual_reset) update_sync_shm_state( event->slot, SYNC_SHM_SIGNALED, 0 );
 }
 
 static unsigned int event_map_access( struct object *obj, unsigned int access )
@@ -204,6 +240,14 @@ static int event_signal( struct object *obj, unsigned int access )
     return 1;
 }
 
+static void event_destroy( struct object *obj )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+
+    if (event->shm) free_sync_shm_slot( event->shm, event->shm_idx );
+}
+
 struct keyed_event *create_keyed_event( struct directory *root, const struct unicode_str *name,
                                         unsigned int attr, const struct security_descriptor *sd )
 {
@@ -291,6 +335,7 @@ DECL_HANDLER(create_event)
     const struct security_descriptor *sd;
 
     reply->handle = 0;
+    reply->shm_idx = -1;
 
     if (!objattr_is_valid( objattr, get_req_data_size() ))
         return;
@@ -306,7 +351,14 @@ DECL_HANDLER(create_event)
         if (get_error() == STATUS_OBJECT_NAME_EXISTS)
             reply->handle = alloc_handle( current->process, event, req->access, req->attributes );
         else
+        {
             reply->handle = alloc_handle_no_access_check( current->process, event, req->access, req->attributes );
+            /* private events with full access can be used directly by the client */
+            if (reply->handle && !name.len && !(req->attributes & OBJ_INHERIT) &&
+                (get_handle_access( current->process, reply->handle ) & (SYNCHRONIZE | EVENT_MODIFY_STATE)) ==
+                (SYNCHRONIZE | EVENT_MODIFY_STATE))
+                reply->shm_idx = use_sync_shm( event, current->process );
+        }
         release_object( event );
     }
 
@@ -365,7 +417,7 @@ DECL_HANDLER(query_event)
     if (!(event = get_event_obj( current->process, req->handle, EVENT_QUERY_STATE ))) return;
 
     reply->manual_reset = event->manual_reset;
-    reply->state = event->signaled;
+    reply->state = event->slot->state & SYNC_SHM_SIGNALED;
 
     release_object( event );
 }
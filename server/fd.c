@@ -345,13 +345,34 @@ static file_pos_t max_unix_offset = OFF_T_MAX;
 
 struct timeout_user
 {
-    struct list           entry;      /* entry in sorted timeout list */
+    unsigned int          index;      /* index in the timeout heap, or TIMEOUT_EXPIRED */
+    struct list           entry;      /* entry in the expired list */
     timeout_t             when;       /* timeout expiry (absolute time) */
     timeout_callback      callback;   /* callback function */
     void                 *private;    /* callback private data */
+    struct timeout_stats *stats;      /* statistics for this callback */
 };
 
-static struct list timeout_list = LIST_INIT(timeout_list);   /* sorted timeouts list */
+#define TIMEOUT_EXPIRED (~0u)
+
+/* timeout statistics, per callback function */
+struct timeout_stats
+{
+    timeout_callback      callback;   /* callback function */
+    unsigned int          pending;    /* number of pending timeouts */
+    unsigned int          max_pending;/* highest number of pending timeouts */
+    unsigned int          added;      /* number of timeouts added */
+    unsigned int          expired;    /* number of timeouts that expired */
+    unsigned int          removed;    /* number of timeouts removed before expiring */
+};
+
+#define MAX_TIMEOUT_STATS 32
+
+static struct timeout_user **timeout_heap;  /* binary heap of timeouts, sorted by expiry time */
+static unsigned int timeout_count;          /* number of timeouts in the heap */
+static unsigned int timeout_size;           /* allocated size of the heap */
+static struct timeout_stats timeout_stats[MAX_TIMEOUT_STATS + 1];  /* last entry for all other callbacks */
+static unsigned int nb_timeout_stats;
 timeout_t current_time;
 
 static inline void set_current_time(void)
@@ -362,35 +383,125 @@ static inline void set_current_time(void)
     current_time = (timeout_t)now.tv_sec * TICKS_PER_SEC + now.tv_usec * 10 + ticks_1601_to_1970;
 }
 
+/* find the statistics entry of a callback */
+static struct timeout_stats *get_timeout_stats( timeout_callback func )
+{
+    unsigned int i;
+
+    for (i = 0; i < nb_timeout_stats; i++)
+        if (timeout_stats[i].callback == func) return &timeout_stats[i];
+    if (nb_timeout_stats == MAX_TIMEOUT_STATS) return &timeout_stats[MAX_TIMEOUT_STATS];
+    timeout_stats[nb_timeout_stats].callback = func;
+    return &timeout_stats[nb_timeout_stats++];
+}
+
+/* store a timeout at a given position in the heap */
+static inline void set_heap_timeout( unsigned int index, struct timeout_user *user )
+{
+    timeout_heap[index] = user;
+    user->index = index;
+}
+
+/* move a timeout towards the top of the heap until the heap is ordered */
+static void timeout_heap_up( struct timeout_user *user, unsigned int index )
+{
+    while (index)
+    {
+        unsigned int parent = (index - 1) / 2;
+        if (timeout_heap[parent]->when <= user->when) break;
+        set_heap_timeout( index, timeout_heap[parent] );
+        index = parent;
+    }
+    set_heap_timeout( index, user );
+}
+
+/* move a timeout towards the bottom of the heap until the heap is ordered */
+static void timeout_heap_down( struct timeout_user *user, unsigned int index )
+{
+    unsigned int child;
+
+    while ((child = 2 * index + 1) < timeout_count)
+    {
+        if (child + 1 < timeout_count && timeout_heap[child + 1]->when < timeout_heap[child]->when)
+            child++;
+        if (user->when <= timeout_heap[child]->when) break;
+        set_heap_timeout( index, timeout_heap[child] );
+        index = child;
+    }
+    set_heap_timeout( index, user );
+}
+
+/* remove a timeout from the heap */
+static void timeout_heap_remove( struct timeout_user *user )
+{
+    unsigned int index = user->index;
+    struct timeout_user *last = timeout_heap[--timeout_count];
+
+    user->index = TIMEOUT_EXPIRED;
+    if (last == user) return;
+    if (index && timeout_heap[(index - 1) / 2]->when > last->when) timeout_heap_up( last, index );
+    else timeout_heap_down( last, index );
+}
+
 /* add a timeout user */
 struct timeout_user *add_timeout_user( timeout_t when, timeout_callback func, void *private )
 {
     struct timeout_user *user;
-    struct list *ptr;
+
+    if (timeout_count == timeout_size)
+    {
+        unsigned int new_size = max( timeout_size * 2, 64 );
+        struct timeout_user **new_heap;
+
+        if (!(new_heap = realloc( timeout_heap, new_size * sizeof(*new_heap) )))
+        {
+            set_error( STATUS_NO_MEMORY );
+            return NULL;
+        }
+        timeout_heap = new_heap;
+        timeout_size = new_size;
+    }
 
     if (!(user = mem_alloc( sizeof(*user) ))) return NULL;
     user->when     = (when > 0) ? when : current_time - when;
     user->callback = func;
     user->private  = private;
+    user->stats    = get_timeout_stats( func );
+    user->stats->added++;
+    if (++user->stats->pending > user->stats->max_pending) user->stats->max_pending = user->stats->pending;
 
-    /* Now insert it in the linked list */
-
-    LIST_FOR_EACH( ptr, &timeout_list )
-    {
-        struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-        if (timeout->when >= user->when) break;
-    }
-    list_add_before( ptr, &user->entry );
+    timeout_heap_up( user, timeout_count++ );
     return user;
 }
 
 /* remove a timeout user */
 void remove_timeout_user( struct timeout_user *user )
 {
-    list_remove( &user->entry );
+    if (user->index != TIMEOUT_EXPIRED) timeout_heap_remove( user );
+    else list_remove( &user->entry );  /* expired but its callback hasn't been called yet */
+    user->stats->pending--;
+    user->stats->removed++;
     free( user );
 }
 
+/* dump the timeout statistics */
+void dump_timeouts(void)
+{
+    unsigned int i;
+
+    fprintf( stderr, "Timeouts: %u pending, heap size %u\n", timeout_count, timeout_size );
+    for (i = 0; i <= MAX_TIMEOUT_STATS; i++)
+    {
+        struct timeout_stats *stats = &timeout_stats[i];
+
+        if (!stats->added) continue;
+        if (i < MAX_TIMEOUT_STATS) fprintf( stderr, "  callback %p:", stats->callback );
+        else fprintf( stderr, "  other callbacks:" );
+        fprintf( stderr, " pending %u max %u added %u expired %u removed %u\n",
+                 stats->pending, stats->max_pending, stats->added, stats->expired, stats->removed );
+    }
+}
+
 /* return a text description of a timeout for debugging purposes */
 const char *get_timeout_str( timeout_t timeout )
 {
@@ -522,7 +633,9 @@ static inline void main_loop_epoll(void)
         if (!active_users) break;  /* last user removed by a timeout */
         if (epoll_fd == -1) break;  /* an error occurred with epoll */
 
+        unlock_main_loop();
         ret = epoll_wait( epoll_fd, events, sizeof(events)/sizeof(events[0]), timeout );
+        lock_main_loop();
         set_current_time();
 
         /* put the events into the pollfd array first, like poll does */
@@ -774,6 +887,16 @@ static inline void main_loop_epoll(void) { }
 
 #endif /* USE_EPOLL */
 
+/* check if set_fd_events can be called by another thread while the main loop is waiting */
+int can_set_fd_events_async(void)
+{
+#ifdef USE_EPOLL
+    return epoll_fd != -1;
+#else
+    return 0;
+#endif
+}
+
 
 /* add a user in the poll array and return its index, or -1 on failure */
 static int add_poll_user( struct fd *fd )
@@ -833,23 +956,18 @@ static void remove_poll_user( struct fd *fd, int user )
 /* process pending timeouts and return the time until the next timeout, in milliseconds */
 static int get_next_timeout(void)
 {
-    if (!list_empty( &timeout_list ))
+    if (timeout_count)
     {
         struct list expired_list, *ptr;
 
-        /* first remove all expired timers from the list */
+        /* first remove all expired timers from the heap */
 
         list_init( &expired_list );
-        while ((ptr = list_head( &timeout_list )) != NULL)
+        while (timeout_count && timeout_heap[0]->when <= current_time)
         {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-
-            if (timeout->when <= current_time)
-            {
-                list_remove( &timeout->entry );
-                list_add_tail( &expired_list, &timeout->entry );
-            }
-            else break;
+            struct timeout_user *timeout = timeout_heap[0];
+            timeout_heap_remove( timeout );
+            list_add_tail( &expired_list, &timeout->entry );
         }
 
         /* now call the callback for all the removed timers */
@@ -858,14 +976,15 @@ static int get_next_timeout(void)
         {
             struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
             list_remove( &timeout->entry );
+            timeout->stats->pending--;
+            timeout->stats->expired++;
             timeout->callback( timeout->private );
             free( timeout );
         }
 
-        if ((ptr = list_head( &timeout_list )) != NULL)
+        if (timeout_count)
         {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-            int diff = (timeout->when - current_time + 9999) / 10000;
+            int diff = (timeout_heap[0]->when - current_time + 9999) / 10000;
             if (diff < 0) diff = 0;
             return diff;
         }
@@ -890,7 +1009,9 @@ void main_loop(void)
 
         if (!active_users) break;  /* last user removed by a timeout */
 
+        unlock_main_loop();
         ret = poll( pollfd, nb_users, timeout );
+        lock_main_loop();
         set_current_time();
 
         if (ret > 0)
@@ -2455,6 +2576,37 @@ DECL_HANDLER(get_handle_fd)
     }
 }
 
+/* get the Unix fds of several handles */
+DECL_HANDLER(get_handle_fds)
+{
+    const obj_handle_t *handles = get_req_data();
+    unsigned int i, n = 0, count = get_req_data_size() / sizeof(*handles);
+    struct handle_fd_info *infos;
+    struct fd *fd;
+    int unix_fd;
+
+    count = min( count, get_reply_max_size() / sizeof(*infos) );
+    if (!count || !(infos = mem_alloc( count * sizeof(*infos) ))) return;
+
+    for (i = 0; i < count; i++)
+    {
+        /* handles without an fd are simply skipped */
+        if (!(fd = get_handle_fd_obj( current->process, handles[i], 0 ))) continue;
+        if ((unix_fd = get_unix_fd( fd )) != -1)
+        {
+            infos[n].handle    = handles[i];
+            infos[n].type      = fd->fd_ops->get_fd_type( fd );
+            infos[n].cacheable = fd->cacheable;
+            infos[n].access    = get_handle_access( current->process, handles[i] );
+            infos[n].options   = fd->options;
+            if (send_client_fd( current->process, unix_fd, handles[i] ) != -1) n++;
+        }
+        release_object( fd );
+    }
+    clear_error();
+    set_reply_data_ptr( infos, n * sizeof(*infos) );
+}
+
 /* perform a read on a file object */
 DECL_HANDLER(read)
 {
@@ -2564,6 +2716,21 @@ DECL_HANDLER(add_fd_completion)
     }
 }
 
+/* get the completion port associated with an fd */
+DECL_HANDLER(get_fd_completion)
+{
+    struct fd *fd = get_handle_fd_obj( current->process, req->handle, 0 );
+    if (fd)
+    {
+        if (fd->completion)
+        {
+            reply->completion = alloc_handle( current->process, fd->completion, IO_COMPLETION_MODIFY_STATE, 0 );
+            reply->ckey = fd->comp_key;
+        }
+        release_object( fd );
+    }
+}
+
 /* set fd disposition information */
 DECL_HANDLER(set_fd_disp_info)
 {
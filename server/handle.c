@@ -27,6 +27,7 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -97,6 +98,21 @@ static inline obj_handle_t handle_global_to_local( obj_handle_t handle )
     return handle ^ HANDLE_OBFUSCATOR;
 }
 
+/* update the entry of a handle in the shared memory mirror of the process handle table */
+static void update_handle_shm( struct handle_table *table, struct handle_entry *entry )
+{
+    unsigned int index = entry - table->entries, value = 0;
+
+    if (!table->process || !table->process->handle_shm || index >= HANDLE_SHM_SLOTS) return;
+    if (entry->ptr)
+    {
+        value = HANDLE_SHM_VALID | (entry->access & ~RESERVED_ALL & HANDLE_SHM_ACCESS);
+        if (entry->access & RESERVED_INHERIT) value |= HANDLE_SHM_INHERIT;
+        if (entry->access & RESERVED_CLOSE_PROTECT) value |= HANDLE_SHM_PROTECT;
+    }
+    table->process->handle_shm[index] = value;
+}
+
 /* grab an object and increment its handle count */
 static struct object *grab_object_for_handle( struct object *obj )
 {
@@ -245,6 +261,7 @@ static obj_handle_t alloc_entry( struct handle_table *table, void *obj, unsigned
     table->free = i + 1;
     entry->ptr    = grab_object_for_handle( obj );
     entry->access = access;
+    update_handle_shm( table, entry );
     return index_to_handle(i);
 }
 
@@ -391,6 +408,7 @@ unsigned int close_handle( struct process *process, obj_handle_t handle )
     if (!obj->ops->close_handle( obj, process, handle )) return STATUS_HANDLE_NOT_CLOSABLE;
     entry->ptr = NULL;
     table = handle_is_global(handle) ? global_table : process->handles;
+    update_handle_shm( table, entry );
     if (entry < table->entries + table->free) table->free = entry - table->entries;
     if (entry == table->entries + table->last) shrink_handle_table( table );
     release_object_from_handle( obj );
@@ -518,6 +536,7 @@ static int set_handle_flags( struct process *process, obj_handle_t handle, int m
     mask  = (mask << RESERVED_SHIFT) & RESERVED_ALL;
     flags = (flags << RESERVED_SHIFT) & mask;
     entry->access = (entry->access & ~mask) | flags;
+    update_handle_shm( handle_is_global(handle) ? global_table : process->handles, entry );
     return (old_access & RESERVED_ALL) >> RESERVED_SHIFT;
 }
 
@@ -559,6 +578,7 @@ obj_handle_t duplicate_handle( struct process *src, obj_handle_t src_handle, str
         {
             if (attr & OBJ_INHERIT) access |= RESERVED_INHERIT;
             entry->access = access;
+            update_handle_shm( handle_is_global(src_handle) ? global_table : src->handles, entry );
             res = src_handle;
         }
         else
@@ -570,7 +590,7 @@ obj_handle_t duplicate_handle( struct process *src, obj_handle_t src_handle, str
 }
 
 /* open a new handle to an existing object */
-obj_handle_t open_object( const struct namespace *namespace, const struct unicode_str *name,
+obj_handle_t open_object( struct namespace *namespace, const struct unicode_str *name,
                           const struct object_ops *ops, unsigned int access, unsigned int attr )
 {
     obj_handle_t handle = 0;
@@ -801,3 +821,24 @@ DECL_HANDLER(get_system_handles)
         enum_processes( enum_handles, &info );
     }
 }
+
+/* set the shared memory area mirroring the handle table of the current process */
+DECL_HANDLER(set_handle_shm)
+{
+    struct process *process = current->process;
+    struct handle_table *table = process->handles;
+    int i, fd = thread_get_inflight_fd( current, req->shm_fd );
+
+    if (fd == -1)
+    {
+        set_error( STATUS_INVALID_HANDLE );
+        return;
+    }
+    if (process->handle_shm) set_error( STATUS_INVALID_PARAMETER );
+    else if (!table) set_error( STATUS_PROCESS_IS_TERMINATING );
+    else if ((process->handle_shm = map_client_shm( fd, HANDLE_SHM_SIZE )))
+    {
+        for (i = 0; i <= table->last; i++) update_handle_shm( table, table->entries + i );
+    }
+    close( fd );
+}
@@ -327,6 +327,7 @@ static void mailslot_device_dump( struct object *obj, int verbose )
 {
     assert( obj->ops == &mailslot_device_ops );
     fprintf( stderr, "Mail slot device\n" );
+    if (verbose) dump_namespace( ((struct mailslot_device *)obj)->mailslots );
 }
 
 static struct object_type *mailslot_device_get_type( struct object *obj )
@@ -367,7 +368,7 @@ static void mailslot_device_destroy( struct object *obj )
     struct mailslot_device *device = (struct mailslot_device*)obj;
     assert( obj->ops == &mailslot_device_ops );
     if (device->fd) release_object( device->fd );
-    free( device->mailslots );
+    free_namespace( device->mailslots );
 }
 
 static enum server_fd_type mailslot_device_get_fd_type( struct fd *fd )
@@ -38,15 +38,19 @@
 
 struct mutex
 {
-    struct object  obj;             /* object header */
-    struct thread *owner;           /* mutex owner */
-    unsigned int   count;           /* recursion count */
-    int            abandoned;       /* has it been abandoned? */
-    struct list    entry;           /* entry in owner thread mutex list */
+    struct object         obj;      /* object header */
+    struct thread        *owner;    /* thread whose mutex list contains the mutex */
+    struct list           entry;    /* entry in owner thread mutex list */
+    struct sync_shm_slot *slot;     /* owner id and recursion count, local or in the sync shared memory */
+    struct sync_shm_slot  local;    /* local state when not using the shared memory */
+    struct sync_shm      *shm;      /* shared memory holding the state, if any */
+    int                   shm_idx;  /* index of the state in the shared memory */
 };
 
 static void mutex_dump( struct object *obj, int verbose );
 static struct object_type *mutex_get_type( struct object *obj );
+static int mutex_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void mutex_remove_queue( struct object *obj, struct wait_queue_entry *entry );
 static int mutex_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void mutex_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static unsigned int mutex_map_access( struct object *obj, unsigned int access );
@@ -58,8 +62,8 @@ static const struct object_ops mutex_ops =
     sizeof(struct mutex),      /* size */
     mutex_dump,                /* dump */
     mutex_get_type,            /* get_type */
-    add_queue,                 /* add_queue */
-    remove_queue,              /* remove_queue */
+    mutex_add_queue,           /* add_queue */
+    mutex_remove_queue,        /* remove_queue */
     mutex_signaled,            /* signaled */
     mutex_satisfied,           /* satisfied */
     mutex_signal,              /* signal */
@@ -74,29 +78,80 @@ static const struct object_ops mutex_ops =
 };
 
 
+/* the mutex state can also be changed by the client when it's in shared memory, but only
+ * by the owner thread, or to acquire it while it's free and the server has no waiters */
+static inline thread_id_t get_mutex_owner( struct mutex *mutex )
+{
+    return mutex->slot->state & SYNC_SHM_OWNER_MASK;
+}
+
+/* remove the mutex from the thread list of owned mutexes */
+static void unlink_mutex( struct mutex *mutex )
+{
+    if (!mutex->owner) return;
+    list_remove( &mutex->entry );
+    mutex->owner = NULL;
+}
+
 /* grab a mutex for a given thread */
 static void do_grab( struct mutex *mutex, struct thread *thread )
 {
-    assert( !mutex->count || (mutex->owner == thread) );
+    assert( !get_mutex_owner( mutex ) || get_mutex_owner( mutex ) == thread->id );
 
-    if (!mutex->count++)  /* FIXME: avoid wrap-around */
+    if (!get_mutex_owner( mutex ))
     {
-        assert( !mutex->owner );
+        update_sync_shm_state( mutex->slot, SYNC_SHM_OWNER_MASK, thread->id );
+        mutex->slot->count = 0;
+        /* a mutex released by the client may still be in the list of its previous owner */
+        unlink_mutex( mutex );
         mutex->owner = thread;
         list_add_head( &thread->mutex_list, &mutex->entry );
     }
+    mutex->slot->count++;  /* FIXME: avoid wrap-around */
 }
 
 /* release a mutex once the recursion count is 0 */
 static void do_release( struct mutex *mutex )
 {
-    assert( !mutex->count );
-    /* remove the mutex from the thread list of owned mutexes */
-    list_remove( &mutex->entry );
-    mutex->owner = NULL;
+    mutex->slot->count = 0;
+    update_sync_shm_state( mutex->slot, SYNC_SHM_OWNER_MASK, 0 );
+    unlink_mutex( mutex );
     wake_up( &mutex->obj, 0 );
 }
 
+/* release the mutex on behalf of the current thread */
+static int release_mutex( struct mutex *mutex, unsigned int *prev )
+{
+    if (get_mutex_owner( mutex ) != current->id)
+    {
+        set_error( STATUS_MUTANT_NOT_OWNED );
+        return 0;
+    }
+    if (prev) *prev = mutex->slot->count;
+    if (mutex->slot->count > 1) mutex->slot->count--;
+    else do_release( mutex );
+    return 1;
+}
+
+/* release a mutex whose owner thread died */
+static void abandon_mutex( struct mutex *mutex )
+{
+    update_sync_shm_state( mutex->slot, 0, SYNC_SHM_ABANDONED );
+    do_release( mutex );
+}
+
+/* move the state of a new private mutex to the sync shared memory of the process */
+static int use_sync_shm( struct mutex *mutex, struct process *process )
+{
+    if ((mutex->shm_idx = alloc_sync_shm_slot( process, &mutex->obj, &mutex->shm )) != -1)
+    {
+        mutex->slot = get_sync_shm_slot( mutex->shm, mutex->shm_idx );
+        mutex->slot->state = mutex->local.state;
+        mutex->slot->count = mutex->local.count;
+    }
+    return mutex->shm_idx;
+}
+
 static struct mutex *create_mutex( struct directory *root, const struct unicode_str *name,
                                    unsigned int attr, int owned, const struct security_descriptor *sd )
 {
@@ -107,9 +162,12 @@ static struct mutex *create_mutex( struct directory *root, const struct unicode_
         if (get_error() != STATUS_OBJECT_NAME_EXISTS)
         {
             /* initialize it if it didn't already exist */
-            mutex->count = 0;
-            mutex->owner = NULL;
-            mutex->abandoned = 0;
+            mutex->owner       = NULL;
+            mutex->slot        = &mutex->local;
+            mutex->local.state = 0;
+            mutex->local.count = 0;
+            mutex->shm         = NULL;
+            mutex->shm_idx     = -1;
             if (owned) do_grab( mutex, current );
             if (sd) default_set_sd( &mutex->obj, sd, OWNER_SECURITY_INFORMATION|
                                                      GROUP_SECURITY_INFORMATION|
@@ -120,6 +178,15 @@ static struct mutex *create_mutex( struct directory *root, const struct unicode_
     return mutex;
 }
 
+/* abandon the mutexes that a thread acquired directly on the client side */
+static void abandon_shm_mutex( struct object *obj, void *arg )
+{
+    struct mutex *mutex = (struct mutex *)obj;
+    struct thread *thread = arg;
+
+    if (obj->ops == &mutex_ops && get_mutex_owner( mutex ) == thread->id) abandon_mutex( mutex );
+}
+
 void abandon_mutexes( struct thread *thread )
 {
     struct list *ptr;
@@ -128,17 +195,18 @@ void abandon_mutexes( struct thread *thread )
     {
         struct mutex *mutex = LIST_ENTRY( ptr, struct mutex, entry );
         assert( mutex->owner == thread );
-        mutex->count = 0;
-        mutex->abandoned = 1;
-        do_release( mutex );
+        if (get_mutex_owner( mutex ) == thread->id) abandon_mutex( mutex );
+        else unlink_mutex( mutex );  /* already released by the client */
     }
+    enum_sync_shm_objects( thread->process, abandon_shm_mutex, thread );
 }
 
 static void mutex_dump( struct object *obj, int verbose )
 {
     struct mutex *mutex = (struct mutex *)obj;
     assert( obj->ops == &mutex_ops );
-    fprintf( stderr, "Mutex count=%u owner=%p ", mutex->count, mutex->owner );
+    fprintf( stderr, "Mutex count=%u owner=%04x shm=%d ",
+             mutex->slot->count, get_mutex_owner( mutex ), mutex->shm_idx );
     dump_object_name( &mutex->obj );
     fputc( '\n', stderr );
 }
@@ -150,11 +218,26 @@ static struct object_type *mutex_get_type( struct object *obj )
     return get_object_type( &str );
 }
 
+static int mutex_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct mutex *mutex = (struct mutex *)obj;
+    assert( obj->ops == &mutex_ops );
+    return sync_shm_add_queue( obj, entry, mutex->slot );
+}
+
+static void mutex_remove_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct mutex *mutex = (struct mutex *)obj;
+    assert( obj->ops == &mutex_ops );
+    sync_shm_remove_queue( obj, entry, mutex->slot );
+}
+
 static int mutex_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct mutex *mutex = (struct mutex *)obj;
+    thread_id_t owner = get_mutex_owner( mutex );
     assert( obj->ops == &mutex_ops );
-    return (!mutex->count || (mutex->owner == get_wait_queue_thread( entry )));
+    return (!owner || owner == get_wait_queue_thread( entry )->id);
 }
 
 static void mutex_satisfied( struct object *obj, struct wait_queue_entry *entry )
@@ -162,9 +245,9 @@ static void mutex_satisfied( struct object *obj, struct wait_queue_entry *entry
     struct mutex *mutex = (struct mutex *)obj;
     assert( obj->ops == &mutex_ops );
 
+    if (update_sync_shm_state( mutex->slot, SYNC_SHM_ABANDONED, 0 ) & SYNC_SHM_ABANDONED)
+        make_wait_abandoned( entry );
     do_grab( mutex, get_wait_queue_thread( entry ));
-    if (mutex->abandoned) make_wait_abandoned( entry );
-    mutex->abandoned = 0;
 }
 
 static unsigned int mutex_map_access( struct object *obj, unsigned int access )
@@ -186,13 +269,7 @@ static int mutex_signal( struct object *obj, unsigned int access )
         set_error( STATUS_ACCESS_DENIED );
         return 0;
     }
-    if (!mutex->count || (mutex->owner != current))
-    {
-        set_error( STATUS_MUTANT_NOT_OWNED );
-        return 0;
-    }
-    if (!--mutex->count) do_release( mutex );
-    return 1;
+    return release_mutex( mutex, NULL );
 }
 
 static void mutex_destroy( struct object *obj )
@@ -200,9 +277,8 @@ static void mutex_destroy( struct object *obj )
     struct mutex *mutex = (struct mutex *)obj;
     assert( obj->ops == &mutex_ops );
 
-    if (!mutex->count) return;
-    mutex->count = 0;
-    do_release( mutex );
+    unlink_mutex( mutex );
+    if (mutex->shm) free_sync_shm_slot( mutex->shm, mutex->shm_idx );
 }
 
 /* create a mutex */
@@ -215,6 +291,7 @@ DECL_HANDLER(create_mutex)
     const struct security_descriptor *sd;
 
     reply->handle = 0;
+    reply->shm_idx = -1;
 
     if (!objattr_is_valid( objattr, get_req_data_size() ))
         return;
@@ -230,7 +307,13 @@ DECL_HANDLER(create_mutex)
         if (get_error() == STATUS_OBJECT_NAME_EXISTS)
             reply->handle = alloc_handle( current->process, mutex, req->access, req->attributes );
         else
+        {
             reply->handle = alloc_handle_no_access_check( current->process, mutex, req->access, req->attributes );
+            /* private mutexes that can be waited on can be used directly by the client */
+            if (reply->handle && !name.len && !(req->attributes & OBJ_INHERIT) &&
+                (get_handle_access( current->process, reply->handle ) & SYNCHRONIZE))
+                reply->shm_idx = use_sync_shm( mutex, current->process );
+        }
         release_object( mutex );
     }
 
@@ -265,12 +348,7 @@ DECL_HANDLER(release_mutex)
     if ((mutex = (struct mutex *)get_handle_obj( current->process, req->handle,
                                                  0, &mutex_ops )))
     {
-        if (!mutex->count || (mutex->owner != current)) set_error( STATUS_MUTANT_NOT_OWNED );
-        else
-        {
-            reply->prev_count = mutex->count;
-            if (!--mutex->count) do_release( mutex );
-        }
+        release_mutex( mutex, &reply->prev_count );
         release_object( mutex );
     }
 }
@@ -45,16 +45,25 @@ struct object_name
     struct list         entry;           /* entry in the hash list */
     struct object      *obj;             /* object owning this name */
     struct object      *parent;          /* parent object */
+    struct namespace   *namespace;       /* namespace containing the name */
+    unsigned int        hash;            /* hash value of the name */
     data_size_t         len;             /* name length in bytes */
     WCHAR               name[1];
 };
 
 struct namespace
 {
-    unsigned int        hash_size;       /* size of hash table */
-    struct list         names[1];        /* array of hash entry lists */
+    unsigned int        hash_size;       /* size of hash table, always a power of 2 */
+    unsigned int        count;           /* number of names in the namespace */
+    unsigned int        lookups;         /* number of name lookups */
+    unsigned int        probes;          /* number of names compared during lookups */
+    unsigned int        max_chain;       /* longest hash list walked during a lookup */
+    struct list        *names;           /* array of hash entry lists */
 };
 
+/* the hash table is doubled when the average list length exceeds this */
+#define MAX_NAMESPACE_LOAD 2
+
 
 #ifdef DEBUG_OBJECTS
 static struct list object_list = LIST_INIT(object_list);
@@ -120,12 +129,37 @@ void *memdup( const void *data, size_t len )
 
 /*****************************************************************/
 
-static int get_name_hash( const struct namespace *namespace, const WCHAR *name, data_size_t len )
+/* case-insensitive hash of an object name */
+static unsigned int get_name_hash( const WCHAR *name, data_size_t len )
+{
+    unsigned int hash = 0;
+
+    for (len /= sizeof(WCHAR); len; len--) hash = hash * 65599 + tolowerW( *name++ );
+    return hash;
+}
+
+/* double the size of the hash table of a namespace */
+static void grow_namespace( struct namespace *namespace )
 {
-    WCHAR hash = 0;
-    len /= sizeof(WCHAR);
-    while (len--) hash ^= tolowerW(*name++);
-    return hash % namespace->hash_size;
+    unsigned int i, new_size = namespace->hash_size * 2;
+    struct list *new_names, *ptr;
+
+    /* keep the current table if we can't allocate a new one */
+    if (!(new_names = malloc( new_size * sizeof(*new_names) ))) return;
+    for (i = 0; i < new_size; i++) list_init( &new_names[i] );
+    for (i = 0; i < namespace->hash_size; i++)
+    {
+        /* move the names from the tail to preserve their order */
+        while ((ptr = list_tail( &namespace->names[i] )))
+        {
+            struct object_name *name = LIST_ENTRY( ptr, struct object_name, entry );
+            list_remove( ptr );
+            list_add_head( &new_names[name->hash & (new_size - 1)], ptr );
+        }
+    }
+    free( namespace->names );
+    namespace->names     = new_names;
+    namespace->hash_size = new_size;
 }
 
 /* allocate a name for an object */
@@ -147,6 +181,7 @@ static void free_name( struct object *obj )
 {
     struct object_name *ptr = obj->name;
     list_remove( &ptr->entry );
+    ptr->namespace->count--;
     if (ptr->parent) release_object( ptr->parent );
     free( ptr );
 }
@@ -155,11 +190,12 @@ static void free_name( struct object *obj )
 static void set_object_name( struct namespace *namespace,
                              struct object *obj, struct object_name *ptr )
 {
-    int hash = get_name_hash( namespace, ptr->name, ptr->len );
-
-    list_add_head( &namespace->names[hash], &ptr->entry );
+    ptr->hash = get_name_hash( ptr->name, ptr->len );
+    ptr->namespace = namespace;
+    list_add_head( &namespace->names[ptr->hash & (namespace->hash_size - 1)], &ptr->entry );
     ptr->obj = obj;
     obj->name = ptr;
+    if (++namespace->count > namespace->hash_size * MAX_NAMESPACE_LOAD) grow_namespace( namespace );
 }
 
 /* get the name of an existing object */
@@ -300,7 +336,12 @@ struct object *grab_object( void *ptr )
 {
     struct object *obj = (struct object *)ptr;
     assert( obj->refcount < INT_MAX );
+#ifdef USE_WORKER_THREADS
+    /* worker threads can grab objects concurrently */
+    __sync_add_and_fetch( &obj->refcount, 1 );
+#else
     obj->refcount++;
+#endif
     return obj;
 }
 
@@ -309,7 +350,12 @@ void release_object( void *ptr )
 {
     struct object *obj = (struct object *)ptr;
     assert( obj->refcount );
+#ifdef USE_WORKER_THREADS
+    /* the last reference is never released by a worker thread */
+    if (!__sync_sub_and_fetch( &obj->refcount, 1 ))
+#else
     if (!--obj->refcount)
+#endif
     {
         assert( !obj->handle_count );
         /* if the refcount is 0, nobody can be in the wait queue */
@@ -326,31 +372,38 @@ void release_object( void *ptr )
 }
 
 /* find an object by its name; the refcount is incremented */
-struct object *find_object( const struct namespace *namespace, const struct unicode_str *name,
+struct object *find_object( struct namespace *namespace, const struct unicode_str *name,
                             unsigned int attributes )
 {
     const struct list *list;
+    struct object *obj = NULL;
+    unsigned int hash, chain = 0;
     struct list *p;
 
     if (!name || !name->len) return NULL;
 
-    list = &namespace->names[ get_name_hash( namespace, name->str, name->len ) ];
+    hash = get_name_hash( name->str, name->len );
+    list = &namespace->names[hash & (namespace->hash_size - 1)];
     LIST_FOR_EACH( p, list )
     {
         const struct object_name *ptr = LIST_ENTRY( p, struct object_name, entry );
-        if (ptr->len != name->len) continue;
+        chain++;
+        if (ptr->hash != hash || ptr->len != name->len) continue;
         if (attributes & OBJ_CASE_INSENSITIVE)
         {
-            if (!strncmpiW( ptr->name, name->str, name->len/sizeof(WCHAR) ))
-                return grab_object( ptr->obj );
+            if (strncmpiW( ptr->name, name->str, name->len/sizeof(WCHAR) )) continue;
         }
         else
         {
-            if (!memcmp( ptr->name, name->str, name->len ))
-                return grab_object( ptr->obj );
+            if (memcmp( ptr->name, name->str, name->len )) continue;
         }
+        obj = grab_object( ptr->obj );
+        break;
     }
-    return NULL;
+    namespace->lookups++;
+    namespace->probes += chain;
+    if (chain > namespace->max_chain) namespace->max_chain = chain;
+    return obj;
 }
 
 /* find an object by its index; the refcount is incremented */
@@ -371,21 +424,46 @@ struct object *find_object_index( const struct namespace *namespace, unsigned in
     return NULL;
 }
 
-/* allocate a namespace */
+/* allocate a namespace; the hash table grows as names are added */
 struct namespace *create_namespace( unsigned int hash_size )
 {
     struct namespace *namespace;
-    unsigned int i;
+    unsigned int i, size = 8;
 
-    namespace = mem_alloc( sizeof(*namespace) + (hash_size - 1) * sizeof(namespace->names[0]) );
-    if (namespace)
+    while (size < hash_size) size *= 2;
+    if (!(namespace = mem_alloc( sizeof(*namespace) ))) return NULL;
+    if (!(namespace->names = mem_alloc( size * sizeof(*namespace->names) )))
     {
-        namespace->hash_size      = hash_size;
-        for (i = 0; i < hash_size; i++) list_init( &namespace->names[i] );
+        free( namespace );
+        return NULL;
     }
+    namespace->hash_size = size;
+    namespace->count     = 0;
+    namespace->lookups   = 0;
+    namespace->probes    = 0;
+    namespace->max_chain = 0;
+    for (i = 0; i < size; i++) list_init( &namespace->names[i] );
     return namespace;
 }
 
+/* free a namespace, which must not contain any name */
+void free_namespace( struct namespace *namespace )
+{
+    if (!namespace) return;
+    free( namespace->names );
+    free( namespace );
+}
+
+/* dump the lookup statistics of a namespace to stderr */
+void dump_namespace( const struct namespace *namespace )
+{
+    unsigned int average = namespace->lookups ? namespace->probes * 100ull / namespace->lookups : 0;
+
+    fprintf( stderr, "    names=%u buckets=%u lookups=%u avg chain=%u.%02u max chain=%u\n",
+             namespace->count, namespace->hash_size, namespace->lookups,
+             average / 100, average % 100, namespace->max_chain );
+}
+
 /* functions for unimplemented/default object operations */
 
 struct object_type *no_get_type( struct object *obj )
@@ -31,6 +31,14 @@
 
 #define DEBUG_OBJECTS
 
+/* requests that don't modify the server state can be handled by worker threads */
+#if defined(__linux__) && defined(HAVE_PTHREAD_H) && defined(__GNUC__)
+#define USE_WORKER_THREADS
+#define THREAD_LOCAL __thread
+#else
+#define THREAD_LOCAL
+#endif
+
 /* kernel objects */
 
 struct namespace;
@@ -125,11 +133,13 @@ extern void *create_named_object( struct namespace *namespace, const struct obje
 extern void unlink_named_object( struct object *obj );
 extern void make_object_static( struct object *obj );
 extern struct namespace *create_namespace( unsigned int hash_size );
+extern void free_namespace( struct namespace *namespace );
+extern void dump_namespace( const struct namespace *namespace );
 /* grab/release_object can take any pointer, but you better make sure */
 /* that the thing pointed to starts with a struct object... */
 extern struct object *grab_object( void *obj );
 extern void release_object( void *obj );
-extern struct object *find_object( const struct namespace *namespace, const struct unicode_str *name,
+extern struct object *find_object( struct namespace *namespace, const struct unicode_str *name,
                                    unsigned int attributes );
 extern struct object *find_object_index( const struct namespace *namespace, unsigned int index );
 extern struct object_type *no_get_type( struct object *obj );
@@ -172,6 +182,22 @@ extern void reset_event( struct event *event );
 
 extern void abandon_mutexes( struct thread *thread );
 
+/* sync objects shared memory functions */
+
+struct sync_shm;
+
+extern void release_sync_shm( struct sync_shm *shm );
+extern int alloc_sync_shm_slot( struct process *process, struct object *obj, struct sync_shm **ret );
+extern struct sync_shm_slot *get_sync_shm_slot( struct sync_shm *shm, int index );
+extern void free_sync_shm_slot( struct sync_shm *shm, int index );
+extern void enum_sync_shm_objects( struct process *process,
+                                   void (*func)( struct object *, void * ), void *arg );
+extern int update_sync_shm_state( struct sync_shm_slot *slot, int clear, int set );
+extern int sync_shm_add_queue( struct object *obj, struct wait_queue_entry *entry,
+                               struct sync_shm_slot *slot );
+extern void sync_shm_remove_queue( struct object *obj, struct wait_queue_entry *entry,
+                                   struct sync_shm_slot *slot );
+
 /* serial functions */
 
 int get_serial_async_timeout(struct object *obj, int type, int count);
@@ -192,6 +218,7 @@ extern void debug_exit_thread( struct thread *thread );
 extern unsigned int get_prefix_cpu_mask(void);
 extern void init_registry(void);
 extern void flush_registry(void);
+extern int key_enum_needs_sort( struct process *process, obj_handle_t hkey, int values );
 
 /* signal functions */
 
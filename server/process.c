@@ -29,6 +29,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/time.h>
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
 #ifdef HAVE_SYS_SOCKET_H
 # include <sys/socket.h>
 #endif
@@ -528,6 +531,8 @@ struct thread *create_process( int fd, struct thread *parent_thread, int inherit
     process->trace_data      = 0;
     process->rawinput_mouse  = NULL;
     process->rawinput_kbd    = NULL;
+    process->sync_shm        = NULL;
+    process->handle_shm      = NULL;
     list_init( &process->thread_list );
     list_init( &process->locks );
     list_init( &process->classes );
@@ -625,6 +630,8 @@ static void process_destroy( struct object *obj )
     if (process->msg_fd) release_object( process->msg_fd );
     list_remove( &process->entry );
     if (process->idle_event) release_object( process->idle_event );
+    if (process->sync_shm) release_sync_shm( process->sync_shm );
+    if (process->handle_shm) munmap( process->handle_shm, HANDLE_SHM_SIZE );
     if (process->id) free_ptid( process->id );
     if (process->token) release_object( process->token );
 }
@@ -859,6 +866,16 @@ static void process_killed( struct process *process )
     destroy_process_classes( process );
     free_process_user_handles( process );
     remove_process_locks( process );
+    if (process->sync_shm)
+    {
+        release_sync_shm( process->sync_shm );
+        process->sync_shm = NULL;
+    }
+    if (process->handle_shm)
+    {
+        munmap( process->handle_shm, HANDLE_SHM_SIZE );
+        process->handle_shm = NULL;
+    }
     set_process_startup_state( process, STARTUP_ABORTED );
     finish_process_tracing( process );
     release_job_process( process );
@@ -94,6 +94,8 @@ struct process
     struct list          rawinput_devices;/* list of registered rawinput devices */
     const struct rawinput_device *rawinput_mouse; /* rawinput mouse device, if any */
     const struct rawinput_device *rawinput_kbd;   /* rawinput keyboard device, if any */
+    struct sync_shm     *sync_shm;        /* shared memory for the state of private sync objects */
+    unsigned int        *handle_shm;      /* shared memory mirroring the handle table */
 };
 
 struct process_snapshot
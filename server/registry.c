@@ -69,12 +69,19 @@ struct key
     unsigned short    namelen;     /* length of key name */
     unsigned short    classlen;    /* length of class name */
     struct key       *parent;      /* parent key */
+    struct key       *hash_next;   /* next key in the parent's hash bucket */
+    int               index;       /* index in the parent's subkeys array */
+    struct deleted_subkey *deleted; /* subkeys deleted since the last save */
     int               last_subkey; /* last in use subkey */
     int               nb_subkeys;  /* count of allocated subkeys */
     struct key      **subkeys;     /* subkeys array */
+    struct key      **subkey_hash; /* hash table of subkeys, for keys with many subkeys */
+    unsigned int      subkey_hash_size; /* size of the subkey hash table */
     int               last_value;  /* last in use value */
     int               nb_values;   /* count of allocated values in array */
     struct key_value *values;      /* values array */
+    int              *value_hash;  /* hash table of value indices, for keys with many values */
+    unsigned int      value_hash_size; /* size of the value hash table */
     unsigned int      flags;       /* flags */
     timeout_t         modif;       /* last modification time */
     struct list       notify_list; /* list of notifications */
@@ -87,6 +94,17 @@ struct key
 #define KEY_SYMLINK  0x0008  /* key is a symbolic link */
 #define KEY_WOW64    0x0010  /* key contains a Wow6432Node subkey */
 #define KEY_WOWSHARE 0x0020  /* key is a Wow64 shared key (used for Software\Classes) */
+#define KEY_UNSORTED_SUBKEYS 0x0040  /* subkeys array needs sorting before enumeration */
+#define KEY_UNSORTED_VALUES  0x0080  /* values array needs sorting before enumeration */
+#define KEY_CHANGED  0x0100  /* key itself has been modified, not only its subkeys */
+
+/* name of a subkey deleted since the last save, to be recorded in the journal */
+struct deleted_subkey
+{
+    struct deleted_subkey *next;
+    data_size_t            namelen;
+    WCHAR                  name[1];
+};
 
 /* a key value */
 struct key_value
@@ -96,11 +114,17 @@ struct key_value
     unsigned int      type;    /* value type */
     data_size_t       len;     /* value data length in bytes */
     void             *data;    /* pointer to value data */
+    int               hash_next; /* index of the next value in the hash bucket */
 };
 
 #define MIN_SUBKEYS  8   /* min. number of allocated subkeys per key */
 #define MIN_VALUES   8   /* min. number of allocated values per key */
 
+/* Keys with many subkeys or values index them with a hash table. New entries are then
+ * appended to the arrays, deleted ones are replaced by the last entry, and the arrays
+ * are only sorted again when they get enumerated. */
+#define MIN_HASH_ENTRIES 64
+
 #define MAX_NAME_LEN  255    /* max. length of a key name */
 #define MAX_VALUE_LEN 16383  /* max. length of a value name */
 
@@ -109,6 +133,7 @@ static struct key *root_key;
 
 static const timeout_t ticks_1601_to_1970 = (timeout_t)86400 * (369 * 365 + 89) * TICKS_PER_SEC;
 static const timeout_t save_period = 30 * -TICKS_PER_SEC;  /* delay between periodic saves */
+static const off_t min_journal_size = 65536;  /* journal size that always triggers a full save */
 static struct timeout_user *save_timeout_user;  /* saving timer */
 static enum prefix_type { PREFIX_UNKNOWN, PREFIX_32BIT, PREFIX_64BIT } prefix_type;
 
@@ -119,6 +144,10 @@ static const struct unicode_str symlink_str = { symlink_value, sizeof(symlink_va
 
 static void set_periodic_save_timer(void);
 static struct key_value *find_value( const struct key *key, const struct unicode_str *name, int *index );
+static void sort_subkeys( struct key *key );
+static void sort_values( struct key *key );
+static void free_deleted_subkeys( struct key *key );
+static void clear_values( struct key *key );
 
 /* information about where to save a registry branch */
 struct save_branch_info
@@ -185,6 +214,12 @@ static inline int is_wow6432node( const WCHAR *name, unsigned int len )
  * - key names use escapes too in order to support Unicode
  * - the modification time optionally follows the key name
  * - REG_EXPAND_SZ and REG_MULTI_SZ are saved as strings instead of hex
+ *
+ * The periodic saves append the modified keys to a journal file in the same
+ * format, next to the registry file, until the journal becomes too large and
+ * the whole branch is saved again. Two options are only used in the journal:
+ * - #clear removes all the values of the key before the ones that follow
+ * - #delete removes the key and all its subkeys
  */
 
 /* dump the full path of a key */
@@ -253,11 +288,13 @@ static void dump_value( const struct key_value *value, FILE *f )
 }
 
 /* save a registry and all its subkeys to a text file */
-static void save_subkeys( const struct key *key, const struct key *base, FILE *f )
+static void save_subkeys( struct key *key, const struct key *base, FILE *f )
 {
     int i;
 
     if (key->flags & KEY_VOLATILE) return;
+    sort_subkeys( key );
+    sort_values( key );
     /* save key if it has either some values or no subkeys, or needs special options */
     /* keys with no values but subkeys are saved implicitly by saving the subkeys */
     if ((key->last_value >= 0) || (key->last_subkey == -1) || key->class || (key->flags & KEY_SYMLINK))
@@ -408,12 +445,15 @@ static void key_destroy( struct object *obj )
         free( key->values[i].data );
     }
     free( key->values );
+    free( key->value_hash );
     for (i = 0; i <= key->last_subkey; i++)
     {
         key->subkeys[i]->parent = NULL;
         release_object( key->subkeys[i] );
     }
     free( key->subkeys );
+    free( key->subkey_hash );
+    free_deleted_subkeys( key );
     /* unconditionally notify everything waiting on this key */
     while ((ptr = list_head( &key->notify_list )))
     {
@@ -477,11 +517,17 @@ static struct key *alloc_key( const struct unicode_str *name, timeout_t modif )
         key->last_subkey = -1;
         key->nb_subkeys  = 0;
         key->subkeys     = NULL;
+        key->subkey_hash = NULL;
+        key->subkey_hash_size = 0;
         key->nb_values   = 0;
         key->last_value  = -1;
         key->values      = NULL;
+        key->value_hash  = NULL;
+        key->value_hash_size = 0;
         key->modif       = modif;
         key->parent      = NULL;
+        key->hash_next   = NULL;
+        key->deleted     = NULL;
         list_init( &key->notify_list );
         if (name->len && !(key->name = memdup( name->str, name->len )))
         {
@@ -492,6 +538,36 @@ static struct key *alloc_key( const struct unicode_str *name, timeout_t modif )
     return key;
 }
 
+/* free the list of deleted subkeys of a key */
+static void free_deleted_subkeys( struct key *key )
+{
+    struct deleted_subkey *deleted;
+
+    while ((deleted = key->deleted))
+    {
+        key->deleted = deleted->next;
+        free( deleted );
+    }
+}
+
+/* remember a deleted subkey until the next save */
+static void add_deleted_subkey( struct key *parent, const struct key *key )
+{
+    struct deleted_subkey *deleted;
+
+    if (key->flags & KEY_VOLATILE) return;
+    /* if this fails, the next save will be a full one */
+    if (!(deleted = malloc( offsetof( struct deleted_subkey, name[key->namelen / sizeof(WCHAR)] ))))
+    {
+        parent->flags |= KEY_CHANGED;
+        return;
+    }
+    deleted->namelen = key->namelen;
+    memcpy( deleted->name, key->name, key->namelen );
+    deleted->next = parent->deleted;
+    parent->deleted = deleted;
+}
+
 /* mark a key and all its parents as dirty (modified) */
 static void make_dirty( struct key *key )
 {
@@ -510,10 +586,22 @@ static void make_clean( struct key *key )
 
     if (key->flags & KEY_VOLATILE) return;
     if (!(key->flags & KEY_DIRTY)) return;
-    key->flags &= ~KEY_DIRTY;
+    key->flags &= ~(KEY_DIRTY | KEY_CHANGED);
+    free_deleted_subkeys( key );
     for (i = 0; i <= key->last_subkey; i++) make_clean( key->subkeys[i] );
 }
 
+/* mark a key and all its subkeys as modified, so that they get saved in the journal */
+static void make_changed( struct key *key )
+{
+    int i;
+
+    if (key->flags & KEY_VOLATILE) return;
+    make_dirty( key );
+    key->flags |= KEY_DIRTY | KEY_CHANGED;
+    for (i = 0; i <= key->last_subkey; i++) make_changed( key->subkeys[i] );
+}
+
 /* go through all the notifications and send them if necessary */
 static void check_notify( struct key *key, unsigned int change, int not_subtree )
 {
@@ -534,6 +622,7 @@ static void touch_key( struct key *key, unsigned int change )
 
     key->modif = current_time;
     make_dirty( key );
+    if (!(key->flags & KEY_VOLATILE)) key->flags |= KEY_CHANGED;
 
     /* do notifications */
     check_notify( key, change, 1 );
@@ -541,6 +630,91 @@ static void touch_key( struct key *key, unsigned int change )
         check_notify( k, change & ~REG_NOTIFY_CHANGE_LAST_SET, 0 );
 }
 
+/* case-insensitive hash of a key or value name */
+static unsigned int hash_name( const WCHAR *name, data_size_t len )
+{
+    unsigned int hash = 0;
+
+    for (len /= sizeof(WCHAR); len; len--) hash = hash * 65599 + tolowerW( *name++ );
+    return hash;
+}
+
+/* compare two key or value names, in the order of the sorted arrays */
+static int compare_names( const WCHAR *name1, data_size_t len1, const WCHAR *name2, data_size_t len2 )
+{
+    int res = memicmpW( name1, name2, min( len1, len2 ) / sizeof(WCHAR) );
+    if (!res) res = len1 - len2;
+    return res;
+}
+
+/* add a subkey to the hash table of its parent */
+static void add_subkey_hash( struct key *parent, struct key *key )
+{
+    unsigned int bucket = hash_name( key->name, key->namelen ) & (parent->subkey_hash_size - 1);
+
+    key->hash_next = parent->subkey_hash[bucket];
+    parent->subkey_hash[bucket] = key;
+}
+
+/* remove a subkey from the hash table of its parent */
+static void remove_subkey_hash( struct key *parent, struct key *key )
+{
+    struct key **ptr = &parent->subkey_hash[hash_name( key->name, key->namelen ) & (parent->subkey_hash_size - 1)];
+
+    while (*ptr != key) ptr = &(*ptr)->hash_next;
+    *ptr = key->hash_next;
+    key->hash_next = NULL;
+}
+
+/* (re)build the subkey hash table to fit the allocated subkeys array; return 1 if OK, 0 on error */
+static int rehash_subkeys( struct key *key )
+{
+    unsigned int size = key->subkey_hash_size ? key->subkey_hash_size : MIN_HASH_ENTRIES;
+    struct key **hash;
+    int i;
+
+    while (size < (unsigned int)key->nb_subkeys) size *= 2;
+    if (size == key->subkey_hash_size) return 1;
+    if (!(hash = mem_alloc( size * sizeof(*hash) ))) return 0;
+    memset( hash, 0, size * sizeof(*hash) );
+    free( key->subkey_hash );
+    key->subkey_hash = hash;
+    key->subkey_hash_size = size;
+    for (i = 0; i <= key->last_subkey; i++) add_subkey_hash( key, key->subkeys[i] );
+    return 1;
+}
+
+static int compare_subkeys( const void *p1, const void *p2 )
+{
+    const struct key *key1 = *(const struct key * const *)p1;
+    const struct key *key2 = *(const struct key * const *)p2;
+
+    return compare_names( key1->name, key1->namelen, key2->name, key2->namelen );
+}
+
+/* sort the subkeys array after some were appended or moved out of order */
+static void sort_subkeys( struct key *key )
+{
+    int i;
+
+    if (!(key->flags & KEY_UNSORTED_SUBKEYS)) return;
+    qsort( key->subkeys, key->last_subkey + 1, sizeof(*key->subkeys), compare_subkeys );
+    for (i = 0; i <= key->last_subkey; i++) key->subkeys[i]->index = i;
+    key->flags &= ~KEY_UNSORTED_SUBKEYS;
+}
+
+/* check if enumerating a key has to sort it first, which needs the exclusive server lock */
+int key_enum_needs_sort( struct process *process, obj_handle_t hkey, int values )
+{
+    struct key *key;
+    int ret;
+
+    if (!(key = (struct key *)get_handle_obj( process, hkey, 0, &key_ops ))) return 0;
+    ret = (key->flags & (values ? KEY_UNSORTED_VALUES : KEY_UNSORTED_SUBKEYS)) != 0;
+    release_object( key );
+    return ret;
+}
+
 /* try to grow the array of subkeys; return 1 if OK, 0 on error */
 static int grow_subkeys( struct key *key )
 {
@@ -563,6 +737,7 @@ static int grow_subkeys( struct key *key )
     }
     key->subkeys    = new_subkeys;
     key->nb_subkeys = nb_subkeys;
+    if (key->subkey_hash || nb_subkeys > MIN_HASH_ENTRIES) return rehash_subkeys( key );
     return 1;
 }
 
@@ -587,8 +762,19 @@ static struct key *alloc_subkey( struct key *parent, const struct unicode_str *n
     {
         key->parent = parent;
         for (i = ++parent->last_subkey; i > index; i--)
+        {
             parent->subkeys[i] = parent->subkeys[i-1];
+            parent->subkeys[i]->index = i;
+        }
         parent->subkeys[index] = key;
+        key->index = index;
+        if (parent->subkey_hash)
+        {
+            add_subkey_hash( parent, key );
+            /* with a hash table, new keys are appended */
+            if (index && compare_subkeys( &parent->subkeys[index - 1], &parent->subkeys[index] ) > 0)
+                parent->flags |= KEY_UNSORTED_SUBKEYS;
+        }
         if (is_wow6432node( key->name, key->namelen ) && !is_wow6432node( parent->name, parent->namelen ))
             parent->flags |= KEY_WOW64;
     }
@@ -605,7 +791,25 @@ static void free_subkey( struct key *parent, int index )
     assert( index <= parent->last_subkey );
 
     key = parent->subkeys[index];
-    for (i = index; i < parent->last_subkey; i++) parent->subkeys[i] = parent->subkeys[i + 1];
+    if (parent->subkey_hash)
+    {
+        /* with a hash table, move the last key into the hole instead of shifting the array */
+        remove_subkey_hash( parent, key );
+        if (index < parent->last_subkey)
+        {
+            parent->subkeys[index] = parent->subkeys[parent->last_subkey];
+            parent->subkeys[index]->index = index;
+            parent->flags |= KEY_UNSORTED_SUBKEYS;
+        }
+    }
+    else
+    {
+        for (i = index; i < parent->last_subkey; i++)
+        {
+            parent->subkeys[i] = parent->subkeys[i + 1];
+            parent->subkeys[i]->index = i;
+        }
+    }
     parent->last_subkey--;
     key->flags |= KEY_DELETED;
     key->parent = NULL;
@@ -626,19 +830,33 @@ static void free_subkey( struct key *parent, int index )
 }
 
 /* find the named child of a given key and return its index */
+/* when the key has a hash table, the index is only returned for a missing child, */
+/* as the position where it should be appended */
 static struct key *find_subkey( const struct key *key, const struct unicode_str *name, int *index )
 {
     int i, min, max, res;
-    data_size_t len;
+
+    if (key->subkey_hash)
+    {
+        struct key *subkey = key->subkey_hash[hash_name( name->str, name->len ) & (key->subkey_hash_size - 1)];
+
+        for ( ; subkey; subkey = subkey->hash_next)
+        {
+            if (subkey->namelen != name->len) continue;
+            if (memicmpW( subkey->name, name->str, name->len / sizeof(WCHAR) )) continue;
+            *index = -1;
+            return subkey;
+        }
+        *index = key->last_subkey + 1;
+        return NULL;
+    }
 
     min = 0;
     max = key->last_subkey;
     while (min <= max)
     {
         i = (min + max) / 2;
-        len = min( key->subkeys[i]->namelen, name->len );
-        res = memicmpW( key->subkeys[i]->name, name->str, len / sizeof(WCHAR) );
-        if (!res) res = key->subkeys[i]->namelen - name->len;
+        res = compare_names( key->subkeys[i]->name, key->subkeys[i]->namelen, name->str, name->len );
         if (!res)
         {
             *index = i;
@@ -805,7 +1023,7 @@ static struct key *create_key( struct key *key, const struct unicode_str *name,
 
     if (options & REG_OPTION_CREATE_LINK) key->flags |= KEY_SYMLINK;
     if (options & REG_OPTION_VOLATILE) key->flags |= KEY_VOLATILE;
-    else key->flags |= KEY_DIRTY;
+    else key->flags |= KEY_DIRTY | KEY_CHANGED;
 
     if (debug_level > 1) dump_operation( key, NULL, "Create" );
     if (class && class->len)
@@ -863,7 +1081,7 @@ static struct key *create_key_recursive( struct key *key, const struct unicode_s
 }
 
 /* query information about a key or a subkey */
-static void enum_key( const struct key *key, int index, int info_class,
+static void enum_key( struct key *key, int index, int info_class,
                       struct enum_key_reply *reply )
 {
     static const WCHAR backslash[] = { '\\' };
@@ -881,6 +1099,7 @@ static void enum_key( const struct key *key, int index, int info_class,
             set_error( STATUS_NO_MORE_ENTRIES );
             return;
         }
+        sort_subkeys( key );
         key = key->subkeys[index];
     }
 
@@ -971,7 +1190,6 @@ static void enum_key( const struct key *key, int index, int info_class,
 /* delete a key and its values */
 static int delete_key( struct key *key, int recurse )
 {
-    int index;
     struct key *parent = key->parent;
 
     /* must find parent and index */
@@ -986,9 +1204,7 @@ static int delete_key( struct key *key, int recurse )
         if (0 > delete_key(key->subkeys[key->last_subkey], 1))
             return -1;
 
-    for (index = 0; index <= parent->last_subkey; index++)
-        if (parent->subkeys[index] == key) break;
-    assert( index <= parent->last_subkey );
+    assert( parent->subkeys[key->index] == key );
 
     /* we can only delete a key that has no subkeys */
     if (key->last_subkey >= 0)
@@ -998,11 +1214,54 @@ static int delete_key( struct key *key, int recurse )
     }
 
     if (debug_level > 1) dump_operation( key, NULL, "Delete" );
-    free_subkey( parent, index );
+    add_deleted_subkey( parent, key );
+    free_subkey( parent, key->index );
     touch_key( parent, REG_NOTIFY_CHANGE_NAME );
     return 0;
 }
 
+/* (re)build the value hash table; return 1 if OK, 0 on error */
+static int rehash_values( struct key *key )
+{
+    unsigned int bucket, size = key->value_hash_size ? key->value_hash_size : MIN_HASH_ENTRIES;
+    int i;
+
+    while (size < (unsigned int)key->nb_values) size *= 2;
+    if (size != key->value_hash_size)
+    {
+        int *hash;
+        if (!(hash = mem_alloc( size * sizeof(*hash) ))) return 0;
+        free( key->value_hash );
+        key->value_hash = hash;
+        key->value_hash_size = size;
+    }
+    for (bucket = 0; bucket < size; bucket++) key->value_hash[bucket] = -1;
+    for (i = 0; i <= key->last_value; i++)
+    {
+        bucket = hash_name( key->values[i].name, key->values[i].namelen ) & (size - 1);
+        key->values[i].hash_next = key->value_hash[bucket];
+        key->value_hash[bucket] = i;
+    }
+    return 1;
+}
+
+static int compare_values( const void *p1, const void *p2 )
+{
+    const struct key_value *value1 = p1;
+    const struct key_value *value2 = p2;
+
+    return compare_names( value1->name, value1->namelen, value2->name, value2->namelen );
+}
+
+/* sort the values array after some were appended out of order */
+static void sort_values( struct key *key )
+{
+    if (!(key->flags & KEY_UNSORTED_VALUES)) return;
+    qsort( key->values, key->last_value + 1, sizeof(*key->values), compare_values );
+    key->flags &= ~KEY_UNSORTED_VALUES;
+    rehash_values( key );  /* can't fail, the table size doesn't change */
+}
+
 /* try to grow the array of values; return 1 if OK, 0 on error */
 static int grow_values( struct key *key )
 {
@@ -1025,6 +1284,7 @@ static int grow_values( struct key *key )
     }
     key->values = new_val;
     key->nb_values = nb_values;
+    if (key->value_hash || nb_values > MIN_HASH_ENTRIES) return rehash_values( key );
     return 1;
 }
 
@@ -1032,16 +1292,27 @@ static int grow_values( struct key *key )
 static struct key_value *find_value( const struct key *key, const struct unicode_str *name, int *index )
 {
     int i, min, max, res;
-    data_size_t len;
+
+    if (key->value_hash)
+    {
+        for (i = key->value_hash[hash_name( name->str, name->len ) & (key->value_hash_size - 1)];
+             i != -1; i = key->values[i].hash_next)
+        {
+            if (key->values[i].namelen != name->len) continue;
+            if (memicmpW( key->values[i].name, name->str, name->len / sizeof(WCHAR) )) continue;
+            *index = i;
+            return &key->values[i];
+        }
+        *index = key->last_value + 1;  /* append it */
+        return NULL;
+    }
 
     min = 0;
     max = key->last_value;
     while (min <= max)
     {
         i = (min + max) / 2;
-        len = min( key->values[i].namelen, name->len );
-        res = memicmpW( key->values[i].name, name->str, len / sizeof(WCHAR) );
-        if (!res) res = key->values[i].namelen - name->len;
+        res = compare_names( key->values[i].name, key->values[i].namelen, name->str, name->len );
         if (!res)
         {
             *index = i;
@@ -1077,6 +1348,17 @@ static struct key_value *insert_value( struct key *key, const struct unicode_str
     value->namelen = name->len;
     value->len     = 0;
     value->data    = NULL;
+    if (key->value_hash)
+    {
+        if (index == key->last_value)  /* appended */
+        {
+            unsigned int bucket = hash_name( name->str, name->len ) & (key->value_hash_size - 1);
+            value->hash_next = key->value_hash[bucket];
+            key->value_hash[bucket] = index;
+            if (index && compare_values( value - 1, value ) > 0) key->flags |= KEY_UNSORTED_VALUES;
+        }
+        else rehash_values( key );
+    }
     return value;
 }
 
@@ -1159,6 +1441,7 @@ static void enum_value( struct key *key, int i, int info_class, struct enum_key_
         void *data;
         data_size_t namelen, maxlen;
 
+        sort_values( key );
         value = &key->values[i];
         reply->type = value->type;
         namelen = value->namelen;
@@ -1211,9 +1494,27 @@ static void delete_value( struct key *key, const struct unicode_str *name )
         return;
     }
     if (debug_level > 1) dump_operation( key, value, "Delete" );
+    if (key->value_hash)
+    {
+        int *ptr = &key->value_hash[hash_name( value->name, value->namelen ) & (key->value_hash_size - 1)];
+
+        while (*ptr != index) ptr = &key->values[*ptr].hash_next;
+        *ptr = value->hash_next;
+    }
     free( value->name );
     free( value->data );
-    for (i = index; i < key->last_value; i++) key->values[i] = key->values[i + 1];
+    if (key->value_hash && index < key->last_value)
+    {
+        /* move the last value into the hole instead of shifting the array */
+        int *ptr;
+
+        *value = key->values[key->last_value];
+        ptr = &key->value_hash[hash_name( value->name, value->namelen ) & (key->value_hash_size - 1)];
+        while (*ptr != key->last_value) ptr = &key->values[*ptr].hash_next;
+        *ptr = index;
+        key->flags |= KEY_UNSORTED_VALUES;
+    }
+    else for (i = index; i < key->last_value; i++) key->values[i] = key->values[i + 1];
     key->last_value--;
     touch_key( key, REG_NOTIFY_CHANGE_LAST_SET );
 
@@ -1230,6 +1531,21 @@ static void delete_value( struct key *key, const struct unicode_str *name )
     }
 }
 
+/* delete all the values of a key */
+static void clear_values( struct key *key )
+{
+    int i;
+
+    for (i = 0; i <= key->last_value; i++)
+    {
+        free( key->values[i].name );
+        free( key->values[i].data );
+    }
+    key->last_value = -1;
+    key->flags &= ~KEY_UNSORTED_VALUES;
+    if (key->value_hash) rehash_values( key );
+}
+
 /* get the registry key corresponding to an hkey handle */
 static struct key *get_hkey_obj( obj_handle_t hkey, unsigned int access )
 {
@@ -1451,6 +1767,8 @@ static int load_key_option( struct key *key, const char *buffer, struct file_loa
         key->classlen = len;
     }
     if (!strncmp( buffer, "#link", 5 )) key->flags |= KEY_SYMLINK;
+    if (!strcmp( buffer, "#clear" )) clear_values( key );
+    if (!strcmp( buffer, "#delete" ) && key->parent) delete_key( key, 1 );
     /* ignore unknown options */
     return 1;
 }
@@ -1695,11 +2013,46 @@ static void load_registry( struct key *key, obj_handle_t handle )
         {
             load_keys( key, NULL, f, -1 );
             fclose( f );
+            make_changed( key );
         }
         else file_set_error();
     }
 }
 
+/* get the name of the journal of a registry file */
+static char *get_journal_name( const char *filename )
+{
+    static const char suffix[] = ".journal";
+    char *name;
+
+    if ((name = malloc( strlen(filename) + sizeof(suffix) )))
+    {
+        strcpy( name, filename );
+        strcat( name, suffix );
+    }
+    return name;
+}
+
+/* replay the journal of one of the initial registry files */
+static void load_journal( const char *filename, struct key *key )
+{
+    char *name;
+    FILE *f;
+
+    if (!(name = get_journal_name( filename ))) return;
+    if ((f = fopen( name, "r" )))
+    {
+        load_keys( key, name, f, 0 );
+        fclose( f );
+        if (get_error() == STATUS_NOT_REGISTRY_FILE)
+            fprintf( stderr, "%s is not a valid registry file\n", name );
+        clear_error();
+    }
+    free( name );
+    /* the files now match the contents of the branch */
+    make_clean( key );
+}
+
 /* load one of the initial registry files */
 static int load_init_registry_from_file( const char *filename, struct key *key )
 {
@@ -1715,6 +2068,7 @@ static int load_init_registry_from_file( const char *filename, struct key *key )
             return 1;
         }
     }
+    load_journal( filename, key );
 
     assert( save_branch_count < MAX_SAVE_BRANCH_INFO );
 
@@ -1900,7 +2254,7 @@ static void save_registry( struct key *key, obj_handle_t handle )
 static int save_branch( struct key *key, const char *path )
 {
     struct stat st;
-    char *p, *tmp = NULL;
+    char *p, *tmp = NULL, *journal;
     int fd, count = 0, ret = 0;
     FILE *f;
 
@@ -1964,12 +2318,101 @@ static int save_branch( struct key *key, const char *path )
         if (!ret) unlink( tmp );
     }
 
+    /* the journal is obsolete once the new file is in place */
+    if (ret && (journal = get_journal_name( path )))
+    {
+        unlink( journal );
+        free( journal );
+    }
+
 done:
     free( tmp );
     if (ret) make_clean( key );
     return ret;
 }
 
+/* append the modified keys of a branch to the journal */
+static void journal_subkeys( struct key *key, const struct key *base, FILE *f )
+{
+    struct deleted_subkey *deleted;
+    int i;
+
+    if (key->flags & KEY_VOLATILE) return;
+    if (!(key->flags & KEY_DIRTY)) return;
+
+    /* deletions must come first, the keys may have been created again */
+    for (deleted = key->deleted; deleted; deleted = deleted->next)
+    {
+        fprintf( f, "\n[" );
+        if (key != base)
+        {
+            dump_path( key, base, f );
+            fprintf( f, "\\\\" );
+        }
+        dump_strW( deleted->name, deleted->namelen / sizeof(WCHAR), f, "[]" );
+        fprintf( f, "]\n#delete\n" );
+    }
+    if (key->flags & KEY_CHANGED)
+    {
+        fprintf( f, "\n[" );
+        if (key != base) dump_path( key, base, f );
+        fprintf( f, "] %u\n", (unsigned int)((key->modif - ticks_1601_to_1970) / TICKS_PER_SEC) );
+        fprintf( f, "#time=%x%08x\n", (unsigned int)(key->modif >> 32), (unsigned int)key->modif );
+        if (key->class)
+        {
+            fprintf( f, "#class=\"" );
+            dump_strW( key->class, key->classlen / sizeof(WCHAR), f, "\"\"" );
+            fprintf( f, "\"\n" );
+        }
+        if (key->flags & KEY_SYMLINK) fputs( "#link\n", f );
+        fputs( "#clear\n", f );
+        sort_values( key );
+        for (i = 0; i <= key->last_value; i++) dump_value( &key->values[i], f );
+    }
+    for (i = 0; i <= key->last_subkey; i++) journal_subkeys( key->subkeys[i], base, f );
+}
+
+/* save the modifications of a registry branch to its journal */
+/* return 0 if the whole branch needs to be saved instead */
+static int journal_branch( struct key *key, const char *path )
+{
+    struct stat st, journal_st;
+    off_t max_size = min_journal_size;
+    char *name;
+    int fd, ret = 0;
+    FILE *f;
+
+    if (!(key->flags & KEY_DIRTY)) return 1;
+
+    /* special files are always written directly */
+    if (lstat( path, &st ) || !S_ISREG(st.st_mode) || st.st_nlink > 1) return 0;
+    if (st.st_size / 4 > max_size) max_size = st.st_size / 4;
+
+    if (!(name = get_journal_name( path ))) return 0;
+    if ((fd = open( name, O_WRONLY | O_APPEND | O_CREAT, 0666 )) == -1) goto done;
+    if (fstat( fd, &journal_st ) || journal_st.st_size >= max_size || !(f = fdopen( fd, "a" )))
+    {
+        close( fd );
+        goto done;
+    }
+
+    if (debug_level > 1)
+    {
+        fprintf( stderr, "%s: ", name );
+        dump_operation( key, NULL, "journaling" );
+    }
+
+    if (!journal_st.st_size) fprintf( f, "WINE REGISTRY Version 2\n" );
+    journal_subkeys( key, key, f );
+    if (!(ret = !fflush( f ))) ftruncate( fd, journal_st.st_size );  /* don't leave partial records */
+    fclose( f );
+
+done:
+    free( name );
+    if (ret) make_clean( key );
+    return ret;
+}
+
 /* periodic saving of the registry */
 static void periodic_save( void *arg )
 {
@@ -1978,7 +2421,10 @@ static void periodic_save( void *arg )
     if (fchdir( config_dir_fd ) == -1) return;
     save_timeout_user = NULL;
     for (i = 0; i < save_branch_count; i++)
-        save_branch( save_branch_info[i].key, save_branch_info[i].path );
+    {
+        if (!journal_branch( save_branch_info[i].key, save_branch_info[i].path ))
+            save_branch( save_branch_info[i].key, save_branch_info[i].path );
+    }
     if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
     set_periodic_save_timer();
 }
@@ -24,6 +24,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #ifdef HAVE_PWD_H
 #include <pwd.h>
 #endif
@@ -35,9 +36,15 @@
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
 #ifdef HAVE_SYS_SOCKET_H
 # include <sys/socket.h>
 #endif
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
 #ifdef HAVE_SYS_WAIT_H
 # include <sys/wait.h>
 #endif
@@ -51,6 +58,9 @@
 #ifdef HAVE_POLL_H
 #include <poll.h>
 #endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 #ifdef __APPLE__
 # include <mach/mach_time.h>
 #endif
@@ -73,6 +83,12 @@
 #define SCM_RIGHTS 1
 #endif
 
+/* memfd sealing, missing from older headers */
+#ifndef F_GET_SEALS
+#define F_GET_SEALS    1034
+#define F_SEAL_SHRINK  0x0002
+#endif
+
 /* path names for server master Unix socket */
 static const char * const server_socket_name = "socket";   /* name of the socket file */
 static const char * const server_lock_name = "lock";       /* name of the server lock file */
@@ -120,14 +136,15 @@ static const struct fd_ops master_socket_fd_ops =
 };
 
 
-struct thread *current = NULL;  /* thread handling the current request */
-unsigned int global_error = 0;  /* global error code for when no thread is current */
+THREAD_LOCAL struct thread *current = NULL;  /* thread handling the current request */
+THREAD_LOCAL unsigned int global_error = 0;  /* global error code for when no thread is current */
 timeout_t server_start_time = 0;  /* server startup time */
 int server_dir_fd = -1;    /* file descriptor for the server dir */
 int config_dir_fd = -1;    /* file descriptor for the config dir */
 
 static struct master_socket *master_socket;  /* the master socket object */
 static struct timeout_user *master_timeout;
+static THREAD_LOCAL int in_worker_thread;    /* are we running in a worker thread? */
 
 /* complain about a protocol error and terminate the client connection */
 void fatal_protocol_error( struct thread *thread, const char *err, ... )
@@ -188,11 +205,118 @@ void write_reply( struct thread *thread )
         fatal_protocol_error( thread, "reply write: %s\n", strerror( errno ));
 }
 
+#if defined(__linux__) && defined(__NR_futex)
+
+static inline int futex_wake( int *addr, int count )
+{
+    return syscall( __NR_futex, addr, 1 /* FUTEX_WAKE */, count, NULL, 0, 0 );
+}
+
+/* map a shared memory area created by the client */
+void *map_client_shm( int fd, size_t size )
+{
+    struct stat st;
+    void *ptr;
+    int seals;
+
+    /* make sure the client can't truncate the file under our feet */
+    if ((seals = fcntl( fd, F_GET_SEALS )) == -1 || !(seals & F_SEAL_SHRINK) ||
+        fstat( fd, &st ) == -1 || st.st_size < size)
+    {
+        set_error( STATUS_INVALID_PARAMETER );
+        return NULL;
+    }
+    if ((ptr = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 )) == MAP_FAILED)
+    {
+        file_set_error();
+        return NULL;
+    }
+    return ptr;
+}
+
+/* map the shared memory area used to reply to the small requests of a thread */
+int set_request_shm( struct thread *thread, int fd )
+{
+    if (thread->request_shm)
+    {
+        set_error( STATUS_INVALID_PARAMETER );
+        return 0;
+    }
+    if (!(thread->request_shm = map_client_shm( fd, sizeof(struct request_shm) ))) return 0;
+    return 1;
+}
+
+/* unmap the shared memory area of a thread, waking up the client if it's waiting on it */
+void close_request_shm( struct thread *thread )
+{
+    struct request_shm *shm = thread->request_shm;
+
+    if (!shm) return;
+    __sync_lock_test_and_set( &shm->state, REQUEST_SHM_CLOSED );
+    futex_wake( &shm->state, INT_MAX );
+    munmap( shm, sizeof(*shm) );
+    thread->request_shm = NULL;
+    thread->reply_shm = 0;
+}
+
+/* store the reply of the current thread in its shared memory area */
+static void send_reply_shm( union generic_reply *reply )
+{
+    struct request_shm *shm = current->request_shm;
+
+    current->reply_shm = 0;
+    memcpy( &shm->reply, reply, sizeof(*reply) );
+    if (current->reply_size) memcpy( shm->data, current->reply_data, current->reply_size );
+    free( current->reply_data );
+    current->reply_data = NULL;
+
+    /* the full barrier orders the state change with the read of the waiting flag */
+    if (__sync_val_compare_and_swap( &shm->state, REQUEST_SHM_PENDING,
+                                     REQUEST_SHM_REPLIED ) != REQUEST_SHM_PENDING)
+    {
+        if (in_worker_thread) current->worker_error = EPROTO;
+        else fatal_protocol_error( current, "bad shared memory state %d\n", shm->state );
+        return;
+    }
+    if (shm->waiting) futex_wake( &shm->state, 1 );
+}
+
+#else  /* __linux__ */
+
+void *map_client_shm( int fd, size_t size )
+{
+    set_error( STATUS_NOT_SUPPORTED );
+    return NULL;
+}
+
+int set_request_shm( struct thread *thread, int fd )
+{
+    set_error( STATUS_NOT_SUPPORTED );
+    return 0;
+}
+
+void close_request_shm( struct thread *thread )
+{
+}
+
+static void send_reply_shm( union generic_reply *reply )
+{
+    assert( 0 );  /* set_request_shm can't succeed */
+}
+
+#endif  /* __linux__ */
+
 /* send a reply to the current thread */
 static void send_reply( union generic_reply *reply )
 {
     int ret;
 
+    if (current->reply_shm)
+    {
+        send_reply_shm( reply );
+        return;
+    }
+
     if (!current->reply_size)
     {
         if ((ret = write( get_unix_fd( current->reply_fd ),
@@ -222,7 +346,9 @@ static void send_reply( union generic_reply *reply )
     return;
 
  error:
-    if (ret >= 0)
+    if (in_worker_thread)  /* leave it to the main thread */
+        current->worker_error = (ret >= 0) ? EIO : errno;
+    else if (ret >= 0)
         fatal_protocol_error( current, "partial write %d\n", ret );
     else if (errno == EPIPE)
         kill_thread( current, 0 );  /* normal death */
@@ -264,6 +390,315 @@ static void call_req_handler( struct thread *thread )
         }
     }
     current = NULL;
+    free( thread->req_data );
+    thread->req_data = NULL;
+}
+
+#ifdef USE_WORKER_THREADS
+
+/* Worker threads
+ *
+ * The main loop holds the server lock exclusively while it processes
+ * events, and releases it while waiting. Requests that don't modify the
+ * server state besides object refcounts are handed over to worker
+ * threads, which run them concurrently holding the lock in shared mode.
+ * A worker sends the reply and re-enables the request fd itself; anything
+ * that would modify the server state (write errors, terminated threads,
+ * releasing the last reference) is left to the main thread.
+ */
+
+struct worker_notify
+{
+    struct object        obj;        /* object header */
+    struct fd           *fd;         /* read end of the notification pipe */
+};
+
+static void worker_notify_dump( struct object *obj, int verbose );
+static void worker_notify_destroy( struct object *obj );
+static void worker_notify_poll_event( struct fd *fd, int event );
+
+static const struct object_ops worker_notify_ops =
+{
+    sizeof(struct worker_notify),  /* size */
+    worker_notify_dump,            /* dump */
+    no_get_type,                   /* get_type */
+    no_add_queue,                  /* add_queue */
+    NULL,                          /* remove_queue */
+    NULL,                          /* signaled */
+    NULL,                          /* satisfied */
+    no_signal,                     /* signal */
+    no_get_fd,                     /* get_fd */
+    no_map_access,                 /* map_access */
+    default_get_sd,                /* get_sd */
+    default_set_sd,                /* set_sd */
+    no_lookup_name,                /* lookup_name */
+    no_open_file,                  /* open_file */
+    no_close_handle,               /* close_handle */
+    worker_notify_destroy          /* destroy */
+};
+
+static const struct fd_ops worker_notify_fd_ops =
+{
+    NULL,                          /* get_poll_events */
+    worker_notify_poll_event,      /* poll_event */
+    NULL,                          /* flush */
+    NULL,                          /* get_fd_type */
+    NULL,                          /* ioctl */
+    NULL,                          /* queue_async */
+    NULL,                          /* reselect_async */
+    NULL                           /* cancel_async */
+};
+
+static pthread_rwlock_t server_lock;
+static pthread_mutex_t worker_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t worker_cond = PTHREAD_COND_INITIALIZER;
+static struct list worker_queue = LIST_INIT(worker_queue);  /* threads waiting for a worker */
+static struct list worker_done = LIST_INIT(worker_done);    /* threads to finish in the main thread */
+static struct worker_notify *worker_notify;
+static int worker_notify_pipe = -1;  /* write end of the notification pipe */
+static int nb_workers;
+
+static void worker_notify_dump( struct object *obj, int verbose )
+{
+    fputs( "Worker notification\n", stderr );
+}
+
+static void worker_notify_destroy( struct object *obj )
+{
+    struct worker_notify *notify = (struct worker_notify *)obj;
+    release_object( notify->fd );
+}
+
+/* check if a request can be run by a worker thread */
+/* it must not modify anything besides object refcounts and the current thread reply */
+static int is_worker_request( struct thread *thread )
+{
+    const union generic_request *req = &thread->req;
+
+    switch (req->request_header.req)
+    {
+    case REQ_get_key_value:
+    case REQ_get_object_info:
+    case REQ_get_handle_unix_name:
+        return 1;
+    case REQ_enum_key:
+        /* enumerating an unsorted key sorts it, which needs the exclusive lock */
+        return req->enum_key_request.index == -1 ||
+               !key_enum_needs_sort( thread->process, req->enum_key_request.hkey, 0 );
+    case REQ_enum_key_value:
+        return !key_enum_needs_sort( thread->process, req->enum_key_value_request.hkey, 1 );
+    default:
+        return 0;
+    }
+}
+
+/* finish the requests that the workers couldn't handle completely */
+static void worker_notify_poll_event( struct fd *fd, int event )
+{
+    struct list done = LIST_INIT(done);
+    struct list *ptr;
+    char buffer[64];
+
+    while (read( get_unix_fd( fd ), buffer, sizeof(buffer) ) > 0) /* nothing */;
+
+    pthread_mutex_lock( &worker_mutex );
+    list_move_tail( &done, &worker_done );
+    pthread_mutex_unlock( &worker_mutex );
+
+    while ((ptr = list_head( &done )))
+    {
+        struct thread *thread = LIST_ENTRY( ptr, struct thread, worker_entry );
+
+        list_remove( &thread->worker_entry );
+        if (thread->state != TERMINATED && thread->worker_defer)
+        {
+            call_req_handler( thread );
+            if (thread->state != TERMINATED && !thread->reply_towrite)
+                set_fd_events( thread->request_fd, POLLIN );
+        }
+        else if (thread->state != TERMINATED && thread->worker_error)
+        {
+            if (thread->worker_error == EPIPE)
+                kill_thread( thread, 0 );  /* normal death */
+            else
+                fatal_protocol_error( thread, "reply write: %s\n", strerror( thread->worker_error ));
+        }
+        thread->worker_error = 0;
+        thread->worker_defer = 0;
+        release_object( thread );
+    }
+}
+
+/* run a request in a worker thread, return FALSE if the main thread has to finish it */
+static int run_worker_request( struct thread *thread )
+{
+    union generic_reply reply;
+    enum request req = thread->req.request_header.req;
+
+    if (thread->state == TERMINATED) return 0;
+    /* the main thread may have made it unsafe since the request was queued */
+    if (!is_worker_request( thread ))
+    {
+        thread->worker_defer = 1;
+        return 0;
+    }
+
+    current = thread;
+    current->reply_size = 0;
+    clear_error();
+    memset( &reply, 0, sizeof(reply) );
+
+    req_handlers[req]( &current->req, &reply );
+
+    reply.reply_header.error = current->error;
+    reply.reply_header.reply_size = current->reply_size;
+    send_reply( &reply );
+    current = NULL;
+
+    free( thread->req_data );
+    thread->req_data = NULL;
+    if (thread->worker_error) return 0;
+    /* go back to waiting for requests, unless we have to wait for POLLOUT */
+    if (!thread->reply_towrite) set_fd_events( thread->request_fd, POLLIN );
+    return 1;
+}
+
+static void *worker_thread( void *arg )
+{
+    struct thread *thread;
+    sigset_t sigset;
+    char dummy = 0;
+
+    /* signals are handled by the main thread */
+    sigfillset( &sigset );
+    pthread_sigmask( SIG_BLOCK, &sigset, NULL );
+    in_worker_thread = 1;
+
+    for (;;)
+    {
+        pthread_mutex_lock( &worker_mutex );
+        while (list_empty( &worker_queue )) pthread_cond_wait( &worker_cond, &worker_mutex );
+        thread = LIST_ENTRY( list_head( &worker_queue ), struct thread, worker_entry );
+        list_remove( &thread->worker_entry );
+        pthread_mutex_unlock( &worker_mutex );
+
+        pthread_rwlock_rdlock( &server_lock );
+        if (run_worker_request( thread ))
+        {
+            /* the thread is still alive so this is not the last reference */
+            release_object( thread );
+        }
+        else
+        {
+            pthread_mutex_lock( &worker_mutex );
+            list_add_tail( &worker_done, &thread->worker_entry );
+            pthread_mutex_unlock( &worker_mutex );
+            write( worker_notify_pipe, &dummy, 1 );
+        }
+        pthread_rwlock_unlock( &server_lock );
+    }
+    return NULL;
+}
+
+/* hand over a request to a worker thread if possible */
+static int queue_worker_request( struct thread *thread )
+{
+    if (!nb_workers || debug_level || !thread->reply_fd) return 0;
+    if (!is_worker_request( thread )) return 0;
+    if (!can_set_fd_events_async()) return 0;
+
+    /* stop listening to the thread until the reply is sent */
+    set_fd_events( thread->request_fd, 0 );
+    grab_object( thread );
+
+    pthread_mutex_lock( &worker_mutex );
+    list_add_tail( &worker_queue, &thread->worker_entry );
+    pthread_cond_signal( &worker_cond );
+    pthread_mutex_unlock( &worker_mutex );
+    return 1;
+}
+
+/* start the worker threads; the main thread holds the server lock from now on */
+void start_worker_threads( int count )
+{
+    pthread_rwlockattr_t attr;
+    pthread_t id;
+    int pipe_fds[2];
+
+    if (count <= 0 || !can_set_fd_events_async()) return;
+
+    pthread_rwlockattr_init( &attr );
+#ifdef PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP
+    /* don't let a constant flow of worker requests starve the main loop */
+    pthread_rwlockattr_setkind_np( &attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP );
+#endif
+    pthread_rwlock_init( &server_lock, &attr );
+    pthread_rwlockattr_destroy( &attr );
+
+    if (pipe( pipe_fds ) == -1) return;
+    fcntl( pipe_fds[0], F_SETFL, O_NONBLOCK );
+    fcntl( pipe_fds[1], F_SETFL, O_NONBLOCK );
+    if (!(worker_notify = alloc_object( &worker_notify_ops )))
+    {
+        close( pipe_fds[0] );
+        close( pipe_fds[1] );
+        return;
+    }
+    if (!(worker_notify->fd = create_anonymous_fd( &worker_notify_fd_ops, pipe_fds[0],
+                                                   &worker_notify->obj, 0 )))
+    {
+        release_object( worker_notify );
+        worker_notify = NULL;
+        close( pipe_fds[1] );
+        return;
+    }
+    make_object_static( &worker_notify->obj );
+    set_fd_events( worker_notify->fd, POLLIN );
+    worker_notify_pipe = pipe_fds[1];
+
+    pthread_rwlock_wrlock( &server_lock );
+    for (nb_workers = 0; nb_workers < count; nb_workers++)
+        if (pthread_create( &id, NULL, worker_thread, NULL )) break;
+    if (debug_level) fprintf( stderr, "wineserver: started %d worker threads\n", nb_workers );
+}
+
+/* release the server lock while the main loop is waiting */
+void unlock_main_loop(void)
+{
+    if (nb_workers) pthread_rwlock_unlock( &server_lock );
+}
+
+/* get the server lock back once the main loop has something to do */
+void lock_main_loop(void)
+{
+    if (nb_workers) pthread_rwlock_wrlock( &server_lock );
+}
+
+#else  /* USE_WORKER_THREADS */
+
+static int queue_worker_request( struct thread *thread )
+{
+    return 0;
+}
+
+void start_worker_threads( int count )
+{
+}
+
+void unlock_main_loop(void)
+{
+}
+
+void lock_main_loop(void)
+{
+}
+
+#endif  /* USE_WORKER_THREADS */
+
+/* run a request once it has been read completely */
+static void handle_request( struct thread *thread )
+{
+    if (!queue_worker_request( thread )) call_req_handler( thread );
 }
 
 /* read a request from a thread */
@@ -275,10 +710,23 @@ void read_request( struct thread *thread )
     {
         if ((ret = read( get_unix_fd( thread->request_fd ), &thread->req,
                          sizeof(thread->req) )) != sizeof(thread->req)) goto error;
+        if (thread->req.request_header.req & REQUEST_SHM_FLAG)
+        {
+            /* only requests without variable data can be replied through the shared memory */
+            if (!thread->request_shm || thread->req.request_header.request_size ||
+                thread->req.request_header.reply_size > REQUEST_SHM_DATA_SIZE)
+            {
+                fatal_protocol_error( thread, "invalid shared memory request %x\n",
+                                      thread->req.request_header.req );
+                return;
+            }
+            thread->req.request_header.req &= ~REQUEST_SHM_FLAG;
+            thread->reply_shm = 1;
+        }
         if (!(thread->req_toread = thread->req.request_header.request_size))
         {
             /* no data, handle request at once */
-            call_req_handler( thread );
+            handle_request( thread );
             return;
         }
         if (!(thread->req_data = malloc( thread->req_toread )))
@@ -299,9 +747,7 @@ void read_request( struct thread *thread )
         if (ret <= 0) break;
         if (!(thread->req_toread -= ret))
         {
-            call_req_handler( thread );
-            free( thread->req_data );
-            thread->req_data = NULL;
+            handle_request( thread );
             return;
         }
     }
@@ -50,6 +50,12 @@ extern int receive_fd( struct process *process );
 extern int send_client_fd( struct process *process, int fd, obj_handle_t handle );
 extern void read_request( struct thread *thread );
 extern void write_reply( struct thread *thread );
+extern void *map_client_shm( int fd, size_t size );
+extern int set_request_shm( struct thread *thread, int fd );
+extern void close_request_shm( struct thread *thread );
+extern void start_worker_threads( int count );
+extern void unlock_main_loop(void);
+extern void lock_main_loop(void);
 extern unsigned int get_tick_count(void);
 extern void open_master_socket(void);
 extern void close_master_socket( timeout_t timeout );
@@ -112,6 +118,9 @@ DECL_HANDLER(new_thread);
 DECL_HANDLER(get_startup_info);
 DECL_HANDLER(init_process_done);
 DECL_HANDLER(init_thread);
+DECL_HANDLER(set_request_shm);
+DECL_HANDLER(set_sync_shm);
+DECL_HANDLER(set_handle_shm);
 DECL_HANDLER(terminate_process);
 DECL_HANDLER(terminate_thread);
 DECL_HANDLER(get_process_info);
@@ -150,6 +159,7 @@ DECL_HANDLER(open_file_object);
 DECL_HANDLER(alloc_file_handle);
 DECL_HANDLER(get_handle_unix_name);
 DECL_HANDLER(get_handle_fd);
+DECL_HANDLER(get_handle_fds);
 DECL_HANDLER(flush);
 DECL_HANDLER(lock_file);
 DECL_HANDLER(unlock_file);
@@ -357,9 +367,11 @@ DECL_HANDLER(create_completion);
 DECL_HANDLER(open_completion);
 DECL_HANDLER(add_completion);
 DECL_HANDLER(remove_completion);
+DECL_HANDLER(remove_completions);
 DECL_HANDLER(query_completion);
 DECL_HANDLER(set_completion_info);
 DECL_HANDLER(add_fd_completion);
+DECL_HANDLER(get_fd_completion);
 DECL_HANDLER(set_fd_disp_info);
 DECL_HANDLER(set_fd_name_info);
 DECL_HANDLER(get_window_layered_info);
@@ -388,6 +400,9 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_get_startup_info,
     (req_handler)req_init_process_done,
     (req_handler)req_init_thread,
+    (req_handler)req_set_request_shm,
+    (req_handler)req_set_sync_shm,
+    (req_handler)req_set_handle_shm,
     (req_handler)req_terminate_process,
     (req_handler)req_terminate_thread,
     (req_handler)req_get_process_info,
@@ -426,6 +441,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_alloc_file_handle,
     (req_handler)req_get_handle_unix_name,
     (req_handler)req_get_handle_fd,
+    (req_handler)req_get_handle_fds,
     (req_handler)req_flush,
     (req_handler)req_lock_file,
     (req_handler)req_unlock_file,
@@ -633,9 +649,11 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_open_completion,
     (req_handler)req_add_completion,
     (req_handler)req_remove_completion,
+    (req_handler)req_remove_completions,
     (req_handler)req_query_completion,
     (req_handler)req_set_completion_info,
     (req_handler)req_add_fd_completion,
+    (req_handler)req_get_fd_completion,
     (req_handler)req_set_fd_disp_info,
     (req_handler)req_set_fd_name_info,
     (req_handler)req_get_window_layered_info,
@@ -739,6 +757,12 @@ C_ASSERT( FIELD_OFFSET(struct init_thread_reply, info_size) == 24 );
 C_ASSERT( FIELD_OFFSET(struct init_thread_reply, version) == 28 );
 C_ASSERT( FIELD_OFFSET(struct init_thread_reply, all_cpus) == 32 );
 C_ASSERT( sizeof(struct init_thread_reply) == 40 );
+C_ASSERT( FIELD_OFFSET(struct set_request_shm_request, shm_fd) == 12 );
+C_ASSERT( sizeof(struct set_request_shm_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct set_sync_shm_request, shm_fd) == 12 );
+C_ASSERT( sizeof(struct set_sync_shm_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct set_handle_shm_request, shm_fd) == 12 );
+C_ASSERT( sizeof(struct set_handle_shm_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct terminate_process_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct terminate_process_request, exit_code) == 16 );
 C_ASSERT( sizeof(struct terminate_process_request) == 24 );
@@ -873,6 +897,7 @@ C_ASSERT( FIELD_OFFSET(struct create_event_request, manual_reset) == 20 );
 C_ASSERT( FIELD_OFFSET(struct create_event_request, initial_state) == 24 );
 C_ASSERT( sizeof(struct create_event_request) == 32 );
 C_ASSERT( FIELD_OFFSET(struct create_event_reply, handle) == 8 );
+C_ASSERT( FIELD_OFFSET(struct create_event_reply, shm_idx) == 12 );
 C_ASSERT( sizeof(struct create_event_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct event_op_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct event_op_request, op) == 16 );
@@ -904,6 +929,7 @@ C_ASSERT( FIELD_OFFSET(struct create_mutex_request, attributes) == 16 );
 C_ASSERT( FIELD_OFFSET(struct create_mutex_request, owned) == 20 );
 C_ASSERT( sizeof(struct create_mutex_request) == 24 );
 C_ASSERT( FIELD_OFFSET(struct create_mutex_reply, handle) == 8 );
+C_ASSERT( FIELD_OFFSET(struct create_mutex_reply, shm_idx) == 12 );
 C_ASSERT( sizeof(struct create_mutex_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct release_mutex_request, handle) == 12 );
 C_ASSERT( sizeof(struct release_mutex_request) == 16 );
@@ -921,6 +947,7 @@ C_ASSERT( FIELD_OFFSET(struct create_semaphore_request, initial) == 20 );
 C_ASSERT( FIELD_OFFSET(struct create_semaphore_request, max) == 24 );
 C_ASSERT( sizeof(struct create_semaphore_request) == 32 );
 C_ASSERT( FIELD_OFFSET(struct create_semaphore_reply, handle) == 8 );
+C_ASSERT( FIELD_OFFSET(struct create_semaphore_reply, shm_idx) == 12 );
 C_ASSERT( sizeof(struct create_semaphore_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct release_semaphore_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct release_semaphore_request, count) == 16 );
@@ -972,6 +999,8 @@ C_ASSERT( FIELD_OFFSET(struct get_handle_fd_reply, cacheable) == 12 );
 C_ASSERT( FIELD_OFFSET(struct get_handle_fd_reply, access) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_handle_fd_reply, options) == 20 );
 C_ASSERT( sizeof(struct get_handle_fd_reply) == 24 );
+C_ASSERT( sizeof(struct get_handle_fds_request) == 16 );
+C_ASSERT( sizeof(struct get_handle_fds_reply) == 8 );
 C_ASSERT( FIELD_OFFSET(struct flush_request, blocking) == 12 );
 C_ASSERT( FIELD_OFFSET(struct flush_request, async) == 16 );
 C_ASSERT( sizeof(struct flush_request) == 56 );
@@ -2221,6 +2250,9 @@ C_ASSERT( FIELD_OFFSET(struct remove_completion_reply, cvalue) == 16 );
 C_ASSERT( FIELD_OFFSET(struct remove_completion_reply, information) == 24 );
 C_ASSERT( FIELD_OFFSET(struct remove_completion_reply, status) == 32 );
 C_ASSERT( sizeof(struct remove_completion_reply) == 40 );
+C_ASSERT( FIELD_OFFSET(struct remove_completions_request, handle) == 12 );
+C_ASSERT( sizeof(struct remove_completions_request) == 16 );
+C_ASSERT( sizeof(struct remove_completions_reply) == 8 );
 C_ASSERT( FIELD_OFFSET(struct query_completion_request, handle) == 12 );
 C_ASSERT( sizeof(struct query_completion_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct query_completion_reply, depth) == 8 );
@@ -2234,6 +2266,11 @@ C_ASSERT( FIELD_OFFSET(struct add_fd_completion_request, cvalue) == 16 );
 C_ASSERT( FIELD_OFFSET(struct add_fd_completion_request, information) == 24 );
 C_ASSERT( FIELD_OFFSET(struct add_fd_completion_request, status) == 32 );
 C_ASSERT( sizeof(struct add_fd_completion_request) == 40 );
+C_ASSERT( FIELD_OFFSET(struct get_fd_completion_request, handle) == 12 );
+C_ASSERT( sizeof(struct get_fd_completion_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_fd_completion_reply, completion) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_fd_completion_reply, ckey) == 16 );
+C_ASSERT( sizeof(struct get_fd_completion_reply) == 24 );
 C_ASSERT( FIELD_OFFSET(struct set_fd_disp_info_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct set_fd_disp_info_request, unlink) == 16 );
 C_ASSERT( sizeof(struct set_fd_disp_info_request) == 24 );
@@ -38,25 +38,31 @@
 
 struct semaphore
 {
-    struct object  obj;    /* object header */
-    unsigned int   count;  /* current count */
-    unsigned int   max;    /* maximum possible count */
+    struct object         obj;      /* object header */
+    unsigned int          max;      /* maximum possible count */
+    struct sync_shm_slot *slot;     /* current count, local or in the sync shared memory */
+    struct sync_shm_slot  local;    /* local state when not using the shared memory */
+    struct sync_shm      *shm;      /* shared memory holding the state, if any */
+    int                   shm_idx;  /* index of the state in the shared memory */
 };
 
 static void semaphore_dump( struct object *obj, int verbose );
 static struct object_type *semaphore_get_type( struct object *obj );
+static int semaphore_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void semaphore_remove_queue( struct object *obj, struct wait_queue_entry *entry );
 static int semaphore_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void semaphore_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static unsigned int semaphore_map_access( struct object *obj, unsigned int access );
 static int semaphore_signal( struct object *obj, unsigned int access );
+static void semaphore_destroy( struct object *obj );
 
 static const struct object_ops semaphore_ops =
 {
     sizeof(struct semaphore),      /* size */
     semaphore_dump,                /* dump */
     semaphore_get_type,            /* get_type */
-    add_queue,                     /* add_queue */
-    remove_queue,                  /* remove_queue */
+    semaphore_add_queue,           /* add_queue */
+    semaphore_remove_queue,        /* remove_queue */
     semaphore_signaled,            /* signaled */
     semaphore_satisfied,           /* satisfied */
     semaphore_signal,              /* signal */
@@ -67,7 +73,7 @@ static const struct object_ops semaphore_ops =
     no_lookup_name,                /* lookup_name */
     no_open_file,                  /* open_file */
     no_close_handle,               /* close_handle */
-    no_destroy                     /* destroy */
+    semaphore_destroy              /* destroy */
 };
 
 
@@ -87,8 +93,12 @@ static struct semaphore *create_semaphore( struct directory *root, const struct
         if (get_error() != STATUS_OBJECT_NAME_EXISTS)
         {
             /* initialize it if it didn't already exist */
-            sem->count = initial;
-            sem->max   = max;
+            sem->max         = max;
+            sem->slot        = &sem->local;
+            sem->local.state = initial;
+            sem->local.count = max;
+            sem->shm         = NULL;
+            sem->shm_idx     = -1;
             if (sd) default_set_sd( &sem->obj, sd, OWNER_SECURITY_INFORMATION|
                                                    GROUP_SECURITY_INFORMATION|
                                                    DACL_SECURITY_INFORMATION|
@@ -98,25 +108,45 @@ static struct semaphore *create_semaphore( struct directory *root, const struct
     return sem;
 }
 
-static int release_semaphore( struct semaphore *sem, unsigned int count,
-                              unsigned int *prev )
+/* move the state of a new private semaphore to the sync shared memory of the process */
+static int use_sync_shm( struct semaphore *sem, struct process *process )
 {
-    if (prev) *prev = sem->count;
-    if (sem->count + count < sem->count || sem->count + count > sem->max)
-    {
-        set_error( STATUS_SEMAPHORE_LIMIT_EXCEEDED );
-        return 0;
-    }
-    else if (sem->count)
+    if ((sem->shm_idx = alloc_sync_shm_slot( process, &sem->obj, &sem->shm )) != -1)
     {
-        /* there cannot be any thread to wake up if the count is != 0 */
-        sem->count += count;
+        sem->slot = get_sync_shm_slot( sem->shm, sem->shm_idx );
+        sem->slot->state = sem->local.state;
+        sem->slot->count = sem->max;
     }
-    else
+    return sem->shm_idx;
+}
+
+static inline unsigned int get_semaphore_count( struct semaphore *sem )
+{
+    return sem->slot->state & ~SYNC_SHM_SERVER;
+}
+
+static int release_semaphore( struct semaphore *sem, unsigned int count,
+                              unsigned int *prev )
+{
+    unsigned int current;
+    int state, old = sem->slot->state;
+
+    /* the client may change the count concurrently unless we have waiters */
+    do
     {
-        sem->count = count;
-        wake_up( &sem->obj, count );
-    }
+        state = old;
+        current = state & ~SYNC_SHM_SERVER;
+        if (prev) *prev = current;
+        if (current + count < current || current + count > sem->max)
+        {
+            set_error( STATUS_SEMAPHORE_LIMIT_EXCEEDED );
+            return 0;
+        }
+        old = interlocked_cmpxchg( &sem->slot->state, (state & SYNC_SHM_SERVER) | (current + count), state );
+    } while (old != state);
+
+    /* there cannot be any thread to wake up if the count was != 0 */
+    if (!current) wake_up( &sem->obj, count );
     return 1;
 }
 
@@ -124,7 +154,7 @@ static void semaphore_dump( struct object *obj, int verbose )
 {
     struct semaphore *sem = (struct semaphore *)obj;
     assert( obj->ops == &semaphore_ops );
-    fprintf( stderr, "Semaphore count=%d max=%d ", sem->count, sem->max );
+    fprintf( stderr, "Semaphore count=%d max=%d shm=%d ", get_semaphore_count( sem ), sem->max, sem->shm_idx );
     dump_object_name( &sem->obj );
     fputc( '\n', stderr );
 }
@@ -136,19 +166,33 @@ static struct object_type *semaphore_get_type( struct object *obj )
     return get_object_type( &str );
 }
 
+static int semaphore_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    return sync_shm_add_queue( obj, entry, sem->slot );
+}
+
+static void semaphore_remove_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    sync_shm_remove_queue( obj, entry, sem->slot );
+}
+
 static int semaphore_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct semaphore *sem = (struct semaphore *)obj;
     assert( obj->ops == &semaphore_ops );
-    return (sem->count > 0);
+    return (get_semaphore_count( sem ) > 0);
 }
 
 static void semaphore_satisfied( struct object *obj, struct wait_queue_entry *entry )
 {
     struct semaphore *sem = (struct semaphore *)obj;
     assert( obj->ops == &semaphore_ops );
-    assert( sem->count );
-    sem->count--;
+    /* we have a waiter, so the client can't change the count under us */
+    if (get_semaphore_count( sem )) interlocked_xchg_add( &sem->slot->state, -1 );
 }
 
 static unsigned int semaphore_map_access( struct object *obj, unsigned int access )
@@ -173,6 +217,14 @@ static int semaphore_signal( struct object *obj, unsigned int access )
     return release_semaphore( sem, 1, NULL );
 }
 
+static void semaphore_destroy( struct object *obj )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+
+    if (sem->shm) free_sync_shm_slot( sem->shm, sem->shm_idx );
+}
+
 /* create a semaphore */
 DECL_HANDLER(create_semaphore)
 {
@@ -183,6 +235,7 @@ DECL_HANDLER(create_semaphore)
     const struct security_descriptor *sd;
 
     reply->handle = 0;
+    reply->shm_idx = -1;
 
     if (!objattr_is_valid( objattr, get_req_data_size() ))
         return;
@@ -198,7 +251,14 @@ DECL_HANDLER(create_semaphore)
         if (get_error() == STATUS_OBJECT_NAME_EXISTS)
             reply->handle = alloc_handle( current->process, sem, req->access, req->attributes );
         else
+        {
             reply->handle = alloc_handle_no_access_check( current->process, sem, req->access, req->attributes );
+            /* private semaphores with full access can be used directly by the client */
+            if (reply->handle && !name.len && !(req->attributes & OBJ_INHERIT) &&
+                (get_handle_access( current->process, reply->handle ) & (SYNCHRONIZE | SEMAPHORE_MODIFY_STATE)) ==
+                (SYNCHRONIZE | SEMAPHORE_MODIFY_STATE))
+                reply->shm_idx = use_sync_shm( sem, current->process );
+        }
         release_object( sem );
     }
 
@@ -246,7 +306,7 @@ DECL_HANDLER(query_semaphore)
     if ((sem = (struct semaphore *)get_handle_obj( current->process, req->handle,
                                                    SEMAPHORE_QUERY_STATE, &semaphore_ops )))
     {
-        reply->current = sem->count;
+        reply->current = get_semaphore_count( sem );
         reply->max = sem->max;
         release_object( sem );
     }
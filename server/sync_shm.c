@@ -0,0 +1,186 @@
+/*
+ * Shared memory for process-private synchronization objects
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * The state of unnamed events, mutexes and semaphores is stored in a memory
+ * area shared with the process that created them, so that the client can
+ * signal them and acquire them without a server round-trip as long as the
+ * server doesn't have any thread waiting on them. While the server has
+ * waiters, the SYNC_SHM_SERVER bit is set in the state and the client sends
+ * all its operations to the server. Handles to these objects that end up
+ * in other processes always go through the server, which operates on the
+ * shared state.
+ */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <sys/types.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#include <unistd.h>
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winternl.h"
+
+#include "object.h"
+#include "process.h"
+#include "thread.h"
+#include "request.h"
+
+struct sync_shm
+{
+    unsigned int          refcount;    /* references from the process and from the objects */
+    struct sync_shm_slot *slots;       /* shared memory area */
+    struct object       **objects;     /* object using each allocated slot */
+    unsigned int         *free_slots;  /* stack of freed slot indices */
+    unsigned int          nb_free;     /* number of entries in the free stack */
+    unsigned int          used;        /* number of slots ever allocated */
+    unsigned int          size;        /* size of the objects and free_slots arrays */
+};
+
+/* release a reference to the shared memory of a process */
+void release_sync_shm( struct sync_shm *shm )
+{
+    if (--shm->refcount) return;
+    munmap( shm->slots, SYNC_SHM_SIZE );
+    free( shm->objects );
+    free( shm->free_slots );
+    free( shm );
+}
+
+/* allocate a slot in the shared memory of a process, returning its index or -1 */
+int alloc_sync_shm_slot( struct process *process, struct object *obj, struct sync_shm **ret )
+{
+    struct sync_shm *shm = process->sync_shm;
+    unsigned int index;
+
+    if (!shm) return -1;
+    if (shm->nb_free) index = shm->free_slots[--shm->nb_free];
+    else
+    {
+        if (shm->used == SYNC_SHM_SLOTS) return -1;
+        if (shm->used == shm->size)
+        {
+            unsigned int new_size = shm->size ? shm->size * 2 : 64;
+            struct object **new_objects;
+            unsigned int *new_free;
+
+            if (!(new_objects = realloc( shm->objects, new_size * sizeof(*new_objects) ))) return -1;
+            shm->objects = new_objects;
+            if (!(new_free = realloc( shm->free_slots, new_size * sizeof(*new_free) ))) return -1;
+            shm->free_slots = new_free;
+            shm->size = new_size;
+        }
+        index = shm->used++;
+    }
+    shm->objects[index] = obj;
+    shm->refcount++;
+    *ret = shm;
+    return index;
+}
+
+/* return the shared state of a slot */
+struct sync_shm_slot *get_sync_shm_slot( struct sync_shm *shm, int index )
+{
+    return &shm->slots[index];
+}
+
+/* free a slot when its object is destroyed */
+void free_sync_shm_slot( struct sync_shm *shm, int index )
+{
+    assert( shm->objects[index] );
+    shm->objects[index] = NULL;
+    shm->free_slots[shm->nb_free++] = index;
+    release_sync_shm( shm );
+}
+
+/* call a function for all the objects stored in the shared memory of a process */
+void enum_sync_shm_objects( struct process *process, void (*func)( struct object *, void * ), void *arg )
+{
+    struct sync_shm *shm = process->sync_shm;
+    unsigned int i;
+
+    if (!shm) return;
+    shm->refcount++;  /* the callback may destroy objects */
+    for (i = 0; i < shm->used; i++) if (shm->objects[i]) func( shm->objects[i], arg );
+    release_sync_shm( shm );
+}
+
+/* atomically clear and set bits of a shared state, returning the previous state */
+int update_sync_shm_state( struct sync_shm_slot *slot, int clear, int set )
+{
+    int state, prev = slot->state;
+
+    do
+    {
+        state = prev;
+        prev = interlocked_cmpxchg( &slot->state, (state & ~clear) | set, state );
+    } while (prev != state);
+    return prev;
+}
+
+/* add a waiter to a sync object, which moves its state under the control of the server */
+int sync_shm_add_queue( struct object *obj, struct wait_queue_entry *entry, struct sync_shm_slot *slot )
+{
+    if (!add_queue( obj, entry )) return 0;
+    /* the signaled state is checked after this, so a concurrent client change can't be missed */
+    update_sync_shm_state( slot, 0, SYNC_SHM_SERVER );
+    return 1;
+}
+
+/* remove a waiter from a sync object, giving the state back to the client after the last one */
+void sync_shm_remove_queue( struct object *obj, struct wait_queue_entry *entry, struct sync_shm_slot *slot )
+{
+    if (list_head( &obj->wait_queue ) == &entry->entry && !list_next( &obj->wait_queue, &entry->entry ))
+        update_sync_shm_state( slot, SYNC_SHM_SERVER, 0 );
+    remove_queue( obj, entry );
+}
+
+/* set the shared memory area of the current process */
+DECL_HANDLER(set_sync_shm)
+{
+    struct sync_shm *shm;
+    int fd = thread_get_inflight_fd( current, req->shm_fd );
+
+    if (fd == -1)
+    {
+        set_error( STATUS_INVALID_HANDLE );
+        return;
+    }
+    if (current->process->sync_shm) set_error( STATUS_INVALID_PARAMETER );
+    else if ((shm = mem_alloc( sizeof(*shm) )))
+    {
+        memset( shm, 0, sizeof(*shm) );
+        if ((shm->slots = map_client_shm( fd, SYNC_SHM_SIZE )))
+        {
+            shm->refcount = 1;
+            current->process->sync_shm = shm;
+        }
+        else free( shm );
+    }
+    close( fd );
+}
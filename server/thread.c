@@ -189,6 +189,10 @@ static inline void init_thread_structure( struct thread *thread )
     thread->request_fd      = NULL;
     thread->reply_fd        = NULL;
     thread->wait_fd         = NULL;
+    thread->request_shm     = NULL;
+    thread->reply_shm       = 0;
+    thread->worker_error    = 0;
+    thread->worker_defer    = 0;
     thread->state           = RUNNING;
     thread->exit_code       = 0;
     thread->priority        = 0;
@@ -283,6 +287,7 @@ static void cleanup_thread( struct thread *thread )
     if (thread->request_fd) release_object( thread->request_fd );
     if (thread->reply_fd) release_object( thread->reply_fd );
     if (thread->wait_fd) release_object( thread->wait_fd );
+    close_request_shm( thread );
     free( thread->suspend_context );
     cleanup_clipboard_thread(thread);
     destroy_thread_windows( thread );
@@ -1332,6 +1337,20 @@ DECL_HANDLER(init_thread)
     if (wait_fd != -1) close( wait_fd );
 }
 
+/* set the shared memory area used to reply to small requests */
+DECL_HANDLER(set_request_shm)
+{
+    int fd = thread_get_inflight_fd( current, req->shm_fd );
+
+    if (fd == -1)
+    {
+        set_error( STATUS_INVALID_HANDLE );
+        return;
+    }
+    set_request_shm( current, fd );
+    close( fd );
+}
+
 /* terminate a thread */
 DECL_HANDLER(terminate_thread)
 {
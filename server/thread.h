@@ -72,6 +72,11 @@ struct thread
     struct fd             *request_fd;    /* fd for receiving client requests */
     struct fd             *reply_fd;      /* fd to send a reply to a client */
     struct fd             *wait_fd;       /* fd to use to wake a sleeping client */
+    struct request_shm    *request_shm;   /* shared memory area for small request replies */
+    int                    reply_shm;     /* send the current reply through the shared memory */
+    struct list            worker_entry;  /* entry in the worker threads queues */
+    int                    worker_error;  /* reply write error to handle in the main thread */
+    int                    worker_defer;  /* request has to be run by the main thread after all */
     enum run_state         state;         /* running state */
     int                    exit_code;     /* thread exit code */
     int                    unix_pid;      /* Unix pid of client */
@@ -97,7 +102,7 @@ struct thread_snapshot
     int             priority;  /* priority class */
 };
 
-extern struct thread *current;
+extern THREAD_LOCAL struct thread *current;
 
 /* thread functions */
 
@@ -137,7 +142,7 @@ extern int send_thread_signal( struct thread *thread, int sig );
 extern void get_selector_entry( struct thread *thread, int entry, unsigned int *base,
                                 unsigned int *limit, unsigned char *flags );
 
-extern unsigned int global_error;  /* global error code for when no thread is current */
+extern THREAD_LOCAL unsigned int global_error;  /* global error code for when no thread is current */
 
 static inline unsigned int get_error(void)       { return current ? current->error : global_error; }
 static inline void set_error( unsigned int err ) { global_error = err; if (current) current->error = err; }
@@ -1159,6 +1159,57 @@ static void dump_varargs_handle_infos( const char *prefix, data_size_t size )
     fputc( '}', stderr );
 }
 
+static void dump_varargs_handles( const char *prefix, data_size_t size )
+{
+    const obj_handle_t *data = cur_data;
+    data_size_t len = size / sizeof(*data);
+
+    fprintf( stderr, "%s{", prefix );
+    while (len > 0)
+    {
+        fprintf( stderr, "%04x", *data++ );
+        if (--len) fputc( ',', stderr );
+    }
+    fputc( '}', stderr );
+    remove_data( size );
+}
+
+static void dump_varargs_handle_fd_infos( const char *prefix, data_size_t size )
+{
+    const struct handle_fd_info *info;
+
+    fprintf( stderr, "%s{", prefix );
+    while (size >= sizeof(*info))
+    {
+        info = cur_data;
+        fprintf( stderr, "{handle=%04x,type=%d,cacheable=%d,access=%08x,options=%08x}",
+                 info->handle, info->type, info->cacheable, info->access, info->options );
+        size -= sizeof(*info);
+        remove_data( sizeof(*info) );
+        if (size) fputc( ',', stderr );
+    }
+    fputc( '}', stderr );
+}
+
+static void dump_varargs_completion_packets( const char *prefix, data_size_t size )
+{
+    const struct completion_packet *packet;
+
+    fprintf( stderr, "%s{", prefix );
+    while (size >= sizeof(*packet))
+    {
+        packet = cur_data;
+        dump_uint64( "{ckey=", &packet->ckey );
+        dump_uint64( ",cvalue=", &packet->cvalue );
+        dump_uint64( ",information=", &packet->information );
+        fprintf( stderr, ",status=%08x}", packet->status );
+        size -= sizeof(*packet);
+        remove_data( sizeof(*packet) );
+        if (size) fputc( ',', stderr );
+    }
+    fputc( '}', stderr );
+}
+
 typedef void (*dump_func)( const void *req );
 
 /* Everything below this line is generated automatically by tools/make_requests */
@@ -1256,6 +1307,21 @@ static void dump_init_thread_reply( const struct init_thread_reply *req )
     fprintf( stderr, ", all_cpus=%08x", req->all_cpus );
 }
 
+static void dump_set_request_shm_request( const struct set_request_shm_request *req )
+{
+    fprintf( stderr, " shm_fd=%d", req->shm_fd );
+}
+
+static void dump_set_sync_shm_request( const struct set_sync_shm_request *req )
+{
+    fprintf( stderr, " shm_fd=%d", req->shm_fd );
+}
+
+static void dump_set_handle_shm_request( const struct set_handle_shm_request *req )
+{
+    fprintf( stderr, " shm_fd=%d", req->shm_fd );
+}
+
 static void dump_terminate_process_request( const struct terminate_process_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -1505,6 +1571,7 @@ static void dump_create_event_request( const struct create_event_request *req )
 static void dump_create_event_reply( const struct create_event_reply *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", shm_idx=%d", req->shm_idx );
 }
 
 static void dump_event_op_request( const struct event_op_request *req )
@@ -1573,6 +1640,7 @@ static void dump_create_mutex_request( const struct create_mutex_request *req )
 static void dump_create_mutex_reply( const struct create_mutex_reply *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", shm_idx=%d", req->shm_idx );
 }
 
 static void dump_release_mutex_request( const struct release_mutex_request *req )
@@ -1610,6 +1678,7 @@ static void dump_create_semaphore_request( const struct create_semaphore_request
 static void dump_create_semaphore_reply( const struct create_semaphore_reply *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", shm_idx=%d", req->shm_idx );
 }
 
 static void dump_release_semaphore_request( const struct release_semaphore_request *req )
@@ -1715,6 +1784,16 @@ static void dump_get_handle_fd_reply( const struct get_handle_fd_reply *req )
     fprintf( stderr, ", options=%08x", req->options );
 }
 
+static void dump_get_handle_fds_request( const struct get_handle_fds_request *req )
+{
+    dump_varargs_handles( " handles=", cur_size );
+}
+
+static void dump_get_handle_fds_reply( const struct get_handle_fds_reply *req )
+{
+    dump_varargs_handle_fd_infos( " infos=", cur_size );
+}
+
 static void dump_flush_request( const struct flush_request *req )
 {
     fprintf( stderr, " blocking=%d", req->blocking );
@@ -4142,6 +4221,16 @@ static void dump_remove_completion_reply( const struct remove_completion_reply *
     fprintf( stderr, ", status=%08x", req->status );
 }
 
+static void dump_remove_completions_request( const struct remove_completions_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_remove_completions_reply( const struct remove_completions_reply *req )
+{
+    dump_varargs_completion_packets( " packets=", cur_size );
+}
+
 static void dump_query_completion_request( const struct query_completion_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -4167,6 +4256,17 @@ static void dump_add_fd_completion_request( const struct add_fd_completion_reque
     fprintf( stderr, ", status=%08x", req->status );
 }
 
+static void dump_get_fd_completion_request( const struct get_fd_completion_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_get_fd_completion_reply( const struct get_fd_completion_reply *req )
+{
+    fprintf( stderr, " completion=%04x", req->completion );
+    dump_uint64( ", ckey=", &req->ckey );
+}
+
 static void dump_set_fd_disp_info_request( const struct set_fd_disp_info_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -4307,6 +4407,9 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_startup_info_request,
     (dump_func)dump_init_process_done_request,
     (dump_func)dump_init_thread_request,
+    (dump_func)dump_set_request_shm_request,
+    (dump_func)dump_set_sync_shm_request,
+    (dump_func)dump_set_handle_shm_request,
     (dump_func)dump_terminate_process_request,
     (dump_func)dump_terminate_thread_request,
     (dump_func)dump_get_process_info_request,
@@ -4345,6 +4448,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_alloc_file_handle_request,
     (dump_func)dump_get_handle_unix_name_request,
     (dump_func)dump_get_handle_fd_request,
+    (dump_func)dump_get_handle_fds_request,
     (dump_func)dump_flush_request,
     (dump_func)dump_lock_file_request,
     (dump_func)dump_unlock_file_request,
@@ -4552,9 +4656,11 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_open_completion_request,
     (dump_func)dump_add_completion_request,
     (dump_func)dump_remove_completion_request,
+    (dump_func)dump_remove_completions_request,
     (dump_func)dump_query_completion_request,
     (dump_func)dump_set_completion_info_request,
     (dump_func)dump_add_fd_completion_request,
+    (dump_func)dump_get_fd_completion_request,
     (dump_func)dump_set_fd_disp_info_request,
     (dump_func)dump_set_fd_name_info_request,
     (dump_func)dump_get_window_layered_info_request,
@@ -4580,6 +4686,9 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_startup_info_reply,
     NULL,
     (dump_func)dump_init_thread_reply,
+    NULL,
+    NULL,
+    NULL,
     (dump_func)dump_terminate_process_reply,
     (dump_func)dump_terminate_thread_reply,
     (dump_func)dump_get_process_info_reply,
@@ -4618,6 +4727,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_alloc_file_handle_reply,
     (dump_func)dump_get_handle_unix_name_reply,
     (dump_func)dump_get_handle_fd_reply,
+    (dump_func)dump_get_handle_fds_reply,
     (dump_func)dump_flush_reply,
     (dump_func)dump_lock_file_reply,
     NULL,
@@ -4825,9 +4935,11 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_open_completion_reply,
     NULL,
     (dump_func)dump_remove_completion_reply,
+    (dump_func)dump_remove_completions_reply,
     (dump_func)dump_query_completion_reply,
     NULL,
     NULL,
+    (dump_func)dump_get_fd_completion_reply,
     NULL,
     NULL,
     (dump_func)dump_get_window_layered_info_reply,
@@ -4853,6 +4965,9 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "get_startup_info",
     "init_process_done",
     "init_thread",
+    "set_request_shm",
+    "set_sync_shm",
+    "set_handle_shm",
     "terminate_process",
     "terminate_thread",
     "get_process_info",
@@ -4891,6 +5006,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "alloc_file_handle",
     "get_handle_unix_name",
     "get_handle_fd",
+    "get_handle_fds",
     "flush",
     "lock_file",
     "unlock_file",
@@ -5098,9 +5214,11 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "open_completion",
     "add_completion",
     "remove_completion",
+    "remove_completions",
     "query_completion",
     "set_completion_info",
     "add_fd_completion",
+    "get_fd_completion",
     "set_fd_disp_info",
     "set_fd_name_info",
     "get_window_layered_info",